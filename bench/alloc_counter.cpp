@@ -0,0 +1,62 @@
+#include "alloc_counter.h"
+#include "alloc_stats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef PLEYX_ALLOC_STATS
+
+// pleyx's own hook already counts every allocation, by tag
+AllocSnapshot allocSnapshot() {
+    AllocSnapshot snapshot;
+    for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); i++) {
+        AllocTotals totals = allocTotals(static_cast<AllocTag>(i));
+        snapshot.count += totals.count;
+        snapshot.bytes += totals.bytes;
+    }
+    return snapshot;
+}
+
+#else
+
+static std::atomic<uint64_t> g_allocCount{0};
+static std::atomic<uint64_t> g_allocBytes{0};
+
+AllocSnapshot allocSnapshot() {
+    AllocSnapshot snapshot;
+    snapshot.count = g_allocCount.load(std::memory_order_relaxed);
+    snapshot.bytes = g_allocBytes.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void* operator new(std::size_t size) {
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Process-wide heap allocation counters, fed by the replaced global
+// operator new in alloc_counter.cpp (or, when built with
+// PLEYX_ALLOC_STATS, summed over pleyx's per-tag counters). Benchmarks
+// snapshot them around a measured region to report allocations per
+// operation.
+struct AllocSnapshot {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+AllocSnapshot allocSnapshot();
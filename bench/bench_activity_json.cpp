@@ -0,0 +1,129 @@
+// SET_ACTIVITY serialization benchmark: the old dump -> parse -> wrap -> dump
+// round-trip through nlohmann::json against the single-pass JsonWriter path.
+
+#include "alloc_counter.h"
+#include "discord.h"
+
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+static MediaInfo sampleEpisode() {
+    MediaInfo info;
+    info.activityType = ActivityType::Watching;
+    info.details = "The Expanse";
+    info.state = "S03E07 \xE2\x80\xA2 Delta-V";
+    info.largeImage = "https://files.catbox.moe/abcdef.jpg";
+    info.largeText = "The Expanse";
+    info.imdbId = "tt3230854";
+    info.durationMs = 2700000;
+    info.progressMs = 600000;
+    info.isPlaying = true;
+    return info;
+}
+
+// The serialization path as it was before the JsonWriter
+static std::string legacyActivityJson(const MediaInfo& info) {
+    json activity;
+    activity["type"] = static_cast<int>(info.activityType);
+    activity["details"] = info.details;
+    activity["state"] = info.state;
+    activity["assets"] = {
+        {"large_image", info.largeImage},
+        {"large_text", info.largeText},
+        {"small_image", info.smallImage},
+        {"small_text", info.smallText}
+    };
+    if (info.isPlaying && info.durationMs > 0) {
+        int64_t nowSecs = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        activity["timestamps"] = {
+            {"start", nowSecs - (info.progressMs / 1000)},
+            {"end", nowSecs + ((info.durationMs - info.progressMs) / 1000)}
+        };
+    }
+    json buttons = json::array();
+    if (info.imdbId.has_value() && !info.imdbId->empty()) {
+        buttons.push_back({
+            {"label", "View on IMDb"},
+            {"url", "https://www.imdb.com/title/" + *info.imdbId}
+        });
+    }
+    if (!buttons.empty()) {
+        activity["buttons"] = buttons;
+    }
+    return activity.dump();
+}
+
+static std::string legacyEnvelope(const MediaInfo& info, int nonce) {
+    json activity = json::parse(legacyActivityJson(info));
+    json payload = {
+        {"cmd", "SET_ACTIVITY"},
+        {"args", {
+            {"pid", 4242},
+            {"activity", activity}
+        }},
+        {"nonce", std::to_string(nonce)}
+    };
+    return payload.dump();
+}
+
+static void report(const char* name, uint64_t iterations, Clock::duration elapsed,
+                   const AllocSnapshot& before, const AllocSnapshot& after) {
+    double secs = std::chrono::duration<double>(elapsed).count();
+    printf("%-34s %10.0f ops/s  %8.0f ns/op  %6.1f allocs/op  %8.1f bytes/op\n",
+        name,
+        iterations / secs,
+        secs * 1e9 / iterations,
+        static_cast<double>(after.count - before.count) / iterations,
+        static_cast<double>(after.bytes - before.bytes) / iterations);
+}
+
+int main(int argc, char** argv) {
+    uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    MediaInfo info = sampleEpisode();
+
+    // Both paths must produce the same document
+    std::string activity;
+    appendActivityJson(activity, info);
+    std::string envelope;
+    appendSetActivityCommand(envelope, 4242, activity, "1");
+    if (json::parse(envelope) != json::parse(legacyEnvelope(info, 1))) {
+        fprintf(stderr, "Serializations differ:\n%s\n%s\n", envelope.c_str(), legacyEnvelope(info, 1).c_str());
+        return 1;
+    }
+
+    printf("SET_ACTIVITY serialization benchmark (%llu iterations, %zu byte envelope)\n",
+        static_cast<unsigned long long>(iterations), envelope.size());
+
+    size_t sink = 0;
+    {
+        AllocSnapshot before = allocSnapshot();
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            sink += legacyEnvelope(info, static_cast<int>(i)).size();
+        }
+        report("dump -> parse -> dump (legacy)", iterations, Clock::now() - start, before, allocSnapshot());
+    }
+    {
+        // Steady state of the IPC worker: both buffers keep their capacity
+        AllocSnapshot before = allocSnapshot();
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            activity.clear();
+            appendActivityJson(activity, info);
+            envelope.clear();
+            appendSetActivityCommand(envelope, 4242, activity, "123456");
+            sink += envelope.size();
+        }
+        report("single pass (JsonWriter + splice)", iterations, Clock::now() - start, before, allocSnapshot());
+    }
+
+    if (sink == 42) printf(" ");  // Keep the loops observable
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Discord IPC protocol benchmark against the local stand-in server:
+// publish round-trip percentiles and time to reconnect after Discord drops
+// the connection.
+
+#include "discord.h"
+#include "discord_standin.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+static void report(const char* name, const std::vector<double>& samplesUs) {
+    printf("%-24s n=%-5zu p50=%8.1fus  p90=%8.1fus  p99=%8.1fus  max=%8.1fus\n",
+        name, samplesUs.size(),
+        percentile(samplesUs, 50), percentile(samplesUs, 90),
+        percentile(samplesUs, 99), percentile(samplesUs, 100));
+}
+
+// Waits until the worker has completed a connect beyond connectsBefore
+static bool waitForReconnect(Discord& discord, uint64_t connectsBefore, std::chrono::milliseconds limit) {
+    auto deadline = Clock::now() + limit;
+    while (discord.stats().connects <= connectsBefore || !discord.isConnected()) {
+        if (Clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int updates = 500;
+    int reconnects = 20;
+    DiscordStandinOptions options;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        int value = atoi(argv[i + 1]);
+        if (arg == "--updates") updates = value;
+        else if (arg == "--reconnects") reconnects = value;
+        else if (arg == "--latency-ms") options.latency = std::chrono::milliseconds(value);
+        else if (arg == "--jitter-ms") options.jitter = std::chrono::milliseconds(value);
+    }
+
+#ifndef _WIN32
+    // Keep the stand-in away from a real Discord client's socket
+    char dirTemplate[] = "/tmp/pleyx-bench-XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_RUNTIME_DIR", dir, 1);
+#else
+    printf("Note: close Discord first, the stand-in uses its pipe name\n");
+#endif
+
+    DiscordStandin standin(options);
+    if (!standin.start()) {
+        return 1;
+    }
+
+    std::vector<double> ipcRtt;
+    std::vector<double> endToEnd;
+    std::vector<double> reconnectTimes;
+    int failures = 0;
+    {
+        Discord discord("0");
+        if (!discord.connect().get().ok) {
+            fprintf(stderr, "Could not connect to the stand-in\n");
+            return 1;
+        }
+
+        MediaInfo info;
+        info.activityType = ActivityType::Watching;
+        info.largeImage = "tv";
+        info.largeText = "Benchmark";
+        info.durationMs = 2700000;
+        info.isPlaying = true;
+
+        for (int i = 0; i < updates; i++) {
+            info.details = "Update " + std::to_string(i);
+            info.progressMs = i * 1000;
+            auto start = Clock::now();
+            IpcResponse response = discord.updatePresence(info).get();
+            auto elapsed = Clock::now() - start;
+            if (!response.ok) {
+                failures++;
+                continue;
+            }
+            ipcRtt.push_back(static_cast<double>(response.roundTrip.count()));
+            endToEnd.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+        }
+
+        // Dropped connections are restored by the worker on its own
+        for (int i = 0; i < reconnects; i++) {
+            uint64_t connectsBefore = discord.stats().connects;
+            auto start = Clock::now();
+            standin.dropClients();
+            if (!waitForReconnect(discord, connectsBefore, std::chrono::seconds(10))) {
+                fprintf(stderr, "Reconnect %d did not complete\n", i);
+                failures++;
+                continue;
+            }
+            reconnectTimes.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+    }
+
+    standin.stop();
+#ifndef _WIN32
+    rmdir(dir);
+#endif
+
+    DiscordStandinStats stats = standin.stats();
+    printf("Discord IPC benchmark (%d updates, %d reconnects, latency %lldms, jitter %lldms)\n",
+        updates, reconnects,
+        static_cast<long long>(options.latency.count()), static_cast<long long>(options.jitter.count()));
+    report("publish round-trip", ipcRtt);
+    report("publish end-to-end", endToEnd);
+    report("reconnect", reconnectTimes);
+    printf("failures=%d  server: connections=%llu commands=%llu replies=%llu\n", failures,
+        static_cast<unsigned long long>(stats.connections),
+        static_cast<unsigned long long>(stats.commands),
+        static_cast<unsigned long long>(stats.replies));
+    return failures == 0 ? 0 : 1;
+}
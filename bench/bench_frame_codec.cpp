@@ -0,0 +1,235 @@
+// Frame codec microbenchmark: frames per second and heap allocations per
+// frame for header encoding and for the full write/read path of
+// DiscordTransport over a local socket pair, then the same per publish for
+// DiscordIPC's reactor side (queue, execute, frame write) against a local
+// endpoint, with and without a future for the result.
+
+#include "alloc_counter.h"
+#include "discord_ipc.h"
+#include "discord_transport.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// Roughly the size of a SET_ACTIVITY envelope for a TV episode
+static std::string samplePayload() {
+    std::string payload = "{\"cmd\":\"SET_ACTIVITY\",\"args\":{\"pid\":4242,\"activity\":{\"type\":3,"
+        "\"details\":\"The Expanse\",\"state\":\"S03E07 \\u2022 Delta-V\",\"assets\":{"
+        "\"large_image\":\"https://files.catbox.moe/abcdef.jpg\",\"large_text\":\"The Expanse\","
+        "\"small_image\":\"plex\",\"small_text\":\"Plex\"},\"timestamps\":{\"start\":1700000000,"
+        "\"end\":1700002700},\"buttons\":[{\"label\":\"View on IMDb\","
+        "\"url\":\"https://www.imdb.com/title/tt3230854\"}]}},\"nonce\":\"123456\"}";
+    return payload;
+}
+
+// The activity object of that envelope, as the pipeline hands it over
+static std::string sampleActivity() {
+    return "{\"type\":3,\"details\":\"The Expanse\",\"state\":\"S03E07 \\u2022 Delta-V\","
+        "\"assets\":{\"large_image\":\"https://files.catbox.moe/abcdef.jpg\","
+        "\"large_text\":\"The Expanse\",\"small_image\":\"plex\",\"small_text\":\"Plex\"},"
+        "\"timestamps\":{\"start\":1700000000,\"end\":1700002700},\"buttons\":[{"
+        "\"label\":\"View on IMDb\",\"url\":\"https://www.imdb.com/title/tt3230854\"}]}";
+}
+
+static void report(const char* name, uint64_t frames, Clock::duration elapsed,
+                   const AllocSnapshot& before, const AllocSnapshot& after) {
+    double secs = std::chrono::duration<double>(elapsed).count();
+    printf("%-28s %10.0f frames/s  %6.2f allocs/frame  %8.1f bytes/frame\n",
+        name,
+        frames / secs,
+        static_cast<double>(after.count - before.count) / frames,
+        static_cast<double>(after.bytes - before.bytes) / frames);
+}
+
+static void benchHeaderCodec(uint64_t frames) {
+    char header[FRAME_HEADER_SIZE];
+    uint64_t checksum = 0;
+
+    AllocSnapshot before = allocSnapshot();
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < frames; i++) {
+        encodeFrameHeader(header, OP_FRAME, static_cast<uint32_t>(i & 0xFFFF));
+        int opcode;
+        uint32_t length;
+        decodeFrameHeader(header, opcode, length);
+        checksum += length + static_cast<uint32_t>(opcode);
+    }
+    auto elapsed = Clock::now() - start;
+    report("header encode+decode", frames, elapsed, before, allocSnapshot());
+
+    if (checksum == 42) printf(" ");  // Keep the loop observable
+}
+
+#ifndef _WIN32
+// Baseline: what writeFrame used to do, a fresh vector per frame and one write
+static void legacyWrite(int fd, int opcode, const std::string& payload) {
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    std::vector<char> buffer(8 + len);
+    memcpy(buffer.data(), &opcode, 4);
+    memcpy(buffer.data() + 4, &len, 4);
+    memcpy(buffer.data() + 8, payload.c_str(), len);
+    if (write(fd, buffer.data(), buffer.size()) < 0) {
+        perror("write");
+    }
+}
+
+static void benchRoundTrip(uint64_t frames, bool legacy) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        return;
+    }
+
+    DiscordTransport writer;
+    DiscordTransport reader;
+    writer.adopt(fds[0]);
+    reader.adopt(fds[1]);
+
+    const std::string payload = samplePayload();
+    const uint64_t warmup = 1000;
+
+    // Reader drains into one reused string, like DiscordTransport's frame buffer
+    std::thread drain([&] {
+        int opcode;
+        std::string data;
+        for (uint64_t i = 0; i < warmup + frames; i++) {
+            if (!reader.readFrame(opcode, data, 5000)) {
+                fprintf(stderr, "read failed after %llu frames\n", static_cast<unsigned long long>(i));
+                return;
+            }
+        }
+    });
+
+    for (uint64_t i = 0; i < warmup; i++) {
+        writer.writeFrame(OP_FRAME, payload);
+    }
+
+    AllocSnapshot before = allocSnapshot();
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < frames; i++) {
+        if (legacy) {
+            legacyWrite(fds[0], OP_FRAME, payload);
+        } else {
+            writer.writeFrame(OP_FRAME, payload);
+        }
+    }
+    drain.join();
+    auto elapsed = Clock::now() - start;
+
+    report(legacy ? "write+read (legacy vector)" : "write+read (gather)", frames, elapsed,
+        before, allocSnapshot());
+}
+
+// Publishes through DiscordIPC to an endpoint that completes the handshake
+// and then only reads. Without replies the count covers the reactor side
+// of a publish up to the pipe, not the JSON parse of Discord's answer; the
+// ring of pending commands stays full, so each one supersedes the oldest.
+static void benchExecute(uint64_t publishes, bool withResult) {
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::string path = DiscordTransport::endpointName(0);
+    if (listener < 0 || path.size() >= sizeof(addr.sun_path)) {
+        perror("socket");
+        return;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+        perror("bind");
+        close(listener);
+        return;
+    }
+
+    std::thread sink([listener] {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) return;
+        DiscordTransport connection;
+        connection.adopt(fd);
+        int opcode;
+        std::string data;
+        if (!connection.readFrame(opcode, data, 5000)) return;
+        connection.writeFrame(OP_FRAME, "{\"cmd\":\"DISPATCH\",\"evt\":\"READY\",\"nonce\":null,\"data\":{}}");
+        while (connection.readFrame(opcode, data, -1)) {
+        }
+    });
+
+    {
+        DiscordIPC ipc("bench");
+        if (!ipc.connect().get().ok) {
+            fprintf(stderr, "connect failed\n");
+        } else {
+            // Each publish consumes its string, so they are made up front
+            const uint64_t warmup = 1000;
+            std::vector<std::string> activities(warmup + publishes, sampleActivity());
+            uint64_t sent = ipc.stats().requests;
+            AllocSnapshot before{};
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < warmup + publishes; i++) {
+                if (i == warmup) {
+                    before = allocSnapshot();
+                    start = Clock::now();
+                }
+                if (withResult) {
+                    ipc.sendActivity(std::move(activities[i]));
+                } else {
+                    ipc.postActivity(std::move(activities[i]));
+                }
+                // One at a time, so none is superseded in the queue
+                while (ipc.stats().requests == sent) {
+                    std::this_thread::yield();
+                }
+                sent++;
+            }
+            auto elapsed = Clock::now() - start;
+            report(withResult ? "publish (sendActivity)" : "publish (postActivity)", publishes, elapsed,
+                before, allocSnapshot());
+        }
+    }
+    sink.join();
+    close(listener);
+    unlink(path.c_str());
+}
+#endif
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+    printf("Frame codec benchmark (%llu frames, %zu byte payload)\n",
+        static_cast<unsigned long long>(frames), samplePayload().size());
+
+    benchHeaderCodec(frames * 10);
+#ifndef _WIN32
+    benchRoundTrip(frames, true);
+    benchRoundTrip(frames, false);
+
+    // Keep the endpoint away from a real Discord client's socket
+    char dirTemplate[] = "/tmp/pleyx-bench-XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_RUNTIME_DIR", dir, 1);
+    uint64_t publishes = frames / 10;
+    benchExecute(publishes, true);
+    benchExecute(publishes, false);
+    rmdir(dir);
+#else
+    printf("write+read and publish benchmarks need Unix sockets and run on POSIX only\n");
+#endif
+    return 0;
+}
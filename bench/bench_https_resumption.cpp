@@ -0,0 +1,75 @@
+// HTTPS request latency against the local TLS stand-in: the first request
+// pays a full handshake, later ones resume the cached session.
+
+#include "http_client.h"
+#include "tls_standin.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+int main(int argc, char** argv) {
+    int requests = 50;
+    TlsStandinOptions options;
+    options.latency = std::chrono::milliseconds(20);
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--requests" && i + 1 < argc) requests = atoi(argv[++i]);
+        else if (arg == "--latency-ms" && i + 1 < argc) options.latency = std::chrono::milliseconds(atoi(argv[++i]));
+        else if (arg == "--tls12") options.tls12Only = true;
+        else if (arg == "--no-tickets") options.tickets = false;
+    }
+
+    TlsStandin standin(options);
+    if (!standin.start() || !addTrustedCaFile(standin.caFile())) {
+        fprintf(stderr, "Could not start the TLS stand-in\n");
+        return 1;
+    }
+
+    double firstMs = 0.0;
+    std::vector<double> laterMs;
+    int failures = 0;
+    for (int i = 0; i < requests; i++) {
+        auto start = Clock::now();
+        HttpResponse response = httpRequest("GET", standin.url("/?t=bench"));
+        double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (!response.ok()) {
+            failures++;
+            continue;
+        }
+        if (i == 0) firstMs = elapsed;
+        else laterMs.push_back(elapsed);
+    }
+    standin.stop();
+
+    TlsStats client = tlsStats();
+    TlsStandinStats server = standin.stats();
+    printf("HTTPS resumption benchmark (%d requests, %lldms RTT, %s, %s)\n", requests,
+        static_cast<long long>(options.latency.count()),
+        options.tls12Only ? "TLS 1.2" : "TLS 1.3",
+        options.tickets ? "tickets" : "session IDs");
+    printf("%-24s %8.1fms\n", "first request (full)", firstMs);
+    printf("%-24s p50=%6.1fms  p90=%6.1fms  max=%6.1fms\n", "later requests",
+        percentile(laterMs, 50), percentile(laterMs, 90), percentile(laterMs, 100));
+    printf("client: full=%llu resumed=%llu failed=%llu  server: full=%llu resumed=%llu  failures=%d\n",
+        static_cast<unsigned long long>(client.fullHandshakes),
+        static_cast<unsigned long long>(client.resumedHandshakes),
+        static_cast<unsigned long long>(client.failedHandshakes),
+        static_cast<unsigned long long>(server.fullHandshakes),
+        static_cast<unsigned long long>(server.resumedHandshakes),
+        failures);
+    return failures == 0 && client.resumedHandshakes + 1 >= static_cast<uint64_t>(requests) ? 0 : 1;
+}
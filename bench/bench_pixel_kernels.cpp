@@ -0,0 +1,144 @@
+// Tray icon pixel kernels: grayscale, source-over compositing and the
+// anti-aliased progress ring, scalar against each SIMD path this CPU has,
+// over icon sizes (16x16, 32x32) and a 256x256 image. Checks first that
+// every path gives the scalar bytes (the ring's coverage within one step).
+
+#include "pixel_kernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const PixelIsa ISAS[] = {PixelIsa::Scalar, PixelIsa::Sse2, PixelIsa::Avx2, PixelIsa::Neon};
+static const int SIZES[] = {16, 32, 256};
+static const uint32_t RING_COLOR = 0xFFE5A00Du;  // Plex orange, opaque
+
+// Random premultiplied pixels: no channel exceeds its alpha
+static std::vector<uint32_t> randomPixels(size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> pixels(count);
+    for (auto& p : pixels) {
+        uint32_t alpha = rng() % 256;
+        // Fully transparent and opaque pixels are common in icons
+        if (rng() % 4 == 0) {
+            alpha = rng() % 2 ? 255 : 0;
+        }
+        p = alpha << 24;
+        for (int shift = 0; shift < 24; shift += 8) {
+            p |= (alpha ? rng() % (alpha + 1) : 0) << shift;
+        }
+    }
+    return pixels;
+}
+
+static bool closeEnough(uint32_t a, uint32_t b, int tolerance) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        int diff = static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((b >> shift) & 0xFF);
+        if (std::abs(diff) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool compare(const char* what, PixelIsa isa, int size, const std::vector<uint32_t>& expected,
+                    const std::vector<uint32_t>& actual, int tolerance) {
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (!closeEnough(expected[i], actual[i], tolerance)) {
+            fprintf(stderr, "%s (%s, %dx%d) differs at pixel %zu: %08x, scalar %08x\n",
+                what, pixelIsaName(isa), size, size, i, actual[i], expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sizes one above a vector width exercise the scalar tails
+static bool verify(PixelIsa isa) {
+    for (int size : {1, 7, 16, 17, 33, 256}) {
+        size_t count = static_cast<size_t>(size) * size;
+        std::vector<uint32_t> src = randomPixels(count, 1);
+        std::vector<uint32_t> dst = randomPixels(count, 2);
+
+        std::vector<uint32_t> expected(count), actual(count);
+        grayscalePixels(src.data(), expected.data(), count, 154, PixelIsa::Scalar);
+        grayscalePixels(src.data(), actual.data(), count, 154, isa);
+        if (!compare("grayscale", isa, size, expected, actual, 0)) {
+            return false;
+        }
+
+        expected = dst;
+        actual = dst;
+        compositePixels(src.data(), expected.data(), count, PixelIsa::Scalar);
+        compositePixels(src.data(), actual.data(), count, isa);
+        if (!compare("composite", isa, size, expected, actual, 0)) {
+            return false;
+        }
+
+        for (double progress : {0.0, 0.01, 0.3, 0.5, 0.77, 0.999, 1.0}) {
+            expected = dst;
+            actual = dst;
+            float thickness = size * 0.15f;
+            drawProgressRing(expected.data(), size, size, progress, thickness, RING_COLOR, PixelIsa::Scalar);
+            drawProgressRing(actual.data(), size, size, progress, thickness, RING_COLOR, isa);
+            if (!compare("ring", isa, size, expected, actual, 1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Fn>
+static double nsPerImage(Fn fn) {
+    // Enough repetitions for about 50ms at icon sizes
+    int reps = 0;
+    auto start = Clock::now();
+    Clock::duration elapsed{};
+    while (elapsed < std::chrono::milliseconds(50)) {
+        for (int i = 0; i < 64; i++) {
+            fn();
+        }
+        reps += 64;
+        elapsed = Clock::now() - start;
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / reps;
+}
+
+static void run(PixelIsa isa, int size) {
+    size_t count = static_cast<size_t>(size) * size;
+    std::vector<uint32_t> src = randomPixels(count, 3);
+    std::vector<uint32_t> dst = randomPixels(count, 4);
+    std::vector<uint32_t> out(count);
+
+    double gray = nsPerImage([&] { grayscalePixels(src.data(), out.data(), count, 154, isa); });
+    double over = nsPerImage([&] { compositePixels(src.data(), dst.data(), count, isa); });
+    // Redraws over the same pixels; the cost doesn't depend on what is there
+    double ring = nsPerImage([&] {
+        drawProgressRing(out.data(), size, size, 0.62, size * 0.15f, RING_COLOR, isa);
+    });
+    printf("%-7s %4dx%-4d %10.1f %12.1f %12.1f %10.2f\n",
+        pixelIsaName(isa), size, size, gray, over, ring, gray / count);
+}
+
+int main() {
+    for (PixelIsa isa : ISAS) {
+        if (pixelIsaSupported(isa) && isa != PixelIsa::Scalar && !verify(isa)) {
+            return 1;
+        }
+    }
+    printf("Pixel kernels (best path here: %s), ns per image\n", pixelIsaName(bestPixelIsa()));
+    printf("%-7s %-9s %10s %12s %12s %10s\n", "path", "size", "grayscale", "composite", "ring", "gray ns/px");
+    for (int size : SIZES) {
+        for (PixelIsa isa : ISAS) {
+            if (pixelIsaSupported(isa)) {
+                run(isa, size);
+            }
+        }
+    }
+    return 0;
+}
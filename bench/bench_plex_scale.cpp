@@ -0,0 +1,86 @@
+// Plex client scale benchmark against the synthetic Plex stand-in: fetch
+// and parse latency percentiles for /status/sessions from one session up
+// to hundreds of concurrent streams, optionally with server latency,
+// jitter and injected errors.
+
+#include "plex.h"
+#include "plex_standin.h"
+#include "log.h"
+#include "reactor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+int main(int argc, char** argv) {
+    int fetches = 50;
+    PlexStandinOptions options;
+    std::vector<int> sessionCounts = {1, 10, 50, 200, 500};
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        const char* value = argv[i + 1];
+        if (arg == "--fetches") fetches = atoi(value);
+        else if (arg == "--sessions") sessionCounts = {atoi(value)};
+        else if (arg == "--latency-ms") options.latency = std::chrono::milliseconds(atoi(value));
+        else if (arg == "--jitter-ms") options.jitter = std::chrono::milliseconds(atoi(value));
+        else if (arg == "--error-rate") options.errorRate = atof(value);
+        else if (arg == "--churn") options.churnPerMinute = atof(value);
+    }
+    // Injected errors would otherwise log a line per fetch
+    setLogLevel(LogLevel::Error);
+
+    Reactor reactor;
+    std::thread ioThread([&reactor] { reactor.run(); });
+
+    printf("Plex client scale benchmark (%d fetches per size)\n", fetches);
+    for (int sessions : sessionCounts) {
+        options.sessions = sessions;
+        PlexStandin standin(options);
+        if (!standin.start()) {
+            return 1;
+        }
+        PlexClient plex(standin.url(), options.token);
+
+        std::vector<double> fetchMs;
+        std::vector<double> parseMs;
+        size_t bytes = 0;
+        int failed = 0;
+        for (int i = 0; i < fetches; i++) {
+            std::promise<std::string> body;
+            auto start = Clock::now();
+            plex.fetchSessions(reactor, [&body](std::string response) { body.set_value(std::move(response)); });
+            std::string response = body.get_future().get();
+            fetchMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            start = Clock::now();
+            bool found = plex.parseSessions(response).has_value();
+            parseMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            bytes = std::max(bytes, response.size());
+            failed += !found;
+        }
+        standin.stop();
+
+        printf("%4d sessions %7zu KB  fetch p50=%7.2fms p99=%7.2fms  parse p50=%7.2fms p99=%7.2fms  failed=%d\n",
+            sessions, bytes / 1024, percentile(fetchMs, 50), percentile(fetchMs, 99),
+            percentile(parseMs, 50), percentile(parseMs, 99), failed);
+    }
+
+    reactor.stop();
+    ioThread.join();
+    return 0;
+}
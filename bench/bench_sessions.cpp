@@ -0,0 +1,279 @@
+// Per-cycle CPU path benchmark over the checked-in /status/sessions
+// fixtures (bench/fixtures, 0 to 200 concurrent sessions): session parsing
+// and selection on the heap and in a cycle arena, what handing the result
+// between stages costs as a NowPlaying vs a shared NowPlayingSnapshot,
+// presence text, activity JSON, the SET_ACTIVITY envelope, frame encoding
+// and art cache lookups. Checks first that parseSessions picks the same
+// session as a straightforward scan of each fixture.
+//
+//     bench_sessions [ms per measurement] [fixture dir]
+
+#include "alloc_counter.h"
+#include "cycle_arena.h"
+#include "discord.h"
+#include "discord_ipc.h"
+#include "discord_transport.h"
+#include "image_cache.h"
+#include "now_playing_snapshot.h"
+#include "plex.h"
+#include "presence.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+#ifndef PLEYX_FIXTURE_DIR
+#define PLEYX_FIXTURE_DIR "bench/fixtures"
+#endif
+
+static const int FIXTURE_SESSIONS[] = {0, 1, 10, 50, 200};
+static const char* FILTER_USER = "user3";
+
+struct Fixture {
+    int sessions = 0;
+    std::string body;
+};
+
+static Clock::duration g_budget = std::chrono::milliseconds(300);
+
+static bool loadFixture(const std::string& dir, int sessions, Fixture& fixture) {
+    char name[32];
+    snprintf(name, sizeof(name), "/sessions_%03d.json", sessions);
+    std::ifstream file(dir + name, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "Can't open %s%s\n", dir.c_str(), name);
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    fixture.sessions = sessions;
+    fixture.body = contents.str();
+    return true;
+}
+
+// Runs op in doubling batches until the time budget is spent, then prints
+// its per-call cost
+template <typename Op>
+static void measure(const char* name, const char* fixture, Op op) {
+    uint64_t iterations = 0;
+    uint64_t batch = 1;
+    Clock::duration elapsed{};
+    AllocSnapshot before = allocSnapshot();
+    while (elapsed < g_budget) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < batch; i++) {
+            op();
+        }
+        elapsed += Clock::now() - start;
+        iterations += batch;
+        batch *= 2;
+    }
+    AllocSnapshot after = allocSnapshot();
+    double secs = std::chrono::duration<double>(elapsed).count();
+    printf("%-26s %-14s %12.0f ns/op  %8.1f allocs/op  %10.1f bytes/op\n",
+        name,
+        fixture,
+        secs * 1e9 / iterations,
+        static_cast<double>(after.count - before.count) / iterations,
+        static_cast<double>(after.bytes - before.bytes) / iterations);
+}
+
+// The selection rule, written out plainly: newest session first, the first
+// "playing" one wins, else the newest one seen
+static std::optional<std::string> expectedTitle(const std::string& body, const std::string& user) {
+    json j = json::parse(body);
+    const json& container = j["MediaContainer"];
+    if (!container.contains("Metadata")) {
+        return std::nullopt;
+    }
+    const json* best = nullptr;
+    const json& sessions = container["Metadata"];
+    for (auto it = sessions.rbegin(); it != sessions.rend(); ++it) {
+        if (!user.empty() && (*it)["User"]["title"] != user) continue;
+        if ((*it)["Player"]["state"] == "playing") {
+            best = &*it;
+            break;
+        }
+        if (!best) best = &*it;
+    }
+    if (!best) {
+        return std::nullopt;
+    }
+    return (*best)["title"].get<std::string>();
+}
+
+static bool verifySelection(const std::vector<Fixture>& fixtures) {
+    for (const Fixture& fixture : fixtures) {
+        for (const std::string user : {"", FILTER_USER}) {
+            PlexClient plex("http://127.0.0.1:32400", "tok", user);
+            std::optional<NowPlaying> np = plex.parseSessions(fixture.body);
+            std::optional<std::string> expected = expectedTitle(fixture.body, user);
+            if (np.has_value() != expected.has_value() || (np && np->title != *expected)) {
+                fprintf(stderr, "%d sessions, user '%s': parseSessions picked '%s', expected '%s'\n",
+                    fixture.sessions, user.c_str(),
+                    np ? np->title.c_str() : "(none)", expected ? expected->c_str() : "(none)");
+                return false;
+            }
+        }
+    }
+    printf("Session selection matches a reference scan for all %zu fixtures\n", fixtures.size());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        g_budget = std::chrono::milliseconds(std::strtoull(argv[1], nullptr, 10));
+    }
+    std::string dir = argc > 2 ? argv[2] : PLEYX_FIXTURE_DIR;
+
+    std::vector<Fixture> fixtures;
+    for (int sessions : FIXTURE_SESSIONS) {
+        Fixture fixture;
+        if (!loadFixture(dir, sessions, fixture)) {
+            return 1;
+        }
+        fixtures.push_back(std::move(fixture));
+    }
+    if (!verifySelection(fixtures)) {
+        return 1;
+    }
+
+    printf("Session pipeline benchmark (%lld ms per measurement)\n",
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(g_budget).count()));
+
+    PlexClient plex("http://127.0.0.1:32400", "tok");
+    PlexClient filtered("http://127.0.0.1:32400", "tok", FILTER_USER);
+    CycleArena arena;
+    size_t sink = 0;
+
+    for (const Fixture& fixture : fixtures) {
+        char label[32];
+        snprintf(label, sizeof(label), "%d (%zu KB)", fixture.sessions, fixture.body.size() / 1024);
+        measure("json::parse only", label, [&] {
+            sink += json::parse(fixture.body).size();
+        });
+        measure("parseSessions", label, [&] {
+            sink += plex.parseSessions(fixture.body).has_value();
+        });
+        measure("parseSessions (user)", label, [&] {
+            sink += filtered.parseSessions(fixture.body).has_value();
+        });
+        measure("parseSnapshot", label, [&] {
+            sink += plex.parseSnapshot(fixture.body) != nullptr;
+        });
+        measure("parseSnapshot (arena)", label, [&] {
+            sink += plex.parseSnapshot(fixture.body, &arena) != nullptr;
+            arena.reset();
+        });
+    }
+
+    // Passing the selected session on: stages used to take NowPlaying by
+    // value, and OMDB enrichment copied it twice
+    {
+        json sessions = json::parse(fixtures[2].body)["MediaContainer"]["Metadata"];
+        json single = {{"MediaContainer", {{"size", 1}, {"Metadata", json::array({sessions[0]})}}}};
+        NowPlaying np = *plex.parseSessions(single.dump());
+        std::shared_ptr<const NowPlayingSnapshot> media = NowPlayingSnapshot::from(np);
+        printf("sizeof(NowPlaying) = %zu, sizeof(NowPlayingSnapshot) = %zu\n",
+            sizeof(NowPlaying), sizeof(NowPlayingSnapshot));
+        const char* label = "episode";
+        measure("NowPlaying copy", label, [&] {
+            NowPlaying copy = np;
+            sink += copy.title.size();
+        });
+        measure("snapshot share", label, [&] {
+            std::shared_ptr<const NowPlayingSnapshot> shared = media;
+            sink += shared->title().size();
+        });
+        OmdbResult omdb;
+        omdb.imdbId = "tt0903747";
+        omdb.imdbRating = "9.5";
+        omdb.rottenTomatoesRating = "96%";
+        measure("NowPlaying + OMDB", label, [&] {
+            NowPlaying copy = np;
+            copy.imdbId = omdb.imdbId;
+            copy.imdbRating = omdb.imdbRating;
+            copy.rottenTomatoesRating = omdb.rottenTomatoesRating;
+            sink += copy.imdbId->size();
+        });
+        measure("snapshot withOmdb", label, [&] {
+            sink += media->withOmdb(omdb)->imdbId().size();
+        });
+    }
+
+    // The rest of a cycle works on the one selected session; the 10 session
+    // fixture holds an episode, a movie and a track
+    PresenceFormatter formatter;
+    const std::string& body = fixtures[2].body;
+    json sessions = json::parse(body)["MediaContainer"]["Metadata"];
+    for (int kind = 0; kind < 3; kind++) {
+        json single = {{"MediaContainer", {{"size", 1}, {"Metadata", json::array({sessions[kind]})}}}};
+        std::shared_ptr<const NowPlayingSnapshot> media = plex.parseSnapshot(single.dump());
+        const char* label = media->mediaType() == MediaType::Episode ? "episode"
+            : media->mediaType() == MediaType::Movie ? "movie" : "track";
+        std::string artUrl = "https://files.catbox.moe/abcdef.jpg";
+
+        // Steady state of the pipeline: every buffer keeps its capacity
+        MediaInfo info;
+        measure("PresenceFormatter::build", label, [&] {
+            formatter.build(*media, artUrl, info);
+            sink += info.details.size();
+        });
+        std::string activity;
+        measure("appendActivityJson", label, [&] {
+            activity.clear();
+            appendActivityJson(activity, info);
+            sink += activity.size();
+        });
+        std::string envelope;
+        measure("appendSetActivityCommand", label, [&] {
+            envelope.clear();
+            appendSetActivityCommand(envelope, 4242, activity, "123456");
+            sink += envelope.size();
+        });
+        // What DiscordTransport::queueFrame does when a write is pending
+        std::string frames;
+        measure("frame encode", label, [&] {
+            char header[FRAME_HEADER_SIZE];
+            encodeFrameHeader(header, OP_FRAME, static_cast<uint32_t>(envelope.size()));
+            frames.clear();
+            frames.append(header, FRAME_HEADER_SIZE);
+            frames.append(envelope);
+            sink += frames.size();
+        });
+    }
+
+    // Art cache as it looks after a long session: every art path of the
+    // 200 session fixture uploaded once
+    ImageCache cache("http://127.0.0.1:32400", "tok");
+    std::vector<std::string> artPaths;
+    json busiest = json::parse(fixtures.back().body);
+    for (const json& item : busiest["MediaContainer"]["Metadata"]) {
+        artPaths.push_back(item["art"].get<std::string>());
+        cache.rememberUrl(artPaths.back(), "https://files.catbox.moe/" + std::to_string(artPaths.size()) + ".jpg");
+    }
+    std::string missPath = "/library/metadata/99999999/art/1700000000";
+    size_t next = 0;
+    char label[32];
+    snprintf(label, sizeof(label), "%zu entries", artPaths.size());
+    measure("ImageCache hit", label, [&] {
+        sink += cache.cachedUrl(artPaths[next])->size();
+        next = (next + 1) % artPaths.size();
+    });
+    measure("ImageCache miss", label, [&] {
+        sink += cache.cachedUrl(missPath) == nullptr;
+    });
+
+    if (sink == 42) printf(" ");  // Keep the loops observable
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Timer scheduling benchmark: the reactor's old binary heap + id map
+// against the TimerWheel, for schedule, reschedule, cancel and firing
+// thousands of timers on a simulated clock. Checks first that the wheel
+// fires every timer exactly once, never early and in the first advance
+// that passes its deadline.
+
+#include "alloc_counter.h"
+#include "timer_wheel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using TimerId = uint64_t;
+using Task = std::function<void()>;
+
+// The reactor's timers before the wheel: cancel erases from the map and
+// leaves the heap entry to be skipped when it surfaces
+class HeapTimers {
+public:
+    TimerId schedule(Clock::time_point deadline, Task task) {
+        TimerId id = nextId++;
+        tasks.emplace(id, std::move(task));
+        queue.push(Entry{deadline, id});
+        return id;
+    }
+
+    bool cancel(TimerId id) {
+        return tasks.erase(id) > 0;
+    }
+
+    // No way to move a heap entry: cancel and schedule anew
+    TimerId reschedule(TimerId id, Clock::time_point deadline) {
+        auto it = tasks.find(id);
+        if (it == tasks.end()) {
+            return 0;
+        }
+        Task task = std::move(it->second);
+        tasks.erase(it);
+        return schedule(deadline, std::move(task));
+    }
+
+    size_t advance(Clock::time_point now) {
+        size_t ran = 0;
+        while (!queue.empty() && queue.top().deadline <= now) {
+            TimerId id = queue.top().id;
+            queue.pop();
+            auto it = tasks.find(id);
+            if (it == tasks.end()) {
+                continue;
+            }
+            Task task = std::move(it->second);
+            tasks.erase(it);
+            task();
+            ran++;
+        }
+        return ran;
+    }
+
+private:
+    struct Entry {
+        Clock::time_point deadline;
+        TimerId id;
+        bool operator>(const Entry& other) const { return deadline > other.deadline; }
+    };
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    std::unordered_map<TimerId, Task> tasks;
+    TimerId nextId = 1;
+};
+
+static bool verifyWheel(size_t timers, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int64_t> delayUs(0, 20LL * 60 * 1000000);  // Up to 20 minutes
+    Clock::time_point origin = Clock::now();
+    TimerWheel wheel(origin);
+
+    struct Expect {
+        Clock::time_point deadline;
+        bool cancelled = false;
+        int fired = 0;
+        Clock::time_point firedAt;
+        Clock::time_point previousAdvance;
+    };
+    std::vector<Expect> expected(timers);
+    std::vector<TimerWheel::TimerId> ids(timers);
+    Clock::time_point now = origin;
+    Clock::time_point previous = origin;
+    for (size_t i = 0; i < timers; i++) {
+        expected[i].deadline = origin + std::chrono::microseconds(delayUs(rng));
+        ids[i] = wheel.schedule(expected[i].deadline, [&expected, &now, &previous, i] {
+            expected[i].fired++;
+            expected[i].firedAt = now;
+            expected[i].previousAdvance = previous;
+        });
+    }
+    for (size_t i = 0; i < timers; i += 3) {
+        expected[i].cancelled = wheel.cancel(ids[i]);
+    }
+    for (size_t i = 1; i < timers; i += 3) {
+        expected[i].deadline = origin + std::chrono::microseconds(delayUs(rng));
+        wheel.reschedule(ids[i], expected[i].deadline);
+    }
+
+    // Uneven steps, some tiny and some across several wheel levels
+    std::uniform_int_distribution<int64_t> stepUs(1, 90 * 1000000);
+    while (wheel.size() > 0) {
+        auto next = wheel.nextDeadline();
+        previous = now;
+        now += std::chrono::microseconds(stepUs(rng) >> (rng() % 16));
+        size_t ran = wheel.advance(now);
+        if (next && (*next > now) != (ran == 0)) {
+            fprintf(stderr, "nextDeadline disagrees with what advance ran\n");
+            return false;
+        }
+    }
+    for (size_t i = 0; i < timers; i++) {
+        const Expect& e = expected[i];
+        if (e.cancelled ? e.fired != 0 : e.fired != 1) {
+            fprintf(stderr, "Timer %zu fired %d times (cancelled=%d)\n", i, e.fired, e.cancelled);
+            return false;
+        }
+        if (!e.cancelled && (e.firedAt < e.deadline || e.previousAdvance >= e.deadline)) {
+            fprintf(stderr, "Timer %zu fired at the wrong time\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void report(const char* name, size_t ops, Clock::duration elapsed,
+                   const AllocSnapshot& before, const AllocSnapshot& after) {
+    double secs = std::chrono::duration<double>(elapsed).count();
+    printf("%-36s %8.1f ns/op  %6.2f allocs/op\n",
+        name,
+        secs * 1e9 / ops,
+        static_cast<double>(after.count - before.count) / ops);
+}
+
+// One round: schedule all, reschedule all (the poll timer pattern), cancel
+// half, then fire the rest in 1ms steps over the simulated window
+template <typename Timers, typename Reschedule>
+static void run(const char* label, size_t timers, uint32_t seed, Reschedule reschedule) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int64_t> delayMs(1, 10000);
+    Clock::time_point origin = Clock::now();
+    std::vector<Clock::time_point> deadlines(timers);
+    for (auto& deadline : deadlines) {
+        deadline = origin + std::chrono::milliseconds(delayMs(rng));
+    }
+
+    Timers wheel(origin);
+    std::vector<TimerId> ids(timers);
+    size_t fired = 0;
+    char name[64];
+
+    AllocSnapshot before = allocSnapshot();
+    auto start = Clock::now();
+    for (size_t i = 0; i < timers; i++) {
+        ids[i] = wheel.schedule(deadlines[i], [&fired] { fired++; });
+    }
+    snprintf(name, sizeof(name), "%s schedule", label);
+    report(name, timers, Clock::now() - start, before, allocSnapshot());
+
+    before = allocSnapshot();
+    start = Clock::now();
+    for (size_t i = 0; i < timers; i++) {
+        ids[i] = reschedule(wheel, ids[i], deadlines[i] + std::chrono::milliseconds(500));
+    }
+    snprintf(name, sizeof(name), "%s reschedule", label);
+    report(name, timers, Clock::now() - start, before, allocSnapshot());
+
+    before = allocSnapshot();
+    start = Clock::now();
+    for (size_t i = 0; i < timers; i += 2) {
+        wheel.cancel(ids[i]);
+    }
+    snprintf(name, sizeof(name), "%s cancel", label);
+    report(name, timers / 2, Clock::now() - start, before, allocSnapshot());
+
+    before = allocSnapshot();
+    start = Clock::now();
+    for (int ms = 1; ms <= 10600; ms++) {
+        wheel.advance(origin + std::chrono::milliseconds(ms));
+    }
+    snprintf(name, sizeof(name), "%s fire (per timer)", label);
+    report(name, fired ? fired : 1, Clock::now() - start, before, allocSnapshot());
+}
+
+struct HeapAdapter : HeapTimers {
+    explicit HeapAdapter(Clock::time_point) {}
+};
+
+int main(int argc, char** argv) {
+    size_t timers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+
+    if (!verifyWheel(timers, 1) || !verifyWheel(timers, 2)) {
+        return 1;
+    }
+    printf("Timer benchmark (%zu timers, deadlines up to 10s, advanced in 1ms steps)\n", timers);
+
+    run<HeapAdapter>("heap + map (before)", timers, 7,
+        [](HeapAdapter& heap, TimerId id, Clock::time_point deadline) { return heap.reschedule(id, deadline); });
+    run<TimerWheel>("timer wheel", timers, 7,
+        [](TimerWheel& wheel, TimerId id, Clock::time_point deadline) {
+            wheel.reschedule(id, deadline);
+            return id;
+        });
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Trace recorder benchmark: cost of recording a span and an instant on the
+// calling thread, and of a Chrome trace dump of full rings. Checks first
+// that dumps taken while other threads record only ever contain whole
+// spans.
+
+#include "alloc_counter.h"
+#include "trace.h"
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static void report(const char* name, uint64_t iterations, Clock::duration elapsed,
+                   const AllocSnapshot& before, const AllocSnapshot& after) {
+    double secs = std::chrono::duration<double>(elapsed).count();
+    printf("%-24s %10.1f ns/op  %6.2f allocs/op\n",
+        name,
+        secs * 1e9 / iterations,
+        static_cast<double>(after.count - before.count) / iterations);
+}
+
+// Spans the concurrent check must see before it counts as a pass, and how
+// long it keeps dumping to see them
+static const size_t MIN_CHECKED_SPANS = 10000;
+static const auto CHECK_DEADLINE = std::chrono::seconds(30);
+
+// Writers record spans whose argument is their own duration in ns; a torn
+// slot would pair one span's argument with another's duration. Dumps at
+// least 50 times and until MIN_CHECKED_SPANS spans were checked.
+static bool verifyConcurrentDumps() {
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 3; w++) {
+        writers.emplace_back([&stop] {
+            traceThreadName("writer");
+            int64_t n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                Clock::time_point begin = Clock::now();
+                n = (n + 7919) % 1000000;
+                traceSpan("bench", "span", begin, begin + std::chrono::nanoseconds(n), "ns", n);
+            }
+        });
+    }
+
+    bool ok = true;
+    size_t checked = 0;
+    Clock::time_point deadline = Clock::now() + CHECK_DEADLINE;
+    for (int dump = 0; ok && (dump < 50 || (checked < MIN_CHECKED_SPANS && Clock::now() < deadline)); dump++) {
+        nlohmann::json trace = nlohmann::json::parse(chromeTraceJson(), nullptr, false);
+        if (trace.is_discarded()) {
+            fprintf(stderr, "Dump %d is not valid JSON\n", dump);
+            ok = false;
+            break;
+        }
+        for (const auto& event : trace["traceEvents"]) {
+            if (event["ph"] != "X" || event["name"] != "span") continue;
+            double dur = event["dur"].get<double>() * 1000.0;
+            int64_t arg = event["args"]["ns"].get<int64_t>();
+            if (static_cast<int64_t>(dur + 0.5) != arg) {
+                fprintf(stderr, "Torn span in dump %d: dur %.0f ns, arg %lld\n",
+                    dump, dur, static_cast<long long>(arg));
+                ok = false;
+                break;
+            }
+            checked++;
+        }
+    }
+    stop = true;
+    for (auto& writer : writers) writer.join();
+    if (ok && checked < MIN_CHECKED_SPANS) {
+        fprintf(stderr, "Concurrent dumps: only %zu spans checked, need %zu\n", checked, MIN_CHECKED_SPANS);
+        ok = false;
+    }
+    if (ok) {
+        printf("Concurrent dumps: %zu spans checked, none torn\n", checked);
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+
+    if (!verifyConcurrentDumps()) {
+        return 1;
+    }
+
+    printf("Trace recorder benchmark (%llu iterations, %zu spans kept per thread)\n",
+        static_cast<unsigned long long>(iterations), TRACE_CAPACITY);
+
+    {
+        AllocSnapshot before = allocSnapshot();
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            TraceScope scope("bench", "scope");
+            scope.setArg("i", static_cast<int64_t>(i));
+        }
+        report("TraceScope", iterations, Clock::now() - start, before, allocSnapshot());
+    }
+    {
+        Clock::time_point begin = Clock::now();
+        AllocSnapshot before = allocSnapshot();
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            traceSpan("bench", "span", begin, begin, "i", static_cast<int64_t>(i));
+        }
+        report("traceSpan (given times)", iterations, Clock::now() - start, before, allocSnapshot());
+    }
+    {
+        AllocSnapshot before = allocSnapshot();
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            traceInstant("bench", "instant");
+        }
+        report("traceInstant", iterations, Clock::now() - start, before, allocSnapshot());
+    }
+    {
+        const uint64_t dumps = 20;
+        size_t bytes = 0;
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < dumps; i++) {
+            bytes = chromeTraceJson().size();
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / dumps;
+        printf("%-24s %10.2f ms/dump  %zu KB\n", "chromeTraceJson", ms, bytes / 1024);
+    }
+    return 0;
+}
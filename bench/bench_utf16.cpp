@@ -0,0 +1,198 @@
+// UTF-8 to UTF-16 for tray tooltips: the old byte-per-unit cast (wrong for
+// anything non-ASCII), a code point at a time decoder appending to a
+// string, and utf8ToUtf16 with its vectorized ASCII runs, over English,
+// accented, Japanese and emoji titles. Checks first that utf8ToUtf16
+// agrees with the reference decoder on those and on random bytes, that
+// truncation never splits a character, and that utf8ToUtf16Elided marks
+// every cut with an ellipsis.
+
+#include "utf16.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t TOOLTIP_UNITS = 127;
+
+struct Sample {
+    const char* label;
+    std::string text;
+};
+
+static std::vector<Sample> samples() {
+    return {
+        {"ascii", "The Expanse - S03E07 - Delta-V \xC2\xB7 Playing"},
+        {"accented", "Beyonc\xC3\xA9 - Caf\xC3\xA9 Tacvba - Ol\xC3\xA9 (D\xC3\xA9j\xC3\xA0 Vu Remix)"},
+        {"japanese", "\xE9\x80\xB2\xE6\x92\x83\xE3\x81\xAE\xE5\xB7\xA8\xE4\xBA\xBA - "
+                     "\xE3\x82\xB7\xE3\x83\xBC\xE3\x82\xBA\xE3\x83\xB3 4 - "
+                     "\xE7\xAC\xAC 12 \xE8\xA9\xB1"},
+        {"emoji", "\xF0\x9F\x8E\xB5 Lo-fi Beats \xF0\x9F\x8E\xA7 to study to \xF0\x9F\x93\x9A"},
+        {"long ascii", std::string(400, 'x')},
+    };
+}
+
+// The old tooltip code: each byte becomes one code unit
+static std::u16string byteCast(const std::string& s) {
+    std::u16string out;
+    for (char c : s) {
+        out += static_cast<char16_t>(static_cast<unsigned char>(c));
+    }
+    return out;
+}
+
+// Straightforward decoder to check against; invalid bytes become U+FFFD
+// one at a time
+static std::u16string reference(const std::string& s) {
+    std::u16string out;
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char b = static_cast<unsigned char>(s[i]);
+        char32_t cp = 0;
+        size_t len = 0;
+        if (b < 0x80) {
+            cp = b;
+            len = 1;
+        } else if (b >= 0xC0 && b < 0xE0) {
+            cp = b & 0x1F;
+            len = 2;
+        } else if (b >= 0xE0 && b < 0xF0) {
+            cp = b & 0x0F;
+            len = 3;
+        } else if (b >= 0xF0 && b < 0xF8) {
+            cp = b & 0x07;
+            len = 4;
+        }
+        bool valid = len > 0 && i + len <= s.size();
+        for (size_t k = 1; valid && k < len; k++) {
+            unsigned char c = static_cast<unsigned char>(s[i + k]);
+            valid = (c & 0xC0) == 0x80;
+            cp = (cp << 6) | (c & 0x3F);
+        }
+        static const char32_t MIN_FOR_LENGTH[] = {0, 0, 0x80, 0x800, 0x10000};
+        valid = valid && cp >= MIN_FOR_LENGTH[len] && cp <= 0x10FFFF && (cp < 0xD800 || cp > 0xDFFF);
+        if (!valid) {
+            out += u'\xFFFD';
+            i++;
+            continue;
+        }
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            out += static_cast<char16_t>(0xD800 + (cp >> 10));
+            out += static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+        } else {
+            out += static_cast<char16_t>(cp);
+        }
+        i += len;
+    }
+    return out;
+}
+
+static bool verifyOne(const std::string& s) {
+    std::u16string expected = reference(s);
+    if (toUtf16(s) != expected) {
+        fprintf(stderr, "Decoding differs from the reference for a %zu byte input\n", s.size());
+        return false;
+    }
+    // Every capacity gives the longest prefix that doesn't split a pair
+    std::vector<char16_t> buffer(expected.size() + 1);
+    for (size_t capacity = 0; capacity <= expected.size(); capacity++) {
+        size_t n = utf8ToUtf16(s, buffer.data(), capacity);
+        size_t want = capacity;
+        if (want > 0 && want < expected.size() && expected[want - 1] >= 0xD800 && expected[want - 1] <= 0xDBFF) {
+            want--;
+        }
+        if (n != want || expected.compare(0, n, buffer.data(), n) != 0) {
+            fprintf(stderr, "Truncation to %zu units wrote %zu, expected %zu\n", capacity, n, want);
+            return false;
+        }
+
+        // Elided: the whole text if it fits, else the longest prefix that
+        // leaves room for U+2026 without splitting a pair
+        n = utf8ToUtf16Elided(s, buffer.data(), capacity);
+        if (capacity >= expected.size()) {
+            want = expected.size();
+        } else if (capacity == 0) {
+            want = 0;
+        } else {
+            want = capacity - 1;
+            if (want > 0 && expected[want - 1] >= 0xD800 && expected[want - 1] <= 0xDBFF) {
+                want--;
+            }
+        }
+        bool elided = capacity > 0 && capacity < expected.size();
+        if ((elided ? n != want + 1 || buffer[want] != u'\x2026' : n != want) ||
+            expected.compare(0, want, buffer.data(), want) != 0) {
+            fprintf(stderr, "Elided truncation to %zu units wrote %zu, expected %zu\n", capacity, n, want);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool verify() {
+    for (const Sample& sample : samples()) {
+        if (!verifyOne(sample.text)) {
+            return false;
+        }
+    }
+    // Random mixes of ASCII, valid sequences and junk, at lengths around
+    // the vector width
+    std::mt19937 rng(1);
+    const std::string pieces[] = {"a", "Z", " ", "\xC3\xA9", "\xE3\x82\xB7", "\xF0\x9F\x8E\xB5", "\x80", "\xC0\xAF",
+                                  "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xE3\x82", "\xFF"};
+    for (int round = 0; round < 20000; round++) {
+        std::string s;
+        size_t pieceCount = rng() % 40;
+        for (size_t k = 0; k < pieceCount; k++) {
+            // Mostly ASCII, as titles are
+            s += pieces[rng() % 4 == 0 ? rng() % 12 : rng() % 3];
+        }
+        if (!verifyOne(s)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Fn>
+static double nsPerCall(Fn fn) {
+    size_t reps = 0;
+    auto start = Clock::now();
+    Clock::duration elapsed{};
+    while (elapsed < std::chrono::milliseconds(50)) {
+        for (int i = 0; i < 256; i++) {
+            fn();
+        }
+        reps += 256;
+        elapsed = Clock::now() - start;
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / reps;
+}
+
+int main() {
+    if (!verify()) {
+        return 1;
+    }
+    printf("UTF-8 to UTF-16, ns per title\n");
+    printf("%-12s %6s %18s %16s %14s %16s\n", "title", "bytes", "byte cast (before)", "code point loop", "utf8ToUtf16",
+        "into szTip (127)");
+    volatile size_t sink = 0;
+    for (const Sample& sample : samples()) {
+        const std::string& s = sample.text;
+        char16_t tip[TOOLTIP_UNITS + 1];
+        double cast = nsPerCall([&] { sink = sink + byteCast(s).size(); });
+        double loop = nsPerCall([&] { sink = sink + reference(s).size(); });
+        double fast = nsPerCall([&] { sink = sink + toUtf16(s).size(); });
+        double intoTip = nsPerCall([&] {
+            size_t n = utf8ToUtf16Elided(s, tip, TOOLTIP_UNITS);
+            tip[n] = u'\0';
+            sink = sink + n;
+        });
+        printf("%-12s %6zu %18.1f %16.1f %14.1f %16.1f\n", sample.label, s.size(), cast, loop, fast, intoTip);
+    }
+    return 0;
+}
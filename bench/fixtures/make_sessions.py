@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Writes the /status/sessions fixtures used by bench_sessions.
+
+Each file is a Plex Media Server response with N concurrent sessions, shaped
+like the real thing (Media/Part/Stream, Guid, Genre, User, Player, Session
+and TranscodeSession objects), with a deterministic mix of episodes, movies
+and tracks from ten users. Regenerate with:
+
+    python3 make_sessions.py
+"""
+
+import json
+import os
+import random
+
+COUNTS = [0, 1, 10, 50, 200]
+
+SHOWS = ["The Expanse", "Severance", "Andor", "Dark", "Shogun", "Frieren: Beyond Journey's End",
+         "Slow Horses", "The Bear", "Arcane", "Pachinko"]
+MOVIES = [("Arrival", 2016, "tt2543164"), ("Dune: Part Two", 2024, "tt15239678"),
+          ("Spirited Away", 2001, "tt0245429"), ("Amélie", 2001, "tt0211915"),
+          ("Parasite", 2019, "tt6751668"), ("Blade Runner 2049", 2017, "tt1856101")]
+ARTISTS = [("Massive Attack", "Mezzanine", "Teardrop"), ("Björk", "Homogenic", "Jóga"),
+           ("Radiohead", "In Rainbows", "Reckoner"), ("Boards of Canada", "Geogaddi", "Music Is Math")]
+GENRES = ["Drama", "Science Fiction", "Thriller", "Animation", "Comedy", "Mystery", "Adventure"]
+STATES = ["playing", "playing", "playing", "paused", "buffering"]
+PLAYERS = [("Plex Web", "Chrome", "Windows"), ("Plex for Android (TV)", "Android", "Android"),
+           ("Plexamp", "Plexamp", "macOS"), ("Plex for Roku", "Roku", "Roku")]
+
+
+def streams(rng, kind):
+    video = {"id": rng.randint(10000, 99999), "streamType": 1, "codec": "hevc", "bitrate": 8000,
+             "height": 2160, "width": 3840, "displayTitle": "4K (HEVC Main 10 HDR)",
+             "extendedDisplayTitle": "4K (HEVC Main 10 HDR)", "decision": "copy", "location": "direct"}
+    audio = {"id": rng.randint(10000, 99999), "streamType": 2, "codec": "eac3", "channels": 6,
+             "language": "English", "languageCode": "eng", "displayTitle": "English (EAC3 5.1)",
+             "extendedDisplayTitle": "English (EAC3 5.1)", "selected": True, "decision": "copy"}
+    if kind == "track":
+        audio.update({"codec": "flac", "channels": 2, "displayTitle": "FLAC (Stereo)",
+                      "extendedDisplayTitle": "FLAC (Stereo)"})
+        return [audio]
+    subtitle = {"id": rng.randint(10000, 99999), "streamType": 3, "codec": "srt", "language": "English",
+                "languageCode": "eng", "displayTitle": "English (SRT)", "selected": True}
+    return [video, audio, subtitle]
+
+
+def session(rng, index):
+    kind = ["episode", "movie", "track"][index % 3]
+    key = 10000 + index
+    state = rng.choice(STATES)
+    user = "user%d" % (index % 10)
+    product, platform, device = rng.choice(PLAYERS)
+    item = {
+        "addedAt": 1700000000 + index,
+        "key": "/library/metadata/%d" % key,
+        "ratingKey": str(key),
+        "librarySectionID": str(1 + index % 3),
+        "type": kind,
+        "guid": "plex://%s/%024x" % (kind, key),
+        "updatedAt": 1710000000 + index,
+        "viewOffset": rng.randint(0, 2_000_000),
+        "thumb": "/library/metadata/%d/thumb/1700000000" % key,
+        "art": "/library/metadata/%d/art/1700000000" % key,
+        "Guid": [],
+        "Genre": [{"count": 12, "filter": "genre=%d" % g, "id": g, "tag": GENRES[g]}
+                  for g in rng.sample(range(len(GENRES)), 2)],
+        "User": {"id": str(1 + index % 10), "thumb": "https://plex.tv/users/%x/avatar" % index, "title": user},
+        "Player": {"address": "192.168.1.%d" % (10 + index % 200), "device": device,
+                   "machineIdentifier": "%032x" % (index * 7919), "model": "", "platform": platform,
+                   "platformVersion": "14", "product": product, "profile": product, "state": state,
+                   "title": "%s %d" % (device, index), "version": "4.120.1", "local": True,
+                   "relayed": False, "secure": True, "userID": 1 + index % 10},
+        "Session": {"id": "%024x" % (index * 104729), "bandwidth": 9000, "location": "lan"},
+    }
+    if kind == "episode":
+        show = SHOWS[index % len(SHOWS)]
+        item.update({"title": "Episode %d" % (1 + index % 10), "grandparentTitle": show,
+                     "parentTitle": "Season %d" % (1 + index % 4), "parentIndex": 1 + index % 4,
+                     "index": 1 + index % 10, "year": 2015 + index % 9, "duration": 2_700_000,
+                     "grandparentArt": "/library/metadata/%d/art/1700000000" % (key + 900000),
+                     "grandparentThumb": "/library/metadata/%d/thumb/1700000000" % (key + 900000),
+                     "contentRating": "TV-MA",
+                     "summary": "The crew of the Rocinante makes a choice with consequences for everyone aboard."})
+        item["Guid"] = [{"id": "imdb://tt%07d" % (3230000 + index)}, {"id": "tvdb://%d" % (8000000 + index)}]
+    elif kind == "movie":
+        title, year, imdb = MOVIES[index % len(MOVIES)]
+        item.update({"title": title, "year": year, "duration": 7_000_000, "contentRating": "PG-13",
+                     "studio": "Studio %d" % (index % 5), "rating": 8.1, "audienceRating": 8.5,
+                     "tagline": "Why are they here?",
+                     "summary": "A linguist works with the military to communicate with alien lifeforms."})
+        item["Guid"] = [{"id": "imdb://" + imdb}, {"id": "tmdb://%d" % (329865 + index)}]
+    else:
+        artist, album, track = ARTISTS[index % len(ARTISTS)]
+        item.update({"title": track, "grandparentTitle": artist, "parentTitle": album, "index": 1 + index % 12,
+                     "parentIndex": 1, "duration": 330_000,
+                     "parentThumb": "/library/metadata/%d/thumb/1700000000" % (key + 800000),
+                     "grandparentThumb": "/library/metadata/%d/thumb/1700000000" % (key + 700000)})
+        del item["Genre"][1:]
+    media = {"id": key * 3, "duration": item["duration"], "bitrate": 9000, "container": "mkv",
+             "videoResolution": "4k", "selected": True,
+             "Part": [{"id": key * 5, "key": "/library/parts/%d/1700000000/file.mkv" % (key * 5),
+                       "duration": item["duration"], "file": "/media/library/%s/%d.mkv" % (kind, key),
+                       "size": 4_000_000_000 + key, "container": "mkv", "decision": "directplay",
+                       "selected": True, "Stream": streams(rng, kind)}]}
+    item["Media"] = [media]
+    if index % 4 == 3:
+        item["TranscodeSession"] = {"key": "/transcode/sessions/%x" % key, "throttled": False,
+                                    "complete": False, "progress": 12.5, "speed": 2.1,
+                                    "duration": item["duration"], "videoDecision": "transcode",
+                                    "audioDecision": "copy", "protocol": "dash", "container": "mp4",
+                                    "videoCodec": "h264", "audioCodec": "aac", "transcodeHwRequested": True}
+    return item
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    for count in COUNTS:
+        rng = random.Random(count)
+        sessions = [session(rng, i) for i in range(count)]
+        container = {"size": count}
+        if sessions:
+            container["Metadata"] = sessions
+        path = os.path.join(here, "sessions_%03d.json" % count)
+        with open(path, "w", encoding="utf-8") as f:
+            json.dump({"MediaContainer": container}, f, ensure_ascii=False, separators=(",", ":"))
+            f.write("\n")
+        print("%s: %d bytes" % (os.path.basename(path), os.path.getsize(path)))
+
+
+if __name__ == "__main__":
+    main()
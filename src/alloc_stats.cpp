@@ -0,0 +1,87 @@
+#include "alloc_stats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+const char* allocTagName(AllocTag tag) {
+    switch (tag) {
+        case AllocTag::Other: return "other";
+        case AllocTag::Http: return "http";
+        case AllocTag::Parse: return "parse";
+        case AllocTag::Enrich: return "enrich";
+        case AllocTag::Render: return "render";
+        case AllocTag::Publish: return "publish";
+        case AllocTag::Ipc: return "ipc";
+        case AllocTag::Log: return "log";
+        default: return "unknown";
+    }
+}
+
+#ifdef PLEYX_ALLOC_STATS
+
+// Constant-initialised, so reading it from operator new never allocates
+thread_local AllocTag t_allocTag = AllocTag::Other;
+
+// One cache line per tag, so threads charging different tags don't
+// contend on the counters
+struct alignas(64) TagCounters {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+static TagCounters g_counters[static_cast<size_t>(AllocTag::Count)];
+
+bool allocStatsEnabled() {
+    return true;
+}
+
+AllocTotals allocTotals(AllocTag tag) {
+    const TagCounters& counters = g_counters[static_cast<size_t>(tag)];
+    AllocTotals totals;
+    totals.count = counters.count.load(std::memory_order_relaxed);
+    totals.bytes = counters.bytes.load(std::memory_order_relaxed);
+    return totals;
+}
+
+void* operator new(std::size_t size) {
+    TagCounters& counters = g_counters[static_cast<size_t>(t_allocTag)];
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#else
+
+bool allocStatsEnabled() {
+    return false;
+}
+
+AllocTotals allocTotals(AllocTag) {
+    return AllocTotals();
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+// Opt-in heap allocation accounting. Built with -DPLEYX_ALLOC_STATS=ON,
+// alloc_stats.cpp replaces the global operator new and charges every
+// allocation (count and bytes) to the calling thread's current tag, which
+// an AllocScope sets for the length of a stage. Without the option the
+// scopes compile to nothing and the totals stay zero.
+
+// What a thread is allocating for
+enum class AllocTag : uint8_t {
+    Other,     // Anything outside a scope
+    Http,      // Building, sending and reading HTTP requests
+    Parse,     // Plex /status/sessions parsing
+    Enrich,    // OMDB lookups and artwork
+    Render,    // Presence text and the tray tooltip
+    Publish,   // Handing updates to Discord and the tray
+    Ipc,       // Discord IPC framing, replies and reconnects
+    Log,       // The log writer thread
+    Count
+};
+
+const char* allocTagName(AllocTag tag);
+
+struct AllocTotals {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+// True when built with PLEYX_ALLOC_STATS
+bool allocStatsEnabled();
+
+// Allocations charged to tag since startup; safe from any thread
+AllocTotals allocTotals(AllocTag tag);
+
+#ifdef PLEYX_ALLOC_STATS
+extern thread_local AllocTag t_allocTag;
+
+// Charges the calling thread's allocations to tag until the scope ends;
+// scopes nest, the innermost wins
+class AllocScope {
+public:
+    explicit AllocScope(AllocTag tag) : previous(t_allocTag) { t_allocTag = tag; }
+    ~AllocScope() { t_allocTag = previous; }
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocTag previous;
+};
+#else
+class AllocScope {
+public:
+    explicit AllocScope(AllocTag) {}
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+};
+#endif
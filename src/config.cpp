@@ -1,7 +1,10 @@
 #include "config.h"
+#include "log.h"
+#include "presence_template.h"
 #include <nlohmann/json.hpp>
 #include <fstream>
-#include <iostream>
+#include <cstdlib>
+#include <sstream>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -11,6 +14,12 @@
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
+static const char* const TEMPLATE_TYPES[] = {"episode", "movie", "track"};
+
+static PresenceTemplateConfig Config::* const TEMPLATE_MEMBERS[] = {
+    &Config::episodeTemplates, &Config::movieTemplates, &Config::trackTemplates
+};
+
 fs::path Config::configPath() {
 #ifdef _WIN32
     // First check for config in same directory as exe (portable mode)
@@ -30,39 +39,142 @@ fs::path Config::configPath() {
         fs::create_directories(configDir);
         return configDir / "config.json";
     }
+#else
+    // XDG base directory, falling back to ~/.config
+    fs::path configHome;
+    if (const char* xdg = getenv("XDG_CONFIG_HOME"); xdg && *xdg) {
+        configHome = xdg;
+    } else if (const char* home = getenv("HOME"); home && *home) {
+        configHome = fs::path(home) / ".config";
+    }
+    if (!configHome.empty()) {
+        fs::path configDir = configHome / "pleyx";
+        std::error_code ec;
+        fs::create_directories(configDir, ec);
+        return configDir / "config.json";
+    }
 #endif
     return "config.json";
 }
 
 Config Config::load() {
-    Config cfg;
-    fs::path path = configPath();
+    return load(configPath());
+}
 
+Config Config::load(const fs::path& path) {
     if (!fs::exists(path)) {
-        saveDefault();
+        saveDefault(path);
     }
 
+    std::string error;
+    std::optional<Config> cfg = read(path, &error);
+    if (!cfg) {
+        logError("Config") << "Error loading config: " << error;
+        return Config();
+    }
+    return *cfg;
+}
+
+std::optional<Config> Config::read(const fs::path& path, std::string* error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        if (error) *error = "cannot open " + path.string();
+        return std::nullopt;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return parse(contents.str(), error);
+}
+
+std::optional<Config> Config::parse(const std::string& text, std::string* error) {
+    Config cfg;
     try {
-        std::ifstream file(path);
-        if (file.is_open()) {
-            json j;
-            file >> j;
-
-            cfg.plexUrl = j.value("plex_url", "http://localhost:32400");
-            cfg.plexToken = j.value("plex_token", "");
-            cfg.plexUsername = j.value("plex_username", "");
-            cfg.omdbApiKey = j.value("omdb_api_key", "");
-            cfg.pollingIntervalSecs = j.value("polling_interval_secs", 15);
-            cfg.startAtBoot = j.value("start_at_boot", false);
-            cfg.debug = j.value("debug", false);
+        json j = json::parse(text);
+        if (!j.is_object()) {
+            if (error) *error = "not a JSON object";
+            return std::nullopt;
+        }
+
+        cfg.plexUrl = j.value("plex_url", "http://localhost:32400");
+        cfg.plexToken = j.value("plex_token", "");
+        cfg.plexUsername = j.value("plex_username", "");
+        cfg.omdbApiKey = j.value("omdb_api_key", "");
+        cfg.pollingIntervalSecs = j.value("polling_interval_secs", 15);
+        cfg.startAtBoot = j.value("start_at_boot", false);
+        cfg.debug = j.value("debug", false);
+        cfg.metricsPort = j.value("metrics_port", 0);
+        cfg.statusAllowOrigin = j.value("status_allow_origin", "");
+        cfg.logFile = j.value("log_file", "");
+        cfg.logFileMaxKb = j.value("log_file_max_kb", 1024);
+        cfg.captureFile = j.value("capture_file", "");
+
+        if (j.contains("templates") && j["templates"].is_object()) {
+            const json& templates = j["templates"];
+            for (size_t i = 0; i < 3; i++) {
+                if (!templates.contains(TEMPLATE_TYPES[i])) continue;
+                const json& t = templates[TEMPLATE_TYPES[i]];
+                PresenceTemplateConfig& out = cfg.*TEMPLATE_MEMBERS[i];
+                out.details = t.value("details", "");
+                out.state = t.value("state", "");
+                out.largeText = t.value("large_text", "");
+            }
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Config] Error loading config: " << e.what() << std::endl;
+        if (error) *error = e.what();
+        return std::nullopt;
     }
 
     return cfg;
 }
 
+bool Config::validate(std::string* error) const {
+    auto fail = [error](std::string reason) {
+        if (error) *error = std::move(reason);
+        return false;
+    };
+    if (plexToken.empty() || plexToken == "YOUR_PLEX_TOKEN_HERE") {
+        return fail("plex_token is not set");
+    }
+    if (plexUrl.rfind("http://", 0) != 0 && plexUrl.rfind("https://", 0) != 0) {
+        return fail("plex_url must start with http:// or https://");
+    }
+    if (pollingIntervalSecs < 1 || pollingIntervalSecs > 3600) {
+        return fail("polling_interval_secs must be from 1 to 3600");
+    }
+    if (metricsPort < 0 || metricsPort > 65535) {
+        return fail("metrics_port must be from 0 to 65535");
+    }
+    // It goes into a response header as is
+    if (statusAllowOrigin.find_first_of("\r\n") != std::string::npos) {
+        return fail("status_allow_origin must be a single line");
+    }
+    static const char* const FIELD_NAMES[] = {"details", "state", "large_text"};
+    for (size_t i = 0; i < 3; i++) {
+        const PresenceTemplateConfig& t = this->*TEMPLATE_MEMBERS[i];
+        const std::string* fields[] = {&t.details, &t.state, &t.largeText};
+        for (size_t f = 0; f < 3; f++) {
+            std::string reason;
+            if (!fields[f]->empty() && !PresenceTemplate::compile(*fields[f], &reason)) {
+                return fail(std::string("templates.") + TEMPLATE_TYPES[i] + "." + FIELD_NAMES[f] + ": " + reason);
+            }
+        }
+    }
+    return true;
+}
+
+ConfigStore::ConfigStore(Config initial) {
+    published.push_back(std::make_unique<const Config>(std::move(initial)));
+    snapshot.store(published.back().get(), std::memory_order_release);
+}
+
+const Config* ConfigStore::publish(Config next) {
+    std::lock_guard<std::mutex> lock(publishMutex);
+    published.push_back(std::make_unique<const Config>(std::move(next)));
+    const Config* latest = published.back().get();
+    snapshot.store(latest, std::memory_order_release);
+    return latest;
+}
+
 void Config::save() const {
     fs::path path = configPath();
 
@@ -82,19 +194,44 @@ void Config::save() const {
     if (debug) {
         j["debug"] = true;
     }
+    if (metricsPort > 0) {
+        j["metrics_port"] = metricsPort;
+    }
+    if (!statusAllowOrigin.empty()) {
+        j["status_allow_origin"] = statusAllowOrigin;
+    }
+    if (!logFile.empty()) {
+        j["log_file"] = logFile;
+        j["log_file_max_kb"] = logFileMaxKb;
+    }
+    if (!captureFile.empty()) {
+        j["capture_file"] = captureFile;
+    }
+    for (size_t i = 0; i < 3; i++) {
+        const PresenceTemplateConfig& t = this->*TEMPLATE_MEMBERS[i];
+        json entry = json::object();
+        if (!t.details.empty()) entry["details"] = t.details;
+        if (!t.state.empty()) entry["state"] = t.state;
+        if (!t.largeText.empty()) entry["large_text"] = t.largeText;
+        if (!entry.empty()) {
+            j["templates"][TEMPLATE_TYPES[i]] = entry;
+        }
+    }
 
     try {
         std::ofstream file(path);
         file << j.dump(4);
-        std::cout << "[Config] Saved config" << std::endl;
+        logInfo("Config") << "Saved config";
     } catch (const std::exception& e) {
-        std::cerr << "[Config] Error saving config: " << e.what() << std::endl;
+        logError("Config") << "Error saving config: " << e.what();
     }
 }
 
 void Config::saveDefault() {
-    fs::path path = configPath();
+    saveDefault(configPath());
+}
 
+void Config::saveDefault(const fs::path& path) {
     json j = {
         {"plex_url", "http://localhost:32400"},
         {"plex_token", "YOUR_PLEX_TOKEN_HERE"},
@@ -105,9 +242,9 @@ void Config::saveDefault() {
     try {
         std::ofstream file(path);
         file << j.dump(4);
-        std::cout << "[Config] Created default config at: " << path << std::endl;
+        logInfo("Config") << "Created default config at: " << path.string();
     } catch (const std::exception& e) {
-        std::cerr << "[Config] Error saving config: " << e.what() << std::endl;
+        logError("Config") << "Error saving config: " << e.what();
     }
 }
 
@@ -131,7 +268,7 @@ bool Config::isStartupEnabled() {
 void Config::setStartupEnabled(bool enabled) {
     HKEY hKey;
     if (RegOpenKeyExW(HKEY_CURRENT_USER, STARTUP_REG_KEY, 0, KEY_WRITE, &hKey) != ERROR_SUCCESS) {
-        std::cerr << "[Config] Failed to open registry key" << std::endl;
+        logError("Config") << "Failed to open registry key";
         return;
     }
 
@@ -143,16 +280,16 @@ void Config::setStartupEnabled(bool enabled) {
         if (RegSetValueExW(hKey, STARTUP_VALUE_NAME, 0, REG_SZ,
             reinterpret_cast<const BYTE*>(exePath),
             static_cast<DWORD>((wcslen(exePath) + 1) * sizeof(wchar_t))) == ERROR_SUCCESS) {
-            std::cout << "[Config] Added to startup" << std::endl;
+            logInfo("Config") << "Added to startup";
         }
     } else {
         RegDeleteValueW(hKey, STARTUP_VALUE_NAME);
-        std::cout << "[Config] Removed from startup" << std::endl;
+        logInfo("Config") << "Removed from startup";
     }
 
     RegCloseKey(hKey);
 }
 #else
 bool Config::isStartupEnabled() { return false; }
-void Config::setStartupEnabled(bool enabled) {}
+void Config::setStartupEnabled(bool /*enabled*/) {}
 #endif
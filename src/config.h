@@ -1,7 +1,20 @@
 #pragma once
 
-#include <string>
+#include <atomic>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Presence text templates for one media type (see presence_template.h);
+// empty keeps the built-in default
+struct PresenceTemplateConfig {
+    std::string details;
+    std::string state;
+    std::string largeText;
+};
 
 struct Config {
     std::string plexUrl;
@@ -11,13 +24,55 @@ struct Config {
     int pollingIntervalSecs = 15;
     bool startAtBoot = false;
     bool debug = false;
+    int metricsPort = 0;  // Local /metrics endpoint; 0 = off
+    std::string statusAllowOrigin;  // Origin allowed to read /now-playing from a browser
+    std::string logFile;  // Relative paths are next to the config file
+    int logFileMaxKb = 1024;
+    std::string captureFile;  // Session capture for tools/replay; relative like logFile
+    PresenceTemplateConfig episodeTemplates;
+    PresenceTemplateConfig movieTemplates;
+    PresenceTemplateConfig trackTemplates;
 
     static std::filesystem::path configPath();
+    // Creates a default config if there is none; a file that can't be read
+    // or parsed gives the defaults
     static Config load();
+    static Config load(const std::filesystem::path& path);
+    // Strict forms of load for reloading: nullopt and the reason in error
+    // when the file or its JSON is malformed
+    static std::optional<Config> read(const std::filesystem::path& path, std::string* error = nullptr);
+    static std::optional<Config> parse(const std::string& text, std::string* error = nullptr);
+    // False, with the reason in error, for a config that can't run: no
+    // token, a bad URL, interval or port, or a template that won't compile
+    bool validate(std::string* error = nullptr) const;
     void save() const;
     static void saveDefault();
+    static void saveDefault(const std::filesystem::path& path);
 
     // Windows startup management
     static bool isStartupEnabled();
     static void setStartupEnabled(bool enabled);
 };
+
+// The current Config as an immutable snapshot. Readers load one pointer
+// and never lock, so the poll path can check it every cycle; publish()
+// swaps in a new snapshot. Superseded snapshots are kept until the store
+// goes away, so a reader never has to pin the one it holds; a config is
+// a few hundred bytes and changes only when someone edits the file.
+class ConfigStore {
+public:
+    explicit ConfigStore(Config initial);
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    // Any thread; a new pointer means a new config
+    const Config* current() const { return snapshot.load(std::memory_order_acquire); }
+    // Any thread; returns the snapshot it made current
+    const Config* publish(Config next);
+
+private:
+    std::atomic<const Config*> snapshot;
+    std::mutex publishMutex;
+    std::vector<std::unique_ptr<const Config>> published;  // Guarded by publishMutex
+};
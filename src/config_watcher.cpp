@@ -0,0 +1,280 @@
+#include "config_watcher.h"
+#include "log.h"
+#include <fstream>
+#include <future>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Editors save in several steps (truncate and write, or write and rename);
+// reload once they have settled
+static const auto SETTLE_DELAY = std::chrono::milliseconds(250);
+
+static std::string readText(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static fs::path watchedDirectory(const fs::path& path) {
+    fs::path directory = path.parent_path();
+    return directory.empty() ? fs::path(".") : directory;
+}
+
+ConfigWatcher::ConfigWatcher(Reactor& reactor, ConfigStore& store, fs::path path)
+    : reactor(reactor), store(store), path(std::move(path)) {}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+void ConfigWatcher::start(ChangeCallback callback) {
+    if (started) {
+        return;
+    }
+    started = true;
+    onChange = std::move(callback);
+    lastText = readText(path);
+    lifetime = std::make_shared<bool>(true);
+    std::weak_ptr<bool> alive = lifetime;
+    reactor.post([this, alive] {
+        if (alive.expired()) {
+            return;
+        }
+        if (watch()) {
+            logInfo("Config") << "Watching " << path.u8string() << " for changes";
+        } else {
+            logWarning("Config") << "Cannot watch " << path.u8string() << "; changes need a restart";
+        }
+    });
+}
+
+void ConfigWatcher::stop() {
+    if (!started) {
+        return;
+    }
+    started = false;
+    if (reactor.inReactorThread()) {
+        halt();
+    } else {
+        std::promise<void> done;
+        reactor.post([&] {
+            halt();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void ConfigWatcher::changed() {
+    if (reloadTimer && reactor.rescheduleTimer(reloadTimer, Reactor::Clock::now() + SETTLE_DELAY)) {
+        return;
+    }
+    std::weak_ptr<bool> alive = lifetime;
+    reloadTimer = reactor.runAfter(SETTLE_DELAY, [this, alive] {
+        if (alive.expired()) {
+            return;
+        }
+        reloadTimer = 0;
+        reload();
+    });
+}
+
+void ConfigWatcher::reload() {
+    std::string text = readText(path);
+    if (text == lastText) {
+        return;
+    }
+    lastText = text;
+
+    std::string error;
+    std::optional<Config> parsed = Config::parse(text, &error);
+    if (!parsed || !parsed->validate(&error)) {
+        logWarning("Config") << "Keeping the current config, " << path.u8string() << " is invalid: " << error;
+        return;
+    }
+
+    const Config& previous = *store.current();
+    const Config& next = *store.publish(std::move(*parsed));
+    logInfo("Config") << "Reloaded " << path.u8string();
+    if (next.metricsPort != previous.metricsPort || next.statusAllowOrigin != previous.statusAllowOrigin ||
+        next.logFile != previous.logFile || next.logFileMaxKb != previous.logFileMaxKb ||
+        next.captureFile != previous.captureFile) {
+        logWarning("Config") << "metrics_port, status_allow_origin, log_file and capture_file changes take effect "
+                                "after a restart";
+    }
+    if (onChange) {
+        onChange(previous, next);
+    }
+}
+
+#ifdef _WIN32
+
+struct ConfigWatcher::DirectoryWatch {
+    HANDLE handle{INVALID_HANDLE_VALUE};
+    bool closed = false;
+    Reactor::Operation op;
+    DWORD buffer[1024];  // FILE_NOTIFY_INFORMATION records, which are DWORD aligned
+};
+
+bool ConfigWatcher::watch() {
+    auto state = std::make_shared<DirectoryWatch>();
+    state->handle = CreateFileW(watchedDirectory(path).c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (state->handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (!reactor.associate(state->handle)) {
+        CloseHandle(state->handle);
+        return false;
+    }
+    directory = state;
+    return startRead();
+}
+
+// Keeps one directory read outstanding; its completion looks for the
+// config file among the names that changed and issues the next read
+bool ConfigWatcher::startRead() {
+    std::shared_ptr<DirectoryWatch> state = directory;
+    static_cast<OVERLAPPED&>(state->op) = OVERLAPPED();
+    state->op.complete = [this, state](DWORD bytes, DWORD error) {
+        if (state->closed) {
+            return;
+        }
+        if (error != ERROR_SUCCESS) {
+            logWarning("Config") << "Stopped watching " << path.u8string() << ": " << error;
+            return;
+        }
+        // No bytes means the changes overflowed the buffer; any could be ours
+        bool relevant = bytes == 0;
+        std::wstring name = path.filename().wstring();
+        const char* record = reinterpret_cast<const char*>(state->buffer);
+        while (bytes > 0) {
+            auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+            int length = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+            if (CompareStringOrdinal(info->FileName, length, name.c_str(), static_cast<int>(name.size()), TRUE) == CSTR_EQUAL) {
+                relevant = true;
+            }
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            record += info->NextEntryOffset;
+        }
+        if (relevant) {
+            changed();
+        }
+        if (!startRead()) {
+            logWarning("Config") << "Stopped watching " << path.u8string() << ": " << GetLastError();
+        }
+    };
+
+    if (!ReadDirectoryChangesW(state->handle, state->buffer, sizeof(state->buffer), FALSE,
+                               FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+                               nullptr, &state->op, nullptr)) {
+        state->op.complete = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void ConfigWatcher::halt() {
+    lifetime.reset();
+    reactor.cancelTimer(reloadTimer);
+    reloadTimer = 0;
+    if (directory) {
+        // The cancelled read still completes, and finds the watch closed
+        directory->closed = true;
+        CancelIoEx(directory->handle, nullptr);
+        CloseHandle(directory->handle);
+        directory.reset();
+    }
+}
+
+#elif defined(__linux__)
+
+bool ConfigWatcher::watch() {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        return false;
+    }
+    // Written and closed, or renamed into place
+    if (inotify_add_watch(inotifyFd, watchedDirectory(path).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+    std::string name = path.filename().string();
+    return reactor.watch(inotifyFd, Reactor::READABLE, [this, name](uint32_t) {
+        alignas(inotify_event) char buffer[4096];
+        bool relevant = false;
+        ssize_t n;
+        while ((n = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* record = buffer; record < buffer + n;) {
+                auto event = reinterpret_cast<const inotify_event*>(record);
+                if (event->len > 0 && name == event->name) {
+                    relevant = true;
+                }
+                record += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (relevant) {
+            changed();
+        }
+    });
+}
+
+void ConfigWatcher::halt() {
+    lifetime.reset();
+    reactor.cancelTimer(reloadTimer);
+    reloadTimer = 0;
+    if (inotifyFd >= 0) {
+        reactor.unwatch(inotifyFd);
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+}
+
+#else
+
+static const auto POLL_INTERVAL = std::chrono::seconds(2);
+
+bool ConfigWatcher::watch() {
+    std::error_code ec;
+    lastWrite = fs::last_write_time(path, ec);
+    poll();
+    return true;
+}
+
+void ConfigWatcher::poll() {
+    std::error_code ec;
+    fs::file_time_type written = fs::last_write_time(path, ec);
+    if (!ec && written != lastWrite) {
+        lastWrite = written;
+        changed();
+    }
+    std::weak_ptr<bool> alive = lifetime;
+    pollTimer = reactor.runAfter(POLL_INTERVAL, [this, alive] {
+        if (!alive.expired()) {
+            poll();
+        }
+    });
+}
+
+void ConfigWatcher::halt() {
+    lifetime.reset();
+    reactor.cancelTimer(reloadTimer);
+    reloadTimer = 0;
+    reactor.cancelTimer(pollTimer);
+    pollTimer = 0;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "config.h"
+#include "reactor.h"
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Watches the config file on the reactor thread (inotify on Linux,
+// ReadDirectoryChangesW on Windows, a modification time check every few
+// seconds elsewhere) and publishes each edit that parses and validates to
+// store. The directory is watched rather than the file, since editors
+// often save by writing a new file and renaming it over the old one. An
+// edit that doesn't validate is logged and the current config kept.
+class ConfigWatcher {
+public:
+    // Runs on the reactor thread after store has the new snapshot
+    using ChangeCallback = std::function<void(const Config& previous, const Config& next)>;
+
+    ConfigWatcher(Reactor& reactor, ConfigStore& store, std::filesystem::path path);
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    // Both may be called from any thread; stop() needs the reactor running
+    void start(ChangeCallback onChange);
+    void stop();
+
+private:
+    bool watch();
+    void halt();
+    void changed();
+    void reload();
+
+    Reactor& reactor;
+    ConfigStore& store;
+    std::filesystem::path path;
+    ChangeCallback onChange;
+    bool started = false;
+    // Completions and timers hold a weak reference; halt() expires it
+    std::shared_ptr<bool> lifetime;
+
+    // Reactor thread only: the pending reload, which each change pushes
+    // back so a save made in several writes is read once, and the text
+    // last read, so touching the file without changing it does nothing
+    Reactor::TimerId reloadTimer = 0;
+    std::string lastText;
+
+#ifdef _WIN32
+    struct DirectoryWatch;
+    bool startRead();
+
+    std::shared_ptr<DirectoryWatch> directory;
+#elif defined(__linux__)
+    int inotifyFd = -1;
+#else
+    void poll();
+
+    std::filesystem::file_time_type lastWrite;
+    Reactor::TimerId pollTimer = 0;
+#endif
+};
@@ -0,0 +1,55 @@
+#include "cycle_arena.h"
+#include <algorithm>
+#include <new>
+
+static thread_local std::pmr::memory_resource* t_arenaResource = nullptr;
+
+CycleArena::CycleArena(size_t initialBytes)
+    : buffer(new std::byte[initialBytes]), capacityBytes(initialBytes) {
+    monotonic.emplace(buffer.get(), capacityBytes, &spill);
+}
+
+void CycleArena::reset() {
+    // Destroying the monotonic resource hands its spilled chunks back
+    monotonic.reset();
+    if (spill.bytes > 0 && capacityBytes < MAX_RETAINED_BYTES) {
+        capacityBytes = std::min(MAX_RETAINED_BYTES, capacityBytes + spill.bytes);
+        buffer.reset(new std::byte[capacityBytes]);
+    }
+    spill.bytes = 0;
+    monotonic.emplace(buffer.get(), capacityBytes, &spill);
+}
+
+// Plain operator new where the alignment allows, unlike
+// new_delete_resource(), so allocation counters see the spills
+void* CycleArena::Spill::do_allocate(size_t size, size_t alignment) {
+    bytes += size;
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+        return ::operator new(size, std::align_val_t(alignment));
+    }
+    return ::operator new(size);
+}
+
+void CycleArena::Spill::do_deallocate(void* p, size_t, size_t alignment) {
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+        ::operator delete(p, std::align_val_t(alignment));
+        return;
+    }
+    ::operator delete(p);
+}
+
+bool CycleArena::Spill::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+std::pmr::memory_resource* currentArenaResource() {
+    return t_arenaResource;
+}
+
+ArenaScope::ArenaScope(CycleArena* arena) : previous(t_arenaResource) {
+    t_arenaResource = arena ? arena->resource() : nullptr;
+}
+
+ArenaScope::~ArenaScope() {
+    t_arenaResource = previous;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Monotonic arena for data that lives no longer than one poll cycle, such
+// as the JSON DOM of a /status/sessions response. Allocations bump a
+// pointer through one retained buffer and are all freed by reset(). A
+// cycle that outgrows the buffer spills to the heap, and the next reset()
+// grows the buffer to fit (up to MAX_RETAINED_BYTES), so in steady state a
+// cycle makes no heap allocations at all. Single-threaded, like a cycle.
+class CycleArena {
+public:
+    static constexpr size_t MAX_RETAINED_BYTES = 4 * 1024 * 1024;
+
+    explicit CycleArena(size_t initialBytes = 64 * 1024);
+
+    CycleArena(const CycleArena&) = delete;
+    CycleArena& operator=(const CycleArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &*monotonic; }
+
+    // Frees everything allocated since the last reset
+    void reset();
+
+    size_t capacity() const { return capacityBytes; }
+
+private:
+    // Heap fallback that remembers how much spilled past the buffer
+    class Spill : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override;
+        void do_deallocate(void* p, size_t size, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    std::unique_ptr<std::byte[]> buffer;
+    size_t capacityBytes;
+    Spill spill;
+    std::optional<std::pmr::monotonic_buffer_resource> monotonic;
+};
+
+// The memory resource ArenaAllocators constructed on this thread draw
+// from: the innermost ArenaScope's arena, or null (the heap) outside any
+// scope
+std::pmr::memory_resource* currentArenaResource();
+
+// Points this thread's default-constructed ArenaAllocators at arena (the
+// heap if null) until the scope ends. Containers built inside the scope
+// must also be destroyed inside it.
+class ArenaScope {
+public:
+    explicit ArenaScope(CycleArena* arena);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    std::pmr::memory_resource* previous;
+};
+
+// Allocator that binds to currentArenaResource() when default-constructed.
+// std::pmr::polymorphic_allocator would fall back to the process-wide
+// default resource instead; this one lets containers that create their
+// allocators themselves (nlohmann::basic_json does) use a per-thread arena.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept : resource(currentArenaResource()) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : resource(other.resource) {}
+
+    T* allocate(size_t n) {
+        if (!resource) {
+            return std::allocator<T>().allocate(n);
+        }
+        return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        if (!resource) {
+            std::allocator<T>().deallocate(p, n);
+            return;
+        }
+        resource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return resource == other.resource; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return resource != other.resource; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    std::pmr::memory_resource* resource;
+};
@@ -1,59 +1,53 @@
 #include "discord.h"
-#include <nlohmann/json.hpp>
+#include "json_writer.h"
 #include <chrono>
-#include <iostream>
 
-using json = nlohmann::json;
+Discord::Discord(const std::string& clientId) : clientId(clientId), ipc(clientId) {}
 
-Discord::Discord(const std::string& clientId) : clientId(clientId) {}
+Discord::Discord(const std::string& clientId, Reactor& reactor) : clientId(clientId), ipc(clientId, reactor) {}
 
 Discord::~Discord() {
     disconnect();
 }
 
-bool Discord::connect() {
-    if (!ipc.openPipe()) {
-        return false;
-    }
-
-    if (!ipc.sendHandshake(clientId)) {
-        ipc.closePipe();
-        return false;
-    }
-
-    handshakeDone = true;
-    return true;
+std::future<IpcResponse> Discord::connect() {
+    return ipc.connect();
 }
 
 void Discord::disconnect() {
-    if (handshakeDone) {
-        clearPresence();
+    if (isConnected()) {
+        // Give the clear a moment to reach Discord before the pipe goes away
+        clearPresence().wait_for(std::chrono::seconds(1));
     }
-    ipc.closePipe();
-    handshakeDone = false;
+    ipc.stop();
 }
 
 bool Discord::isConnected() const {
-    return ipc.isConnected() && handshakeDone;
+    return ipc.isConnected();
 }
 
-std::string Discord::buildActivityJson(const MediaInfo& info) {
-    json activity;
+IpcStats Discord::stats() const {
+    return ipc.stats();
+}
+
+void appendActivityJson(std::string& out, const MediaInfo& info) {
+    JsonWriter activity(out);
+    activity.beginObject();
 
     // Activity type (0=Playing, 2=Listening, 3=Watching)
-    activity["type"] = static_cast<int>(info.activityType);
+    activity.field("type", static_cast<int>(info.activityType));
 
     // Details and state
-    activity["details"] = info.details;
-    activity["state"] = info.state;
+    activity.field("details", info.details);
+    activity.field("state", info.state);
 
     // Assets
-    activity["assets"] = {
-        {"large_image", info.largeImage},
-        {"large_text", info.largeText},
-        {"small_image", info.smallImage},
-        {"small_text", info.smallText}
-    };
+    activity.key("assets").beginObject()
+        .field("large_image", info.largeImage)
+        .field("large_text", info.largeText)
+        .field("small_image", info.smallImage)
+        .field("small_text", info.smallText)
+        .endObject();
 
     // Timestamps for progress bar
     if (info.isPlaying && info.durationMs > 0) {
@@ -64,42 +58,44 @@ std::string Discord::buildActivityJson(const MediaInfo& info) {
         int64_t startTime = nowSecs - (info.progressMs / 1000);
         int64_t endTime = nowSecs + ((info.durationMs - info.progressMs) / 1000);
 
-        activity["timestamps"] = {
-            {"start", startTime},
-            {"end", endTime}
-        };
+        activity.key("timestamps").beginObject()
+            .field("start", startTime)
+            .field("end", endTime)
+            .endObject();
     }
 
     // Buttons
-    json buttons = json::array();
     if (info.imdbId.has_value() && !info.imdbId->empty()) {
-        buttons.push_back({
-            {"label", "View on IMDb"},
-            {"url", "https://www.imdb.com/title/" + *info.imdbId}
-        });
+        activity.key("buttons").beginArray()
+            .beginObject()
+                .field("label", "View on IMDb")
+                .key("url").value("https://www.imdb.com/title/" + *info.imdbId)
+            .endObject()
+            .endArray();
     }
 
-    if (!buttons.empty()) {
-        activity["buttons"] = buttons;
-    }
+    activity.endObject();
+}
 
-    return activity.dump();
+std::future<IpcResponse> Discord::updatePresence(const MediaInfo& info) {
+    // The worker connects on demand, so this never waits on the pipe
+    std::string activityJson;
+    activityJson.reserve(512);
+    appendActivityJson(activityJson, info);
+    return ipc.sendActivity(std::move(activityJson));
 }
 
-bool Discord::updatePresence(const MediaInfo& info) {
-    if (!isConnected()) {
-        if (!connect()) {
-            return false;
-        }
-    }
+std::future<IpcResponse> Discord::clearPresence() {
+    return ipc.clearActivity();
+}
 
-    std::string activityJson = buildActivityJson(info);
-    return ipc.sendActivity(activityJson);
+void Discord::postPresence(const MediaInfo& info) {
+    std::string activityJson;
+    activityJson.reserve(512);
+    appendActivityJson(activityJson, info);
+    ipc.postActivity(std::move(activityJson));
 }
 
-bool Discord::clearPresence() {
-    if (!isConnected()) {
-        return false;
-    }
-    return ipc.clearActivity();
+void Discord::postClearPresence() {
+    ipc.postClearActivity();
 }
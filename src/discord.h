@@ -28,22 +28,31 @@ struct MediaInfo {
     ActivityType activityType = ActivityType::Playing;
 };
 
+// Serializes the SET_ACTIVITY activity object for info in a single pass
+void appendActivityJson(std::string& out, const MediaInfo& info);
+
 class Discord {
 public:
     Discord(const std::string& clientId);
+    // Runs the IPC connection on reactor instead of a thread of its own
+    Discord(const std::string& clientId, Reactor& reactor);
     ~Discord();
 
-    bool connect();
+    // Requests are queued on the IPC worker and never block the caller;
+    // the futures resolve once Discord answers, the request times out or fails.
+    std::future<IpcResponse> connect();
     void disconnect();
     bool isConnected() const;
 
-    bool updatePresence(const MediaInfo& info);
-    bool clearPresence();
+    std::future<IpcResponse> updatePresence(const MediaInfo& info);
+    std::future<IpcResponse> clearPresence();
+    // Fire and forget versions for callers that ignore the result
+    void postPresence(const MediaInfo& info);
+    void postClearPresence();
 
-private:
-    std::string buildActivityJson(const MediaInfo& info);
+    IpcStats stats() const;
 
+private:
     std::string clientId;
     DiscordIPC ipc;
-    bool handshakeDone = false;
 };
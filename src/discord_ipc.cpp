@@ -1,284 +1,667 @@
 #include "discord_ipc.h"
+#include "alloc_stats.h"
+#include "json_writer.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
 #include <nlohmann/json.hpp>
-#include <cstring>
-#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// How long a request may wait for Discord's reply before it is failed
+static const auto REQUEST_TIMEOUT = std::chrono::seconds(5);
+static const auto HANDSHAKE_TIMEOUT = std::chrono::seconds(5);
+
+// An endpoint whose pipe instances are all taken is probed again this often,
+// instead of blocking the reactor in WaitNamedPipe, before the attempt fails
+static const auto BUSY_PROBE_DELAY = std::chrono::milliseconds(200);
+static const int BUSY_PROBE_LIMIT = 5;
+
+// Reconnect backoff after a failed attempt, doubling up to the maximum
+static const auto RECONNECT_BACKOFF_MIN = std::chrono::seconds(1);
+static const auto RECONNECT_BACKOFF_MAX = std::chrono::seconds(60);
+
+// An idle connection is PINGed this often and must answer within the timeout
+static const auto HEARTBEAT_INTERVAL = std::chrono::seconds(30);
+static const auto HEARTBEAT_TIMEOUT = std::chrono::seconds(5);
+
+static int64_t currentPid() {
+#ifdef _WIN32
+    return static_cast<int64_t>(GetCurrentProcessId());
+#else
+    return static_cast<int64_t>(getpid());
+#endif
+}
+
+// Requests posted without a result have no promise to settle
+static void settle(std::optional<std::promise<IpcResponse>>& promise, IpcResponse response) {
+    if (promise) {
+        promise->set_value(std::move(response));
+        promise.reset();
+    }
+}
+
+static void settleError(std::optional<std::promise<IpcResponse>>& promise, const std::string& reason) {
+    if (promise) {
+        IpcResponse response;
+        response.error = reason;
+        settle(promise, std::move(response));
+    }
+}
+
+static std::future<IpcResponse> failedResponse(const std::string& reason) {
+    std::promise<IpcResponse> promise;
+    IpcResponse response;
+    response.error = reason;
+    promise.set_value(std::move(response));
+    return promise.get_future();
+}
 
-DiscordIPC::DiscordIPC() = default;
+void appendSetActivityCommand(std::string& out, int64_t pid, std::string_view activityJson,
+                              std::string_view nonce) {
+    // Fixed skeleton with the pre-serialized activity and nonce spliced in
+    JsonWriter writer(out);
+    writer.beginObject()
+        .field("cmd", "SET_ACTIVITY")
+        .key("args").beginObject()
+            .field("pid", pid);
+    if (!activityJson.empty()) {
+        writer.key("activity").raw(activityJson);
+    }
+    writer.endObject()
+        .field("nonce", nonce)
+        .endObject();
+}
+
+DiscordIPC::DiscordIPC(const std::string& clientId)
+    : clientId(clientId), pid(currentPid()), ownReactor(new Reactor()), reactor(*ownReactor) {
+    ownThread = std::thread([this] { reactor.run(); });
+}
+
+DiscordIPC::DiscordIPC(const std::string& clientId, Reactor& reactor)
+    : clientId(clientId), pid(currentPid()), reactor(reactor) {}
 
 DiscordIPC::~DiscordIPC() {
-    closePipe();
+    stop();
 }
 
-#ifdef _WIN32
+bool DiscordIPC::isConnected() const {
+    return connected;
+}
+
+IpcStats DiscordIPC::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statsData;
+}
+
+std::future<IpcResponse> DiscordIPC::connect() {
+    return submit(RequestKind::Connect, "", true);
+}
+
+std::future<IpcResponse> DiscordIPC::sendActivity(std::string activityJson) {
+    return submit(RequestKind::SetActivity, std::move(activityJson), true);
+}
 
-bool DiscordIPC::openPipe() {
-    if (connected) return true;
-
-    for (int i = 0; i < 10; i++) {
-        std::string pipeName = "\\\\.\\pipe\\discord-ipc-" + std::to_string(i);
-
-        pipeHandle = CreateFileA(
-            pipeName.c_str(),
-            GENERIC_READ | GENERIC_WRITE,
-            0,
-            nullptr,
-            OPEN_EXISTING,
-            FILE_FLAG_OVERLAPPED,
-            nullptr
-        );
-
-        if (pipeHandle != INVALID_HANDLE_VALUE) {
-            connected = true;
-            std::cout << "[Discord] Connected to pipe: " << pipeName << std::endl;
-            return true;
+std::future<IpcResponse> DiscordIPC::clearActivity() {
+    return submit(RequestKind::ClearActivity, "", true);
+}
+
+void DiscordIPC::postActivity(std::string activityJson) {
+    submit(RequestKind::SetActivity, std::move(activityJson), false);
+}
+
+void DiscordIPC::postClearActivity() {
+    submit(RequestKind::ClearActivity, "", false);
+}
+
+std::future<IpcResponse> DiscordIPC::submit(RequestKind kind, std::string activityJson, bool withResult) {
+    Request request{kind, std::move(activityJson), {}};
+    std::future<IpcResponse> future;
+    if (withResult) {
+        future = request.promise.emplace().get_future();
+    }
+    std::vector<Request> superseded;
+    bool post = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return withResult ? failedResponse("IPC worker stopped") : std::future<IpcResponse>();
+        }
+        // Only the newest presence matters; drop activity updates not yet written
+        if (kind != RequestKind::Connect) {
+            for (auto it = queue.begin(); it != queue.end();) {
+                if (it->kind != RequestKind::Connect) {
+                    superseded.push_back(std::move(*it));
+                    it = queue.erase(it);
+                } else {
+                    ++it;
+                }
+            }
         }
+        queue.push_back(std::move(request));
+        post = !drainPosted;
+        drainPosted = true;
+    }
+    if (post) {
+        reactor.post([this] { drainQueue(); });
+    }
+
+    for (auto& old : superseded) {
+        settleError(old.promise, "superseded");
+    }
+    return future;
+}
+
+void DiscordIPC::drainQueue() {
+    AllocScope allocScope(AllocTag::Ipc);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        draining.swap(queue);
+        drainPosted = false;
+    }
+    for (auto& request : draining) {
+        process(request);
+    }
+    draining.clear();
+}
+
+void DiscordIPC::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) return;
+        running = false;
     }
 
-    std::cerr << "[Discord] Failed to connect to any Discord pipe" << std::endl;
-    return false;
+    if (ownReactor) {
+        // Stopping from inside the task keeps it from being skipped
+        reactor.post([this] {
+            shutdown();
+            reactor.stop();
+        });
+        if (ownThread.joinable()) {
+            ownThread.join();
+        }
+    } else if (reactor.inReactorThread()) {
+        shutdown();
+    } else {
+        std::promise<void> done;
+        reactor.post([&] {
+            shutdown();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
 }
 
-void DiscordIPC::closePipe() {
-    if (pipeHandle != INVALID_HANDLE_VALUE) {
-        CancelIo(pipeHandle);
-        CloseHandle(pipeHandle);
-        pipeHandle = INVALID_HANDLE_VALUE;
+void DiscordIPC::shutdown() {
+    reactor.cancelTimer(reconnectTimer);
+    reconnectTimer = 0;
+    closeConnection();
+    failAllPending("IPC worker stopped");
+    failWaiting("IPC worker stopped");
+
+    std::vector<Request> unsent;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        unsent.swap(queue);
+    }
+    for (auto& request : unsent) {
+        settleError(request.promise, "IPC worker stopped");
     }
+}
+
+void DiscordIPC::closeConnection() {
+    transport.close();
+    state = State::Disconnected;
     connected = false;
+    pingOutstanding = false;
+    reactor.cancelTimer(handshakeTimer);
+    reactor.cancelTimer(heartbeatTimer);
+    reactor.cancelTimer(probeTimer);
+    handshakeTimer = heartbeatTimer = probeTimer = 0;
 }
 
 bool DiscordIPC::writeFrame(int opcode, const std::string& payload) {
-    if (!connected || pipeHandle == INVALID_HANDLE_VALUE) return false;
-
-    try {
-        // Frame format: [opcode:4 bytes][length:4 bytes][payload]
-        uint32_t len = static_cast<uint32_t>(payload.size());
-        std::vector<char> buffer(8 + len);
-        memcpy(buffer.data(), &opcode, 4);
-        memcpy(buffer.data() + 4, &len, 4);
-        if (len > 0) {
-            memcpy(buffer.data() + 8, payload.c_str(), len);
-        }
+    TraceScope trace("ipc", "frame out");
+    trace.setArg("bytes", static_cast<int64_t>(payload.size()));
+    return transport.queueFrame(opcode, payload);
+}
 
-        OVERLAPPED overlapped = {0};
-        overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
-        if (!overlapped.hEvent) {
-            return false;
-        }
+void DiscordIPC::process(Request& request) {
+    // Remember what Discord should be showing so it survives a reconnect
+    if (request.kind == RequestKind::SetActivity) {
+        desiredActivity = request.activityJson;
+        restorePending = false;
+    } else if (request.kind == RequestKind::ClearActivity) {
+        desiredActivity.clear();
+        restorePending = false;
+    }
 
-        DWORD written = 0;
-        BOOL result = WriteFile(pipeHandle, buffer.data(), static_cast<DWORD>(buffer.size()), &written, &overlapped);
-
-        if (!result && GetLastError() == ERROR_IO_PENDING) {
-            // Wait up to 5 seconds
-            DWORD waitResult = WaitForSingleObject(overlapped.hEvent, 5000);
-            if (waitResult == WAIT_TIMEOUT) {
-                CancelIo(pipeHandle);
-                CloseHandle(overlapped.hEvent);
-                closePipe();
-                std::cerr << "[Discord] Write timeout" << std::endl;
-                return false;
-            }
-            GetOverlappedResult(pipeHandle, &overlapped, &written, FALSE);
-        }
+    if (state == State::Connected) {
+        execute(request);
+        return;
+    }
+    if (state == State::Probing || state == State::Handshaking) {
+        waiting.push_back(std::move(request));
+        return;
+    }
 
-        CloseHandle(overlapped.hEvent);
+    if (request.kind == RequestKind::ClearActivity) {
+        // Nothing to clear on a connection that does not exist
+        settleError(request.promise, "not connected");
+        return;
+    }
 
-        if (written != buffer.size()) {
-            closePipe();
-            return false;
-        }
+    // Inside the backoff window a request costs nothing but this check
+    if (Clock::now() < nextConnectAt) {
+        restorePending = !desiredActivity.empty();
+        scheduleReconnect();
+        settleError(request.promise, "Discord is not available");
+        return;
+    }
 
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "[Discord] Write error: " << e.what() << std::endl;
-        closePipe();
-        return false;
+    waiting.push_back(std::move(request));
+    beginConnect();
+}
+
+void DiscordIPC::execute(Request& request) {
+    if (request.kind == RequestKind::Connect) {
+        IpcResponse response;
+        response.ok = true;
+        settle(request.promise, std::move(response));
+        return;
+    }
+
+    uint64_t requestNonce = ++nonce;
+    char nonceText[24];
+    char* nonceEnd = std::to_chars(nonceText, nonceText + sizeof(nonceText), requestNonce).ptr;
+    envelope.clear();
+    appendSetActivityCommand(envelope, pid, request.activityJson,
+                             std::string_view(nonceText, static_cast<size_t>(nonceEnd - nonceText)));
+
+    // Register before writing so a fast reply always finds its request
+    Pending& slot = pending[requestNonce % MAX_PENDING];
+    if (slot.nonce != 0) {
+        Promise superseded = takePending(slot);
+        settleError(superseded, "superseded");
+    }
+    slot.nonce = requestNonce;
+    slot.promise = std::move(request.promise);
+    slot.sentAt = Clock::now();
+    pendingCount++;
+    if (requestTimer == 0) {
+        // Captures nothing but this, so the timer task needs no allocation
+        requestTimer = reactor.runAt(slot.sentAt + REQUEST_TIMEOUT, [this] { requestsTimedOut(); });
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.requests++;
+    }
+
+    if (!writeFrame(OP_FRAME, envelope)) {
+        connectionLost("write failed");
     }
 }
 
-bool DiscordIPC::readFrame(int& opcode, std::string& data) {
-    if (!connected || pipeHandle == INVALID_HANDLE_VALUE) return false;
+// Frees slot and hands back its promise; the request timer stops with the
+// last pending command
+DiscordIPC::Promise DiscordIPC::takePending(Pending& slot) {
+    Promise promise = std::move(slot.promise);
+    slot.promise.reset();
+    slot.nonce = 0;
+    if (--pendingCount == 0 && requestTimer != 0) {
+        reactor.cancelTimer(requestTimer);
+        requestTimer = 0;
+    }
+    return promise;
+}
 
-    try {
-        OVERLAPPED overlapped = {0};
-        overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
-        if (!overlapped.hEvent) {
-            return false;
+void DiscordIPC::requestsTimedOut() {
+    AllocScope allocScope(AllocTag::Ipc);
+    requestTimer = 0;
+    Clock::time_point now = Clock::now();
+    Clock::time_point next = Clock::time_point::max();
+    for (Pending& slot : pending) {
+        if (slot.nonce == 0) {
+            continue;
+        }
+        if (now - slot.sentAt < REQUEST_TIMEOUT) {
+            next = std::min(next, slot.sentAt + REQUEST_TIMEOUT);
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            statsData.timeouts++;
         }
+        recordFailure(MetricStage::DiscordRoundTrip);
+        Promise promise = takePending(slot);
+        settleError(promise, "timed out waiting for Discord");
+    }
+    if (pendingCount > 0) {
+        requestTimer = reactor.runAt(next, [this] { requestsTimedOut(); });
+    }
+}
+
+void DiscordIPC::beginConnect() {
+    AllocScope allocScope(AllocTag::Ipc);
+    reactor.cancelTimer(reconnectTimer);
+    reconnectTimer = 0;
+    closeConnection();
+    busyProbes = 0;
+    probeEndpoints();
+}
 
-        char header[8];
-        DWORD bytesRead = 0;
-        BOOL result = ReadFile(pipeHandle, header, 8, &bytesRead, &overlapped);
-
-        if (!result && GetLastError() == ERROR_IO_PENDING) {
-            // Wait up to 5 seconds
-            DWORD waitResult = WaitForSingleObject(overlapped.hEvent, 5000);
-            if (waitResult == WAIT_TIMEOUT) {
-                CancelIo(pipeHandle);
-                CloseHandle(overlapped.hEvent);
-                closePipe();
-                std::cerr << "[Discord] Read timeout (header)" << std::endl;
-                return false;
+void DiscordIPC::probeEndpoints() {
+    bool busy = false;
+    int index = transport.open(pipeIndex, busy);
+    if (index < 0 && busy && busyProbes < BUSY_PROBE_LIMIT) {
+        busyProbes++;
+        state = State::Probing;
+        probeTimer = reactor.runAfter(BUSY_PROBE_DELAY, [this] {
+            AllocScope allocScope(AllocTag::Ipc);
+            probeTimer = 0;
+            probeEndpoints();
+        });
+        return;
+    }
+    bool attached = index >= 0 && transport.attach(reactor,
+        [this](int opcode, const std::string& data) { handleFrame(opcode, data); },
+        [this] {
+            if (state == State::Handshaking) {
+                connectFailed();
+            } else {
+                connectionLost("connection lost");
             }
-            GetOverlappedResult(pipeHandle, &overlapped, &bytesRead, FALSE);
-        }
+        });
+    if (!attached) {
+        connectFailed();
+        return;
+    }
 
-        if (bytesRead != 8) {
-            CloseHandle(overlapped.hEvent);
-            closePipe();
-            return false;
-        }
+    json handshake = {
+        {"v", 1},
+        {"client_id", clientId}
+    };
+    logDebug("Discord") << "Sending handshake...";
+    if (!writeFrame(OP_HANDSHAKE, handshake.dump())) {
+        connectFailed();
+        return;
+    }
 
-        memcpy(&opcode, header, 4);
-        uint32_t len;
-        memcpy(&len, header + 4, 4);
+    // The reply (DISPATCH READY, or CLOSE on a bad client id) arrives in handleFrame
+    state = State::Handshaking;
+    pipeIndex = index;
+    handshakeTimer = reactor.runAfter(HANDSHAKE_TIMEOUT, [this] {
+        handshakeTimer = 0;
+        logWarning("Discord") << "Read timeout";
+        connectFailed();
+    });
+}
 
-        // Sanity check on length
-        if (len > 1024 * 1024) {  // Max 1MB
-            CloseHandle(overlapped.hEvent);
-            closePipe();
-            std::cerr << "[Discord] Invalid payload length: " << len << std::endl;
-            return false;
-        }
+void DiscordIPC::handshakeComplete() {
+    logInfo("Discord") << "Handshake complete";
+    reactor.cancelTimer(handshakeTimer);
+    handshakeTimer = 0;
+    state = State::Connected;
+    connected = true;
+    if (connectFailing) {
+        logInfo("Discord") << "Reconnected";
+    }
+    connectFailing = false;
+    backoff = Clock::duration::zero();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.connects++;
+    }
+    markStartup(StartupPhase::DiscordConnected);
 
-        if (len > 0) {
-            data.resize(len);
-            ResetEvent(overlapped.hEvent);
-
-            result = ReadFile(pipeHandle, &data[0], len, &bytesRead, &overlapped);
-            if (!result && GetLastError() == ERROR_IO_PENDING) {
-                DWORD waitResult = WaitForSingleObject(overlapped.hEvent, 5000);
-                if (waitResult == WAIT_TIMEOUT) {
-                    CancelIo(pipeHandle);
-                    CloseHandle(overlapped.hEvent);
-                    closePipe();
-                    std::cerr << "[Discord] Read timeout (payload)" << std::endl;
-                    return false;
-                }
-                GetOverlappedResult(pipeHandle, &overlapped, &bytesRead, FALSE);
-            }
+    lastFrameAt = Clock::now();
+    scheduleHeartbeat(lastFrameAt + HEARTBEAT_INTERVAL);
 
-            if (bytesRead != len) {
-                CloseHandle(overlapped.hEvent);
-                closePipe();
-                return false;
-            }
-        } else {
-            data.clear();
+    std::deque<Request> ready;
+    ready.swap(waiting);
+    for (auto& request : ready) {
+        if (state != State::Connected) {
+            settleError(request.promise, "connection lost");
+            continue;
         }
+        execute(request);
+    }
 
-        CloseHandle(overlapped.hEvent);
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "[Discord] Read error: " << e.what() << std::endl;
-        closePipe();
-        return false;
+    // Bring back the last presence once Discord is reachable again
+    if (restorePending && state == State::Connected) {
+        restorePending = false;
+        Request restore{RequestKind::SetActivity, desiredActivity, {}};
+        execute(restore);
     }
 }
 
-#else
-// Unix implementation would go here
-bool DiscordIPC::openPipe() { return false; }
-void DiscordIPC::closePipe() {}
-bool DiscordIPC::writeFrame(int, const std::string&) { return false; }
-bool DiscordIPC::readFrame(int&, std::string&) { return false; }
-#endif
+void DiscordIPC::connectFailed() {
+    closeConnection();
 
-bool DiscordIPC::isConnected() const {
-    return connected;
+    backoff = backoff == Clock::duration::zero()
+        ? Clock::duration(RECONNECT_BACKOFF_MIN)
+        : std::min<Clock::duration>(backoff * 2, RECONNECT_BACKOFF_MAX);
+    nextConnectAt = Clock::now() + backoff;
+
+    // Log once per outage rather than on every attempt
+    if (!connectFailing) {
+        logWarning("Discord") << "Discord is not available, retrying in the background";
+        connectFailing = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.connectFailures++;
+    }
+
+    failWaiting("Discord is not available");
+    restorePending = !desiredActivity.empty();
+    scheduleReconnect();
 }
 
-bool DiscordIPC::sendHandshake(const std::string& clientId) {
-    try {
-        json handshake = {
-            {"v", 1},
-            {"client_id", clientId}
-        };
+void DiscordIPC::connectionLost(const std::string& reason) {
+    closeConnection();
+    failAllPending(reason);
 
-        std::string payload = handshake.dump();
-        std::cout << "[Discord] Sending handshake..." << std::endl;
+    // Discord may just be restarting: retry right away, then back off
+    if (!desiredActivity.empty()) {
+        restorePending = true;
+    }
+    backoff = Clock::duration::zero();
+    nextConnectAt = Clock::now();
+    scheduleReconnect();
+}
 
-        if (!writeFrame(OP_HANDSHAKE, payload)) {
-            return false;
+void DiscordIPC::scheduleReconnect() {
+    if (!restorePending || reconnectTimer != 0) {
+        return;
+    }
+    reconnectTimer = reactor.runAt(nextConnectAt, [this] {
+        reconnectTimer = 0;
+        if (state == State::Disconnected && restorePending) {
+            beginConnect();
         }
+    });
+}
+
+void DiscordIPC::scheduleHeartbeat(Clock::time_point at) {
+    reactor.cancelTimer(heartbeatTimer);
+    heartbeatTimer = reactor.runAt(at, [this] {
+        heartbeatTimer = 0;
+        heartbeat();
+    });
+}
 
-        // Read response
-        int opcode;
-        std::string response;
-        if (!readFrame(opcode, response)) {
-            return false;
+void DiscordIPC::heartbeat() {
+    AllocScope allocScope(AllocTag::Ipc);
+    if (state != State::Connected) {
+        return;
+    }
+    auto now = Clock::now();
+
+    if (pingOutstanding) {
+        if (lastFrameAt >= pingSentAt) {
+            pingOutstanding = false;
+        } else if (now - pingSentAt >= HEARTBEAT_TIMEOUT) {
+            logWarning("Discord") << "Discord stopped responding, reconnecting";
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                statsData.deadConnections++;
+            }
+            connectionLost("Discord stopped responding");
+            return;
+        } else {
+            scheduleHeartbeat(pingSentAt + HEARTBEAT_TIMEOUT);
+            return;
         }
+    }
 
-        std::cout << "[Discord] Handshake complete" << std::endl;
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "[Discord] Handshake error: " << e.what() << std::endl;
-        return false;
+    // Frames reset the idle clock without rescheduling; catch up here
+    if (now - lastFrameAt < HEARTBEAT_INTERVAL) {
+        scheduleHeartbeat(lastFrameAt + HEARTBEAT_INTERVAL);
+        return;
     }
+
+    pingSentAt = now;
+    pingOutstanding = true;
+    if (!writeFrame(OP_PING, "{}")) {
+        connectionLost("write failed");
+        return;
+    }
+    scheduleHeartbeat(pingSentAt + HEARTBEAT_TIMEOUT);
 }
 
-bool DiscordIPC::sendActivity(const std::string& activityJson) {
-    try {
-        nonce++;
+void DiscordIPC::handleFrame(int opcode, const std::string& data) {
+    AllocScope allocScope(AllocTag::Ipc);
+    TraceScope trace("ipc", "frame in");
+    trace.setArg("opcode", opcode);
+    lastFrameAt = Clock::now();
+
+    if (state == State::Handshaking) {
+        // Only the READY dispatch means Discord accepted the client id
+        if (opcode == OP_PING) {
+            if (!writeFrame(OP_PONG, data)) {
+                connectFailed();
+            }
+            return;
+        }
+        if (opcode == OP_FRAME) {
+            json message = json::parse(data, nullptr, false);
+            if (!message.is_discarded() && message.contains("evt") && message["evt"] == "READY") {
+                handshakeComplete();
+                return;
+            }
+        }
+        logWarning("Discord") << "Handshake rejected: " << data;
+        connectFailed();
+        return;
+    }
+
+    switch (opcode) {
+        case OP_PING:
+            if (!writeFrame(OP_PONG, data)) {
+                connectionLost("write failed");
+            }
+            return;
+        case OP_PONG:
+            return;
+        case OP_CLOSE:
+            logWarning("Discord") << "Connection closed by Discord: " << data;
+            connectionLost("connection lost");
+            return;
+        case OP_FRAME:
+            break;
+        default:
+            return;
+    }
 
-        json activity = json::parse(activityJson);
-        json payload = {
-            {"cmd", "SET_ACTIVITY"},
-            {"args", {
-                {"pid", GetCurrentProcessId()},
-                {"activity", activity}
-            }},
-            {"nonce", std::to_string(nonce)}
-        };
+    json message = json::parse(data, nullptr, false);
+    if (message.is_discarded()) {
+        logWarning("Discord") << "Malformed frame from Discord";
+        return;
+    }
 
-        std::string payloadStr = payload.dump();
+    // Dispatch events (READY etc.) carry a null nonce
+    if (!message.contains("nonce") || !message["nonce"].is_string()) {
+        return;
+    }
 
-        if (!writeFrame(OP_FRAME, payloadStr)) {
-            return false;
+    const std::string& nonceText = message["nonce"].get_ref<const std::string&>();
+    uint64_t replyNonce = 0;
+    std::from_chars(nonceText.data(), nonceText.data() + nonceText.size(), replyNonce);
+    Pending& slot = pending[replyNonce % MAX_PENDING];
+    if (replyNonce == 0 || slot.nonce != replyNonce) {
+        return;  // Already timed out or superseded
+    }
+    Clock::time_point sentAt = slot.sentAt;
+    Promise promise = takePending(slot);
+
+    bool isError = message.contains("evt") && message["evt"] == "ERROR";
+    IpcResponse response;
+    response.roundTrip = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - sentAt);
+    recordLatency(MetricStage::DiscordRoundTrip, response.roundTrip);
+    traceSpan("ipc", "request", sentAt, Clock::now(), "error", isError);
+    if (isError) {
+        recordFailure(MetricStage::DiscordRoundTrip);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t rtt = response.roundTrip.count();
+        statsData.responses++;
+        statsData.lastRoundTripUs = rtt;
+        statsData.totalRoundTripUs += rtt;
+        if (statsData.responses == 1 || rtt < statsData.minRoundTripUs) statsData.minRoundTripUs = rtt;
+        if (rtt > statsData.maxRoundTripUs) statsData.maxRoundTripUs = rtt;
+
+        if (isError) {
+            statsData.failures++;
         }
+    }
 
-        // Read response
-        int opcode;
-        std::string response;
-        if (!readFrame(opcode, response)) {
-            return false;
+    if (isError) {
+        response.error = "error";
+        if (message.contains("data") && message["data"].is_object()) {
+            response.error = message["data"].value("message", response.error);
         }
-
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "[Discord] Activity error: " << e.what() << std::endl;
-        closePipe();
-        return false;
+        logWarning("Discord") << "Request failed: " << response.error;
+    } else {
+        response.ok = true;
+        markStartup(StartupPhase::FirstPresence);
+    }
+    if (promise) {
+        response.payload = data;
+        settle(promise, std::move(response));
     }
 }
 
-bool DiscordIPC::clearActivity() {
-    try {
-        nonce++;
-
-        json payload = {
-            {"cmd", "SET_ACTIVITY"},
-            {"args", {
-                {"pid", GetCurrentProcessId()}
-            }},
-            {"nonce", std::to_string(nonce)}
-        };
-
-        if (!writeFrame(OP_FRAME, payload.dump())) {
-            return false;
+void DiscordIPC::failAllPending(const std::string& reason) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.failures += pendingCount;
+    }
+    for (Pending& slot : pending) {
+        if (slot.nonce != 0) {
+            Promise promise = takePending(slot);
+            settleError(promise, reason);
         }
+    }
+}
 
-        // Read response to prevent pipe backup
-        int opcode;
-        std::string response;
-        readFrame(opcode, response);
-
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "[Discord] Clear error: " << e.what() << std::endl;
-        return false;
+void DiscordIPC::failWaiting(const std::string& reason) {
+    std::deque<Request> failed;
+    failed.swap(waiting);
+    for (auto& request : failed) {
+        settleError(request.promise, reason);
     }
 }
@@ -1,43 +1,156 @@
 #pragma once
 
+#include "discord_transport.h"
 #include <string>
+#include <string_view>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 
-#ifdef _WIN32
-#include <windows.h>
-#endif
+// Result of a request submitted to the IPC worker
+struct IpcResponse {
+    bool ok = false;
+    std::string payload;                 // Raw JSON of Discord's reply (if any)
+    std::string error;                   // Why the request failed
+    std::chrono::microseconds roundTrip{0};
+};
 
-enum DiscordOpcodes {
-    OP_HANDSHAKE = 0,
-    OP_FRAME = 1,
-    OP_CLOSE = 2,
-    OP_PING = 3,
-    OP_PONG = 4
+// Round-trip statistics for nonce-matched requests
+struct IpcStats {
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+    uint64_t failures = 0;
+    uint64_t timeouts = 0;
+    uint64_t connects = 0;
+    uint64_t connectFailures = 0;
+    uint64_t deadConnections = 0;     // Detected by the liveness heartbeat
+    int64_t lastRoundTripUs = 0;
+    int64_t minRoundTripUs = 0;
+    int64_t maxRoundTripUs = 0;
+    int64_t totalRoundTripUs = 0;
 };
 
+// Appends the SET_ACTIVITY command with activityJson (a serialized activity
+// object) spliced in verbatim; an empty activity clears the presence.
+void appendSetActivityCommand(std::string& out, int64_t pid, std::string_view activityJson,
+                              std::string_view nonce);
+
+// Discord IPC connection driven by a reactor. Callers on any thread only
+// enqueue requests; the reactor thread connects, writes frames, answers
+// PINGs and matches responses to their request by nonce as frames arrive.
+//
+// It also owns reconnection: it remembers the last endpoint that worked,
+// retries with exponential backoff (requests arriving in between fail
+// immediately instead of probing), restores the latest presence once
+// Discord is back, and PINGs idle connections to notice a hung client.
 class DiscordIPC {
 public:
-    DiscordIPC();
+    // Runs on its own reactor thread
+    explicit DiscordIPC(const std::string& clientId);
+    // Shares reactor, which must keep running until stop() returns
+    DiscordIPC(const std::string& clientId, Reactor& reactor);
     ~DiscordIPC();
 
-    bool openPipe();
-    void closePipe();
+    std::future<IpcResponse> connect();
+    std::future<IpcResponse> sendActivity(std::string activityJson);
+    std::future<IpcResponse> clearActivity();
+    // The same for callers that ignore the result: no promise is made, and
+    // the reactor's path from the queue to the pipe does not allocate
+    void postActivity(std::string activityJson);
+    void postClearActivity();
+
+    void stop();
     bool isConnected() const;
+    IpcStats stats() const;
+
+private:
+    enum class RequestKind { Connect, SetActivity, ClearActivity };
+    enum class State { Disconnected, Probing, Handshaking, Connected };
+
+    using Promise = std::optional<std::promise<IpcResponse>>;  // Empty when posted
 
+    struct Request {
+        RequestKind kind;
+        std::string activityJson;
+        Promise promise;
+    };
+
+    // Commands awaiting Discord's reply sit in a fixed ring indexed by nonce;
+    // a command still unanswered MAX_PENDING commands later is superseded
+    static const size_t MAX_PENDING = 16;
+    struct Pending {
+        uint64_t nonce = 0;  // 0 = free
+        Promise promise;
+        std::chrono::steady_clock::time_point sentAt;
+    };
+
+    std::future<IpcResponse> submit(RequestKind kind, std::string activityJson, bool withResult);
+    void drainQueue();
+    void process(Request& request);
+    void execute(Request& request);
+    void beginConnect();
+    void probeEndpoints();
+    void handshakeComplete();
+    void connectFailed();
+    void connectionLost(const std::string& reason);
+    void closeConnection();
+    void scheduleReconnect();
+    void scheduleHeartbeat(std::chrono::steady_clock::time_point at);
+    void heartbeat();
+    void requestsTimedOut();
+    Promise takePending(Pending& slot);
+    void handleFrame(int opcode, const std::string& data);
+    void failAllPending(const std::string& reason);
+    void failWaiting(const std::string& reason);
+    void shutdown();
     bool writeFrame(int opcode, const std::string& payload);
-    bool readFrame(int& opcode, std::string& data);
-    bool sendHandshake(const std::string& clientId);
-    bool sendActivity(const std::string& activityJson);
-    bool clearActivity();
 
-private:
+    std::string clientId;
+    int64_t pid;
+    std::unique_ptr<Reactor> ownReactor;  // Only when constructed without one
+    Reactor& reactor;
+    std::thread ownThread;
     std::atomic<bool> connected{false};
-    int nonce{0};
 
-#ifdef _WIN32
-    HANDLE pipeHandle{INVALID_HANDLE_VALUE};
-#else
-    int pipeFd{-1};
-#endif
+    // Reactor thread only
+    State state = State::Disconnected;
+    uint64_t nonce{0};
+    std::string envelope;                            // Reused for every command
+    std::vector<Request> draining;                   // Swapped with queue, keeping both capacities
+    std::deque<Request> waiting;                     // Held until the handshake finishes
+    std::array<Pending, MAX_PENDING> pending;
+    size_t pendingCount = 0;
+    Reactor::TimerId requestTimer = 0;               // Fires for the oldest pending command
+    Reactor::TimerId handshakeTimer = 0;
+    Reactor::TimerId heartbeatTimer = 0;
+    Reactor::TimerId reconnectTimer = 0;
+    Reactor::TimerId probeTimer = 0;
+    int busyProbes = 0;                              // Retries of busy endpoints this attempt
+
+    // Reconnect scheduling and liveness, reactor thread only
+    int pipeIndex = -1;                              // Last endpoint that accepted us
+    std::chrono::steady_clock::duration backoff{0};
+    std::chrono::steady_clock::time_point nextConnectAt{};
+    bool connectFailing = false;
+    std::string desiredActivity;                     // Re-sent after a reconnect
+    bool restorePending = false;
+    bool pingOutstanding = false;
+    std::chrono::steady_clock::time_point pingSentAt{};
+    std::chrono::steady_clock::time_point lastFrameAt{};
+
+    mutable std::mutex mutex;  // Guards queue, drainPosted, running and statsData
+    std::vector<Request> queue;
+    bool drainPosted = false;
+    bool running = true;
+    IpcStats statsData;
+
+    DiscordTransport transport;
 };
@@ -0,0 +1,645 @@
+#include "discord_transport.h"
+#include "alloc_stats.h"
+#include "log.h"
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+void encodeFrameHeader(char* header, int opcode, uint32_t length) {
+    uint32_t op = static_cast<uint32_t>(opcode);
+    for (int i = 0; i < 4; i++) {
+        header[i] = static_cast<char>((op >> (8 * i)) & 0xFF);
+        header[4 + i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    }
+}
+
+bool decodeFrameHeader(const char* header, int& opcode, uint32_t& length) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(header);
+    uint32_t op = 0;
+    length = 0;
+    for (int i = 0; i < 4; i++) {
+        op |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+        length |= static_cast<uint32_t>(bytes[4 + i]) << (8 * i);
+    }
+    opcode = static_cast<int>(op);
+    return length <= MAX_FRAME_PAYLOAD;
+}
+
+DiscordTransport::DiscordTransport() = default;
+
+DiscordTransport::~DiscordTransport() {
+    close();
+}
+
+int DiscordTransport::open(int preferredIndex, bool& busy) {
+    close();
+    busy = false;
+
+    // Neither connect waits, so probing every endpoint in turn stays cheap;
+    // the preferred one goes first, then the lowest that accepts wins
+    for (int attempt = -1; attempt < ENDPOINT_COUNT; attempt++) {
+        int index = attempt < 0 ? preferredIndex : attempt;
+        if (index < 0 || index >= ENDPOINT_COUNT || (attempt >= 0 && index == preferredIndex)) {
+            continue;
+        }
+        bool endpointBusy = false;
+        NativeHandle handle = connectEndpoint(index, endpointBusy);
+        busy = busy || endpointBusy;
+        if (isValid(handle) && adopt(handle)) {
+            logInfo("Discord") << "Connected to " << endpointName(index);
+            busy = false;
+            return index;
+        }
+    }
+    return -1;
+}
+
+// Hands every complete frame at the front of inBuffer to onFrame; false once
+// the connection is gone, either closed by a handler or on a malformed frame
+bool DiscordTransport::deliverFrames() {
+    uint64_t closes = closeCount;
+    size_t offset = 0;
+    while (inBuffer.size() - offset >= FRAME_HEADER_SIZE) {
+        int opcode;
+        uint32_t length;
+        if (!decodeFrameHeader(&inBuffer[offset], opcode, length)) {
+            logError("Discord") << "Invalid payload length: " << length;
+            fail();
+            return false;
+        }
+        if (inBuffer.size() - offset - FRAME_HEADER_SIZE < length) {
+            break;
+        }
+        frameData.assign(inBuffer, offset + FRAME_HEADER_SIZE, length);
+        offset += FRAME_HEADER_SIZE + length;
+        onFrame(opcode, frameData);
+        if (closeCount != closes) {
+            return false;
+        }
+    }
+    inBuffer.erase(0, offset);
+    return true;
+}
+
+void DiscordTransport::fail() {
+    ClosedHandler handler = onClosed;
+    close();
+    if (handler) {
+        handler();
+    }
+}
+
+#ifdef _WIN32
+
+std::string DiscordTransport::endpointName(int index) {
+    return "\\\\.\\pipe\\discord-ipc-" + std::to_string(index);
+}
+
+DiscordTransport::NativeHandle DiscordTransport::connectEndpoint(int index, bool& busy) {
+    std::string pipeName = endpointName(index);
+    HANDLE handle = CreateFileA(
+        pipeName.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        0,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED,
+        nullptr
+    );
+    // All instances taken; no WaitNamedPipe, the caller retries later
+    busy = handle == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY;
+    return handle;
+}
+
+bool DiscordTransport::isValid(NativeHandle handle) {
+    return handle != INVALID_HANDLE_VALUE;
+}
+
+bool DiscordTransport::adopt(NativeHandle handle) {
+    close();
+
+    // One manual-reset event per direction, reused for every overlapped call
+    readEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    writeEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    cancelEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (!readEvent || !writeEvent || !cancelEvent) {
+        CloseHandle(handle);
+        close();
+        return false;
+    }
+
+    pipeHandle = handle;
+    return true;
+}
+
+void DiscordTransport::cancel() {
+    if (cancelEvent) {
+        SetEvent(cancelEvent);
+    }
+}
+
+struct DiscordTransport::AsyncPipe {
+    HANDLE pipe{INVALID_HANDLE_VALUE};
+    bool closed = false;
+    Reactor::Operation readOp;
+    Reactor::Operation writeOp;
+    std::vector<char> readBuffer = std::vector<char>(16 * 1024);
+    std::string writing;  // Owned by the WriteFile in flight
+    std::string queued;   // Frames waiting for it to finish
+    bool writeInFlight = false;
+};
+
+bool DiscordTransport::attach(Reactor& reactor, FrameHandler onFrame, ClosedHandler onClosed) {
+    if (pipeHandle == INVALID_HANDLE_VALUE || !reactor.associate(pipeHandle)) {
+        return false;
+    }
+    this->reactor = &reactor;
+    this->onFrame = std::move(onFrame);
+    this->onClosed = std::move(onClosed);
+    async = std::make_shared<AsyncPipe>();
+    async->pipe = pipeHandle;
+    return startRead();
+}
+
+// Keeps one overlapped read outstanding; its completion delivers the frames
+// and issues the next read
+bool DiscordTransport::startRead() {
+    std::shared_ptr<AsyncPipe> state = async;
+    static_cast<OVERLAPPED&>(state->readOp) = OVERLAPPED();
+    state->readOp.complete = [this, state](DWORD bytes, DWORD error) {
+        if (state->closed) {
+            return;
+        }
+        AllocScope allocScope(AllocTag::Ipc);
+        if (error != ERROR_SUCCESS || bytes == 0) {
+            fail();
+            return;
+        }
+        inBuffer.append(state->readBuffer.data(), bytes);
+        if (deliverFrames() && !startRead()) {
+            fail();
+        }
+    };
+
+    // Even an immediate success is reported through the completion port
+    if (!ReadFile(state->pipe, state->readBuffer.data(), static_cast<DWORD>(state->readBuffer.size()),
+                  nullptr, &state->readOp) && GetLastError() != ERROR_IO_PENDING) {
+        state->readOp.complete = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool DiscordTransport::startWrite() {
+    std::shared_ptr<AsyncPipe> state = async;
+    state->writing.swap(state->queued);
+    state->queued.clear();
+    static_cast<OVERLAPPED&>(state->writeOp) = OVERLAPPED();
+    state->writeOp.complete = [this, state](DWORD bytes, DWORD error) {
+        state->writeInFlight = false;
+        if (state->closed) {
+            return;
+        }
+        AllocScope allocScope(AllocTag::Ipc);
+        if (error != ERROR_SUCCESS) {
+            fail();
+            return;
+        }
+        // A short write goes out again ahead of anything queued since
+        if (bytes < state->writing.size()) {
+            state->queued.insert(0, state->writing, bytes, std::string::npos);
+        }
+        state->writing.clear();
+        if (!state->queued.empty() && !startWrite()) {
+            fail();
+        }
+    };
+
+    state->writeInFlight = true;
+    if (!WriteFile(state->pipe, state->writing.data(), static_cast<DWORD>(state->writing.size()),
+                   nullptr, &state->writeOp) && GetLastError() != ERROR_IO_PENDING) {
+        state->writeOp.complete = nullptr;
+        state->writeInFlight = false;
+        return false;
+    }
+    return true;
+}
+
+bool DiscordTransport::queueFrame(int opcode, const char* payload, size_t length) {
+    if (!async || length > MAX_FRAME_PAYLOAD) return false;
+
+    char header[FRAME_HEADER_SIZE];
+    encodeFrameHeader(header, opcode, static_cast<uint32_t>(length));
+    async->queued.append(header, FRAME_HEADER_SIZE);
+    async->queued.append(payload, length);
+    return async->writeInFlight || startWrite();
+}
+
+void DiscordTransport::close() {
+    if (async) {
+        async->closed = true;
+        async.reset();
+    }
+    if (reactor) {
+        reactor = nullptr;
+        closeCount++;
+        inBuffer.clear();
+    }
+    if (pipeHandle != INVALID_HANDLE_VALUE) {
+        CancelIoEx(pipeHandle, nullptr);
+        CloseHandle(pipeHandle);
+        pipeHandle = INVALID_HANDLE_VALUE;
+    }
+    if (readEvent) {
+        CloseHandle(readEvent);
+        readEvent = nullptr;
+    }
+    if (writeEvent) {
+        CloseHandle(writeEvent);
+        writeEvent = nullptr;
+    }
+    if (cancelEvent) {
+        CloseHandle(cancelEvent);
+        cancelEvent = nullptr;
+    }
+}
+
+bool DiscordTransport::isOpen() const {
+    return pipeHandle != INVALID_HANDLE_VALUE;
+}
+
+// Runs overlapped reads/writes until length bytes moved; pipes may complete partially
+bool DiscordTransport::transfer(bool write, void* buffer, DWORD length, HANDLE event, int timeoutMs) {
+    char* cursor = static_cast<char*>(buffer);
+    while (length > 0) {
+        OVERLAPPED overlapped = {0};
+        overlapped.hEvent = event;
+
+        DWORD moved = 0;
+        BOOL result = write
+            ? WriteFile(pipeHandle, cursor, length, &moved, &overlapped)
+            : ReadFile(pipeHandle, cursor, length, &moved, &overlapped);
+
+        if (!result) {
+            if (GetLastError() != ERROR_IO_PENDING) {
+                return false;
+            }
+            // cancelEvent stays signalled, so a cancel() that races ahead of this call still wins
+            HANDLE waitHandles[2] = {event, cancelEvent};
+            DWORD waitResult = WaitForMultipleObjects(2, waitHandles, FALSE,
+                timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs));
+            if (waitResult != WAIT_OBJECT_0) {
+                CancelIoEx(pipeHandle, &overlapped);
+                GetOverlappedResult(pipeHandle, &overlapped, &moved, TRUE);
+                if (waitResult == WAIT_TIMEOUT) {
+                    logWarning("Discord") << (write ? "Write" : "Read") << " timeout";
+                }
+                return false;
+            }
+            if (!GetOverlappedResult(pipeHandle, &overlapped, &moved, FALSE)) {
+                return false;
+            }
+        }
+
+        if (moved == 0) {
+            return false;
+        }
+        cursor += moved;
+        length -= moved;
+    }
+    return true;
+}
+
+bool DiscordTransport::writeFrame(int opcode, const char* payload, size_t length) {
+    if (pipeHandle == INVALID_HANDLE_VALUE || length > MAX_FRAME_PAYLOAD) return false;
+
+    // WriteFileGather only works on unbuffered files, so header and payload
+    // are packed into a buffer that keeps its capacity between frames
+    sendBuffer.resize(FRAME_HEADER_SIZE + length);
+    encodeFrameHeader(&sendBuffer[0], opcode, static_cast<uint32_t>(length));
+    if (length > 0) {
+        memcpy(&sendBuffer[FRAME_HEADER_SIZE], payload, length);
+    }
+
+    // Wait up to 5 seconds
+    return transfer(true, &sendBuffer[0], static_cast<DWORD>(sendBuffer.size()), writeEvent, 5000);
+}
+
+bool DiscordTransport::readFrame(int& opcode, std::string& data, int timeoutMs) {
+    if (pipeHandle == INVALID_HANDLE_VALUE) return false;
+
+    char header[FRAME_HEADER_SIZE];
+    if (!transfer(false, header, FRAME_HEADER_SIZE, readEvent, timeoutMs)) {
+        return false;
+    }
+
+    uint32_t len;
+    if (!decodeFrameHeader(header, opcode, len)) {
+        logError("Discord") << "Invalid payload length: " << len;
+        return false;
+    }
+
+    data.resize(len);
+    if (len == 0) {
+        return true;
+    }
+    // The header already arrived, so the payload follows promptly
+    return transfer(false, &data[0], len, readEvent, 5000);
+}
+
+#else
+
+std::string DiscordTransport::endpointName(int index) {
+    // Same lookup order as the Discord client: XDG_RUNTIME_DIR, TMPDIR, TMP, TEMP, /tmp
+    std::string baseDir = "/tmp";
+    for (const char* var : {"XDG_RUNTIME_DIR", "TMPDIR", "TMP", "TEMP"}) {
+        const char* value = getenv(var);
+        if (value && *value) {
+            baseDir = value;
+            break;
+        }
+    }
+    return baseDir + "/discord-ipc-" + std::to_string(index);
+}
+
+DiscordTransport::NativeHandle DiscordTransport::connectEndpoint(int index, bool& busy) {
+    std::string socketPath = endpointName(index);
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // Non-blocking, so a full accept backlog fails now instead of stalling
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        busy = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+        ::close(fd);
+        return -1;
+    }
+    // writeFrame and readFrame block; attach() makes it non-blocking again
+    if (fcntl(fd, F_SETFL, flags) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool DiscordTransport::isValid(NativeHandle handle) {
+    return handle >= 0;
+}
+
+bool DiscordTransport::adopt(NativeHandle handle) {
+    close();
+    pipeFd = handle;
+    return true;
+}
+
+void DiscordTransport::cancel() {
+    if (pipeFd >= 0) {
+        // Makes a blocked recv return 0 without releasing the descriptor
+        shutdown(pipeFd, SHUT_RDWR);
+    }
+}
+
+void DiscordTransport::close() {
+    if (reactor) {
+        reactor->unwatch(pipeFd);
+        reactor = nullptr;
+        closeCount++;
+        inBuffer.clear();
+        outBuffer.clear();
+    }
+    if (pipeFd >= 0) {
+        ::close(pipeFd);
+        pipeFd = -1;
+    }
+}
+
+bool DiscordTransport::attach(Reactor& reactor, FrameHandler onFrame, ClosedHandler onClosed) {
+    if (pipeFd < 0 || fcntl(pipeFd, F_SETFL, fcntl(pipeFd, F_GETFL) | O_NONBLOCK) != 0) {
+        return false;
+    }
+    bool watched = reactor.watch(pipeFd, Reactor::READABLE, [this](uint32_t events) {
+        AllocScope allocScope(AllocTag::Ipc);
+        uint64_t closes = closeCount;
+        if (events & Reactor::WRITABLE) {
+            onWritable();
+        }
+        if ((events & Reactor::READABLE) && closeCount == closes) {
+            onReadable();
+        }
+    });
+    if (!watched) {
+        return false;
+    }
+    this->reactor = &reactor;
+    this->onFrame = std::move(onFrame);
+    this->onClosed = std::move(onClosed);
+    return true;
+}
+
+void DiscordTransport::onReadable() {
+    char chunk[16 * 1024];
+    bool hungUp = false;
+    while (true) {
+        ssize_t received = recv(pipeFd, chunk, sizeof(chunk), 0);
+        if (received > 0) {
+            inBuffer.append(chunk, static_cast<size_t>(received));
+            continue;
+        }
+        if (received < 0 && errno == EINTR) continue;
+        hungUp = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+    // Frames that arrived ahead of a hangup still count
+    if (deliverFrames() && hungUp) {
+        fail();
+    }
+}
+
+void DiscordTransport::onWritable() {
+    int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+    while (!outBuffer.empty()) {
+        ssize_t sent = send(pipeFd, outBuffer.data(), outBuffer.size(), flags);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            fail();
+            return;
+        }
+        outBuffer.erase(0, static_cast<size_t>(sent));
+    }
+    reactor->modify(pipeFd, Reactor::READABLE);
+}
+
+bool DiscordTransport::queueFrame(int opcode, const char* payload, size_t length) {
+    if (!reactor || length > MAX_FRAME_PAYLOAD) return false;
+
+    char header[FRAME_HEADER_SIZE];
+    encodeFrameHeader(header, opcode, static_cast<uint32_t>(length));
+
+    // Keep frames in order behind anything still buffered
+    if (!outBuffer.empty()) {
+        outBuffer.append(header, FRAME_HEADER_SIZE);
+        outBuffer.append(payload, length);
+        return true;
+    }
+
+    iovec parts[2];
+    parts[0].iov_base = header;
+    parts[0].iov_len = FRAME_HEADER_SIZE;
+    parts[1].iov_base = const_cast<char*>(payload);
+    parts[1].iov_len = length;
+
+    msghdr message = {};
+    message.msg_iov = parts;
+    message.msg_iovlen = length > 0 ? 2 : 1;
+
+    int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(pipeFd, &message, flags);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        sent = 0;
+    }
+
+    size_t done = static_cast<size_t>(sent);
+    if (done < FRAME_HEADER_SIZE) {
+        outBuffer.append(header + done, FRAME_HEADER_SIZE - done);
+        done = 0;
+    } else {
+        done -= FRAME_HEADER_SIZE;
+    }
+    outBuffer.append(payload + done, length - done);
+    if (!outBuffer.empty()) {
+        reactor->modify(pipeFd, Reactor::READABLE | Reactor::WRITABLE);
+    }
+    return true;
+}
+
+bool DiscordTransport::isOpen() const {
+    return pipeFd >= 0;
+}
+
+bool DiscordTransport::writeFrame(int opcode, const char* payload, size_t length) {
+    if (pipeFd < 0 || length > MAX_FRAME_PAYLOAD) return false;
+
+    char header[FRAME_HEADER_SIZE];
+    encodeFrameHeader(header, opcode, static_cast<uint32_t>(length));
+
+    // Gather header and payload into one sendmsg (writev plus MSG_NOSIGNAL)
+    iovec parts[2];
+    parts[0].iov_base = header;
+    parts[0].iov_len = FRAME_HEADER_SIZE;
+    parts[1].iov_base = const_cast<char*>(payload);
+    parts[1].iov_len = length;
+
+    msghdr message = {};
+    message.msg_iov = parts;
+    message.msg_iovlen = length > 0 ? 2 : 1;
+
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+
+    while (message.msg_iovlen > 0) {
+        ssize_t sent = sendmsg(pipeFd, &message, flags);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // Skip fully written parts and advance into a partially written one
+        size_t remaining = static_cast<size_t>(sent);
+        while (message.msg_iovlen > 0 && remaining >= message.msg_iov[0].iov_len) {
+            remaining -= message.msg_iov[0].iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if (message.msg_iovlen > 0) {
+            message.msg_iov[0].iov_base = static_cast<char*>(message.msg_iov[0].iov_base) + remaining;
+            message.msg_iov[0].iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+bool DiscordTransport::readFully(char* buffer, size_t length, int timeoutMs) {
+    while (length > 0) {
+        pollfd pfd = {pipeFd, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeoutMs);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready == 0) {
+            logWarning("Discord") << "Read timeout";
+            return false;
+        }
+        if (ready < 0) {
+            return false;
+        }
+
+        ssize_t received = recv(pipeFd, buffer, length, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            return false;
+        }
+        buffer += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool DiscordTransport::readFrame(int& opcode, std::string& data, int timeoutMs) {
+    if (pipeFd < 0) return false;
+
+    char header[FRAME_HEADER_SIZE];
+    if (!readFully(header, FRAME_HEADER_SIZE, timeoutMs)) {
+        return false;
+    }
+
+    uint32_t len;
+    if (!decodeFrameHeader(header, opcode, len)) {
+        logError("Discord") << "Invalid payload length: " << len;
+        return false;
+    }
+
+    data.resize(len);
+    if (len == 0) {
+        return true;
+    }
+    // The header already arrived, so the payload follows promptly
+    return readFully(&data[0], len, 5000);
+}
+
+#endif
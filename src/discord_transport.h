@@ -0,0 +1,129 @@
+#pragma once
+
+#include "reactor.h"
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+enum DiscordOpcodes {
+    OP_HANDSHAKE = 0,
+    OP_FRAME = 1,
+    OP_CLOSE = 2,
+    OP_PING = 3,
+    OP_PONG = 4
+};
+
+// Discord IPC frames: [opcode:4 bytes LE][length:4 bytes LE][payload]
+static const size_t FRAME_HEADER_SIZE = 8;
+static const uint32_t MAX_FRAME_PAYLOAD = 1024 * 1024;  // Max 1MB
+
+void encodeFrameHeader(char* header, int opcode, uint32_t length);
+bool decodeFrameHeader(const char* header, int& opcode, uint32_t& length);
+
+// One connection to the Discord IPC endpoint (named pipe on Windows,
+// Unix domain socket elsewhere). Frames are written with a single gather
+// write of header + payload, and the wait events and receive buffers are
+// owned by the connection so steady-state traffic does not allocate.
+//
+// writeFrame and readFrame may run concurrently on different threads, but
+// each of them must only be called from one thread at a time. Once attached
+// to a reactor the connection is non-blocking: frames arrive through the
+// frame handler and go out through queueFrame, all on the reactor thread.
+class DiscordTransport {
+public:
+    DiscordTransport();
+    ~DiscordTransport();
+
+    DiscordTransport(const DiscordTransport&) = delete;
+    DiscordTransport& operator=(const DiscordTransport&) = delete;
+
+#ifdef _WIN32
+    using NativeHandle = HANDLE;
+#else
+    using NativeHandle = int;
+#endif
+
+    // Connects to a discord-ipc-N endpoint and returns N, or -1 if none
+    // answered. preferredIndex (the last endpoint that worked) is tried
+    // first, then the lowest one that accepts wins. Never waits, so it is
+    // safe on a reactor thread: busy is set when an endpoint exists but all
+    // its pipe instances (or its accept backlog) were taken, worth a retry.
+    int open(int preferredIndex, bool& busy);
+    bool adopt(NativeHandle handle);
+    // Wakes a reader blocked in readFrame; the connection must still be closed
+    void cancel();
+    void close();
+    bool isOpen() const;
+
+    bool writeFrame(int opcode, const char* payload, size_t length);
+    bool writeFrame(int opcode, const std::string& payload) {
+        return writeFrame(opcode, payload.data(), payload.size());
+    }
+
+    // Reads one frame into data, reusing its capacity. timeoutMs < 0 waits
+    // until a frame arrives or the connection is cancelled.
+    bool readFrame(int& opcode, std::string& data, int timeoutMs);
+
+    using FrameHandler = std::function<void(int opcode, const std::string& data)>;
+    using ClosedHandler = std::function<void()>;
+
+    // Hands the open connection to reactor. onClosed runs once if the peer
+    // hangs up or I/O fails (the connection is already closed by then), but
+    // not after close(). Either handler may close the transport; neither may
+    // attach it again.
+    bool attach(Reactor& reactor, FrameHandler onFrame, ClosedHandler onClosed);
+    // Writes what the connection accepts now and buffers the rest
+    bool queueFrame(int opcode, const char* payload, size_t length);
+    bool queueFrame(int opcode, const std::string& payload) {
+        return queueFrame(opcode, payload.data(), payload.size());
+    }
+
+    static const int ENDPOINT_COUNT = 10;
+    // Pipe name or socket path of discord-ipc-N
+    static std::string endpointName(int index);
+
+private:
+    static NativeHandle connectEndpoint(int index, bool& busy);
+    static bool isValid(NativeHandle handle);
+
+    bool deliverFrames();
+    void fail();
+
+    // Attached mode, reactor thread only
+    Reactor* reactor{nullptr};
+    FrameHandler onFrame;
+    ClosedHandler onClosed;
+    uint64_t closeCount = 0;  // Lets a handler's caller notice the connection went away
+    std::string inBuffer;     // Received bytes not yet split into frames
+    std::string frameData;    // Reused for every delivered frame
+
+#ifdef _WIN32
+    bool transfer(bool write, void* buffer, DWORD length, HANDLE event, int timeoutMs);
+
+    HANDLE pipeHandle{INVALID_HANDLE_VALUE};
+    HANDLE readEvent{nullptr};
+    HANDLE writeEvent{nullptr};
+    HANDLE cancelEvent{nullptr};
+    std::string sendBuffer;  // Named pipes have no gather write; reused across frames
+
+    // Overlapped operations outlive close() until their aborted completions
+    // arrive, so they live in shared state the completions keep alive
+    struct AsyncPipe;
+    bool startRead();
+    bool startWrite();
+    std::shared_ptr<AsyncPipe> async;
+#else
+    bool readFully(char* buffer, size_t length, int timeoutMs);
+    void onReadable();
+    void onWritable();
+
+    int pipeFd{-1};
+    std::string outBuffer;  // Queued bytes the socket did not take yet
+#endif
+};
@@ -0,0 +1,923 @@
+#include "http_client.h"
+#include "alloc_stats.h"
+#include "log.h"
+#include "reactor.h"
+#include "trace.h"
+#include "utf16.h"
+#include <cctype>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winhttp.h>
+#pragma comment(lib, "winhttp.lib")
+#else
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef PLEYX_HAVE_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#endif
+#endif
+
+static const char* USER_AGENT = "Pleyx/1.0";
+
+std::string urlEncode(const std::string& s) {
+    std::string encoded;
+    for (char c : s) {
+        if (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.') {
+            encoded += c;
+        } else if (c == ' ') {
+            encoded += '+';
+        } else {
+            char hex[4];
+            snprintf(hex, sizeof(hex), "%%%02X", static_cast<unsigned char>(c));
+            encoded += hex;
+        }
+    }
+    return encoded;
+}
+
+HttpResponse httpRequest(const std::string& method, const std::string& url,
+                         const std::vector<std::string>& headers, const std::string& body) {
+    Reactor reactor;
+    HttpResponse result;
+    httpRequestAsync(reactor, method, url, headers, body, [&](HttpResponse response) {
+        result = std::move(response);
+        reactor.stop();
+    });
+    reactor.run();
+    return result;
+}
+
+#ifdef _WIN32
+
+static void CALLBACK onWinHttpStatus(HINTERNET handle, DWORD_PTR context, DWORD status,
+                                     LPVOID info, DWORD infoLength);
+
+// One asynchronous session for the whole process, so WinHttp can keep
+// connections alive and SChannel's TLS session cache applies across
+// requests. Its status callback drives every request.
+static HINTERNET sharedSession() {
+    static HINTERNET session = [] {
+        HINTERNET handle = WinHttpOpen(L"Pleyx/1.0",
+            WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+            WINHTTP_NO_PROXY_NAME,
+            WINHTTP_NO_PROXY_BYPASS, WINHTTP_FLAG_ASYNC);
+        if (handle) {
+            WinHttpSetStatusCallback(handle, onWinHttpStatus,
+                WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES, 0);
+        }
+        return handle;
+    }();
+    return session;
+}
+
+// A request in flight. WinHttp calls back on its own threads, one call at
+// a time per request; the finished response is posted to the reactor and
+// the state is freed when the request handle reports it is closing.
+struct WinHttpExchange {
+    std::shared_ptr<Reactor::Handle> reactor;
+    HttpCallback done;
+    HINTERNET connect = nullptr;
+    HINTERNET request = nullptr;
+    std::string requestBody;  // Must outlive the send
+    HttpResponse response;
+    size_t readOffset = 0;    // Where the read in flight lands in the body
+    bool completed = false;
+    TraceClock::time_point startedAt = TraceClock::now();
+};
+
+static void completeExchange(WinHttpExchange* exchange, bool ok) {
+    if (exchange->completed) {
+        return;
+    }
+    exchange->completed = true;
+
+    HttpResponse response = ok ? std::move(exchange->response) : HttpResponse();
+    HttpCallback done = std::move(exchange->done);
+    TraceClock::time_point startedAt = exchange->startedAt;
+    exchange->reactor->post([done, response, startedAt]() mutable {
+        AllocScope allocScope(AllocTag::Http);
+        traceSpan("http", "request", startedAt, TraceClock::now(), "status", response.status);
+        done(std::move(response));
+    });
+
+    // Closing the request may free exchange before the call returns
+    HINTERNET connect = exchange->connect;
+    WinHttpCloseHandle(exchange->request);
+    WinHttpCloseHandle(connect);
+}
+
+static void CALLBACK onWinHttpStatus(HINTERNET handle, DWORD_PTR context, DWORD status,
+                                     LPVOID info, DWORD infoLength) {
+    auto* exchange = reinterpret_cast<WinHttpExchange*>(context);
+    if (!exchange) {
+        return;  // The connect handle carries no context
+    }
+    AllocScope allocScope(AllocTag::Http);
+
+    switch (status) {
+        case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+            if (!WinHttpReceiveResponse(handle, nullptr)) {
+                completeExchange(exchange, false);
+            }
+            break;
+        case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE: {
+            DWORD code = 0;
+            DWORD codeSize = sizeof(code);
+            WinHttpQueryHeaders(handle, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                WINHTTP_HEADER_NAME_BY_INDEX, &code, &codeSize, WINHTTP_NO_HEADER_INDEX);
+            exchange->response.status = static_cast<int>(code);
+            if (!WinHttpQueryDataAvailable(handle, nullptr)) {
+                completeExchange(exchange, false);
+            }
+            break;
+        }
+        case WINHTTP_CALLBACK_STATUS_DATA_AVAILABLE: {
+            DWORD available = *static_cast<DWORD*>(info);
+            if (available == 0) {
+                completeExchange(exchange, true);
+                break;
+            }
+            exchange->readOffset = exchange->response.body.size();
+            exchange->response.body.resize(exchange->readOffset + available);
+            if (!WinHttpReadData(handle, &exchange->response.body[exchange->readOffset], available, nullptr)) {
+                completeExchange(exchange, false);
+            }
+            break;
+        }
+        case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+            exchange->response.body.resize(exchange->readOffset + infoLength);
+            if (infoLength == 0) {
+                completeExchange(exchange, true);
+            } else if (!WinHttpQueryDataAvailable(handle, nullptr)) {
+                completeExchange(exchange, false);
+            }
+            break;
+        case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
+            completeExchange(exchange, false);
+            break;
+        case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING:
+            if (handle == exchange->request) {
+                delete exchange;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+TlsStats tlsStats() {
+    return TlsStats();
+}
+
+bool addTrustedCaFile(const std::string&) {
+    // WinHttp only trusts the Windows certificate store
+    return false;
+}
+
+void httpRequestAsync(Reactor& reactor, const std::string& method, const std::string& url,
+                      const std::vector<std::string>& headers, const std::string& body,
+                      HttpCallback done) {
+    AllocScope allocScope(AllocTag::Http);
+    auto fail = [&] {
+        reactor.post([done] { done(HttpResponse()); });
+    };
+    std::wstring wUrl = toWide(url);
+
+    URL_COMPONENTS urlComp = {0};
+    urlComp.dwStructSize = sizeof(urlComp);
+    wchar_t hostName[256] = {0};
+    wchar_t urlPath[2048] = {0};
+    urlComp.lpszHostName = hostName;
+    urlComp.dwHostNameLength = 256;
+    urlComp.lpszUrlPath = urlPath;
+    urlComp.dwUrlPathLength = 2048;
+
+    if (!WinHttpCrackUrl(wUrl.c_str(), 0, 0, &urlComp)) {
+        logError("HTTP") << "Failed to parse URL";
+        fail();
+        return;
+    }
+
+    HINTERNET hSession = sharedSession();
+    if (!hSession) {
+        fail();
+        return;
+    }
+
+    HINTERNET hConnect = WinHttpConnect(hSession, hostName, urlComp.nPort, 0);
+    if (!hConnect) {
+        fail();
+        return;
+    }
+
+    DWORD flags = (urlComp.nScheme == INTERNET_SCHEME_HTTPS) ? WINHTTP_FLAG_SECURE : 0;
+    HINTERNET hRequest = WinHttpOpenRequest(hConnect, toWide(method).c_str(), urlPath,
+        nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+    if (!hRequest) {
+        WinHttpCloseHandle(hConnect);
+        fail();
+        return;
+    }
+
+    auto* exchange = new WinHttpExchange();
+    exchange->reactor = reactor.handle();
+    exchange->done = std::move(done);
+    exchange->connect = hConnect;
+    exchange->request = hRequest;
+    exchange->requestBody = body;
+
+    // Set before anything can call back, so every callback finds its exchange
+    DWORD_PTR context = reinterpret_cast<DWORD_PTR>(exchange);
+    WinHttpSetOption(hRequest, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context));
+
+    for (const auto& header : headers) {
+        WinHttpAddRequestHeaders(hRequest, toWide(header).c_str(), static_cast<DWORD>(-1), WINHTTP_ADDREQ_FLAG_ADD);
+    }
+
+    LPVOID requestData = exchange->requestBody.empty()
+        ? WINHTTP_NO_REQUEST_DATA : const_cast<char*>(exchange->requestBody.data());
+    DWORD requestLength = static_cast<DWORD>(exchange->requestBody.size());
+    if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+        requestData, requestLength, requestLength, context)) {
+        completeExchange(exchange, false);
+    }
+}
+
+#else
+
+static const int IO_TIMEOUT_SECS = 15;
+
+struct ParsedUrl {
+    bool https = false;
+    std::string host;
+    std::string port;
+    std::string target;  // Path and query
+};
+
+static bool parseUrl(const std::string& url, ParsedUrl& parsed) {
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd == std::string::npos) {
+        return false;
+    }
+    std::string scheme = url.substr(0, schemeEnd);
+    if (scheme == "https") {
+        parsed.https = true;
+    } else if (scheme != "http") {
+        return false;
+    }
+
+    size_t hostStart = schemeEnd + 3;
+    size_t pathStart = url.find('/', hostStart);
+    std::string authority = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+    parsed.target = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        parsed.host = authority.substr(0, colon);
+        parsed.port = authority.substr(colon + 1);
+    } else {
+        parsed.host = authority;
+        parsed.port = parsed.https ? "443" : "80";
+    }
+    if (parsed.host.size() > 2 && parsed.host.front() == '[' && parsed.host.back() == ']') {
+        parsed.host = parsed.host.substr(1, parsed.host.size() - 2);
+    }
+    return !parsed.host.empty();
+}
+
+struct ResolvedAddress {
+    sockaddr_storage address;
+    socklen_t length;
+};
+
+struct ResolvedHost {
+    std::vector<ResolvedAddress> addresses;
+    std::chrono::steady_clock::time_point expires;
+};
+
+// getaddrinfo has no portable non-blocking form, so lookups run on one
+// long-lived thread and the results are posted back to the reactor that
+// asked. Requests for a host already being looked up wait on that lookup.
+// Failures are cached briefly, so a DNS outage costs one lookup per host
+// every few seconds instead of one per request.
+static const auto DNS_CACHE_TTL = std::chrono::minutes(5);
+static const auto DNS_FAILURE_TTL = std::chrono::seconds(5);
+
+using ResolveCallback = std::function<void(std::vector<ResolvedAddress> addresses)>;
+
+struct DnsWaiter {
+    std::shared_ptr<Reactor::Handle> reactor;
+    ResolveCallback done;
+};
+
+struct DnsQuery {
+    std::string key;  // host:port
+    std::string host;
+    std::string port;
+};
+
+struct DnsResolver {
+    std::mutex mutex;  // Guards everything below
+    std::condition_variable wake;
+    std::unordered_map<std::string, ResolvedHost> cache;  // Empty addresses: the lookup failed
+    std::unordered_map<std::string, std::vector<DnsWaiter>> waiters;
+    std::deque<DnsQuery> queue;
+    bool started = false;
+};
+
+static DnsResolver& dnsResolver() {
+    // Never destroyed: the thread may still be inside getaddrinfo at exit
+    static DnsResolver* resolver = new DnsResolver();
+    return *resolver;
+}
+
+static std::string hostKey(const ParsedUrl& url) {
+    return url.host + ":" + url.port;
+}
+
+static void runResolver(DnsResolver& resolver) {
+    traceThreadName("dns");
+    std::unique_lock<std::mutex> lock(resolver.mutex);
+    while (true) {
+        resolver.wake.wait(lock, [&resolver] { return !resolver.queue.empty(); });
+        DnsQuery query = std::move(resolver.queue.front());
+        resolver.queue.pop_front();
+        lock.unlock();
+
+        std::vector<ResolvedAddress> addresses;
+        {
+            TraceScope trace("http", "dns lookup");
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* results = nullptr;
+            if (getaddrinfo(query.host.c_str(), query.port.c_str(), &hints, &results) == 0) {
+                for (addrinfo* ai = results; ai; ai = ai->ai_next) {
+                    ResolvedAddress resolved = {};
+                    memcpy(&resolved.address, ai->ai_addr, ai->ai_addrlen);
+                    resolved.length = ai->ai_addrlen;
+                    addresses.push_back(resolved);
+                }
+                freeaddrinfo(results);
+            }
+        }
+
+        lock.lock();
+        auto ttl = addresses.empty() ? std::chrono::steady_clock::duration(DNS_FAILURE_TTL)
+                                     : std::chrono::steady_clock::duration(DNS_CACHE_TTL);
+        resolver.cache[query.key] = ResolvedHost{addresses, std::chrono::steady_clock::now() + ttl};
+        std::vector<DnsWaiter> waiting = std::move(resolver.waiters[query.key]);
+        resolver.waiters.erase(query.key);
+        lock.unlock();
+
+        // Dropped for a reactor that is gone
+        for (DnsWaiter& waiter : waiting) {
+            waiter.reactor->post([done = std::move(waiter.done), addresses] { done(addresses); });
+        }
+        waiting.clear();
+        lock.lock();
+    }
+}
+
+// The cached addresses of url's host, empty for a recent failure; false if
+// it has to be looked up
+static bool cachedAddresses(const ParsedUrl& url, std::vector<ResolvedAddress>& addresses) {
+    DnsResolver& resolver = dnsResolver();
+    std::lock_guard<std::mutex> lock(resolver.mutex);
+    auto it = resolver.cache.find(hostKey(url));
+    if (it == resolver.cache.end() || std::chrono::steady_clock::now() >= it->second.expires) {
+        return false;
+    }
+    addresses = it->second.addresses;
+    return true;
+}
+
+// Looks up url's host on the resolver thread; done runs on reactor with the
+// addresses, empty if the host doesn't resolve
+static void resolveAsync(Reactor& reactor, const ParsedUrl& url, ResolveCallback done) {
+    DnsResolver& resolver = dnsResolver();
+    std::string key = hostKey(url);
+    std::lock_guard<std::mutex> lock(resolver.mutex);
+    std::vector<DnsWaiter>& waiting = resolver.waiters[key];
+    waiting.push_back(DnsWaiter{reactor.handle(), std::move(done)});
+    if (waiting.size() > 1) {
+        return;
+    }
+    resolver.queue.push_back(DnsQuery{key, url.host, url.port});
+    if (!resolver.started) {
+        resolver.started = true;
+        std::thread(runResolver, std::ref(resolver)).detach();
+    }
+    resolver.wake.notify_one();
+}
+
+// After connecting to every address failed: look the host up again next time
+static void forgetResolved(const ParsedUrl& url) {
+    DnsResolver& resolver = dnsResolver();
+    std::lock_guard<std::mutex> lock(resolver.mutex);
+    resolver.cache.erase(hostKey(url));
+}
+
+#ifdef PLEYX_HAVE_OPENSSL
+
+// The client context shared by every HTTPS request, with the most recent
+// session per host:port so the next connection can resume instead of
+// doing a full handshake. TLS 1.3 tickets arrive after the handshake, so
+// sessions are collected through the new-session callback.
+struct TlsState {
+    std::mutex mutex;  // Guards sessions
+    SSL_CTX* context = nullptr;
+    std::unordered_map<std::string, SSL_SESSION*> sessions;
+    std::atomic<uint64_t> fullHandshakes{0};
+    std::atomic<uint64_t> resumedHandshakes{0};
+    std::atomic<uint64_t> failedHandshakes{0};
+};
+
+static int sessionKeyIndex() {
+    static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+static TlsState& tlsState();
+
+static int onNewSession(SSL* ssl, SSL_SESSION* session) {
+    auto* key = static_cast<const std::string*>(SSL_get_ex_data(ssl, sessionKeyIndex()));
+    if (!key) {
+        return 0;
+    }
+    TlsState& state = tlsState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    SSL_SESSION*& slot = state.sessions[*key];
+    if (slot) {
+        SSL_SESSION_free(slot);
+    }
+    slot = session;
+    return 1;  // The cache keeps the reference
+}
+
+static TlsState& tlsState() {
+    static TlsState state;
+    static std::once_flag once;
+    std::call_once(once, [] {
+        state.context = SSL_CTX_new(TLS_client_method());
+        if (state.context) {
+            SSL_CTX_set_min_proto_version(state.context, TLS1_2_VERSION);
+            SSL_CTX_set_default_verify_paths(state.context);
+            SSL_CTX_set_verify(state.context, SSL_VERIFY_PEER, nullptr);
+            SSL_CTX_set_session_cache_mode(state.context,
+                SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(state.context, onNewSession);
+        }
+    });
+    return state;
+}
+
+TlsStats tlsStats() {
+    TlsState& state = tlsState();
+    TlsStats stats;
+    stats.fullHandshakes = state.fullHandshakes;
+    stats.resumedHandshakes = state.resumedHandshakes;
+    stats.failedHandshakes = state.failedHandshakes;
+    return stats;
+}
+
+bool addTrustedCaFile(const std::string& caFile) {
+    TlsState& state = tlsState();
+    return state.context && SSL_CTX_load_verify_locations(state.context, caFile.c_str(), nullptr) == 1;
+}
+
+#else
+
+TlsStats tlsStats() {
+    return TlsStats();
+}
+
+bool addTrustedCaFile(const std::string&) {
+    return false;
+}
+
+#endif
+
+static bool decodeChunked(const std::string& raw, std::string& body) {
+    size_t pos = 0;
+    while (pos < raw.size()) {
+        size_t lineEnd = raw.find("\r\n", pos);
+        if (lineEnd == std::string::npos) {
+            return false;
+        }
+        size_t chunkSize = strtoul(raw.c_str() + pos, nullptr, 16);
+        pos = lineEnd + 2;
+        if (chunkSize == 0) {
+            return true;
+        }
+        if (pos + chunkSize > raw.size()) {
+            return false;
+        }
+        body.append(raw, pos, chunkSize);
+        pos += chunkSize + 2;
+    }
+    return false;
+}
+
+static bool headerEquals(const std::string& headers, const char* name, const char* value) {
+    std::string lower;
+    lower.reserve(headers.size());
+    for (char c : headers) lower += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    std::string needle = std::string("\r\n") + name + ":";
+    size_t pos = lower.find(needle);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    size_t end = lower.find("\r\n", pos + needle.size());
+    return lower.substr(pos + needle.size(), end - pos - needle.size()).find(value) != std::string::npos;
+}
+
+static bool parseResponse(const std::string& raw, HttpResponse& response) {
+    size_t headerEnd = raw.find("\r\n\r\n");
+    if (headerEnd == std::string::npos || raw.compare(0, 5, "HTTP/") != 0) {
+        return false;
+    }
+    size_t statusStart = raw.find(' ');
+    if (statusStart == std::string::npos || statusStart > headerEnd) {
+        return false;
+    }
+
+    std::string headerBlock = raw.substr(0, headerEnd);
+    if (headerEquals(headerBlock, "transfer-encoding", "chunked")) {
+        if (!decodeChunked(raw.substr(headerEnd + 4), response.body)) {
+            return false;
+        }
+    } else {
+        response.body = raw.substr(headerEnd + 4);
+    }
+    response.status = atoi(raw.c_str() + statusStart + 1);
+    return true;
+}
+
+// One request on a reactor: non-blocking connect (trying each resolved
+// address), TLS handshake, request write, then reading to end of stream
+// under Connection: close. The reactor's fd handler and the timeout timer
+// keep it alive until it finishes.
+class HttpExchange : public std::enable_shared_from_this<HttpExchange> {
+public:
+    HttpExchange(Reactor& reactor, HttpCallback done) : reactor(reactor), done(std::move(done)) {}
+    ~HttpExchange() { closeSocket(); }
+
+    bool start(const std::string& method, const std::string& url,
+               const std::vector<std::string>& headers, const std::string& body);
+
+private:
+    enum class Step { Connecting, Handshaking, Sending, Receiving };
+    enum class Io { Next, WantRead, WantWrite, Stop };
+
+    void resolved(std::vector<ResolvedAddress> resolved);
+    bool connectNext();
+    void advance();
+    Io finishConnect();
+    Io handshake();
+    Io sendRequest();
+    Io receive();
+    void finish(bool received);
+    void closeSocket();
+
+    Reactor& reactor;
+    HttpCallback done;
+    ParsedUrl url;
+    std::vector<ResolvedAddress> addresses;
+    size_t nextAddress = 0;
+    int fd = -1;
+    Step step = Step::Connecting;
+    std::string request;
+    size_t sent = 0;
+    std::string raw;
+    Reactor::TimerId timeout = 0;
+    bool finished = false;
+    TraceClock::time_point startedAt = TraceClock::now();
+    TraceClock::time_point handshakeStartedAt;
+#ifdef PLEYX_HAVE_OPENSSL
+    SSL* ssl = nullptr;
+    std::string sessionKey;  // host:port, read by the new-session callback
+    bool offeredSession = false;
+#endif
+};
+
+bool HttpExchange::start(const std::string& method, const std::string& target,
+                         const std::vector<std::string>& headers, const std::string& body) {
+    if (!parseUrl(target, url)) {
+        logError("HTTP") << "Failed to parse URL";
+        return false;
+    }
+#ifndef PLEYX_HAVE_OPENSSL
+    if (url.https) {
+        logError("HTTP") << "Built without OpenSSL, cannot reach https://" << url.host;
+        return false;
+    }
+#endif
+
+    request = method + " " + url.target + " HTTP/1.1\r\n"
+        "Host: " + url.host + "\r\n"
+        "User-Agent: " + USER_AGENT + "\r\n"
+        "Connection: close\r\n";
+    if (!body.empty() || method == "POST" || method == "PUT") {
+        request += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    for (const auto& header : headers) {
+        request += header + "\r\n";
+    }
+    request += "\r\n";
+    request += body;
+
+    std::vector<ResolvedAddress> cached;
+    bool known = cachedAddresses(url, cached);
+    if (known) {
+        addresses = std::move(cached);
+        if (!connectNext()) {
+            if (!addresses.empty()) {
+                forgetResolved(url);
+            }
+            return false;
+        }
+    }
+
+    // Armed before an uncached lookup, so the timeout covers it too
+    auto self = shared_from_this();
+    timeout = reactor.runAfter(std::chrono::seconds(IO_TIMEOUT_SECS), [self] {
+        self->timeout = 0;
+        logWarning("HTTP") << "Request to " << self->url.host << " timed out";
+        self->finish(false);
+    });
+    if (!known) {
+        resolveAsync(reactor, url, [self](std::vector<ResolvedAddress> resolved) {
+            self->resolved(std::move(resolved));
+        });
+    }
+    return true;
+}
+
+void HttpExchange::resolved(std::vector<ResolvedAddress> resolved) {
+    if (finished) {
+        return;  // Timed out during the lookup
+    }
+    AllocScope allocScope(AllocTag::Http);
+    addresses = std::move(resolved);
+    if (addresses.empty()) {
+        finish(false);
+        return;
+    }
+    if (!connectNext()) {
+        forgetResolved(url);
+        finish(false);
+    }
+}
+
+bool HttpExchange::connectNext() {
+    closeSocket();
+    while (nextAddress < addresses.size()) {
+        const ResolvedAddress& address = addresses[nextAddress++];
+        fd = socket(address.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            continue;
+        }
+        // Requests go out in a few small writes (TLS records, then the
+        // request); don't let Nagle hold them for the peer's delayed ACK
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        // Writable once the connect finished, either way
+        step = Step::Connecting;
+        auto self = shared_from_this();
+        if ((connect(fd, reinterpret_cast<const sockaddr*>(&address.address), address.length) == 0 ||
+             errno == EINPROGRESS) &&
+            reactor.watch(fd, Reactor::WRITABLE, [self](uint32_t) { self->advance(); })) {
+            return true;
+        }
+        close(fd);
+        fd = -1;
+    }
+    return false;
+}
+
+// Runs the steps as far as the socket allows, then waits for readiness
+void HttpExchange::advance() {
+    AllocScope allocScope(AllocTag::Http);
+    while (!finished) {
+        Io io = Io::Stop;
+        switch (step) {
+            case Step::Connecting: io = finishConnect(); break;
+            case Step::Handshaking: io = handshake(); break;
+            case Step::Sending: io = sendRequest(); break;
+            case Step::Receiving: io = receive(); break;
+        }
+        if (io == Io::Stop) {
+            return;
+        }
+        if (io != Io::Next) {
+            reactor.modify(fd, io == Io::WantRead ? Reactor::READABLE : Reactor::WRITABLE);
+            return;
+        }
+    }
+}
+
+HttpExchange::Io HttpExchange::finishConnect() {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+        if (connectNext()) {
+            return Io::WantWrite;
+        }
+        forgetResolved(url);
+        finish(false);
+        return Io::Stop;
+    }
+    if (!url.https) {
+        step = Step::Sending;
+        return Io::Next;
+    }
+
+#ifdef PLEYX_HAVE_OPENSSL
+    TlsState& state = tlsState();
+    if (!state.context || !(ssl = SSL_new(state.context))) {
+        finish(false);
+        return Io::Stop;
+    }
+    SSL_set_fd(ssl, fd);
+    SSL_set_tlsext_host_name(ssl, url.host.c_str());
+    SSL_set1_host(ssl, url.host.c_str());
+
+    sessionKey = url.host + ":" + url.port;
+    SSL_set_ex_data(ssl, sessionKeyIndex(), &sessionKey);
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto it = state.sessions.find(sessionKey);
+        if (it != state.sessions.end()) {
+            offeredSession = SSL_set_session(ssl, it->second) == 1;
+        }
+    }
+    step = Step::Handshaking;
+    handshakeStartedAt = TraceClock::now();
+    return Io::Next;
+#else
+    finish(false);
+    return Io::Stop;
+#endif
+}
+
+HttpExchange::Io HttpExchange::handshake() {
+#ifdef PLEYX_HAVE_OPENSSL
+    TlsState& state = tlsState();
+    int result = SSL_connect(ssl);
+    if (result == 1) {
+        bool resumed = SSL_session_reused(ssl);
+        if (resumed) {
+            state.resumedHandshakes++;
+        } else {
+            state.fullHandshakes++;
+        }
+        traceSpan("http", "tls handshake", handshakeStartedAt, TraceClock::now(), "resumed", resumed);
+        step = Step::Sending;
+        return Io::Next;
+    }
+
+    int error = SSL_get_error(ssl, result);
+    if (error == SSL_ERROR_WANT_READ) return Io::WantRead;
+    if (error == SSL_ERROR_WANT_WRITE) return Io::WantWrite;
+
+    state.failedHandshakes++;
+    logWarning("HTTP") << "TLS handshake with " << url.host << " failed: "
+                       << ERR_reason_error_string(ERR_get_error());
+    if (offeredSession) {
+        // Never offer a session the server choked on again
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto it = state.sessions.find(sessionKey);
+        if (it != state.sessions.end()) {
+            SSL_SESSION_free(it->second);
+            state.sessions.erase(it);
+        }
+    }
+#endif
+    finish(false);
+    return Io::Stop;
+}
+
+HttpExchange::Io HttpExchange::sendRequest() {
+    while (sent < request.size()) {
+        long n;
+#ifdef PLEYX_HAVE_OPENSSL
+        if (ssl) {
+            n = SSL_write(ssl, request.data() + sent, static_cast<int>(request.size() - sent));
+            if (n <= 0) {
+                int error = SSL_get_error(ssl, static_cast<int>(n));
+                if (error == SSL_ERROR_WANT_READ) return Io::WantRead;
+                if (error == SSL_ERROR_WANT_WRITE) return Io::WantWrite;
+            }
+        } else
+#endif
+        {
+            n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return Io::WantWrite;
+        }
+        if (n <= 0) {
+            finish(false);
+            return Io::Stop;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    step = Step::Receiving;
+    return Io::Next;
+}
+
+// Connection: close, so the response ends at end of stream; like the
+// blocking client, a read error also ends it and whatever arrived is parsed
+HttpExchange::Io HttpExchange::receive() {
+    char buffer[16384];
+    while (true) {
+        long n;
+#ifdef PLEYX_HAVE_OPENSSL
+        if (ssl) {
+            n = SSL_read(ssl, buffer, sizeof(buffer));
+            if (n <= 0) {
+                int error = SSL_get_error(ssl, static_cast<int>(n));
+                if (error == SSL_ERROR_WANT_READ) return Io::WantRead;
+                if (error == SSL_ERROR_WANT_WRITE) return Io::WantWrite;
+            }
+        } else
+#endif
+        {
+            n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return Io::WantRead;
+        }
+        if (n <= 0) {
+            finish(true);
+            return Io::Stop;
+        }
+        raw.append(buffer, static_cast<size_t>(n));
+    }
+}
+
+void HttpExchange::finish(bool received) {
+    if (finished) {
+        return;
+    }
+    finished = true;
+    AllocScope allocScope(AllocTag::Http);
+    reactor.cancelTimer(timeout);
+    timeout = 0;
+    closeSocket();
+
+    HttpResponse response;
+    if (received && !parseResponse(raw, response)) {
+        response = HttpResponse();
+    }
+    traceSpan("http", "request", startedAt, TraceClock::now(), "status", response.status);
+    HttpCallback callback = std::move(done);
+    callback(std::move(response));
+}
+
+void HttpExchange::closeSocket() {
+#ifdef PLEYX_HAVE_OPENSSL
+    if (ssl) {
+        if (step == Step::Receiving) {
+            SSL_shutdown(ssl);  // Best effort close_notify; never waits
+        }
+        SSL_free(ssl);
+        ssl = nullptr;
+    }
+#endif
+    if (fd >= 0) {
+        reactor.unwatch(fd);
+        close(fd);
+        fd = -1;
+    }
+}
+
+void httpRequestAsync(Reactor& reactor, const std::string& method, const std::string& url,
+                      const std::vector<std::string>& headers, const std::string& body,
+                      HttpCallback done) {
+    AllocScope allocScope(AllocTag::Http);
+    auto exchange = std::make_shared<HttpExchange>(reactor, done);
+    if (!exchange->start(method, url, headers, body)) {
+        reactor.post([done] { done(HttpResponse()); });
+    }
+}
+
+#endif
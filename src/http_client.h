@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Reactor;
+
+struct HttpResponse {
+    int status = 0;  // 0 when the request never got a response
+    std::string body;
+
+    bool ok() const { return status >= 200 && status < 300; }
+};
+
+using HttpCallback = std::function<void(HttpResponse)>;
+
+// HTTP/HTTPS request multiplexed on reactor; call it on the reactor thread.
+// done always runs later on that thread, never from inside this call.
+// headers are complete "Name: value" lines. WinHttp's async mode on
+// Windows; non-blocking sockets plus OpenSSL elsewhere.
+void httpRequestAsync(Reactor& reactor, const std::string& method, const std::string& url,
+                      const std::vector<std::string>& headers, const std::string& body,
+                      HttpCallback done);
+
+// Blocking form of httpRequestAsync, run on a reactor of its own
+HttpResponse httpRequest(const std::string& method, const std::string& url,
+                         const std::vector<std::string>& headers = {},
+                         const std::string& body = "");
+
+struct TlsStats {
+    uint64_t fullHandshakes = 0;
+    uint64_t resumedHandshakes = 0;  // Completed with a cached session
+    uint64_t failedHandshakes = 0;
+};
+
+// Handshake counters for the shared TLS context. Windows leaves session
+// caching to SChannel and does not report them.
+TlsStats tlsStats();
+
+// Also trust the PEM certificates in caFile, e.g. a test CA
+bool addTrustedCaFile(const std::string& caFile);
+
+// Percent-encodes s for use in a query string (spaces become '+')
+std::string urlEncode(const std::string& s);
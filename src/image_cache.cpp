@@ -1,136 +1,205 @@
 #include "image_cache.h"
-#include <iostream>
-#include <sstream>
+#include "http_client.h"
+#include "log.h"
+#include "metrics.h"
+#include "reactor.h"
+#include "trace.h"
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <random>
 
-#ifdef _WIN32
-#include <windows.h>
-#include <winhttp.h>
-#pragma comment(lib, "winhttp.lib")
-#endif
+using json = nlohmann::json;
+namespace fs = std::filesystem;
 
-ImageCache::ImageCache(const std::string& plexUrl, const std::string& plexToken)
-    : plexUrl(plexUrl), plexToken(plexToken) {
+// New uploads arrive in bursts when a library is browsed; one write covers them
+static const auto SAVE_DELAY = std::chrono::seconds(10);
+
+ImageCache::ImageCache(const std::string& plexUrl, const std::string& plexToken, const std::string& uploadUrl)
+    : uploadUrl(uploadUrl) {
+    setPlexServer(plexUrl, plexToken);
+}
+
+void ImageCache::setPlexServer(const std::string& plexUrl, const std::string& plexToken) {
+    std::string url = plexUrl;
     // Remove trailing slash from plex URL
-    while (!this->plexUrl.empty() && this->plexUrl.back() == '/') {
-        this->plexUrl.pop_back();
+    while (!url.empty() && url.back() == '/') {
+        url.pop_back();
+    }
+    if (url != this->plexUrl) {
+        cache.clear();
+        recency.clear();
     }
+    this->plexUrl = std::move(url);
+    this->plexToken = plexToken;
 }
 
-std::string ImageCache::getCatboxUrl(const std::string& artPath) {
+void ImageCache::getCatboxUrl(Reactor& reactor, const std::string& artPath, UrlCallback done) {
     if (artPath.empty()) {
-        return "";
+        reactor.post([done] { done(""); });
+        return;
     }
 
-    std::lock_guard<std::mutex> lock(cacheMutex);
-
     // Check cache first
-    auto it = cache.find(artPath);
-    if (it != cache.end()) {
-        return it->second;
+    if (const std::string* url = cachedUrl(artPath)) {
+        traceInstant("cache", "art hit");
+        reactor.post([done, url = *url] { done(url); });
+        return;
     }
 
     // Download from Plex
-    std::cout << "[ImageCache] Downloading: " << artPath << std::endl;
-    auto imageData = downloadFromPlex(artPath);
-    if (imageData.empty()) {
-        std::cerr << "[ImageCache] Failed to download image" << std::endl;
-        return "";
-    }
-
-    std::cout << "[ImageCache] Downloaded " << imageData.size() << " bytes, uploading to catbox..." << std::endl;
-
-    // Upload to catbox
-    std::string catboxUrl = uploadToCatbox(imageData);
-    if (catboxUrl.empty()) {
-        std::cerr << "[ImageCache] Failed to upload to catbox" << std::endl;
-        return "";
-    }
-
-    std::cout << "[ImageCache] Uploaded: " << catboxUrl << std::endl;
-
-    // Cache the result
-    cache[artPath] = catboxUrl;
-    return catboxUrl;
+    traceInstant("cache", "art miss", "entries", static_cast<int64_t>(cache.size()));
+    logDebug("ImageCache") << "Downloading: " << artPath;
+    auto started = std::chrono::steady_clock::now();
+    httpRequestAsync(reactor, "GET", plexUrl + artPath + "?X-Plex-Token=" + plexToken, {}, "",
+        [this, &reactor, artPath, done, started](HttpResponse response) {
+            recordLatency(MetricStage::ArtDownload, std::chrono::steady_clock::now() - started);
+            traceSpan("cache", "art download", started, std::chrono::steady_clock::now(), "bytes",
+                static_cast<int64_t>(response.body.size()));
+            if (!response.ok() || response.body.empty()) {
+                recordFailure(MetricStage::ArtDownload);
+                logWarning("ImageCache") << "Failed to download image";
+                done("");
+                return;
+            }
+
+            logDebug("ImageCache") << "Downloaded " << response.body.size() << " bytes, uploading to catbox...";
+
+            // Upload to catbox, then cache the result
+            uploadToCatbox(reactor, response.body, [this, artPath, done](std::string catboxUrl) {
+                if (catboxUrl.empty()) {
+                    logWarning("ImageCache") << "Failed to upload to catbox";
+                } else {
+                    logInfo("ImageCache") << "Uploaded: " << catboxUrl;
+                    rememberUrl(artPath, catboxUrl);
+                }
+                done(std::move(catboxUrl));
+            });
+        });
 }
 
-#ifdef _WIN32
-std::vector<uint8_t> ImageCache::downloadFromPlex(const std::string& artPath) {
-    std::vector<uint8_t> result;
-
-    std::string fullUrl = plexUrl + artPath + "?X-Plex-Token=" + plexToken;
-    std::wstring wUrl(fullUrl.begin(), fullUrl.end());
-
-    URL_COMPONENTS urlComp = {0};
-    urlComp.dwStructSize = sizeof(urlComp);
-    wchar_t hostName[256] = {0};
-    wchar_t urlPath[2048] = {0};
-    urlComp.lpszHostName = hostName;
-    urlComp.dwHostNameLength = 256;
-    urlComp.lpszUrlPath = urlPath;
-    urlComp.dwUrlPathLength = 2048;
-
-    if (!WinHttpCrackUrl(wUrl.c_str(), 0, 0, &urlComp)) {
-        return result;
+const std::string* ImageCache::cachedUrl(const std::string& artPath) {
+    auto it = cache.find(artPath);
+    if (it == cache.end()) {
+        return nullptr;
     }
-
-    HINTERNET hSession = WinHttpOpen(L"Pleyx/1.0",
-        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-        WINHTTP_NO_PROXY_NAME,
-        WINHTTP_NO_PROXY_BYPASS, 0);
-
-    if (!hSession) return result;
-
-    HINTERNET hConnect = WinHttpConnect(hSession, hostName, urlComp.nPort, 0);
-    if (!hConnect) {
-        WinHttpCloseHandle(hSession);
-        return result;
+    // The new order is saved with the next write, not on its own
+    if (it->second.position != recency.begin()) {
+        recency.splice(recency.begin(), recency, it->second.position);
+        dirty = true;
     }
+    return &it->second.url;
+}
 
-    DWORD flags = (urlComp.nScheme == INTERNET_SCHEME_HTTPS) ? WINHTTP_FLAG_SECURE : 0;
-    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", urlPath,
-        nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
-
-    if (!hRequest) {
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return result;
+void ImageCache::rememberUrl(const std::string& artPath, std::string url) {
+    auto it = cache.find(artPath);
+    if (it != cache.end()) {
+        it->second.url = std::move(url);
+        recency.splice(recency.begin(), recency, it->second.position);
+    } else {
+        recency.push_front(artPath);
+        cache.emplace(artPath, Entry{std::move(url), recency.begin()});
+        if (cache.size() > MAX_ENTRIES) {
+            cache.erase(recency.back());
+            recency.pop_back();
+        }
     }
+    scheduleSave();
+}
 
-    if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-        WINHTTP_NO_REQUEST_DATA, 0, 0, 0)) {
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return result;
+void ImageCache::scheduleSave() {
+    dirty = true;
+    if (!saveReactor || saveTimer != 0) {
+        return;
     }
+    std::weak_ptr<bool> alive = lifetime;
+    saveTimer = saveReactor->runAfter(SAVE_DELAY, [this, alive] {
+        if (alive.expired()) {
+            return;
+        }
+        saveTimer = 0;
+        flush();
+    });
+}
 
-    if (!WinHttpReceiveResponse(hRequest, nullptr)) {
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return result;
+void ImageCache::flush() {
+    if (!dirty || cacheFile.empty()) {
+        return;
     }
+    dirty = false;
+    saveCacheFile();
+}
 
-    DWORD bytesAvailable = 0;
-    DWORD bytesRead = 0;
-    while (WinHttpQueryDataAvailable(hRequest, &bytesAvailable) && bytesAvailable > 0) {
-        std::vector<uint8_t> buffer(bytesAvailable);
-        if (WinHttpReadData(hRequest, buffer.data(), bytesAvailable, &bytesRead)) {
-            result.insert(result.end(), buffer.begin(), buffer.begin() + bytesRead);
+bool ImageCache::useCacheFile(Reactor& reactor, const std::string& path) {
+    saveReactor = &reactor;
+    cacheFile = path;
+    std::ifstream file(fs::u8path(path), std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    json j = json::parse(file, nullptr, false);
+    if (!j.is_object() || !j.contains("art") || !(j["art"].is_array() || j["art"].is_object())) {
+        logWarning("ImageCache") << "Ignoring malformed cache file " << path;
+        return false;
+    }
+    // Art paths are only meaningful on the server they came from
+    if (j.value("plex_url", "") != plexUrl) {
+        return true;
+    }
+    // [path, url] pairs, most recently used first; files from before the
+    // limit hold an object in no particular order
+    auto load = [this](const json& artPath, const json& url) {
+        if (!artPath.is_string() || !url.is_string() || cache.size() >= MAX_ENTRIES) {
+            return;
+        }
+        const std::string& key = artPath.get_ref<const std::string&>();
+        if (cache.count(key) == 0) {
+            recency.push_back(key);
+            cache.emplace(key, Entry{url.get<std::string>(), std::prev(recency.end())});
+        }
+    };
+    if (j["art"].is_array()) {
+        for (const json& pair : j["art"]) {
+            if (pair.is_array() && pair.size() == 2) {
+                load(pair[0], pair[1]);
+            }
+        }
+    } else {
+        for (const auto& entry : j["art"].items()) {
+            load(json(entry.key()), entry.value());
         }
     }
-
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-
-    return result;
+    logDebug("ImageCache") << "Loaded " << cache.size() << " art URLs from " << path;
+    return true;
 }
 
-std::string ImageCache::uploadToCatbox(const std::vector<uint8_t>& imageData) {
-    std::string result;
+// The file is small (at most MAX_ENTRIES URLs), so it is rewritten whole,
+// through a temporary file so a crash mid-write leaves the old one
+void ImageCache::saveCacheFile() const {
+    json art = json::array();
+    for (const std::string& artPath : recency) {
+        art.push_back({artPath, cache.at(artPath).url});
+    }
+    json j = {{"plex_url", plexUrl}, {"art", std::move(art)}};
+    fs::path path = fs::u8path(cacheFile);
+    fs::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!(file << j.dump())) {
+            logWarning("ImageCache") << "Cannot write cache file " << cacheFile;
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temporary, path, ec);
+    if (ec) {
+        logWarning("ImageCache") << "Cannot replace cache file " << cacheFile << ": " << ec.message();
+    }
+}
 
+void ImageCache::uploadToCatbox(Reactor& reactor, const std::string& imageData, UrlCallback done) {
     // Generate boundary
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -142,96 +211,39 @@ std::string ImageCache::uploadToCatbox(const std::vector<uint8_t>& imageData) {
     }
 
     // Build multipart form data
-    std::vector<uint8_t> body;
+    std::string body;
+    body.reserve(imageData.size() + 512);
 
     // reqtype field
-    std::string part1 = "--" + boundary + "\r\n"
+    body += "--" + boundary + "\r\n"
         "Content-Disposition: form-data; name=\"reqtype\"\r\n\r\n"
         "fileupload\r\n";
-    body.insert(body.end(), part1.begin(), part1.end());
 
     // file field
-    std::string part2 = "--" + boundary + "\r\n"
+    body += "--" + boundary + "\r\n"
         "Content-Disposition: form-data; name=\"fileToUpload\"; filename=\"image.jpg\"\r\n"
         "Content-Type: image/jpeg\r\n\r\n";
-    body.insert(body.end(), part2.begin(), part2.end());
-    body.insert(body.end(), imageData.begin(), imageData.end());
-
-    std::string part3 = "\r\n--" + boundary + "--\r\n";
-    body.insert(body.end(), part3.begin(), part3.end());
-
-    // Connect to catbox.moe
-    HINTERNET hSession = WinHttpOpen(L"Pleyx/1.0",
-        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-        WINHTTP_NO_PROXY_NAME,
-        WINHTTP_NO_PROXY_BYPASS, 0);
-
-    if (!hSession) return result;
-
-    HINTERNET hConnect = WinHttpConnect(hSession, L"catbox.moe", INTERNET_DEFAULT_HTTPS_PORT, 0);
-    if (!hConnect) {
-        WinHttpCloseHandle(hSession);
-        return result;
-    }
-
-    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"POST", L"/user/api.php",
-        nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
-
-    if (!hRequest) {
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return result;
-    }
-
-    // Set content type header
-    std::wstring contentType = L"Content-Type: multipart/form-data; boundary=" +
-        std::wstring(boundary.begin(), boundary.end());
-    WinHttpAddRequestHeaders(hRequest, contentType.c_str(), -1, WINHTTP_ADDREQ_FLAG_ADD);
-
-    if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-        body.data(), static_cast<DWORD>(body.size()), static_cast<DWORD>(body.size()), 0)) {
-        std::cerr << "[ImageCache] Catbox send failed: " << GetLastError() << std::endl;
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return result;
-    }
-
-    if (!WinHttpReceiveResponse(hRequest, nullptr)) {
-        std::cerr << "[ImageCache] Catbox receive failed: " << GetLastError() << std::endl;
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return result;
-    }
-
-    // Read response
-    DWORD bytesAvailable = 0;
-    DWORD bytesRead = 0;
-    while (WinHttpQueryDataAvailable(hRequest, &bytesAvailable) && bytesAvailable > 0) {
-        std::vector<char> buffer(bytesAvailable + 1);
-        if (WinHttpReadData(hRequest, buffer.data(), bytesAvailable, &bytesRead)) {
-            result.append(buffer.data(), bytesRead);
-        }
-    }
-
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-
-    // Trim whitespace
-    while (!result.empty() && (result.back() == '\n' || result.back() == '\r' || result.back() == ' ')) {
-        result.pop_back();
-    }
-
-    return result;
-}
-#else
-std::vector<uint8_t> ImageCache::downloadFromPlex(const std::string& artPath) {
-    return {};
-}
-
-std::string ImageCache::uploadToCatbox(const std::vector<uint8_t>& imageData) {
-    return "";
+    body += imageData;
+    body += "\r\n--" + boundary + "--\r\n";
+
+    auto started = std::chrono::steady_clock::now();
+    httpRequestAsync(reactor, "POST", uploadUrl,
+        {"Content-Type: multipart/form-data; boundary=" + boundary}, body,
+        [done, started](HttpResponse response) {
+            recordLatency(MetricStage::CatboxUpload, std::chrono::steady_clock::now() - started);
+            traceSpan("cache", "catbox upload", started, std::chrono::steady_clock::now(), "status", response.status);
+            if (!response.ok()) {
+                recordFailure(MetricStage::CatboxUpload);
+                logWarning("ImageCache") << "Catbox upload failed, HTTP " << response.status;
+                done("");
+                return;
+            }
+
+            // Trim whitespace
+            std::string result = std::move(response.body);
+            while (!result.empty() && (result.back() == '\n' || result.back() == '\r' || result.back() == ' ')) {
+                result.pop_back();
+            }
+            done(std::move(result));
+        });
 }
-#endif
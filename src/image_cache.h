@@ -1,22 +1,66 @@
 #pragma once
 
+#include "reactor.h"
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
 #include <string>
 #include <unordered_map>
-#include <mutex>
 
 class ImageCache {
 public:
-    ImageCache(const std::string& plexUrl, const std::string& plexToken);
+    using UrlCallback = std::function<void(std::string url)>;
 
-    // Get catbox URL for a Plex art path, uploading if needed
-    std::string getCatboxUrl(const std::string& artPath);
+    // uploadUrl is the catbox API, or a stand-in speaking the same protocol
+    ImageCache(const std::string& plexUrl, const std::string& plexToken,
+               const std::string& uploadUrl = "https://catbox.moe/user/api.php");
+
+    // Fetches art from another server from now on; a new server URL drops
+    // the cached URLs, since art paths are per server. Reactor thread only.
+    void setPlexServer(const std::string& plexUrl, const std::string& plexToken);
+
+    // Get catbox URL for a Plex art path, uploading if needed. done runs on
+    // the reactor thread with the URL, or "" on failure; call it from there.
+    void getCatboxUrl(Reactor& reactor, const std::string& artPath, UrlCallback done);
+
+    // Keeps the uploaded URLs in path from now on, so a restart doesn't
+    // upload the same art again: reads the URLs already there for this
+    // Plex server, and rewrites the file on reactor a while after new
+    // uploads, batching them. Call before the reactor uses the cache; false
+    // if the file is missing or unreadable.
+    bool useCacheFile(Reactor& reactor, const std::string& path);
+    // Writes out changes not saved yet; reactor thread, or once it stopped
+    void flush();
+
+    // The cached catbox URL for artPath, or nullptr; reactor thread only.
+    // The least recently used URL goes once MAX_ENTRIES are cached.
+    const std::string* cachedUrl(const std::string& artPath);
+    void rememberUrl(const std::string& artPath, std::string url);
+
+    static const size_t MAX_ENTRIES = 500;
 
 private:
-    std::vector<uint8_t> downloadFromPlex(const std::string& artPath);
-    std::string uploadToCatbox(const std::vector<uint8_t>& imageData);
+    struct Entry {
+        std::string url;
+        std::list<std::string>::iterator position;  // In recency
+    };
+
+    void uploadToCatbox(Reactor& reactor, const std::string& imageData, UrlCallback done);
+    void scheduleSave();
+    void saveCacheFile() const;
 
     std::string plexUrl;
     std::string plexToken;
-    std::unordered_map<std::string, std::string> cache;  // artPath -> catbox URL
-    std::mutex cacheMutex;
+    std::string uploadUrl;
+
+    // Reactor thread only
+    std::unordered_map<std::string, Entry> cache;  // artPath -> catbox URL
+    std::list<std::string> recency;                // Art paths, most recently used first
+
+    std::string cacheFile;  // Empty: the cache lives in memory only
+    Reactor* saveReactor{nullptr};
+    Reactor::TimerId saveTimer = 0;
+    bool dirty = false;  // The file is behind the cache
+    std::shared_ptr<bool> lifetime{std::make_shared<bool>(true)};
 };
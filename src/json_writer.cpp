@@ -0,0 +1,169 @@
+#include "json_writer.h"
+#include <cstdio>
+
+static const char REPLACEMENT_CHAR[] = "\xEF\xBF\xBD";
+
+// Length of the well-formed UTF-8 sequence starting at s[i], or 0 if invalid
+static size_t utf8SequenceLength(std::string_view s, size_t i) {
+    unsigned char lead = static_cast<unsigned char>(s[i]);
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xBF;  // Valid range for the second byte
+
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        len = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        len = 3;
+        if (lead == 0xE0) lo = 0xA0;       // Overlong
+        else if (lead == 0xED) hi = 0x9F;  // Surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        len = 4;
+        if (lead == 0xF0) lo = 0x90;       // Overlong
+        else if (lead == 0xF4) hi = 0x8F;  // Beyond U+10FFFF
+    } else {
+        return 0;
+    }
+
+    if (i + len > s.size()) return 0;
+    unsigned char second = static_cast<unsigned char>(s[i + 1]);
+    if (second < lo || second > hi) return 0;
+    for (size_t k = 2; k < len; k++) {
+        unsigned char c = static_cast<unsigned char>(s[i + k]);
+        if (c < 0x80 || c > 0xBF) return 0;
+    }
+    return len;
+}
+
+void appendJsonString(std::string& out, std::string_view value) {
+    out += '"';
+
+    size_t i = 0;
+    while (i < value.size()) {
+        // Copy runs of plain ASCII in one go
+        size_t run = i;
+        while (run < value.size()) {
+            unsigned char c = static_cast<unsigned char>(value[run]);
+            if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\') break;
+            run++;
+        }
+        out.append(value.data() + i, run - i);
+        i = run;
+        if (i >= value.size()) break;
+
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x80) {
+            size_t len = utf8SequenceLength(value, i);
+            if (len == 0) {
+                out += REPLACEMENT_CHAR;
+                i++;
+            } else {
+                out.append(value.data() + i, len);
+                i += len;
+            }
+            continue;
+        }
+
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+        }
+        i++;
+    }
+
+    out += '"';
+}
+
+void JsonWriter::separate() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (depth == 0) return;
+
+    uint64_t bit = uint64_t(1) << (depth & 63);
+    if (hasElements & bit) {
+        out += ',';
+    }
+    hasElements |= bit;
+}
+
+void JsonWriter::open(char bracket) {
+    separate();
+    out += bracket;
+    depth++;
+    hasElements &= ~(uint64_t(1) << (depth & 63));
+}
+
+void JsonWriter::close(char bracket) {
+    out += bracket;
+    depth--;
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    open('{');
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    close('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    open('[');
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    close(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+    separate();
+    appendJsonString(out, name);
+    out += ':';
+    afterKey = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view text) {
+    separate();
+    appendJsonString(out, text);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int64_t number) {
+    separate();
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(number));
+    out.append(buf, static_cast<size_t>(len));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    separate();
+    out += flag ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    separate();
+    out += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json) {
+    separate();
+    out.append(json.data(), json.size());
+    return *this;
+}
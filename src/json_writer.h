@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// Appends a JSON string literal (quotes included) to out. Invalid UTF-8 is
+// replaced with U+FFFD so the output is always valid JSON.
+void appendJsonString(std::string& out, std::string_view value);
+
+// Minimal streaming JSON writer that appends straight into a caller-owned
+// buffer. It tracks comma placement but does no other validation, so the
+// caller is responsible for balanced begin/end calls.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out(out) {}
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    JsonWriter& key(std::string_view name);
+    JsonWriter& value(std::string_view text);
+    JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+    JsonWriter& value(int64_t number);
+    JsonWriter& value(int number) { return value(static_cast<int64_t>(number)); }
+    JsonWriter& value(bool flag);
+    JsonWriter& null();
+    // Splices an already serialized JSON value
+    JsonWriter& raw(std::string_view json);
+
+    template <typename T>
+    JsonWriter& field(std::string_view name, const T& v) {
+        key(name);
+        return value(v);
+    }
+
+private:
+    void separate();
+    void open(char bracket);
+    void close(char bracket);
+
+    std::string& out;
+    uint64_t hasElements = 0;  // One bit per nesting level
+    int depth = 0;
+    bool afterKey = false;
+};
@@ -0,0 +1,411 @@
+#include "log.h"
+#include "alloc_stats.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static const size_t QUEUE_CAPACITY = 1024;              // Lines waiting for the writer
+static const auto REPEAT_WINDOW = std::chrono::seconds(60);
+static const size_t MAX_TRACKED_LINES = 512;            // Distinct lines remembered for repeats
+
+static std::atomic<int> g_logLevel{static_cast<int>(LogLevel::Info)};
+
+void setLogLevel(LogLevel level) {
+    g_logLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool logEnabled(LogLevel level) {
+    return static_cast<int>(level) >= g_logLevel.load(std::memory_order_relaxed);
+}
+
+LogLine& LogLine::operator<<(double value) {
+    if (enabled) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", value);
+        text += buf;
+    }
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const void* value) {
+    if (enabled) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%p", value);
+        text += buf;
+    }
+    return *this;
+}
+
+struct LogRecord {
+    LogLevel level = LogLevel::Info;
+    const char* component = nullptr;
+    std::chrono::system_clock::time_point time;
+    std::string text;
+};
+
+// Bounded multi-producer queue (Vyukov): a producer claims a cell by
+// advancing the enqueue position and publishes it through the cell's
+// sequence number, so logging threads never wait on each other or on I/O
+class RecordQueue {
+public:
+    RecordQueue() {
+        for (size_t i = 0; i < QUEUE_CAPACITY; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // False when full
+    bool push(LogRecord& record) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & (QUEUE_CAPACITY - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->record = std::move(record);
+        // seq_cst pairs with the writer's check before it sleeps
+        cell->sequence.store(pos + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    // Writer thread only
+    bool pop(LogRecord& record) {
+        Cell& cell = cells[dequeuePos & (QUEUE_CAPACITY - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+            return false;
+        }
+        record = std::move(cell.record);
+        cell.sequence.store(dequeuePos + QUEUE_CAPACITY, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+
+    bool empty() const {
+        const Cell& cell = cells[dequeuePos & (QUEUE_CAPACITY - 1)];
+        return cell.sequence.load(std::memory_order_seq_cst) != dequeuePos + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence{0};
+        LogRecord record;
+    };
+
+    Cell cells[QUEUE_CAPACITY];
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;
+};
+
+static_assert((QUEUE_CAPACITY & (QUEUE_CAPACITY - 1)) == 0, "QUEUE_CAPACITY must be a power of two");
+
+static const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO ";
+        case LogLevel::Warning: return "WARN ";
+        case LogLevel::Error: return "ERROR";
+    }
+    return "?    ";
+}
+
+static uint64_t lineHash(const LogRecord& record) {
+    // FNV-1a over level, component and text
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+        }
+    };
+    char level = static_cast<char>(record.level);
+    mix(&level, 1);
+    if (record.component) mix(record.component, strlen(record.component));
+    mix("\n", 1);
+    mix(record.text.data(), record.text.size());
+    return hash;
+}
+
+class Logger {
+public:
+    void submit(LogRecord record) {
+        if (stopped.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(ioMutex);
+            write(record, 0);
+            flush();
+            return;
+        }
+        startWriter();
+        if (!queue.push(record)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        wakeWriter();
+    }
+
+    bool openFile(const std::string& path, uint64_t maxBytes, int keep) {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        if (file.is_open()) file.close();
+        filePath = path;
+        fileMaxBytes = maxBytes;
+        fileKeep = keep;
+        file.open(fs::u8path(path), std::ios::binary | std::ios::app);
+        std::error_code ec;
+        uintmax_t size = fs::file_size(fs::u8path(path), ec);
+        fileBytes = ec ? 0 : static_cast<uint64_t>(size);
+        return file.is_open();
+    }
+
+    void shutdown() {
+        std::thread finished;
+        {
+            std::lock_guard<std::mutex> lock(startMutex);
+            if (stopped.exchange(true)) {
+                return;
+            }
+            finished = std::move(writer);
+        }
+        stopping.store(true);
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            sleeping.store(false);
+        }
+        wake.notify_one();
+        if (finished.joinable()) {
+            finished.join();
+        }
+        drain();  // Lines queued while stopping
+    }
+
+private:
+    void startWriter() {
+        if (started.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (started.load(std::memory_order_relaxed) || stopped.load()) {
+            return;
+        }
+        writer = std::thread([this] { run(); });
+        started.store(true, std::memory_order_release);
+        std::atexit(shutdownLogging);
+    }
+
+    void wakeWriter() {
+        if (sleeping.exchange(false)) {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wake.notify_one();
+        }
+    }
+
+    void run() {
+        AllocScope allocScope(AllocTag::Log);
+        for (;;) {
+            drain();
+            if (stopping.load()) {
+                drain();
+                return;
+            }
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            sleeping.store(true);
+            if (!queue.empty() || stopping.load()) {
+                sleeping.store(false);
+                continue;
+            }
+            wake.wait(lock, [this] { return !sleeping.load() || stopping.load(); });
+        }
+    }
+
+    // Writes everything queued, flushing once per batch
+    void drain() {
+        LogRecord record;
+        bool wrote = false;
+        std::lock_guard<std::mutex> lock(ioMutex);
+        while (queue.pop(record)) {
+            uint32_t skipped = 0;
+            if (!allowRepeat(record, skipped)) {
+                continue;
+            }
+            write(record, skipped);
+            wrote = true;
+        }
+        uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost) {
+            LogRecord note;
+            note.level = LogLevel::Warning;
+            note.component = "Log";
+            note.time = std::chrono::system_clock::now();
+            note.text = "Queue full, dropped " + std::to_string(lost) + " lines";
+            write(note, 0);
+            wrote = true;
+        }
+        if (wrote) {
+            flush();
+        }
+    }
+
+    // A line already written within REPEAT_WINDOW is skipped; the next copy
+    // after the window reports how many were
+    bool allowRepeat(const LogRecord& record, uint32_t& skipped) {
+        Clock::time_point now = Clock::now();
+        uint64_t hash = lineHash(record);
+        auto it = repeats.find(hash);
+        if (it != repeats.end()) {
+            if (now - it->second.writtenAt < REPEAT_WINDOW) {
+                it->second.skipped++;
+                return false;
+            }
+            skipped = it->second.skipped;
+            it->second = Repeat{now, 0};
+            return true;
+        }
+        if (repeats.size() >= MAX_TRACKED_LINES) {
+            for (auto entry = repeats.begin(); entry != repeats.end();) {
+                entry = now - entry->second.writtenAt >= REPEAT_WINDOW ? repeats.erase(entry) : std::next(entry);
+            }
+            if (repeats.size() >= MAX_TRACKED_LINES) {
+                repeats.clear();
+            }
+        }
+        repeats.emplace(hash, Repeat{now, 0});
+        return true;
+    }
+
+    void write(const LogRecord& record, uint32_t skipped) {
+        std::string line;
+        line.reserve(record.text.size() + 64);
+        if (record.component) {
+            line += '[';
+            line += record.component;
+            line += "] ";
+        }
+        line += record.text;
+        if (skipped) {
+            line += " (" + std::to_string(skipped) + " repeats suppressed)";
+        }
+        line += '\n';
+
+        FILE* console = record.level >= LogLevel::Warning ? stderr : stdout;
+        fwrite(line.data(), 1, line.size(), console);
+
+        if (file.is_open()) {
+            char stamp[40];
+            std::time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+            int millis = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                record.time.time_since_epoch()).count() % 1000);
+            std::tm local = {};
+#ifdef _WIN32
+            localtime_s(&local, &seconds);
+#else
+            localtime_r(&seconds, &local);
+#endif
+            size_t length = strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+            snprintf(stamp + length, sizeof(stamp) - length, ".%03d %s ", millis, levelName(record.level));
+
+            size_t bytes = strlen(stamp) + line.size();
+            if (fileMaxBytes > 0 && fileBytes > 0 && fileBytes + bytes > fileMaxBytes) {
+                rotate();
+            }
+            file << stamp << line;
+            fileBytes += bytes;
+        }
+    }
+
+    // path -> path.1 -> ... -> path.keep, dropping the oldest
+    void rotate() {
+        file.close();
+        std::error_code ec;
+        fs::path base = fs::u8path(filePath);
+        auto numbered = [&base](int n) {
+            fs::path p = base;
+            p += "." + std::to_string(n);
+            return p;
+        };
+        if (fileKeep > 0) {
+            fs::remove(numbered(fileKeep), ec);
+            for (int n = fileKeep - 1; n >= 1; n--) {
+                fs::rename(numbered(n), numbered(n + 1), ec);
+            }
+            fs::rename(base, numbered(1), ec);
+        }
+        file.open(base, std::ios::binary | std::ios::trunc);
+        fileBytes = 0;
+    }
+
+    void flush() {
+        fflush(stdout);
+        fflush(stderr);
+        if (file.is_open()) file.flush();
+    }
+
+    struct Repeat {
+        Clock::time_point writtenAt;
+        uint32_t skipped = 0;
+    };
+
+    RecordQueue queue;
+    std::atomic<uint64_t> dropped{0};
+
+    std::mutex startMutex;
+    std::thread writer;
+    std::atomic<bool> started{false};
+    std::atomic<bool> stopped{false};   // Lines are written directly from then on
+    std::atomic<bool> stopping{false};  // Tells the writer to finish
+
+    // The writer sleeps only after announcing it in `sleeping`
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping{false};
+
+    // Console and file output, the writer's or a direct write's
+    std::mutex ioMutex;
+    std::unordered_map<uint64_t, Repeat> repeats;
+    std::ofstream file;
+    std::string filePath;
+    uint64_t fileMaxBytes = 0;
+    uint64_t fileBytes = 0;
+    int fileKeep = 0;
+};
+
+// Never destroyed, so lines logged by static destructors still work
+static Logger& logger() {
+    static Logger* instance = new Logger();
+    return *instance;
+}
+
+void submitLog(LogLevel level, const char* component, std::string text) {
+    LogRecord record;
+    record.level = level;
+    record.component = component;
+    record.time = std::chrono::system_clock::now();
+    record.text = std::move(text);
+    logger().submit(std::move(record));
+}
+
+bool setLogFile(const std::string& path, uint64_t maxBytes, int keep) {
+    return logger().openFile(path, maxBytes, keep);
+}
+
+void shutdownLogging() {
+    logger().shutdown();
+}
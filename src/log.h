@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+// Lines below this level are dropped before they are formatted; Info by
+// default, Debug with the debug setting
+void setLogLevel(LogLevel level);
+bool logEnabled(LogLevel level);
+
+// Also writes every line, timestamped, to path. Once the file passes
+// maxBytes it is renamed to path.1 (path.1 to path.2 and so on, keeping
+// `keep` old files) and a new one started. False if it can't be opened.
+bool setLogFile(const std::string& path, uint64_t maxBytes = 1024 * 1024, int keep = 3);
+
+// Writes out what is queued and stops the writer thread; later lines are
+// written directly. Also runs at exit.
+void shutdownLogging();
+
+// Hands a finished line to the writer thread
+void submitLog(LogLevel level, const char* component, std::string text);
+
+// One log line, built with << and queued when it goes out of scope:
+//
+//     logInfo("Plex") << "Connected to " << url;
+//
+// prints "[Plex] Connected to ...". The writer thread does all console and
+// file I/O, and writes a line repeated within a minute only once, noting
+// how many copies it skipped.
+class LogLine {
+public:
+    LogLine(LogLevel level, const char* component)
+        : level(level), component(component), enabled(logEnabled(level)) {}
+    ~LogLine() {
+        if (enabled) submitLog(level, component, std::move(text));
+    }
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(std::string_view value) {
+        if (enabled) text += value;
+        return *this;
+    }
+    LogLine& operator<<(const std::string& value) { return *this << std::string_view(value); }
+    LogLine& operator<<(const char* value) { return *this << std::string_view(value ? value : "(null)"); }
+    LogLine& operator<<(char value) {
+        if (enabled) text += value;
+        return *this;
+    }
+    LogLine& operator<<(double value);
+    LogLine& operator<<(const void* value);
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    LogLine& operator<<(T value) {
+        if (enabled) text += std::to_string(value);
+        return *this;
+    }
+
+private:
+    LogLevel level;
+    const char* component;
+    bool enabled;
+    std::string text;
+};
+
+inline LogLine logDebug(const char* component) { return LogLine(LogLevel::Debug, component); }
+inline LogLine logInfo(const char* component) { return LogLine(LogLevel::Info, component); }
+inline LogLine logWarning(const char* component) { return LogLine(LogLevel::Warning, component); }
+inline LogLine logError(const char* component) { return LogLine(LogLevel::Error, component); }
@@ -1,11 +1,19 @@
 #include "config.h"
+#include "config_watcher.h"
 #include "plex.h"
 #include "discord.h"
 #include "image_cache.h"
+#include "log.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "process_stats.h"
+#include "session_capture.h"
+#include "status_server.h"
+#include "trace.h"
 #include "tray_icon.h"
+#include "utf16.h"
 #include "resource.h"
 
-#include <iostream>
 #include <thread>
 #include <atomic>
 #include <chrono>
@@ -19,12 +27,14 @@
 #define ID_TRAY_EXIT 1001
 #define ID_TRAY_OPEN_CONFIG 1002
 #define ID_TRAY_START_AT_BOOT 1003
+#define ID_TRAY_REFRESH 1004
+#define ID_TRAY_SAVE_TRACE 1005
 
 NOTIFYICONDATAW nid = {0};
 HMENU hMenu = nullptr;
 std::atomic<bool> running{true};
 TrayIcon* g_trayIcon = nullptr;
-std::atomic<bool> g_isPlaying{false};
+Pipeline* g_pipeline = nullptr;
 
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
@@ -44,6 +54,21 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     running = false;
                     PostQuitMessage(0);
                     break;
+                case ID_TRAY_REFRESH:
+                    if (g_pipeline) g_pipeline->refreshNow();
+                    break;
+                case ID_TRAY_SAVE_TRACE: {
+                    // Next to the config, then shown selected in Explorer
+                    std::filesystem::path tracePath = Config::configPath().parent_path() / "pleyx-trace.json";
+                    if (writeChromeTrace(tracePath.string())) {
+                        logInfo("Tray") << "Wrote trace to " << tracePath.string();
+                        std::wstring select = L"/select,\"" + tracePath.wstring() + L"\"";
+                        ShellExecuteW(nullptr, L"open", L"explorer.exe", select.c_str(), nullptr, SW_SHOW);
+                    } else {
+                        logError("Tray") << "Failed to write trace to " << tracePath.string();
+                    }
+                    break;
+                }
                 case ID_TRAY_OPEN_CONFIG:
                     ShellExecuteW(nullptr, L"open", Config::configPath().c_str(), nullptr, nullptr, SW_SHOW);
                     break;
@@ -100,7 +125,9 @@ std::wstring getIconPath() {
 void setupTray(HWND hwnd, HINSTANCE hInstance) {
     // Create menu
     hMenu = CreatePopupMenu();
+    AppendMenuW(hMenu, MF_STRING, ID_TRAY_REFRESH, L"Refresh Now");
     AppendMenuW(hMenu, MF_STRING, ID_TRAY_OPEN_CONFIG, L"Open Config");
+    AppendMenuW(hMenu, MF_STRING, ID_TRAY_SAVE_TRACE, L"Save Trace");
     AppendMenuW(hMenu, MF_STRING | (Config::isStartupEnabled() ? MF_CHECKED : 0),
         ID_TRAY_START_AT_BOOT, L"Start at Boot");
     AppendMenuW(hMenu, MF_SEPARATOR, 0, nullptr);
@@ -144,26 +171,33 @@ void setupTray(HWND hwnd, HINSTANCE hInstance) {
     BOOL result = Shell_NotifyIconW(NIM_ADD, &nid);
     if (result) {
         Shell_NotifyIconW(NIM_SETVERSION, &nid);
-        std::cout << "[Tray] Icon added successfully" << std::endl;
+        logInfo("Tray") << "Icon added successfully";
     } else {
-        std::cout << "[Tray] Failed to add icon, error: " << GetLastError() << std::endl;
+        logError("Tray") << "Failed to add icon, error: " << GetLastError();
     }
 }
 
-void updateTrayTip(const std::wstring& tip) {
-    // Tooltip max is 128 chars including null terminator
-    std::wstring truncated = tip.substr(0, 127);
-    wcscpy_s(nid.szTip, truncated.c_str());
+void updateTrayTip(std::string_view tip) {
+    // Tooltip max is 128 code units including the terminator; a longer
+    // title ends in an ellipsis
+    size_t length = utf8ToWideElided(tip, nid.szTip, ARRAYSIZE(nid.szTip) - 1);
+    nid.szTip[length] = L'\0';
     Shell_NotifyIconW(NIM_MODIFY, &nid);
 }
 
-void setTrayIconPlaying(bool playing) {
+// Gray when nothing plays; colour with a progress ring while something
+// with a known duration plays, moving on at each poll
+void updateTrayIcon(const PresenceUpdate& update) {
     if (!g_trayIcon) return;
 
-    bool wasPlaying = g_isPlaying.exchange(playing);
-    if (wasPlaying == playing) return;  // No change
+    HICON icon = g_trayIcon->getGrayIcon();
+    if (update.playing) {
+        HICON progress = update.show ? g_trayIcon->progressIcon(update.info.progressMs, update.info.durationMs) : nullptr;
+        icon = progress ? progress : g_trayIcon->getColorIcon();
+    }
+    if (icon == nid.hIcon) return;  // No change
 
-    nid.hIcon = playing ? g_trayIcon->getColorIcon() : g_trayIcon->getGrayIcon();
+    nid.hIcon = icon;
     Shell_NotifyIconW(NIM_MODIFY, &nid);
 }
 #endif
@@ -173,14 +207,21 @@ const char* DISCORD_CLIENT_ID = "1451961488427188355";
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     // Load config first to check debug setting
     Config config = Config::load();
+    markStartup(StartupPhase::ConfigLoaded);
 
     // Allocate console only if debug is enabled
     if (config.debug) {
         AllocConsole();
         freopen("CONOUT$", "w", stdout);
         freopen("CONOUT$", "w", stderr);
-        std::cout << "=== Pleyx Starting ===" << std::endl;
+        setLogLevel(LogLevel::Debug);
     }
+    if (!config.logFile.empty()) {
+        // Relative to the config file
+        std::filesystem::path logPath = Config::configPath().parent_path() / std::filesystem::u8path(config.logFile);
+        setLogFile(logPath.u8string(), static_cast<uint64_t>(config.logFileMaxKb) * 1024);
+    }
+    logInfo(nullptr) << "=== Pleyx Starting ===";
 
     if (config.plexToken.empty() || config.plexToken == "YOUR_PLEX_TOKEN_HERE") {
         MessageBoxW(nullptr,
@@ -191,28 +232,30 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         return 1;
     }
 
-    // Test Plex connection
+    // Nothing here waits on the network: Plex is probed by the pipeline's
+    // first poll, which keeps retrying if the network isn't up yet (e.g. at
+    // boot), and Discord connects on the I/O thread while the art cache is
+    // read and the tray set up here
     PlexClient plex(config.plexUrl, config.plexToken, config.plexUsername);
-    if (!plex.testConnection()) {
-        MessageBoxW(nullptr,
-            L"Failed to connect to Plex server.\n\nPlease check your configuration.",
-            L"Pleyx - Connection Error",
-            MB_ICONERROR | MB_OK);
-        return 1;
-    }
-
-    std::cout << "[Plex] Connected to server" << std::endl;
 
     // Set OMDB API key if configured
     if (!config.omdbApiKey.empty()) {
         setOmdbApiKey(config.omdbApiKey);
     }
 
-    // Create Discord client
-    Discord discord(DISCORD_CLIENT_ID);
+    // One I/O thread runs every network request and the Discord connection
+    Reactor reactor;
+    std::thread ioThread([&reactor] { reactor.run(); });
+
+    // Create Discord client and start the handshake
+    Discord discord(DISCORD_CLIENT_ID, reactor);
+    discord.connect();
 
-    // Create image cache for uploading artwork to catbox
+    // Create image cache for uploading artwork to catbox, with the URLs
+    // uploaded in earlier runs
     ImageCache imageCache(config.plexUrl, config.plexToken);
+    imageCache.useCacheFile(reactor, (Config::configPath().parent_path() / "art-cache.json").u8string());
+    markStartup(StartupPhase::CacheLoaded);
 
     // Create hidden window for tray
     WNDCLASSW wc = {0};
@@ -221,164 +264,54 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     wc.lpszClassName = L"PleyxTray";
 
     if (!RegisterClassW(&wc)) {
-        std::cout << "[Tray] Failed to register window class: " << GetLastError() << std::endl;
+        logError("Tray") << "Failed to register window class: " << GetLastError();
     }
 
     HWND hwnd = CreateWindowExW(0, L"PleyxTray", L"Pleyx", 0,
         0, 0, 0, 0, nullptr, nullptr, hInstance, nullptr);
 
     if (!hwnd) {
-        std::cout << "[Tray] Failed to create window: " << GetLastError() << std::endl;
+        logError("Tray") << "Failed to create window: " << GetLastError();
     } else {
-        std::cout << "[Tray] Window created: " << hwnd << std::endl;
+        logInfo("Tray") << "Window created: " << hwnd;
     }
 
     setupTray(hwnd, hInstance);
 
-    // Start polling thread
-    std::thread pollThread([&]() {
-        std::string lastKey;
-
-        while (running) {
-            try {
-                auto nowPlaying = plex.getNowPlaying();
-
-            if (nowPlaying.has_value()) {
-                auto& np = *nowPlaying;
-
-                // Create a key to detect changes
-                std::string currentKey = np.title + std::to_string(static_cast<int>(np.playerState))
-                    + std::to_string(np.progressMs / 10000);  // Update every 10 seconds
-
-                if (currentKey != lastKey) {
-                    lastKey = currentKey;
-
-                    // Update tray tooltip (safely convert to wide string)
-                    try {
-                        std::string title = np.displayTitle();
-                        if (title.length() > 100) title = title.substr(0, 100) + "...";
-                        std::wstring tip = L"Pleyx - ";
-                        for (char c : title) {
-                            tip += static_cast<wchar_t>(static_cast<unsigned char>(c));
-                        }
-                        updateTrayTip(tip);
-                    } catch (...) {
-                        updateTrayTip(L"Pleyx - Now playing");
-                    }
-                }
-
-                // Show presence when playing, or when paused for movies/shows (but not music)
-                bool shouldShowPresence = (np.playerState == PlayerState::Playing) ||
-                    (np.playerState == PlayerState::Paused && np.mediaType != MediaType::Track);
-
-                if (shouldShowPresence) {
-                    setTrayIconPlaying(np.playerState == PlayerState::Playing);
-                    MediaInfo info;
-                    info.details = np.displayTitle();
-                    info.isPlaying = (np.playerState == PlayerState::Playing);
-                    info.durationMs = np.durationMs;
-                    info.progressMs = np.progressMs;
-                    info.imdbId = np.imdbId;
-
-                    // Get artwork URL - prefer OMDB poster, fall back to catbox
-                    std::string artUrl;
-                    if (np.posterUrl) {
-                        artUrl = *np.posterUrl;
-                    } else if (np.artPath) {
-                        artUrl = imageCache.getCatboxUrl(*np.artPath);
-                    }
-
-                    // Set state and activity type based on media type
-                    switch (np.mediaType) {
-                        case MediaType::Episode: {
-                            info.activityType = ActivityType::Watching;
-                            std::string showTitle = np.grandparentTitle.value_or("TV Show");
-                            info.details = (np.playerState == PlayerState::Paused ? "(Paused) " : "") + showTitle;
-                            info.largeImage = artUrl.empty() ? "tv" : artUrl;
-                            info.largeText = np.grandparentTitle.value_or("Watching TV");
-                            if (np.seasonNumber && np.episodeNumber) {
-                                char buf[128];
-                                snprintf(buf, sizeof(buf), "S%02dE%02d • %s",
-                                    *np.seasonNumber, *np.episodeNumber, np.title.c_str());
-                                info.state = buf;
-                            } else {
-                                info.state = np.title;
-                            }
-                            break;
-                        }
-                        case MediaType::Movie: {
-                            info.activityType = ActivityType::Watching;
-                            info.details = (np.playerState == PlayerState::Paused ? "(Paused) " : "") + np.displayTitle();
-                            info.largeImage = artUrl.empty() ? "movie" : artUrl;
-                            info.largeText = np.title;
-                            // Build state: ratings • genres
-                            std::string stateStr;
-                            if (np.imdbRating) {
-                                stateStr = *np.imdbRating;
-                            }
-                            if (np.rottenTomatoesRating) {
-                                if (!stateStr.empty()) stateStr += " • ";
-                                stateStr += *np.rottenTomatoesRating;
-                            }
-                            if (!np.genres.empty()) {
-                                if (!stateStr.empty()) stateStr += " • ";
-                                for (size_t i = 0; i < np.genres.size(); i++) {
-                                    if (i > 0) stateStr += ", ";
-                                    stateStr += np.genres[i];
-                                }
-                            }
-                            info.state = stateStr.empty() ? np.stateText() : stateStr;
-                            break;
-                        }
-                        case MediaType::Track: {
-                            info.activityType = ActivityType::Listening;
-                            info.details = np.title;
-                            info.largeImage = artUrl.empty() ? "music" : artUrl;
-                            std::string artist = np.grandparentTitle.value_or("Unknown Artist");
-                            std::string album = np.parentTitle.value_or("Unknown Album");
-                            info.largeText = artist + " - " + album;
-                            if (!np.genres.empty()) {
-                                info.state = np.genres[0];
-                            } else {
-                                info.state = "Music";
-                            }
-                            break;
-                        }
-                        default:
-                            info.activityType = ActivityType::Playing;
-                            info.largeImage = "plex";
-                            info.largeText = "Plex";
-                            info.state = np.stateText();
-                    }
-
-                    discord.updatePresence(info);
-                } else {
-                    setTrayIconPlaying(false);
-                    discord.clearPresence();
-                }
-            } else {
-                if (!lastKey.empty()) {
-                    lastKey.clear();
-                    setTrayIconPlaying(false);
-                    updateTrayTip(L"Pleyx - Nothing playing");
-                    discord.clearPresence();
-                }
-            }
-
-            } catch (const std::exception& e) {
-                std::cerr << "[Error] Exception in poll loop: " << e.what() << std::endl;
-            } catch (...) {
-                std::cerr << "[Error] Unknown exception in poll loop" << std::endl;
-            }
-
-            // Sleep in 1-second intervals for faster shutdown
-            for (int i = 0; i < config.pollingIntervalSecs && running; i++) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-            }
+    // Start the poll pipeline; the tray is updated from its publish stage
+    SessionCaptureWriter capture;
+    Pipeline pipeline(reactor, plex, discord, imageCache, config.pollingIntervalSecs, PresenceFormatter(config));
+    if (!config.captureFile.empty()) {
+        std::filesystem::path capturePath = Config::configPath().parent_path() / std::filesystem::u8path(config.captureFile);
+        if (capture.open(capturePath.u8string())) {
+            pipeline.setResponseObserver([&capture](const std::string& response) { capture.record(response); });
+        } else {
+            logWarning("Tray") << "Cannot open capture file " << capturePath.u8string();
+        }
+    }
+    // Edits to the config file apply to the running pipeline
+    ConfigStore configStore(config);
+    pipeline.followConfig(configStore);
+    ConfigWatcher configWatcher(reactor, configStore, Config::configPath());
+    configWatcher.start([&pipeline](const Config& previous, const Config& next) {
+        if (next.debug != previous.debug) {
+            setLogLevel(next.debug ? LogLevel::Debug : LogLevel::Info);
+        }
+        pipeline.configChanged();
+    });
+    pipeline.start([](const PresenceUpdate& update) {
+        updateTrayIcon(update);
+        if (update.tooltip) {
+            updateTrayTip(*update.tooltip);
         }
-
-        discord.disconnect();
     });
+    g_pipeline = &pipeline;
+
+    StatusServer status(reactor, pipeline, discord);
+    status.setAllowedOrigin(config.statusAllowOrigin);
+    if (config.metricsPort > 0 && config.metricsPort <= 65535) {
+        status.start(static_cast<uint16_t>(config.metricsPort));
+    }
 
     // Message loop
     MSG msg;
@@ -388,7 +321,14 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     }
 
     running = false;
-    pollThread.join();
+    g_pipeline = nullptr;
+    configWatcher.stop();
+    pipeline.stop();
+    status.stop();
+    discord.disconnect();
+    reactor.stop();
+    ioThread.join();
+    imageCache.flush();
 
     Shell_NotifyIconW(NIM_DELETE, &nid);
     if (hMenu) DestroyMenu(hMenu);
@@ -397,6 +337,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         g_trayIcon = nullptr;
     }
 
-    std::cout << "=== Pleyx Stopped ===" << std::endl;
+    // Same figures pleyxd reports, for comparing the two builds
+    ProcessStats resources = currentProcessStats();
+    logInfo("Tray") << "rss=" << resources.residentBytes / 1048576.0 << " MB peak="
+                    << resources.peakResidentBytes / 1048576.0 << " MB cpu=" << resources.cpuSeconds << "s threads="
+                    << resources.threads;
+
+    logInfo(nullptr) << "=== Pleyx Stopped ===";
+    shutdownLogging();
     return 0;
 }
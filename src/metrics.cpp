@@ -0,0 +1,203 @@
+#include "metrics.h"
+#include "log.h"
+#include <cmath>
+#include <cstdio>
+
+int LatencyHistogram::bucketOf(uint64_t us) {
+    if (us < static_cast<uint64_t>(SUB_BUCKETS)) {
+        return static_cast<int>(us);
+    }
+    int msb = 63;
+    while (!(us >> msb)) msb--;
+    int shift = msb - SUB_BITS;
+    if (shift > MAX_SHIFT) {
+        return BUCKETS - 1;
+    }
+    // (us >> shift) is in [SUB_BUCKETS, 2 * SUB_BUCKETS)
+    return shift * SUB_BUCKETS + static_cast<int>(us >> shift);
+}
+
+uint64_t LatencyHistogram::bucketUpperUs(int bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t lower = static_cast<uint64_t>(bucket - shift * SUB_BUCKETS) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::microseconds value) {
+    uint64_t us = value.count() > 0 ? static_cast<uint64_t>(value.count()) : 0;
+    counts[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+    uint64_t seen = maxUs.load(std::memory_order_relaxed);
+    while (us > seen && !maxUs.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snap;
+    snap.buckets.resize(BUCKETS);
+    for (int i = 0; i < BUCKETS; i++) {
+        snap.buckets[i] = counts[i].load(std::memory_order_relaxed);
+        snap.count += snap.buckets[i];  // Consistent with the buckets, unlike count
+    }
+    snap.sumUs = sumUs.load(std::memory_order_relaxed);
+    snap.maxUs = maxUs.load(std::memory_order_relaxed);
+    return snap;
+}
+
+uint64_t LatencyHistogram::Snapshot::quantileUs(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = bucketUpperUs(static_cast<int>(i));
+            return upper < maxUs ? upper : maxUs;
+        }
+    }
+    return maxUs;
+}
+
+static const char* const STAGE_NAMES[] = {
+    "plex_fetch", "plex_parse", "omdb", "art_download", "catbox_upload", "discord_roundtrip", "cycle"
+};
+
+static const size_t STAGE_COUNT = static_cast<size_t>(MetricStage::Count);
+
+static LatencyHistogram g_stageLatency[STAGE_COUNT];
+static std::atomic<uint64_t> g_stageFailures[STAGE_COUNT];
+
+static const char* const STARTUP_PHASE_NAMES[] = {
+    "config_loaded", "cache_loaded", "discord_connected", "plex_reachable", "first_presence"
+};
+
+static const size_t STARTUP_PHASE_COUNT = static_cast<size_t>(StartupPhase::Count);
+
+// Taken during static initialisation, as near to process start as this
+// code gets without platform calls
+static const std::chrono::steady_clock::time_point g_processStart = std::chrono::steady_clock::now();
+
+// Microseconds since g_processStart, or -1 until reached
+static std::atomic<int64_t> g_startupUs[STARTUP_PHASE_COUNT] = {{-1}, {-1}, {-1}, {-1}, {-1}};
+
+const char* metricStageName(MetricStage stage) {
+    return STAGE_NAMES[static_cast<size_t>(stage)];
+}
+
+void recordLatency(MetricStage stage, std::chrono::steady_clock::duration elapsed) {
+    g_stageLatency[static_cast<size_t>(stage)].record(
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+}
+
+void recordFailure(MetricStage stage) {
+    g_stageFailures[static_cast<size_t>(stage)].fetch_add(1, std::memory_order_relaxed);
+}
+
+const LatencyHistogram& stageHistogram(MetricStage stage) {
+    return g_stageLatency[static_cast<size_t>(stage)];
+}
+
+uint64_t stageFailures(MetricStage stage) {
+    return g_stageFailures[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+}
+
+const char* startupPhaseName(StartupPhase phase) {
+    return STARTUP_PHASE_NAMES[static_cast<size_t>(phase)];
+}
+
+void markStartup(StartupPhase phase) {
+    std::atomic<int64_t>& slot = g_startupUs[static_cast<size_t>(phase)];
+    if (slot.load(std::memory_order_relaxed) >= 0) {
+        return;
+    }
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - g_processStart).count();
+    int64_t unset = -1;
+    if (slot.compare_exchange_strong(unset, us, std::memory_order_relaxed)) {
+        logInfo("Startup") << startupPhaseName(phase) << " after " << us / 1e6 << "s";
+    }
+}
+
+double startupSeconds(StartupPhase phase) {
+    int64_t us = g_startupUs[static_cast<size_t>(phase)].load(std::memory_order_relaxed);
+    return us < 0 ? -1.0 : us / 1e6;
+}
+
+void appendMetricFamily(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void appendMetricSample(std::string& out, const char* name, const std::string& labels, double value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.9g", value);
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += buf;
+    out += '\n';
+}
+
+void appendStageMetrics(std::string& out) {
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    static const char* const QUANTILE_LABELS[] = {"0.5", "0.9", "0.99", "0.999"};
+
+    LatencyHistogram::Snapshot snaps[STAGE_COUNT];
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        snaps[i] = g_stageLatency[i].snapshot();
+    }
+
+    appendMetricFamily(out, "pleyx_stage_duration_seconds", "summary",
+        "Time spent in each stage of a poll cycle.");
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        std::string stage = std::string("stage=\"") + STAGE_NAMES[i] + "\"";
+        for (size_t q = 0; q < 4; q++) {
+            appendMetricSample(out, "pleyx_stage_duration_seconds",
+                stage + ",quantile=\"" + QUANTILE_LABELS[q] + "\"",
+                snaps[i].quantileUs(QUANTILES[q]) / 1e6);
+        }
+        appendMetricSample(out, "pleyx_stage_duration_seconds_sum", stage, snaps[i].sumUs / 1e6);
+        appendMetricSample(out, "pleyx_stage_duration_seconds_count", stage, static_cast<double>(snaps[i].count));
+    }
+
+    appendMetricFamily(out, "pleyx_stage_duration_max_seconds", "gauge",
+        "Longest time seen in each stage since startup.");
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        appendMetricSample(out, "pleyx_stage_duration_max_seconds",
+            std::string("stage=\"") + STAGE_NAMES[i] + "\"", snaps[i].maxUs / 1e6);
+    }
+
+    appendMetricFamily(out, "pleyx_stage_failures_total", "counter",
+        "Stage attempts that failed (HTTP errors, timeouts, error replies).");
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        appendMetricSample(out, "pleyx_stage_failures_total",
+            std::string("stage=\"") + STAGE_NAMES[i] + "\"", static_cast<double>(stageFailures(static_cast<MetricStage>(i))));
+    }
+
+    appendMetricFamily(out, "pleyx_startup_seconds", "gauge",
+        "Time from process start to each startup milestone reached.");
+    for (size_t i = 0; i < STARTUP_PHASE_COUNT; i++) {
+        double seconds = startupSeconds(static_cast<StartupPhase>(i));
+        if (seconds >= 0.0) {
+            appendMetricSample(out, "pleyx_startup_seconds",
+                std::string("phase=\"") + STARTUP_PHASE_NAMES[i] + "\"", seconds);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Log-linear latency histogram in the HdrHistogram style: 16 sub-buckets
+// per power of two keep every value within 6.25% from 1us to about three
+// days. Recording is a few relaxed atomic adds, safe from any thread.
+class LatencyHistogram {
+public:
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sumUs = 0;
+        uint64_t maxUs = 0;
+        std::vector<uint64_t> buckets;
+
+        // Upper bound of the bucket holding quantile q (0..1), capped at max
+        uint64_t quantileUs(double q) const;
+    };
+
+    void record(std::chrono::microseconds value);
+    Snapshot snapshot() const;
+
+private:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int MAX_SHIFT = 33;
+    static constexpr int BUCKETS = (MAX_SHIFT + 2) * SUB_BUCKETS;
+
+    static int bucketOf(uint64_t us);
+    static uint64_t bucketUpperUs(int bucket);
+
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumUs{0};
+    std::atomic<uint64_t> maxUs{0};
+};
+
+// Where a poll cycle spends its time
+enum class MetricStage {
+    PlexFetch,
+    PlexParse,
+    Omdb,
+    ArtDownload,
+    CatboxUpload,
+    DiscordRoundTrip,
+    Cycle,
+    Count
+};
+
+const char* metricStageName(MetricStage stage);
+
+// Process-wide stage metrics; both are safe from any thread
+void recordLatency(MetricStage stage, std::chrono::steady_clock::duration elapsed);
+void recordFailure(MetricStage stage);
+
+const LatencyHistogram& stageHistogram(MetricStage stage);
+uint64_t stageFailures(MetricStage stage);
+
+// Startup milestones, each timed once from process start. Startup no
+// longer runs in a fixed order, so each is marked wherever it happens.
+enum class StartupPhase {
+    ConfigLoaded,
+    CacheLoaded,
+    DiscordConnected,
+    PlexReachable,
+    FirstPresence,  // Discord has accepted the first activity update
+    Count
+};
+
+const char* startupPhaseName(StartupPhase phase);
+
+// Records and logs the time since process start the first time phase is
+// reached; later calls do nothing. Any thread.
+void markStartup(StartupPhase phase);
+// Seconds from process start to phase, or negative if not reached yet
+double startupSeconds(StartupPhase phase);
+
+// Prometheus text format helpers: a family header, and one sample
+void appendMetricFamily(std::string& out, const char* name, const char* type, const char* help);
+void appendMetricSample(std::string& out, const char* name, const std::string& labels, double value);
+
+// Stage latency summaries (p50/p90/p99/p999, sum, count), maxima,
+// failure counters and the startup milestones reached, in Prometheus text
+// format
+void appendStageMetrics(std::string& out);
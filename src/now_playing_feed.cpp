@@ -0,0 +1,136 @@
+#include "now_playing_feed.h"
+#include "json_writer.h"
+#include <vector>
+
+static const char* stateName(PlayerState state) {
+    switch (state) {
+        case PlayerState::Playing: return "playing";
+        case PlayerState::Paused: return "paused";
+        case PlayerState::Buffering: return "buffering";
+        default: return "stopped";
+    }
+}
+
+static const char* typeName(MediaType type) {
+    switch (type) {
+        case MediaType::Movie: return "movie";
+        case MediaType::Episode: return "episode";
+        case MediaType::Track: return "track";
+        default: return "unknown";
+    }
+}
+
+static void optionalText(JsonWriter& json, std::string_view name, bool present, std::string_view value) {
+    json.key(name);
+    if (present) {
+        json.value(value);
+    } else {
+        json.null();
+    }
+}
+
+static void optionalNumber(JsonWriter& json, std::string_view name, bool present, int value) {
+    json.key(name);
+    if (present) {
+        json.value(value);
+    } else {
+        json.null();
+    }
+}
+
+static void appendMediaJson(std::string& out, const NowPlayingSnapshot& media, std::string_view artUrl) {
+    using S = NowPlayingSnapshot;
+    JsonWriter json(out);
+    json.beginObject()
+        .field("state", stateName(media.playerState()))
+        .field("type", typeName(media.mediaType()))
+        .field("title", media.title())
+        .field("display_title", media.displayTitle());
+    optionalText(json, "grandparent_title", media.has(S::HAS_GRANDPARENT_TITLE), media.grandparentTitle());
+    optionalText(json, "parent_title", media.has(S::HAS_PARENT_TITLE), media.parentTitle());
+    optionalNumber(json, "year", media.has(S::HAS_YEAR), media.year());
+    optionalNumber(json, "season", media.has(S::HAS_SEASON), media.seasonNumber());
+    optionalNumber(json, "episode", media.has(S::HAS_EPISODE), media.episodeNumber());
+    json.field("duration_ms", media.durationMs())
+        .field("progress_ms", media.progressMs());
+    json.key("genres").beginArray();
+    for (std::string_view genre : media.genres()) {
+        json.value(genre);
+    }
+    json.endArray();
+    optionalText(json, "imdb_id", media.has(S::HAS_IMDB_ID), media.imdbId());
+    optionalText(json, "imdb_rating", media.has(S::HAS_IMDB_RATING), media.imdbRating());
+    optionalText(json, "rotten_tomatoes_rating", media.has(S::HAS_RT_RATING), media.rottenTomatoesRating());
+    optionalText(json, "art_url", !artUrl.empty(), artUrl);
+    json.endObject();
+}
+
+static std::shared_ptr<const NowPlayingState> makeState(uint64_t version, int64_t sampledAtMs, bool sampled,
+                                                        std::string_view media) {
+    auto state = std::make_shared<NowPlayingState>();
+    state->version = version;
+    JsonWriter json(state->json);
+    json.beginObject().field("version", static_cast<int64_t>(version)).key("sampled_at_ms");
+    if (sampled) {
+        json.value(sampledAtMs);
+    } else {
+        json.null();
+    }
+    json.key("now_playing").raw(media).endObject();
+    // JSON output has no raw newlines, so it fits on one data line
+    state->event = "id: " + std::to_string(version) + "\ndata: " + state->json + "\n\n";
+    return state;
+}
+
+// Nothing sampled until the first cycle
+NowPlayingFeed::NowPlayingFeed() : state(makeState(0, 0, false, "null")) {}
+
+std::shared_ptr<const NowPlayingState> NowPlayingFeed::current() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state;
+}
+
+void NowPlayingFeed::update(const NowPlayingSnapshot* media, std::string_view artUrl,
+                            std::chrono::system_clock::time_point sampledAt) {
+    scratch.clear();
+    if (media) {
+        appendMediaJson(scratch, *media, artUrl);
+    } else {
+        scratch = "null";
+    }
+    if (scratch == lastMedia) {
+        return;
+    }
+    lastMedia.swap(scratch);
+
+    int64_t sampledAtMs = std::chrono::duration_cast<std::chrono::milliseconds>(sampledAt.time_since_epoch()).count();
+    // Only this thread replaces the state, so it can be built unlocked
+    std::shared_ptr<const NowPlayingState> next = makeState(current()->version + 1, sampledAtMs, true, lastMedia);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        state = next;
+    }
+
+    // A listener may unsubscribe itself or another, e.g. on a failed write
+    std::vector<uint64_t> ids;
+    ids.reserve(listeners.size());
+    for (const auto& entry : listeners) {
+        ids.push_back(entry.first);
+    }
+    for (uint64_t id : ids) {
+        auto it = listeners.find(id);
+        if (it != listeners.end()) {
+            it->second(next);
+        }
+    }
+}
+
+uint64_t NowPlayingFeed::subscribe(Listener listener) {
+    uint64_t id = nextListener++;
+    listeners.emplace(id, std::move(listener));
+    return id;
+}
+
+void NowPlayingFeed::unsubscribe(uint64_t id) {
+    listeners.erase(id);
+}
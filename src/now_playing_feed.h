@@ -0,0 +1,56 @@
+#pragma once
+
+#include "now_playing_snapshot.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// One immutable JSON document describing what is playing. version goes up
+// by one with every change and doubles as the server-sent event id.
+struct NowPlayingState {
+    uint64_t version = 0;
+    std::string json;
+    std::string event;  // The same as a server-sent event, framed once for every stream
+};
+
+// What the pipeline last selected, for local tools (overlays, dashboards,
+// scripts) through the status server. Each change is serialized once into a
+// NowPlayingState that every reader shares, so the poll path does the same
+// work however many readers there are. A cycle that changes nothing but the
+// sample time publishes nothing; progress moves while media plays, so that
+// is one change per poll.
+class NowPlayingFeed {
+public:
+    using Listener = std::function<void(const std::shared_ptr<const NowPlayingState>& state)>;
+
+    NowPlayingFeed();
+
+    // The latest state, never null; any thread
+    std::shared_ptr<const NowPlayingState> current() const;
+
+    // Pipeline's reactor thread. media is null when nothing plays; artUrl is
+    // the public image the presence uses, never a Plex URL.
+    void update(const NowPlayingSnapshot* media, std::string_view artUrl,
+                std::chrono::system_clock::time_point sampledAt);
+
+    // Reactor thread; listeners run there after each change, inside the
+    // pipeline's cycle, so they should only take note of the state
+    uint64_t subscribe(Listener listener);
+    void unsubscribe(uint64_t id);
+
+private:
+    mutable std::mutex mutex;
+    std::shared_ptr<const NowPlayingState> state;
+
+    // Reactor thread only: the serialized media of the current state, to
+    // spot cycles that changed nothing, and the listeners
+    std::string lastMedia;
+    std::string scratch;
+    std::unordered_map<uint64_t, Listener> listeners;
+    uint64_t nextListener = 1;
+};
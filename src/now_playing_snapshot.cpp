@@ -0,0 +1,267 @@
+#include "now_playing_snapshot.h"
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+
+// Strings live in a deque, which never moves its elements, so views of
+// them stay valid as it grows
+static std::mutex g_internMutex;
+static std::deque<std::string> g_internStorage;
+static std::unordered_set<std::string_view> g_internIndex;
+static size_t g_internBytes = 0;
+
+std::string_view internString(std::string_view s) {
+    std::lock_guard<std::mutex> lock(g_internMutex);
+    auto it = g_internIndex.find(s);
+    if (it != g_internIndex.end()) {
+        return *it;
+    }
+    if (g_internBytes + s.size() > INTERN_MAX_BYTES) {
+        return std::string_view();
+    }
+    g_internBytes += s.size();
+    std::string_view stored = g_internStorage.emplace_back(s);
+    g_internIndex.insert(stored);
+    return stored;
+}
+
+std::shared_ptr<const NowPlayingSnapshot> NowPlayingSnapshot::from(const NowPlaying& np) {
+    Builder builder;
+    builder.mediaType(np.mediaType)
+        .playerState(np.playerState)
+        .durationMs(np.durationMs)
+        .progressMs(np.progressMs)
+        .title(np.title);
+    if (np.year) builder.year(*np.year);
+    if (np.seasonNumber) builder.seasonNumber(*np.seasonNumber);
+    if (np.episodeNumber) builder.episodeNumber(*np.episodeNumber);
+    if (np.grandparentTitle) builder.grandparentTitle(*np.grandparentTitle);
+    if (np.parentTitle) builder.parentTitle(*np.parentTitle);
+    if (np.imdbId) builder.imdbId(*np.imdbId);
+    if (np.posterUrl) builder.posterUrl(*np.posterUrl);
+    if (np.imdbRating) builder.imdbRating(*np.imdbRating);
+    if (np.rottenTomatoesRating) builder.rottenTomatoesRating(*np.rottenTomatoesRating);
+    if (np.artPath) builder.artPath(*np.artPath);
+    for (const std::string& genre : np.genres) {
+        builder.addGenre(genre);
+    }
+    return builder.build();
+}
+
+std::string NowPlayingSnapshot::displayTitle() const {
+    std::string out;
+    switch (mediaType()) {
+        case MediaType::Episode:
+        case MediaType::Track:
+            if (has(HAS_GRANDPARENT_TITLE)) {
+                out.append(grandparentTitle()).append(" - ");
+            }
+            out.append(title());
+            break;
+        default:
+            out.append(title());
+            if (has(HAS_YEAR)) {
+                out.append(" (").append(std::to_string(yearValue)).append(")");
+            }
+            break;
+    }
+    return out;
+}
+
+const char* NowPlayingSnapshot::stateText() const {
+    switch (playerState()) {
+        case PlayerState::Playing: return "Playing";
+        case PlayerState::Paused: return "Paused";
+        case PlayerState::Buffering: return "Buffering";
+        default: return "Stopped";
+    }
+}
+
+NowPlaying NowPlayingSnapshot::toNowPlaying() const {
+    NowPlaying np;
+    np.title = title();
+    np.mediaType = mediaType();
+    np.playerState = playerState();
+    if (has(HAS_YEAR)) np.year = yearValue;
+    if (has(HAS_GRANDPARENT_TITLE)) np.grandparentTitle = std::string(grandparentTitle());
+    if (has(HAS_PARENT_TITLE)) np.parentTitle = std::string(parentTitle());
+    if (has(HAS_SEASON)) np.seasonNumber = season;
+    if (has(HAS_EPISODE)) np.episodeNumber = episode;
+    if (has(HAS_IMDB_ID)) np.imdbId = std::string(imdbId());
+    if (has(HAS_POSTER_URL)) np.posterUrl = std::string(posterUrl());
+    if (has(HAS_IMDB_RATING)) np.imdbRating = std::string(imdbRating());
+    if (has(HAS_RT_RATING)) np.rottenTomatoesRating = std::string(rottenTomatoesRating());
+    if (has(HAS_ART_PATH)) np.artPath = std::string(artPath());
+    np.genres.assign(genreList.begin(), genreList.end());
+    np.durationMs = duration;
+    np.progressMs = progress;
+    return np;
+}
+
+std::shared_ptr<const NowPlayingSnapshot> NowPlayingSnapshot::withOmdb(const OmdbResult& result) const {
+    bool addsImdbId = !result.imdbId.empty() && !has(HAS_IMDB_ID);
+    if (!addsImdbId && result.posterUrl.empty() && result.imdbRating.empty() &&
+        result.rottenTomatoesRating.empty()) {
+        return nullptr;
+    }
+    Builder builder = Builder::copyOf(*this);
+    if (addsImdbId) builder.imdbId(result.imdbId);
+    if (!result.posterUrl.empty()) builder.posterUrl(result.posterUrl);
+    if (!result.imdbRating.empty()) builder.imdbRating(result.imdbRating);
+    if (!result.rottenTomatoesRating.empty()) builder.rottenTomatoesRating(result.rottenTomatoesRating);
+    return builder.build();
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::mediaType(MediaType value) {
+    type = static_cast<uint8_t>(value);
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::playerState(PlayerState value) {
+    state = static_cast<uint8_t>(value);
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::year(int value) {
+    yearValue = value;
+    flags |= HAS_YEAR;
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::seasonNumber(int value) {
+    season = value;
+    flags |= HAS_SEASON;
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::episodeNumber(int value) {
+    episode = value;
+    flags |= HAS_EPISODE;
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::durationMs(int64_t value) {
+    duration = value;
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::progressMs(int64_t value) {
+    progress = value;
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::setText(Text field, uint16_t flag, std::string_view value) {
+    texts[field] = value;
+    flags |= flag;
+    return *this;
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::title(std::string_view value) {
+    return setText(TITLE, 0, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::grandparentTitle(std::string_view value) {
+    return setText(GRANDPARENT_TITLE, HAS_GRANDPARENT_TITLE, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::parentTitle(std::string_view value) {
+    return setText(PARENT_TITLE, HAS_PARENT_TITLE, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::imdbId(std::string_view value) {
+    return setText(IMDB_ID, HAS_IMDB_ID, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::posterUrl(std::string_view value) {
+    return setText(POSTER_URL, HAS_POSTER_URL, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::imdbRating(std::string_view value) {
+    return setText(IMDB_RATING, HAS_IMDB_RATING, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::rottenTomatoesRating(std::string_view value) {
+    return setText(RT_RATING, HAS_RT_RATING, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::artPath(std::string_view value) {
+    return setText(ART_PATH, HAS_ART_PATH, value);
+}
+
+NowPlayingSnapshot::Builder& NowPlayingSnapshot::Builder::addGenre(std::string_view value) {
+    if (genreCount < MAX_GENRES) {
+        genreViews[genreCount++] = value;
+    }
+    return *this;
+}
+
+NowPlayingSnapshot::Builder NowPlayingSnapshot::Builder::copyOf(const NowPlayingSnapshot& snapshot) {
+    Builder builder;
+    for (size_t i = 0; i < TEXT_COUNT; i++) {
+        builder.texts[i] = snapshot.text(static_cast<Text>(i));
+    }
+    for (std::string_view genre : snapshot.genreList) {
+        builder.addGenre(genre);
+    }
+    builder.duration = snapshot.duration;
+    builder.progress = snapshot.progress;
+    builder.yearValue = snapshot.yearValue;
+    builder.season = snapshot.season;
+    builder.episode = snapshot.episode;
+    builder.flags = snapshot.flags;
+    builder.type = snapshot.type;
+    builder.state = snapshot.state;
+    return builder;
+}
+
+std::shared_ptr<const NowPlayingSnapshot> NowPlayingSnapshot::Builder::build() const {
+    auto snapshot = std::make_shared<NowPlayingSnapshot>(Key());
+
+    // Intern the recurring texts first, to size the buffer for the rest;
+    // a full intern table leaves them to the buffer too
+    std::string_view resolved[TEXT_COUNT];
+    size_t bufferBytes = 0;
+    for (size_t i = 0; i < TEXT_COUNT; i++) {
+        bool recurring = i == GRANDPARENT_TITLE || i == PARENT_TITLE || i == IMDB_RATING || i == RT_RATING;
+        if (recurring && !texts[i].empty()) {
+            resolved[i] = internString(texts[i]);
+        }
+        if (resolved[i].empty()) {
+            bufferBytes += texts[i].size();
+        }
+    }
+    std::string_view genres[MAX_GENRES];
+    for (size_t i = 0; i < genreCount; i++) {
+        genres[i] = internString(genreViews[i]);
+        if (genres[i].empty()) {
+            bufferBytes += genreViews[i].size();
+        }
+    }
+
+    // Reserved up front, so appending never moves what earlier views point at
+    snapshot->buffer.reserve(bufferBytes);
+    auto place = [&snapshot](std::string_view value) {
+        size_t offset = snapshot->buffer.size();
+        snapshot->buffer.append(value);
+        return std::string_view(snapshot->buffer.data() + offset, value.size());
+    };
+    for (size_t i = 0; i < TEXT_COUNT; i++) {
+        std::string_view value = resolved[i].empty() ? place(texts[i]) : resolved[i];
+        snapshot->textData[i] = value.data();
+        snapshot->textLength[i] = static_cast<uint32_t>(value.size());
+    }
+    snapshot->genreList.reserve(genreCount);
+    for (size_t i = 0; i < genreCount; i++) {
+        snapshot->genreList.push_back(genres[i].empty() ? place(genreViews[i]) : genres[i]);
+    }
+
+    snapshot->duration = duration;
+    snapshot->progress = progress;
+    snapshot->yearValue = yearValue;
+    snapshot->season = season;
+    snapshot->episode = episode;
+    snapshot->flags = flags;
+    snapshot->type = type;
+    snapshot->state = state;
+    return snapshot;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "plex.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Returns a view of a process-wide copy of s that lives until exit. The
+// table only grows, so it stops taking new strings past INTERN_MAX_BYTES
+// and hands those back uninterned (empty view); safe from any thread.
+constexpr size_t INTERN_MAX_BYTES = 256 * 1024;
+std::string_view internString(std::string_view s);
+
+// Compact, immutable form of NowPlaying that pipeline stages share by
+// reference instead of copying. Strings that recur from poll to poll
+// (show, artist, album and season names, genres, ratings) point into the
+// intern table; the rest are packed into one buffer owned by the snapshot.
+// Optional fields are bit flags rather than std::optional. Build one with
+// NowPlayingSnapshot::Builder, or from a NowPlaying.
+class NowPlayingSnapshot {
+public:
+    enum Flag : uint16_t {
+        HAS_YEAR = 1 << 0,
+        HAS_SEASON = 1 << 1,
+        HAS_EPISODE = 1 << 2,
+        HAS_GRANDPARENT_TITLE = 1 << 3,
+        HAS_PARENT_TITLE = 1 << 4,
+        HAS_IMDB_ID = 1 << 5,
+        HAS_POSTER_URL = 1 << 6,
+        HAS_IMDB_RATING = 1 << 7,
+        HAS_RT_RATING = 1 << 8,
+        HAS_ART_PATH = 1 << 9
+    };
+
+    class Builder;
+
+    // Only for Builder, through make_shared; Key keeps everyone else out
+    struct Key {
+        explicit Key() = default;
+    };
+    explicit NowPlayingSnapshot(Key) {}
+
+    static std::shared_ptr<const NowPlayingSnapshot> from(const NowPlaying& np);
+
+    NowPlayingSnapshot(const NowPlayingSnapshot&) = delete;
+    NowPlayingSnapshot& operator=(const NowPlayingSnapshot&) = delete;
+
+    bool has(Flag flag) const { return (flags & flag) != 0; }
+
+    MediaType mediaType() const { return static_cast<MediaType>(type); }
+    PlayerState playerState() const { return static_cast<PlayerState>(state); }
+    int year() const { return yearValue; }          // 0 unless HAS_YEAR
+    int seasonNumber() const { return season; }     // 0 unless HAS_SEASON
+    int episodeNumber() const { return episode; }   // 0 unless HAS_EPISODE
+    int64_t durationMs() const { return duration; }
+    int64_t progressMs() const { return progress; }
+
+    // Empty unless the matching flag is set
+    std::string_view title() const { return text(TITLE); }
+    std::string_view grandparentTitle() const { return text(GRANDPARENT_TITLE); }  // Show name or artist
+    std::string_view parentTitle() const { return text(PARENT_TITLE); }            // Season or album
+    std::string_view imdbId() const { return text(IMDB_ID); }
+    std::string_view posterUrl() const { return text(POSTER_URL); }
+    std::string_view imdbRating() const { return text(IMDB_RATING); }
+    std::string_view rottenTomatoesRating() const { return text(RT_RATING); }
+    std::string_view artPath() const { return text(ART_PATH); }
+    const std::vector<std::string_view>& genres() const { return genreList; }
+
+    std::string displayTitle() const;
+    const char* stateText() const;
+
+    NowPlaying toNowPlaying() const;
+
+    // A copy with the OMDB fields result has; null when it adds nothing
+    std::shared_ptr<const NowPlayingSnapshot> withOmdb(const OmdbResult& result) const;
+
+private:
+    enum Text : uint8_t {
+        TITLE,
+        GRANDPARENT_TITLE,
+        PARENT_TITLE,
+        IMDB_ID,
+        POSTER_URL,
+        IMDB_RATING,
+        RT_RATING,
+        ART_PATH,
+        TEXT_COUNT
+    };
+
+    std::string_view text(Text field) const { return std::string_view(textData[field], textLength[field]); }
+
+    const char* textData[TEXT_COUNT] = {};
+    uint32_t textLength[TEXT_COUNT] = {};
+    std::vector<std::string_view> genreList;
+    std::string buffer;  // Texts that aren't interned, back to back
+    int64_t duration = 0;
+    int64_t progress = 0;
+    int32_t yearValue = 0;
+    int32_t season = 0;
+    int32_t episode = 0;
+    uint16_t flags = 0;
+    uint8_t type = static_cast<uint8_t>(MediaType::Unknown);
+    uint8_t state = static_cast<uint8_t>(PlayerState::Stopped);
+};
+
+// Collects fields as views into anything alive until build(), e.g. a
+// parsed response, then copies them into a snapshot in one go. Keeps the
+// first MAX_GENRES genres.
+class NowPlayingSnapshot::Builder {
+public:
+    static constexpr size_t MAX_GENRES = 16;
+
+    Builder& mediaType(MediaType value);
+    Builder& playerState(PlayerState value);
+    Builder& year(int value);
+    Builder& seasonNumber(int value);
+    Builder& episodeNumber(int value);
+    Builder& durationMs(int64_t value);
+    Builder& progressMs(int64_t value);
+
+    Builder& title(std::string_view value);
+    Builder& grandparentTitle(std::string_view value);
+    Builder& parentTitle(std::string_view value);
+    Builder& imdbId(std::string_view value);
+    Builder& posterUrl(std::string_view value);
+    Builder& imdbRating(std::string_view value);
+    Builder& rottenTomatoesRating(std::string_view value);
+    Builder& artPath(std::string_view value);
+    Builder& addGenre(std::string_view value);
+
+    // A builder holding everything snapshot has
+    static Builder copyOf(const NowPlayingSnapshot& snapshot);
+
+    std::shared_ptr<const NowPlayingSnapshot> build() const;
+
+private:
+    Builder& setText(Text field, uint16_t flag, std::string_view value);
+
+    std::string_view texts[TEXT_COUNT];
+    std::string_view genreViews[MAX_GENRES];
+    size_t genreCount = 0;
+    int64_t duration = 0;
+    int64_t progress = 0;
+    int32_t yearValue = 0;
+    int32_t season = 0;
+    int32_t episode = 0;
+    uint16_t flags = 0;
+    uint8_t type = static_cast<uint8_t>(MediaType::Unknown);
+    uint8_t state = static_cast<uint8_t>(PlayerState::Stopped);
+};
@@ -0,0 +1,404 @@
+#include "pipeline.h"
+#include "alloc_stats.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <future>
+
+using Clock = std::chrono::steady_clock;
+
+// Until Plex first answers (at boot the network may not be up yet), a
+// failed fetch is retried after this, doubling up to the poll interval
+static const auto STARTUP_RETRY_MIN = std::chrono::seconds(1);
+
+// Runs one stage step, keeping the reactor alive through exceptions
+template <typename Fn>
+static void guarded(const char* stage, Fn&& fn) {
+    try {
+        fn();
+    } catch (const std::exception& e) {
+        logError("Pipeline") << "Exception in " << stage << " stage: " << e.what();
+    } catch (...) {
+        logError("Pipeline") << "Unknown exception in " << stage << " stage";
+    }
+}
+
+Pipeline::Pipeline(Reactor& reactor, PlexClient& plex, Discord& discord, ImageCache& imageCache,
+                   int pollingIntervalSecs, PresenceFormatter formatter)
+    : reactor(reactor), plex(plex), discord(discord), imageCache(imageCache),
+      pollingInterval(pollingIntervalSecs > 0 ? pollingIntervalSecs : 1), formatter(std::move(formatter)) {}
+
+Pipeline::~Pipeline() {
+    stop();
+}
+
+void Pipeline::start(PublishCallback callback, bool poll) {
+    if (running.exchange(true)) {
+        return;
+    }
+    onPublish = std::move(callback);
+    lifetime = std::make_shared<bool>(true);
+    if (poll) {
+        reactor.post([this] { fetch(); });
+    }
+}
+
+void Pipeline::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    // Requests in flight finish on their own and find the pipeline gone
+    auto halt = [this] {
+        reactor.cancelTimer(fetchTimer);
+        fetchTimer = 0;
+        lifetime.reset();
+        fetchInFlight = false;
+        enrichBusy = false;
+        waitingCycle.reset();
+    };
+    if (reactor.inReactorThread()) {
+        halt();
+    } else {
+        std::promise<void> done;
+        reactor.post([&] {
+            halt();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void Pipeline::refreshNow() {
+    reactor.post([this] {
+        // fetch() schedules the next poll itself
+        if (lifetime && reactor.rescheduleTimer(fetchTimer, Clock::now())) {
+            count(&PipelineStats::refreshes);
+        }
+    });
+}
+
+void Pipeline::inject(std::string response) {
+    if (!lifetime) {
+        return;
+    }
+    uint64_t injectCycle = ++cycle;
+    count(&PipelineStats::fetched);
+    if (responseObserver) {
+        responseObserver(response);
+    }
+    parse(injectCycle, Clock::now(), response);
+}
+
+void Pipeline::setResponseObserver(ResponseObserver observer) {
+    responseObserver = std::move(observer);
+}
+
+void Pipeline::setCycleObserver(CycleObserver observer) {
+    cycleObserver = std::move(observer);
+}
+
+void Pipeline::followConfig(const ConfigStore& store) {
+    configStore = &store;
+    appliedConfig = store.current();
+}
+
+void Pipeline::configChanged() {
+    reactor.post([this] {
+        if (lifetime) {
+            applyConfig();
+        }
+    });
+}
+
+// Brings the components up to date with the newest config snapshot; the
+// check is one atomic load, so fetch() can make it every cycle
+void Pipeline::applyConfig() {
+    const Config* latest = configStore ? configStore->current() : nullptr;
+    if (!latest || latest == appliedConfig) {
+        return;
+    }
+    const Config& previous = *appliedConfig;
+    appliedConfig = latest;
+
+    if (latest->plexUrl != previous.plexUrl || latest->plexToken != previous.plexToken ||
+        latest->plexUsername != previous.plexUsername) {
+        plex.setServer(latest->plexUrl, latest->plexToken, latest->plexUsername);
+        imageCache.setPlexServer(latest->plexUrl, latest->plexToken);
+        logInfo("Pipeline") << "Plex server is now " << latest->plexUrl;
+    }
+    if (latest->omdbApiKey != previous.omdbApiKey) {
+        setOmdbApiKey(latest->omdbApiKey);
+        // Look the current title up again with the new key
+        omdbKey.clear();
+        omdbResult = OmdbResult();
+    }
+    formatter = PresenceFormatter(*latest);
+
+    std::chrono::seconds interval(latest->pollingIntervalSecs > 0 ? latest->pollingIntervalSecs : 1);
+    if (interval != pollingInterval) {
+        pollingInterval = interval;
+        logInfo("Pipeline") << "Polling every " << interval.count() << "s";
+        // Keep the cadence from the last fetch, or poll now if that is overdue
+        if (fetchTimer) {
+            reactor.rescheduleTimer(fetchTimer, std::max(lastFetchAt + pollingInterval, Clock::now()));
+        }
+    }
+}
+
+PipelineStats Pipeline::stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return statsData;
+}
+
+void Pipeline::count(uint64_t PipelineStats::*counter) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    statsData.*counter += 1;
+}
+
+void Pipeline::fetch() {
+    applyConfig();
+
+    // Keep a fixed cadence from the start of each fetch
+    lastFetchAt = Clock::now();
+    fetchTimer = reactor.runAt(lastFetchAt + pollingInterval, [this] { fetch(); });
+
+    // A Plex server slower than the poll interval gets no second request
+    if (fetchInFlight) {
+        count(&PipelineStats::superseded);
+        return;
+    }
+    fetchInFlight = true;
+    uint64_t fetchCycle = ++cycle;
+    Clock::time_point startedAt = Clock::now();
+    std::weak_ptr<bool> alive = lifetime;
+    plex.fetchSessions(reactor, [this, alive, fetchCycle, startedAt](std::string response) {
+        if (alive.expired()) {
+            return;
+        }
+        fetchInFlight = false;
+        if (!plexReached) {
+            if (response.empty()) {
+                retryFetchSoon();
+            } else {
+                plexReached = true;
+                markStartup(StartupPhase::PlexReachable);
+                logInfo("Plex") << "Connected to server";
+            }
+        }
+        count(&PipelineStats::fetched);
+        if (responseObserver) {
+            responseObserver(response);
+        }
+        parse(fetchCycle, startedAt, response);
+    });
+}
+
+void Pipeline::retryFetchSoon() {
+    startupRetry = startupRetry == Clock::duration::zero()
+        ? Clock::duration(STARTUP_RETRY_MIN)
+        : std::min<Clock::duration>(startupRetry * 2, pollingInterval);
+    Clock::time_point retryAt = Clock::now() + startupRetry;
+    if (retryAt < lastFetchAt + pollingInterval) {
+        reactor.rescheduleTimer(fetchTimer, retryAt);
+    }
+}
+
+void Pipeline::parse(uint64_t fetchCycle, Clock::time_point startedAt, const std::string& response) {
+    AllocScope allocScope(AllocTag::Parse);
+    SessionCycle session;
+    session.cycle = fetchCycle;
+    session.startedAt = startedAt;
+    session.fetchedAt = Clock::now();
+    guarded("parse", [&] {
+        session.media = plex.parseSnapshot(response, &parseArena);
+    });
+    parseArena.reset();
+    recordLatency(MetricStage::PlexParse, Clock::now() - session.fetchedAt);
+    traceSpan("pipeline", "parse", session.fetchedAt, Clock::now(), "cycle", static_cast<int64_t>(fetchCycle));
+    count(&PipelineStats::parsed);
+
+    if (enrichBusy) {
+        if (waitingCycle) {
+            count(&PipelineStats::superseded);
+            traceInstant("pipeline", "superseded", "cycle", static_cast<int64_t>(waitingCycle->cycle));
+        }
+        waitingCycle = std::move(session);
+        return;
+    }
+    enrich(std::move(session));
+}
+
+void Pipeline::enrich(SessionCycle session) {
+    AllocScope allocScope(AllocTag::Enrich);
+    enrichBusy = true;
+    session.enrichStartedAt = Clock::now();
+    if (!session.media || session.media->mediaType() == MediaType::Track) {
+        enrichArt(std::move(session));
+        return;
+    }
+
+    // OMDB data depends only on the title, so look it up once per title
+    // rather than on every poll
+    const NowPlayingSnapshot& media = *session.media;
+    std::string key = std::to_string(static_cast<int>(media.mediaType()));
+    key.append(1, '\n').append(media.grandparentTitle()).append(1, '\n').append(media.title())
+        .append(1, '\n').append(std::to_string(media.year()));
+    if (key == omdbKey) {
+        traceInstant("cache", "omdb hit");
+        applyCachedOmdb(session);
+        enrichArt(std::move(session));
+        return;
+    }
+
+    count(&PipelineStats::omdbLookups);
+    std::weak_ptr<bool> alive = lifetime;
+    lookupOmdb(reactor, media,
+        [this, alive, key, session = std::move(session)](OmdbResult looked) mutable {
+            if (alive.expired()) {
+                return;
+            }
+            AllocScope allocScope(AllocTag::Enrich);
+            omdbKey = std::move(key);
+            omdbResult = std::move(looked);
+            applyCachedOmdb(session);
+            enrichArt(std::move(session));
+        });
+}
+
+// Snapshots are shared, so this swaps in an enriched copy
+void Pipeline::applyCachedOmdb(SessionCycle& session) const {
+    if (auto enriched = session.media->withOmdb(omdbResult)) {
+        session.media = std::move(enriched);
+    }
+}
+
+void Pipeline::enrichArt(SessionCycle session) {
+    AllocScope allocScope(AllocTag::Enrich);
+    // Artwork URL - prefer OMDB poster, fall back to catbox
+    if (session.media && shouldShowPresence(*session.media)) {
+        const NowPlayingSnapshot& media = *session.media;
+        if (media.has(NowPlayingSnapshot::HAS_POSTER_URL)) {
+            session.artUrl = media.posterUrl();
+        } else if (media.has(NowPlayingSnapshot::HAS_ART_PATH)) {
+            std::weak_ptr<bool> alive = lifetime;
+            std::string artPath(media.artPath());
+            imageCache.getCatboxUrl(reactor, artPath,
+                [this, alive, session = std::move(session)](std::string url) mutable {
+                    if (alive.expired()) {
+                        return;
+                    }
+                    AllocScope allocScope(AllocTag::Enrich);
+                    session.artUrl = std::move(url);
+                    finishCycle(session);
+                });
+            return;
+        }
+    }
+    finishCycle(session);
+}
+
+// Render and publish are cheap, so they run right behind enrich; then the
+// newest cycle that arrived meanwhile gets its turn
+void Pipeline::finishCycle(SessionCycle& session) {
+    count(&PipelineStats::enriched);
+    int64_t cycleArg = static_cast<int64_t>(session.cycle);
+    traceSpan("pipeline", "enrich", session.enrichStartedAt, Clock::now(), "cycle", cycleArg);
+
+    guarded("render", [&] {
+        bool changed;
+        {
+            AllocScope allocScope(AllocTag::Render);
+            TraceScope trace("pipeline", "render");
+            trace.setArg("cycle", cycleArg);
+            changed = render(session, rendered);
+        }
+        count(&PipelineStats::rendered);
+        if (changed) {
+            guarded("publish", [&] {
+                AllocScope allocScope(AllocTag::Publish);
+                TraceScope trace("pipeline", "publish");
+                trace.setArg("cycle", cycleArg);
+                publish(rendered);
+                count(&PipelineStats::published);
+            });
+        }
+    });
+    // Every cycle, shown on Discord or not; the feed drops repeats
+    guarded("now playing", [&] {
+        AllocScope allocScope(AllocTag::Publish);
+        auto sampledAt = std::chrono::system_clock::now() -
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(Clock::now() - session.fetchedAt);
+        feed.update(session.media.get(), session.artUrl, sampledAt);
+    });
+
+    Clock::duration elapsed = Clock::now() - session.startedAt;
+    recordLatency(MetricStage::Cycle, elapsed);
+    traceSpan("pipeline", "cycle", session.startedAt, Clock::now(), "cycle", cycleArg);
+    if (cycleObserver) {
+        guarded("cycle observer", [&] { cycleObserver(session.cycle, elapsed); });
+    }
+
+    enrichBusy = false;
+    if (waitingCycle) {
+        SessionCycle next = std::move(*waitingCycle);
+        waitingCycle.reset();
+        enrich(std::move(next));
+    }
+}
+
+// Fills update in place so its strings keep their capacity from cycle to
+// cycle; false when there is nothing to publish
+bool Pipeline::render(SessionCycle& session, PresenceUpdate& update) {
+    update.cycle = session.cycle;
+    update.fetchedAt = session.fetchedAt;
+    update.show = false;
+    update.playing = false;
+
+    if (!session.media) {
+        // Nothing to undo until something has been shown
+        if (!everShown) {
+            return false;
+        }
+        update.tooltip = "Pleyx - Nothing playing";
+        return true;
+    }
+
+    const NowPlayingSnapshot& media = *session.media;
+    everShown = true;
+
+    // Full length: the tray cuts it to fit at a character boundary and
+    // marks the cut with an ellipsis
+    update.tooltip = "Pleyx - " + media.displayTitle();
+
+    update.show = shouldShowPresence(media);
+    if (update.show) {
+        update.playing = (media.playerState() == PlayerState::Playing);
+        formatter.build(media, session.artUrl, update.info);
+    }
+    return true;
+}
+
+void Pipeline::publish(PresenceUpdate& update) {
+    // Updates refresh the progress timestamps, so send every one; a clear
+    // only needs sending once
+    if (update.show) {
+        discord.postPresence(update.info);
+    } else if (lastShown.value_or(true)) {
+        discord.postClearPresence();
+    }
+    lastShown = update.show;
+
+    if (update.tooltip) {
+        if (*update.tooltip == lastTooltip) {
+            update.tooltip.reset();
+        } else {
+            lastTooltip = *update.tooltip;
+        }
+    }
+
+    if (onPublish) {
+        onPublish(update);
+    }
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "config.h"
+#include "cycle_arena.h"
+#include "discord.h"
+#include "image_cache.h"
+#include "now_playing_feed.h"
+#include "now_playing_snapshot.h"
+#include "plex.h"
+#include "presence.h"
+#include "reactor.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+// Desired presence state after one poll cycle. Every update is complete on
+// its own, so a newer one can always replace an older one still queued.
+struct PresenceUpdate {
+    uint64_t cycle = 0;
+    std::chrono::steady_clock::time_point fetchedAt;
+    bool show = false;                   // Publish info, otherwise clear
+    bool playing = false;                // Tray icon state
+    std::optional<std::string> tooltip;  // UTF-8 tray text, unset = leave as is
+    MediaInfo info;
+};
+
+struct PipelineStats {
+    uint64_t fetched = 0;
+    uint64_t parsed = 0;
+    uint64_t enriched = 0;
+    uint64_t rendered = 0;
+    uint64_t published = 0;
+    uint64_t superseded = 0;  // Cycles dropped for a newer one before a stage got to them
+    uint64_t omdbLookups = 0;
+    uint64_t refreshes = 0;   // Polls brought forward by refreshNow()
+};
+
+// Runs a poll cycle as fetch -> parse -> enrich -> render -> publish on the
+// reactor thread. Fetches and lookups are non-blocking requests, so a slow
+// stage (an OMDB lookup or a catbox upload) holds back only the stages
+// after it; the next Plex fetch still happens on time, and while enrich is
+// busy only the newest parsed cycle waits for it.
+class Pipeline {
+public:
+    using PublishCallback = std::function<void(const PresenceUpdate&)>;
+    using ResponseObserver = std::function<void(const std::string& response)>;
+    using CycleObserver = std::function<void(uint64_t cycle, std::chrono::steady_clock::duration elapsed)>;
+
+    Pipeline(Reactor& reactor, PlexClient& plex, Discord& discord, ImageCache& imageCache,
+             int pollingIntervalSecs, PresenceFormatter formatter = PresenceFormatter());
+    ~Pipeline();
+
+    // onPublish runs on the reactor thread after Discord has been updated;
+    // the tooltip is only set there when its text changed. Both may be
+    // called from any thread; stop() needs the reactor to still be running.
+    // Without poll, cycles only run on responses passed to inject().
+    void start(PublishCallback onPublish, bool poll = true);
+    void stop();
+    // Polls Plex right away and restarts the interval from there; any thread
+    void refreshNow();
+    // Runs a cycle on a /status/sessions response from elsewhere, e.g. a
+    // replayed capture, as if a fetch had just returned it; reactor thread
+    void inject(std::string response);
+
+    // Hooks for recording and replay, set before start(); both run on the
+    // reactor thread. The response observer sees every response before it
+    // is parsed; the cycle observer runs once a cycle has been published
+    // (or found nothing to publish), with the time since its fetch began.
+    void setResponseObserver(ResponseObserver observer);
+    void setCycleObserver(CycleObserver observer);
+
+    // Takes the polling interval, Plex server and credentials, OMDB key and
+    // templates from store from now on; its current config must be the one
+    // the pipeline and its components were built with. Each fetch checks
+    // for a newer snapshot; configChanged() (any thread) applies one right
+    // away. Set before start().
+    void followConfig(const ConfigStore& store);
+    void configChanged();
+
+    PipelineStats stats() const;
+
+    // What each cycle selected, as JSON for local tools; current() from any
+    // thread, subscribe() on the reactor thread
+    NowPlayingFeed& nowPlaying() { return feed; }
+
+private:
+    struct SessionCycle {
+        uint64_t cycle = 0;
+        std::chrono::steady_clock::time_point startedAt;  // When its fetch went out
+        std::chrono::steady_clock::time_point fetchedAt;
+        std::chrono::steady_clock::time_point enrichStartedAt;
+        std::shared_ptr<const NowPlayingSnapshot> media;  // Null when nothing is playing
+        std::string artUrl;
+    };
+
+    void fetch();
+    void retryFetchSoon();
+    void applyConfig();
+    void parse(uint64_t cycle, std::chrono::steady_clock::time_point startedAt, const std::string& response);
+    void enrich(SessionCycle session);
+    void applyCachedOmdb(SessionCycle& session) const;
+    void enrichArt(SessionCycle session);
+    void finishCycle(SessionCycle& session);
+    bool render(SessionCycle& session, PresenceUpdate& update);
+    void publish(PresenceUpdate& update);
+    void count(uint64_t PipelineStats::*counter);
+
+    Reactor& reactor;
+    PlexClient& plex;
+    Discord& discord;
+    ImageCache& imageCache;
+    std::chrono::seconds pollingInterval;
+    PublishCallback onPublish;
+    ResponseObserver responseObserver;
+    CycleObserver cycleObserver;
+
+    // Config followed, and the snapshot last applied; reactor thread
+    const ConfigStore* configStore = nullptr;
+    const Config* appliedConfig = nullptr;
+
+    std::atomic<bool> running{false};
+    // Requests in flight hold a weak reference; stop() expires it
+    std::shared_ptr<bool> lifetime;
+
+    // Fetch stage: the poll timer and whether a fetch is still out
+    Reactor::TimerId fetchTimer = 0;
+    std::chrono::steady_clock::time_point lastFetchAt;
+    uint64_t cycle = 0;
+    bool fetchInFlight = false;
+    // Whether Plex has answered yet, and the retry delay until it does
+    bool plexReached = false;
+    std::chrono::steady_clock::duration startupRetry{};
+
+    // Parse stage: the arena each response's DOM is built in, reset after
+    // every parse
+    CycleArena parseArena;
+
+    // Enrich stage: busy with one cycle, the newest parsed one waits
+    bool enrichBusy = false;
+    std::optional<SessionCycle> waitingCycle;
+
+    // Enrich stage: OMDB results for the title it last looked up
+    std::string omdbKey;
+    OmdbResult omdbResult;
+
+    // Render stage: compiled templates, whether anything has been shown
+    // since startup, and the update it fills in, reused between cycles
+    PresenceFormatter formatter;
+    bool everShown = false;
+    PresenceUpdate rendered;
+
+    // Publish stage: what was last applied
+    std::optional<bool> lastShown;
+    std::string lastTooltip;
+    NowPlayingFeed feed;
+
+    mutable std::mutex statsMutex;
+    PipelineStats statsData;
+};
@@ -0,0 +1,642 @@
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PLEYX_PIXELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PLEYX_TARGET_AVX2
+#else
+#define PLEYX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLEYX_PIXELS_SSE2 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+// AArch64 only: the ring needs vector square root and division
+#define PLEYX_PIXELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Luminance weights in 1/256ths; they sum to 256, so white stays 255
+static const uint32_t GRAY_R = 77;
+static const uint32_t GRAY_G = 150;
+static const uint32_t GRAY_B = 29;
+
+static const float PI = 3.14159265f;
+static const float HALF_PI = 1.57079633f;
+static const float TWO_PI = 6.28318531f;
+
+// Pixels the ring kernels colour at a time before compositing them
+static const int RING_CHUNK = 64;
+
+const char* pixelIsaName(PixelIsa isa) {
+    switch (isa) {
+        case PixelIsa::Sse2: return "sse2";
+        case PixelIsa::Avx2: return "avx2";
+        case PixelIsa::Neon: return "neon";
+        default: return "scalar";
+    }
+}
+
+#ifdef PLEYX_PIXELS_X86
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // The OS must save the YMM registers on a context switch
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+bool pixelIsaSupported(PixelIsa isa) {
+    switch (isa) {
+        case PixelIsa::Scalar:
+            return true;
+#ifdef PLEYX_PIXELS_SSE2
+        case PixelIsa::Sse2:
+            return true;
+#endif
+#ifdef PLEYX_PIXELS_X86
+        case PixelIsa::Avx2: {
+            static const bool supported = cpuHasAvx2();
+            return supported;
+        }
+#endif
+#ifdef PLEYX_PIXELS_NEON
+        case PixelIsa::Neon:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+PixelIsa bestPixelIsa() {
+    static const PixelIsa best = [] {
+        for (PixelIsa isa : {PixelIsa::Avx2, PixelIsa::Neon, PixelIsa::Sse2}) {
+            if (pixelIsaSupported(isa)) {
+                return isa;
+            }
+        }
+        return PixelIsa::Scalar;
+    }();
+    return best;
+}
+
+// Scalar reference; every other path must give the same bytes
+
+static inline uint32_t div255(uint32_t x) {  // x <= 255 * 255
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t grayPixel(uint32_t p, uint32_t brightness) {
+    uint32_t b = p & 0xFF;
+    uint32_t g = (p >> 8) & 0xFF;
+    uint32_t r = (p >> 16) & 0xFF;
+    uint32_t y = (r * GRAY_R + g * GRAY_G + b * GRAY_B) >> 8;
+    uint32_t gray = (y * brightness) >> 8;
+    return (p & 0xFF000000u) | (gray << 16) | (gray << 8) | gray;
+}
+
+static inline uint32_t overPixel(uint32_t s, uint32_t d) {
+    uint32_t inverseAlpha = 255 - (s >> 24);
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t c = ((s >> shift) & 0xFF) + div255(((d >> shift) & 0xFF) * inverseAlpha);
+        out |= std::min<uint32_t>(c, 255) << shift;
+    }
+    return out;
+}
+
+// Colour scaled by an 8-bit coverage
+static inline uint32_t scalePixel(uint32_t color, uint32_t alpha) {
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        out |= div255(((color >> shift) & 0xFF) * alpha) << shift;
+    }
+    return out;
+}
+
+struct RingGeometry {
+    float centerX;
+    float centerY;
+    float radius;         // Of the ring's centre line
+    float halfThickness;
+    float sweep;          // Radians covered, clockwise from 12 o'clock
+    bool full;            // No start or end edge to anti-alias
+};
+
+static inline float clamp01(float x) {
+    return std::min(std::max(x, 0.0f), 1.0f);
+}
+
+// Angle of (px, py) clockwise from 12 o'clock in [0, 2pi), y pointing
+// down; atan2 by a polynomial (within 1e-5 rad) so vector paths match
+static inline float clockwiseAngle(float px, float py) {
+    float x = -py;
+    float y = px;
+    float ax = std::fabs(x);
+    float ay = std::fabs(y);
+    float a = std::min(ax, ay) / std::max(std::max(ax, ay), 1e-20f);
+    float s = a * a;
+    float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+    r = ay > ax ? HALF_PI - r : r;
+    r = x < 0.0f ? PI - r : r;
+    r = y < 0.0f ? -r : r;
+    return r < 0.0f ? r + TWO_PI : r;
+}
+
+static inline float ringCoverage(float px, float py, const RingGeometry& ring) {
+    float d = std::sqrt(px * px + py * py);
+    float coverage = clamp01(ring.halfThickness + 0.5f - std::fabs(d - ring.radius));
+    if (!ring.full) {
+        // Distance along the arc past each end, for anti-aliased end caps
+        float theta = clockwiseAngle(px, py);
+        coverage = coverage * clamp01((ring.sweep - theta) * d + 0.5f) * clamp01(theta * d + 0.5f);
+    }
+    return coverage;
+}
+
+static inline uint32_t ringAlpha(float coverage) {
+    return static_cast<uint32_t>(static_cast<int32_t>(coverage * 255.0f + 0.5f));
+}
+
+static void grayscaleScalar(const uint32_t* src, uint32_t* dst, size_t count, uint32_t brightness) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = grayPixel(src[i], brightness);
+    }
+}
+
+static void compositeScalar(const uint32_t* src, uint32_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = overPixel(src[i], dst[i]);
+    }
+}
+
+static void ringRowScalar(uint32_t* out, int x0, int count, float py, uint32_t color, const RingGeometry& ring) {
+    for (int i = 0; i < count; i++) {
+        float px = static_cast<float>(x0 + i) + 0.5f - ring.centerX;
+        out[i] = scalePixel(color, ringAlpha(ringCoverage(px, py, ring)));
+    }
+}
+
+#ifdef PLEYX_PIXELS_SSE2
+
+static inline __m128i graySse2(__m128i p, __m128i brightness) {
+    const __m128i low = _mm_set1_epi32(0xFF);
+    __m128i b = _mm_and_si128(p, low);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), low);
+    __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+    // Every product and the sum fit the low 16 bits of each lane
+    __m128i y = _mm_add_epi32(_mm_add_epi32(
+        _mm_mullo_epi16(r, _mm_set1_epi32(GRAY_R)),
+        _mm_mullo_epi16(g, _mm_set1_epi32(GRAY_G))),
+        _mm_mullo_epi16(b, _mm_set1_epi32(GRAY_B)));
+    __m128i gray = _mm_srli_epi32(_mm_mullo_epi16(_mm_srli_epi32(y, 8), brightness), 8);
+    __m128i alpha = _mm_and_si128(p, _mm_set1_epi32(static_cast<int>(0xFF000000u)));
+    return _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(gray, 16)), _mm_or_si128(_mm_slli_epi32(gray, 8), gray));
+}
+
+// Two pixels widened to 16-bit lanes: dst * (255 - src alpha) / 255
+static inline __m128i fadeSse2(__m128i s16, __m128i d16) {
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xFF), 0xFF);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(d16, _mm_sub_epi16(_mm_set1_epi16(255), alpha)), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static inline __m128i overSse2(__m128i s, __m128i d) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = fadeSse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+    __m128i hi = fadeSse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+    return _mm_adds_epu8(s, _mm_packus_epi16(lo, hi));
+}
+
+static inline __m128 clamp01Sse2(__m128 x) {
+    return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+static inline __m128 selectSse2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 absSse2(__m128 x) {
+    return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+}
+
+static inline __m128 clockwiseAngleSse2(__m128 px, __m128 py) {
+    const __m128 zero = _mm_setzero_ps();
+    __m128 x = _mm_sub_ps(zero, py);
+    __m128 y = px;
+    __m128 ax = absSse2(x);
+    __m128 ay = absSse2(y);
+    __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-20f)));
+    __m128 s = _mm_mul_ps(a, a);
+    __m128 r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(
+        _mm_mul_ps(_mm_set1_ps(-0.0464964749f), s), _mm_set1_ps(0.15931422f)), s), _mm_set1_ps(0.327622764f)), s), a), a);
+    r = selectSse2(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(HALF_PI), r), r);
+    r = selectSse2(_mm_cmplt_ps(x, zero), _mm_sub_ps(_mm_set1_ps(PI), r), r);
+    r = selectSse2(_mm_cmplt_ps(y, zero), _mm_sub_ps(zero, r), r);
+    return selectSse2(_mm_cmplt_ps(r, zero), _mm_add_ps(r, _mm_set1_ps(TWO_PI)), r);
+}
+
+static inline __m128i scaleSse2(__m128i alpha, uint32_t color) {
+    __m128i out = _mm_setzero_si128();
+    for (int shift = 0; shift < 32; shift += 8) {
+        __m128i t = _mm_add_epi32(_mm_mullo_epi16(alpha, _mm_set1_epi32((color >> shift) & 0xFF)), _mm_set1_epi32(128));
+        t = _mm_srli_epi32(_mm_add_epi32(t, _mm_srli_epi32(t, 8)), 8);
+        out = _mm_or_si128(out, _mm_slli_epi32(t, shift));
+    }
+    return out;
+}
+
+static void grayscaleSse2(const uint32_t* src, uint32_t* dst, size_t count, uint32_t brightness) {
+    __m128i scale = _mm_set1_epi32(static_cast<int>(brightness));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), graySse2(p, scale));
+    }
+    grayscaleScalar(src + i, dst + i, count - i, brightness);
+}
+
+static void compositeSse2(const uint32_t* src, uint32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), overSse2(s, d));
+    }
+    compositeScalar(src + i, dst + i, count - i);
+}
+
+static void ringRowSse2(uint32_t* out, int x0, int count, float py, uint32_t color, const RingGeometry& ring) {
+    const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    __m128 vy = _mm_set1_ps(py);
+    __m128 yy = _mm_mul_ps(vy, vy);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x0 + i)), offsets), _mm_set1_ps(ring.centerX));
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), yy));
+        __m128 coverage = clamp01Sse2(_mm_sub_ps(_mm_add_ps(_mm_set1_ps(ring.halfThickness), _mm_set1_ps(0.5f)),
+            absSse2(_mm_sub_ps(d, _mm_set1_ps(ring.radius)))));
+        if (!ring.full) {
+            __m128 theta = clockwiseAngleSse2(px, vy);
+            __m128 end = clamp01Sse2(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(ring.sweep), theta), d), _mm_set1_ps(0.5f)));
+            __m128 start = clamp01Sse2(_mm_add_ps(_mm_mul_ps(theta, d), _mm_set1_ps(0.5f)));
+            coverage = _mm_mul_ps(_mm_mul_ps(coverage, end), start);
+        }
+        __m128i alpha = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(coverage, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), scaleSse2(alpha, color));
+    }
+    ringRowScalar(out + i, x0 + i, count - i, py, color, ring);
+}
+
+#endif
+
+#ifdef PLEYX_PIXELS_X86
+
+PLEYX_TARGET_AVX2 static inline __m256i grayAvx2(__m256i p, __m256i brightness) {
+    const __m256i low = _mm256_set1_epi32(0xFF);
+    __m256i b = _mm256_and_si256(p, low);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 8), low);
+    __m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 16), low);
+    __m256i y = _mm256_add_epi32(_mm256_add_epi32(
+        _mm256_mullo_epi16(r, _mm256_set1_epi32(GRAY_R)),
+        _mm256_mullo_epi16(g, _mm256_set1_epi32(GRAY_G))),
+        _mm256_mullo_epi16(b, _mm256_set1_epi32(GRAY_B)));
+    __m256i gray = _mm256_srli_epi32(_mm256_mullo_epi16(_mm256_srli_epi32(y, 8), brightness), 8);
+    __m256i alpha = _mm256_and_si256(p, _mm256_set1_epi32(static_cast<int>(0xFF000000u)));
+    return _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(gray, 16)),
+        _mm256_or_si256(_mm256_slli_epi32(gray, 8), gray));
+}
+
+// Unpacking, shuffling and packing all stay within 128-bit halves, so the
+// pixel order survives the round trip
+PLEYX_TARGET_AVX2 static inline __m256i fadeAvx2(__m256i s16, __m256i d16) {
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, 0xFF), 0xFF);
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(d16, _mm256_sub_epi16(_mm256_set1_epi16(255), alpha)),
+        _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+PLEYX_TARGET_AVX2 static inline __m256i overAvx2(__m256i s, __m256i d) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = fadeAvx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+    __m256i hi = fadeAvx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+    return _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi));
+}
+
+PLEYX_TARGET_AVX2 static inline __m256 clamp01Avx2(__m256 x) {
+    return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+PLEYX_TARGET_AVX2 static inline __m256 absAvx2(__m256 x) {
+    return _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)));
+}
+
+PLEYX_TARGET_AVX2 static inline __m256 clockwiseAngleAvx2(__m256 px, __m256 py) {
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 x = _mm256_sub_ps(zero, py);
+    __m256 y = px;
+    __m256 ax = absAvx2(x);
+    __m256 ay = absAvx2(y);
+    __m256 a = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(1e-20f)));
+    __m256 s = _mm256_mul_ps(a, a);
+    __m256 r = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(
+        _mm256_mul_ps(_mm256_set1_ps(-0.0464964749f), s), _mm256_set1_ps(0.15931422f)), s),
+        _mm256_set1_ps(0.327622764f)), s), a), a);
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(HALF_PI), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(PI), r), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(zero, r), _mm256_cmp_ps(y, zero, _CMP_LT_OQ));
+    return _mm256_blendv_ps(r, _mm256_add_ps(r, _mm256_set1_ps(TWO_PI)), _mm256_cmp_ps(r, zero, _CMP_LT_OQ));
+}
+
+PLEYX_TARGET_AVX2 static inline __m256i scaleAvx2(__m256i alpha, uint32_t color) {
+    __m256i out = _mm256_setzero_si256();
+    for (int shift = 0; shift < 32; shift += 8) {
+        __m256i t = _mm256_add_epi32(_mm256_mullo_epi16(alpha, _mm256_set1_epi32((color >> shift) & 0xFF)),
+            _mm256_set1_epi32(128));
+        t = _mm256_srli_epi32(_mm256_add_epi32(t, _mm256_srli_epi32(t, 8)), 8);
+        out = _mm256_or_si256(out, _mm256_slli_epi32(t, shift));
+    }
+    return out;
+}
+
+PLEYX_TARGET_AVX2 static void grayscaleAvx2(const uint32_t* src, uint32_t* dst, size_t count, uint32_t brightness) {
+    __m256i scale = _mm256_set1_epi32(static_cast<int>(brightness));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), grayAvx2(p, scale));
+    }
+    grayscaleScalar(src + i, dst + i, count - i, brightness);
+}
+
+PLEYX_TARGET_AVX2 static void compositeAvx2(const uint32_t* src, uint32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), overAvx2(s, d));
+    }
+    compositeScalar(src + i, dst + i, count - i);
+}
+
+PLEYX_TARGET_AVX2 static void ringRowAvx2(uint32_t* out, int x0, int count, float py, uint32_t color,
+                                          const RingGeometry& ring) {
+    const __m256 offsets = _mm256_set_ps(7.5f, 6.5f, 5.5f, 4.5f, 3.5f, 2.5f, 1.5f, 0.5f);
+    __m256 vy = _mm256_set1_ps(py);
+    __m256 yy = _mm256_mul_ps(vy, vy);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(x0 + i)), offsets),
+            _mm256_set1_ps(ring.centerX));
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(px, px), yy));
+        __m256 coverage = clamp01Avx2(_mm256_sub_ps(
+            _mm256_add_ps(_mm256_set1_ps(ring.halfThickness), _mm256_set1_ps(0.5f)),
+            absAvx2(_mm256_sub_ps(d, _mm256_set1_ps(ring.radius)))));
+        if (!ring.full) {
+            __m256 theta = clockwiseAngleAvx2(px, vy);
+            __m256 end = clamp01Avx2(_mm256_add_ps(
+                _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(ring.sweep), theta), d), _mm256_set1_ps(0.5f)));
+            __m256 start = clamp01Avx2(_mm256_add_ps(_mm256_mul_ps(theta, d), _mm256_set1_ps(0.5f)));
+            coverage = _mm256_mul_ps(_mm256_mul_ps(coverage, end), start);
+        }
+        __m256i alpha = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(coverage, _mm256_set1_ps(255.0f)),
+            _mm256_set1_ps(0.5f)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), scaleAvx2(alpha, color));
+    }
+    ringRowScalar(out + i, x0 + i, count - i, py, color, ring);
+}
+
+#endif
+
+#ifdef PLEYX_PIXELS_NEON
+
+// Eight channel values times eight 8-bit factors, divided by 255 and rounded
+static inline uint8x8_t mulDiv255Neon(uint8x8_t value, uint8x8_t factor) {
+    uint16x8_t p = vmull_u8(value, factor);
+    return vraddhn_u16(p, vrshrq_n_u16(p, 8));
+}
+
+static inline uint8x8_t grayNeon(uint8x8_t b, uint8x8_t g, uint8x8_t r, uint8x8_t brightness) {
+    uint16x8_t sum = vmull_u8(r, vdup_n_u8(GRAY_R));
+    sum = vmlal_u8(sum, g, vdup_n_u8(GRAY_G));
+    sum = vmlal_u8(sum, b, vdup_n_u8(GRAY_B));
+    return vshrn_n_u16(vmull_u8(vshrn_n_u16(sum, 8), brightness), 8);
+}
+
+static inline float32x4_t clamp01Neon(float32x4_t x) {
+    return vminq_f32(vmaxq_f32(x, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+}
+
+static inline float32x4_t clockwiseAngleNeon(float32x4_t px, float32x4_t py) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t x = vsubq_f32(zero, py);
+    float32x4_t y = px;
+    float32x4_t ax = vabsq_f32(x);
+    float32x4_t ay = vabsq_f32(y);
+    float32x4_t a = vdivq_f32(vminq_f32(ax, ay), vmaxq_f32(vmaxq_f32(ax, ay), vdupq_n_f32(1e-20f)));
+    float32x4_t s = vmulq_f32(a, a);
+    float32x4_t r = vaddq_f32(vmulq_f32(vmulq_f32(vsubq_f32(vmulq_f32(vaddq_f32(
+        vmulq_f32(vdupq_n_f32(-0.0464964749f), s), vdupq_n_f32(0.15931422f)), s), vdupq_n_f32(0.327622764f)), s), a), a);
+    r = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(HALF_PI), r), r);
+    r = vbslq_f32(vcltq_f32(x, zero), vsubq_f32(vdupq_n_f32(PI), r), r);
+    r = vbslq_f32(vcltq_f32(y, zero), vsubq_f32(zero, r), r);
+    return vbslq_f32(vcltq_f32(r, zero), vaddq_f32(r, vdupq_n_f32(TWO_PI)), r);
+}
+
+static inline uint32x4_t scaleNeon(uint32x4_t alpha, uint32_t color) {
+    uint32x4_t out = vdupq_n_u32(0);
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32x4_t t = vaddq_u32(vmulq_n_u32(alpha, (color >> shift) & 0xFF), vdupq_n_u32(128));
+        t = vshrq_n_u32(vaddq_u32(t, vshrq_n_u32(t, 8)), 8);
+        out = vorrq_u32(out, vshlq_u32(t, vdupq_n_s32(shift)));
+    }
+    return out;
+}
+
+static void grayscaleNeon(const uint32_t* src, uint32_t* dst, size_t count, uint32_t brightness) {
+    uint8x8_t scale = vdup_n_u8(static_cast<uint8_t>(brightness));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // Deinterleaves 16 pixels into B, G, R and A planes
+        uint8x16x4_t p = vld4q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        uint8x16_t gray = vcombine_u8(
+            grayNeon(vget_low_u8(p.val[0]), vget_low_u8(p.val[1]), vget_low_u8(p.val[2]), scale),
+            grayNeon(vget_high_u8(p.val[0]), vget_high_u8(p.val[1]), vget_high_u8(p.val[2]), scale));
+        p.val[0] = p.val[1] = p.val[2] = gray;
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + i), p);
+    }
+    grayscaleScalar(src + i, dst + i, count - i, brightness);
+}
+
+static void compositeNeon(const uint32_t* src, uint32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t s = vld4q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        uint8x16x4_t d = vld4q_u8(reinterpret_cast<const uint8_t*>(dst + i));
+        uint8x16_t inverseAlpha = vmvnq_u8(s.val[3]);
+        for (int c = 0; c < 4; c++) {
+            uint8x16_t faded = vcombine_u8(
+                mulDiv255Neon(vget_low_u8(d.val[c]), vget_low_u8(inverseAlpha)),
+                mulDiv255Neon(vget_high_u8(d.val[c]), vget_high_u8(inverseAlpha)));
+            d.val[c] = vqaddq_u8(s.val[c], faded);
+        }
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + i), d);
+    }
+    compositeScalar(src + i, dst + i, count - i);
+}
+
+static void ringRowNeon(uint32_t* out, int x0, int count, float py, uint32_t color, const RingGeometry& ring) {
+    static const float OFFSETS[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+    const float32x4_t offsets = vld1q_f32(OFFSETS);
+    float32x4_t vy = vdupq_n_f32(py);
+    float32x4_t yy = vmulq_f32(vy, vy);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t px = vsubq_f32(vaddq_f32(vdupq_n_f32(static_cast<float>(x0 + i)), offsets), vdupq_n_f32(ring.centerX));
+        float32x4_t d = vsqrtq_f32(vaddq_f32(vmulq_f32(px, px), yy));
+        float32x4_t coverage = clamp01Neon(vsubq_f32(vaddq_f32(vdupq_n_f32(ring.halfThickness), vdupq_n_f32(0.5f)),
+            vabsq_f32(vsubq_f32(d, vdupq_n_f32(ring.radius)))));
+        if (!ring.full) {
+            float32x4_t theta = clockwiseAngleNeon(px, vy);
+            float32x4_t end = clamp01Neon(vaddq_f32(vmulq_f32(vsubq_f32(vdupq_n_f32(ring.sweep), theta), d),
+                vdupq_n_f32(0.5f)));
+            float32x4_t start = clamp01Neon(vaddq_f32(vmulq_f32(theta, d), vdupq_n_f32(0.5f)));
+            coverage = vmulq_f32(vmulq_f32(coverage, end), start);
+        }
+        uint32x4_t alpha = vreinterpretq_u32_s32(vcvtq_s32_f32(vaddq_f32(vmulq_f32(coverage, vdupq_n_f32(255.0f)),
+            vdupq_n_f32(0.5f))));
+        vst1q_u32(out + i, scaleNeon(alpha, color));
+    }
+    ringRowScalar(out + i, x0 + i, count - i, py, color, ring);
+}
+
+#endif
+
+void grayscalePixels(const uint32_t* src, uint32_t* dst, size_t count, uint8_t brightness, PixelIsa isa) {
+    switch (isa) {
+#ifdef PLEYX_PIXELS_SSE2
+        case PixelIsa::Sse2: grayscaleSse2(src, dst, count, brightness); return;
+#endif
+#ifdef PLEYX_PIXELS_X86
+        case PixelIsa::Avx2:
+            if (pixelIsaSupported(PixelIsa::Avx2)) {
+                grayscaleAvx2(src, dst, count, brightness);
+                return;
+            }
+            break;
+#endif
+#ifdef PLEYX_PIXELS_NEON
+        case PixelIsa::Neon: grayscaleNeon(src, dst, count, brightness); return;
+#endif
+        default: break;
+    }
+    grayscaleScalar(src, dst, count, brightness);
+}
+
+void compositePixels(const uint32_t* src, uint32_t* dst, size_t count, PixelIsa isa) {
+    switch (isa) {
+#ifdef PLEYX_PIXELS_SSE2
+        case PixelIsa::Sse2: compositeSse2(src, dst, count); return;
+#endif
+#ifdef PLEYX_PIXELS_X86
+        case PixelIsa::Avx2:
+            if (pixelIsaSupported(PixelIsa::Avx2)) {
+                compositeAvx2(src, dst, count);
+                return;
+            }
+            break;
+#endif
+#ifdef PLEYX_PIXELS_NEON
+        case PixelIsa::Neon: compositeNeon(src, dst, count); return;
+#endif
+        default: break;
+    }
+    compositeScalar(src, dst, count);
+}
+
+void drawProgressRing(uint32_t* pixels, int width, int height, double progress, float thickness, uint32_t color,
+                      PixelIsa isa) {
+    if (width <= 0 || height <= 0 || thickness <= 0.0f || progress <= 0.0) {
+        return;
+    }
+    RingGeometry ring;
+    ring.centerX = width * 0.5f;
+    ring.centerY = height * 0.5f;
+    ring.halfThickness = thickness * 0.5f;
+    ring.radius = std::min(width, height) * 0.5f - ring.halfThickness;
+    ring.full = progress >= 1.0;
+    ring.sweep = static_cast<float>(std::min(progress, 1.0) * TWO_PI);
+
+    // A path the CPU can't run falls back to scalar
+    if (!pixelIsaSupported(isa)) {
+        isa = PixelIsa::Scalar;
+    }
+    uint32_t chunk[RING_CHUNK];
+    for (int y = 0; y < height; y++) {
+        float py = static_cast<float>(y) + 0.5f - ring.centerY;
+        // Rows that miss the ring entirely need no work
+        if (std::fabs(py) > ring.radius + ring.halfThickness + 0.5f) {
+            continue;
+        }
+        uint32_t* row = pixels + static_cast<size_t>(y) * width;
+        for (int x0 = 0; x0 < width; x0 += RING_CHUNK) {
+            int count = std::min(RING_CHUNK, width - x0);
+            switch (isa) {
+#ifdef PLEYX_PIXELS_SSE2
+                case PixelIsa::Sse2: ringRowSse2(chunk, x0, count, py, color, ring); break;
+#endif
+#ifdef PLEYX_PIXELS_X86
+                case PixelIsa::Avx2: ringRowAvx2(chunk, x0, count, py, color, ring); break;
+#endif
+#ifdef PLEYX_PIXELS_NEON
+                case PixelIsa::Neon: ringRowNeon(chunk, x0, count, py, color, ring); break;
+#endif
+                default: ringRowScalar(chunk, x0, count, py, color, ring); break;
+            }
+            compositePixels(chunk, row + x0, count, isa);
+        }
+    }
+}
+
+void premultiplyPixels(uint32_t* pixels, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t alpha = pixels[i] >> 24;
+        pixels[i] = (scalePixel(pixels[i], alpha) & 0x00FFFFFFu) | (alpha << 24);
+    }
+}
+
+void unpremultiplyPixels(uint32_t* pixels, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t p = pixels[i];
+        uint32_t alpha = p >> 24;
+        if (alpha == 0 || alpha == 255) {
+            continue;
+        }
+        uint32_t out = alpha << 24;
+        for (int shift = 0; shift < 24; shift += 8) {
+            uint32_t c = (((p >> shift) & 0xFF) * 255 + alpha / 2) / alpha;
+            out |= std::min<uint32_t>(c, 255) << shift;
+        }
+        pixels[i] = out;
+    }
+}
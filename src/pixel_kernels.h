@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels over 32-bit pixels in Windows DIB byte order (B, G, R, A; read
+// as a little-endian uint32_t, 0xAARRGGBB), independent of GDI so they can
+// be benchmarked anywhere. Each has a scalar path and SSE2, AVX2 and NEON
+// paths where the CPU has them, and every path gives the same bytes as
+// the scalar one (the ring's coverage may differ by one step of 255).
+
+enum class PixelIsa : uint8_t {
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon
+};
+
+const char* pixelIsaName(PixelIsa isa);
+bool pixelIsaSupported(PixelIsa isa);
+// The widest path this CPU runs, checked once
+PixelIsa bestPixelIsa();
+
+// Luminance (0.299 R + 0.587 G + 0.114 B) scaled by brightness/256, alpha
+// kept. Linear, so it works on straight and premultiplied pixels alike.
+// src and dst may be the same.
+void grayscalePixels(const uint32_t* src, uint32_t* dst, size_t count, uint8_t brightness,
+                     PixelIsa isa = bestPixelIsa());
+
+// Porter-Duff source-over of premultiplied src onto premultiplied dst:
+// dst = src + dst * (255 - src alpha) / 255, rounded
+void compositePixels(const uint32_t* src, uint32_t* dst, size_t count, PixelIsa isa = bestPixelIsa());
+
+// Anti-aliased arc of premultiplied color composited onto the premultiplied
+// width x height image, clockwise from 12 o'clock over progress (0..1) of a
+// full turn. The ring is centred, thickness pixels wide, and its outer
+// edge touches the image's shorter side.
+void drawProgressRing(uint32_t* pixels, int width, int height, double progress, float thickness, uint32_t color,
+                      PixelIsa isa = bestPixelIsa());
+
+// Straight <-> premultiplied alpha, for images such as icons that store
+// straight alpha; scalar, since they run once per rendered image
+void premultiplyPixels(uint32_t* pixels, size_t count);
+void unpremultiplyPixels(uint32_t* pixels, size_t count);
@@ -1,118 +1,87 @@
 #include "plex.h"
+#include "cycle_arena.h"
+#include "now_playing_snapshot.h"
+#include "http_client.h"
+#include "log.h"
+#include "metrics.h"
+#include "reactor.h"
+#include "trace.h"
 #include <nlohmann/json.hpp>
-#include <iostream>
 #include <regex>
 #include <fstream>
+#include <map>
 #include <sstream>
-
-#ifdef _WIN32
-#include <windows.h>
-#include <winhttp.h>
-#pragma comment(lib, "winhttp.lib")
-#endif
+#include <string_view>
 
 using json = nlohmann::json;
 
+// JSON whose nodes and strings come from the current ArenaScope
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+using ArenaJson = nlohmann::basic_json<std::map, std::vector, ArenaString, bool, int64_t, uint64_t, double,
+                                       ArenaAllocator>;
+
+// j's string; throws like get<std::string>() if it is something else
+static std::string_view stringValue(const ArenaJson& j) {
+    const ArenaString& s = j.get_ref<const ArenaString&>();
+    return std::string_view(s.data(), s.size());
+}
+
+// The string at key, or fallback when it is missing or not a string
+static std::string_view stringField(const ArenaJson& object, const char* key, std::string_view fallback = {}) {
+    auto it = object.find(key);
+    if (it == object.end() || !it->is_string()) {
+        return fallback;
+    }
+    return stringValue(*it);
+}
+
 // OMDB API key set from config
 static std::string g_omdbApiKey;
+static std::string g_omdbBaseUrl = "https://www.omdbapi.com/";
 
 void setOmdbApiKey(const std::string& apiKey) {
     g_omdbApiKey = apiKey;
     if (!apiKey.empty()) {
-        std::cout << "[OMDB] API key configured" << std::endl;
+        logInfo("OMDB") << "API key configured";
     }
 }
 
-struct OmdbResult {
-    std::string imdbId;
-    std::string posterUrl;
-    std::string imdbRating;
-    std::string rottenTomatoesRating;
-};
+void setOmdbBaseUrl(const std::string& baseUrl) {
+    g_omdbBaseUrl = baseUrl;
+}
 
-static OmdbResult queryOmdb(const std::string& title, int year, bool isShow) {
-    OmdbResult result;
-    if (g_omdbApiKey.empty()) return result;
-
-#ifdef _WIN32
-    // URL encode title
-    std::string encodedTitle;
-    for (char c : title) {
-        if (isalnum(c) || c == '-' || c == '_' || c == '.') {
-            encodedTitle += c;
-        } else if (c == ' ') {
-            encodedTitle += '+';
-        } else {
-            char hex[4];
-            snprintf(hex, sizeof(hex), "%%%02X", static_cast<unsigned char>(c));
-            encodedTitle += hex;
-        }
-    }
+// Empty when OMDB is not configured
+static std::string omdbUrl(const std::string& title, int year, bool isShow) {
+    if (g_omdbApiKey.empty()) return "";
 
-    std::string path = "/?apikey=" + g_omdbApiKey + "&t=" + encodedTitle;
+    std::string url = g_omdbBaseUrl + "?apikey=" + g_omdbApiKey + "&t=" + urlEncode(title);
     if (year > 0) {
-        path += "&y=" + std::to_string(year);
+        url += "&y=" + std::to_string(year);
     }
     if (isShow) {
-        path += "&type=series";
-    }
-
-    std::wstring wPath(path.begin(), path.end());
-
-    HINTERNET hSession = WinHttpOpen(L"Pleyx/1.0",
-        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-        WINHTTP_NO_PROXY_NAME,
-        WINHTTP_NO_PROXY_BYPASS, 0);
-    if (!hSession) return result;
-
-    HINTERNET hConnect = WinHttpConnect(hSession, L"www.omdbapi.com", INTERNET_DEFAULT_HTTPS_PORT, 0);
-    if (!hConnect) {
-        WinHttpCloseHandle(hSession);
-        return result;
-    }
-
-    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", wPath.c_str(),
-        nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
-    if (!hRequest) {
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return result;
+        url += "&type=series";
     }
+    return url;
+}
 
-    if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-        WINHTTP_NO_REQUEST_DATA, 0, 0, 0) || !WinHttpReceiveResponse(hRequest, nullptr)) {
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
+static OmdbResult parseOmdb(const HttpResponse& response) {
+    OmdbResult result;
+    if (!response.ok()) {
         return result;
     }
 
-    std::string response;
-    DWORD bytesAvailable = 0;
-    DWORD bytesRead = 0;
-    while (WinHttpQueryDataAvailable(hRequest, &bytesAvailable) && bytesAvailable > 0) {
-        std::vector<char> buffer(bytesAvailable + 1);
-        if (WinHttpReadData(hRequest, buffer.data(), bytesAvailable, &bytesRead)) {
-            response.append(buffer.data(), bytesRead);
-        }
-    }
-
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-
     try {
-        auto j = json::parse(response);
+        auto j = json::parse(response.body);
         if (j.value("Response", "") == "True") {
             if (j.contains("imdbID")) {
                 result.imdbId = j["imdbID"].get<std::string>();
-                std::cout << "[OMDB] Found IMDB ID: " << result.imdbId << std::endl;
+                logDebug("OMDB") << "Found IMDB ID: " << result.imdbId;
             }
             if (j.contains("Poster")) {
                 std::string poster = j["Poster"].get<std::string>();
                 if (poster != "N/A" && !poster.empty()) {
                     result.posterUrl = poster;
-                    std::cout << "[OMDB] Found poster: " << poster << std::endl;
+                    logDebug("OMDB") << "Found poster: " << poster;
                 }
             }
             // Parse ratings array
@@ -122,16 +91,15 @@ static OmdbResult queryOmdb(const std::string& title, int year, bool isShow) {
                     std::string value = rating.value("Value", "");
                     if (source == "Internet Movie Database" && !value.empty()) {
                         result.imdbRating = value;
-                        std::cout << "[OMDB] IMDB rating: " << value << std::endl;
+                        logDebug("OMDB") << "IMDB rating: " << value;
                     } else if (source == "Rotten Tomatoes" && !value.empty()) {
                         result.rottenTomatoesRating = value;
-                        std::cout << "[OMDB] RT rating: " << value << std::endl;
+                        logDebug("OMDB") << "RT rating: " << value;
                     }
                 }
             }
         }
     } catch (...) {}
-#endif
     return result;
 }
 
@@ -164,110 +132,46 @@ std::string NowPlaying::stateText() const {
     }
 }
 
-PlexClient::PlexClient(const std::string& serverUrl, const std::string& token, const std::string& username)
-    : serverUrl(serverUrl), token(token), filterUsername(username) {
+PlexClient::PlexClient(const std::string& serverUrl, const std::string& token, const std::string& username) {
+    setServer(serverUrl, token, username);
+}
+
+void PlexClient::setServer(const std::string& serverUrl, const std::string& token, const std::string& username) {
+    this->serverUrl = serverUrl;
+    this->token = token;
+    filterUsername = username;
     // Remove trailing slash
     while (!this->serverUrl.empty() && this->serverUrl.back() == '/') {
         this->serverUrl.pop_back();
     }
     if (!filterUsername.empty()) {
-        std::cout << "[Plex] Filtering sessions to user: " << filterUsername << std::endl;
+        logInfo("Plex") << "Filtering sessions to user: " << filterUsername;
     }
 }
 
-#ifdef _WIN32
-std::string PlexClient::httpGet(const std::string& path) {
-    std::string result;
-
-    // Parse URL
-    std::string fullUrl = serverUrl + path;
-    std::wstring wUrl(fullUrl.begin(), fullUrl.end());
-
-    URL_COMPONENTS urlComp = {0};
-    urlComp.dwStructSize = sizeof(urlComp);
-    wchar_t hostName[256] = {0};
-    wchar_t urlPath[2048] = {0};
-    urlComp.lpszHostName = hostName;
-    urlComp.dwHostNameLength = 256;
-    urlComp.lpszUrlPath = urlPath;
-    urlComp.dwUrlPathLength = 2048;
-
-    if (!WinHttpCrackUrl(wUrl.c_str(), 0, 0, &urlComp)) {
-        std::cerr << "[Plex] Failed to parse URL" << std::endl;
-        return "";
-    }
-
-    HINTERNET hSession = WinHttpOpen(L"Pleyx/1.0",
-        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-        WINHTTP_NO_PROXY_NAME,
-        WINHTTP_NO_PROXY_BYPASS, 0);
-
-    if (!hSession) {
-        std::cerr << "[Plex] Failed to open session" << std::endl;
-        return "";
-    }
-
-    HINTERNET hConnect = WinHttpConnect(hSession, hostName, urlComp.nPort, 0);
-    if (!hConnect) {
-        WinHttpCloseHandle(hSession);
-        std::cerr << "[Plex] Failed to connect" << std::endl;
-        return "";
-    }
-
-    DWORD flags = (urlComp.nScheme == INTERNET_SCHEME_HTTPS) ? WINHTTP_FLAG_SECURE : 0;
-    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", urlPath,
-        nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+std::vector<std::string> PlexClient::requestHeaders() const {
+    return {
+        "X-Plex-Token: " + token,
+        "Accept: application/json"
+    };
+}
 
-    if (!hRequest) {
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        std::cerr << "[Plex] Failed to open request" << std::endl;
-        return "";
-    }
+std::string PlexClient::httpGet(const std::string& path) {
+    HttpResponse response = httpRequest("GET", serverUrl + path, requestHeaders());
+    return responseBody(path, response);
+}
 
-    // Add headers
-    std::wstring tokenHeader = L"X-Plex-Token: " + std::wstring(token.begin(), token.end());
-    WinHttpAddRequestHeaders(hRequest, tokenHeader.c_str(), -1, WINHTTP_ADDREQ_FLAG_ADD);
-    WinHttpAddRequestHeaders(hRequest, L"Accept: application/json", -1, WINHTTP_ADDREQ_FLAG_ADD);
-
-    if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-        WINHTTP_NO_REQUEST_DATA, 0, 0, 0)) {
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        std::cerr << "[Plex] Failed to send request" << std::endl;
+std::string PlexClient::responseBody(const std::string& path, HttpResponse& response) {
+    if (response.status == 0) {
+        logWarning("Plex") << "Request failed: " << path;
         return "";
     }
-
-    if (!WinHttpReceiveResponse(hRequest, nullptr)) {
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        std::cerr << "[Plex] Failed to receive response" << std::endl;
+    if (!response.ok()) {
+        logWarning("Plex") << "HTTP " << response.status << " for " << path;
         return "";
     }
-
-    // Read response
-    DWORD bytesAvailable = 0;
-    DWORD bytesRead = 0;
-    while (WinHttpQueryDataAvailable(hRequest, &bytesAvailable) && bytesAvailable > 0) {
-        std::vector<char> buffer(bytesAvailable + 1);
-        if (WinHttpReadData(hRequest, buffer.data(), bytesAvailable, &bytesRead)) {
-            result.append(buffer.data(), bytesRead);
-        }
-    }
-
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-
-    return result;
-}
-#else
-std::string PlexClient::httpGet(const std::string& path) {
-    return "";
+    return std::move(response.body);
 }
-#endif
 
 bool PlexClient::testConnection() {
     std::string response = httpGet("/");
@@ -294,41 +198,133 @@ std::string PlexClient::extractImdbId(const std::string& jsonResponse, const std
     return "";
 }
 
+std::string PlexClient::fetchSessions() {
+    return httpGet("/status/sessions");
+}
+
+void PlexClient::fetchSessions(Reactor& reactor, std::function<void(std::string)> done) {
+    static const std::string path = "/status/sessions";
+    auto started = std::chrono::steady_clock::now();
+    httpRequestAsync(reactor, "GET", serverUrl + path, requestHeaders(), "",
+        [done = std::move(done), started](HttpResponse response) {
+            recordLatency(MetricStage::PlexFetch, std::chrono::steady_clock::now() - started);
+            traceSpan("plex", "fetch sessions", started, std::chrono::steady_clock::now(), "bytes",
+                static_cast<int64_t>(response.body.size()));
+            if (!response.ok()) {
+                recordFailure(MetricStage::PlexFetch);
+            }
+            done(responseBody(path, response));
+        });
+}
+
 std::optional<NowPlaying> PlexClient::getNowPlaying() {
-    std::string response = httpGet("/status/sessions");
-    if (response.empty()) {
+    auto nowPlaying = parseSessions(fetchSessions());
+    if (nowPlaying) {
+        enrichWithOmdb(*nowPlaying);
+    }
+    return nowPlaying;
+}
+
+static void applyOmdb(NowPlaying& np, const OmdbResult& omdb) {
+    if (!omdb.imdbId.empty() && !np.imdbId) {
+        np.imdbId = omdb.imdbId;
+    }
+    if (!omdb.posterUrl.empty()) {
+        np.posterUrl = omdb.posterUrl;
+    }
+    if (!omdb.imdbRating.empty()) {
+        np.imdbRating = omdb.imdbRating;
+    }
+    if (!omdb.rottenTomatoesRating.empty()) {
+        np.rottenTomatoesRating = omdb.rottenTomatoesRating;
+    }
+}
+
+// Query OMDB for IMDB ID and poster (for movies and shows only)
+static std::string omdbUrlFor(const NowPlaying& np) {
+    if (np.mediaType == MediaType::Track) {
+        return "";
+    }
+    std::string searchTitle = (np.mediaType == MediaType::Episode && np.grandparentTitle)
+        ? *np.grandparentTitle : np.title;
+    return omdbUrl(searchTitle, np.year.value_or(0), np.mediaType == MediaType::Episode);
+}
+
+void enrichWithOmdb(NowPlaying& np) {
+    std::string url = omdbUrlFor(np);
+    if (!url.empty()) {
+        applyOmdb(np, parseOmdb(httpRequest("GET", url)));
+    }
+}
+
+void lookupOmdb(Reactor& reactor, const NowPlayingSnapshot& media, std::function<void(OmdbResult)> done) {
+    std::string url;
+    if (media.mediaType() != MediaType::Track) {
+        bool isShow = media.mediaType() == MediaType::Episode;
+        std::string_view searchTitle = isShow && media.has(NowPlayingSnapshot::HAS_GRANDPARENT_TITLE)
+            ? media.grandparentTitle() : media.title();
+        url = omdbUrl(std::string(searchTitle), media.year(), isShow);
+    }
+    if (url.empty()) {
+        reactor.post([done = std::move(done)] { done(OmdbResult()); });
+        return;
+    }
+    auto started = std::chrono::steady_clock::now();
+    httpRequestAsync(reactor, "GET", url, {}, "",
+        [done = std::move(done), started](HttpResponse response) {
+            recordLatency(MetricStage::Omdb, std::chrono::steady_clock::now() - started);
+            traceSpan("omdb", "lookup", started, std::chrono::steady_clock::now(), "status", response.status);
+            if (!response.ok()) {
+                recordFailure(MetricStage::Omdb);
+            }
+            done(parseOmdb(response));
+        });
+}
+
+std::optional<NowPlaying> PlexClient::parseSessions(const std::string& response) const {
+    std::shared_ptr<const NowPlayingSnapshot> snapshot = parseSnapshot(response);
+    if (!snapshot) {
         return std::nullopt;
     }
+    return snapshot->toNowPlaying();
+}
 
+std::shared_ptr<const NowPlayingSnapshot> PlexClient::parseSnapshot(const std::string& response, CycleArena* arena) const {
+    if (response.empty()) {
+        return nullptr;
+    }
+
+    // The DOM and everything parsing it allocates come from the arena,
+    // and must be gone before the scope ends
+    ArenaScope arenaScope(arena);
     try {
-        auto j = json::parse(response);
+        ArenaJson j = ArenaJson::parse(response);
 
-        if (!j.contains("MediaContainer") || !j["MediaContainer"].contains("Metadata")) {
-            return std::nullopt;
+        auto container = j.find("MediaContainer");
+        if (container == j.end() || !container->contains("Metadata")) {
+            return nullptr;
         }
 
-        auto& metadataArray = j["MediaContainer"]["Metadata"];
+        const ArenaJson& metadataArray = (*container)["Metadata"];
         if (metadataArray.empty()) {
-            return std::nullopt;
+            return nullptr;
         }
 
         // Find the best session: prefer "playing" over others, take last in array
         // If filterUsername is set, only consider sessions for that user
-        const json* bestSession = nullptr;
+        const ArenaJson* bestSession = nullptr;
         for (auto it = metadataArray.rbegin(); it != metadataArray.rend(); ++it) {
             auto& item = *it;
 
             // Filter by username if configured
             if (!filterUsername.empty() && item.contains("User")) {
-                std::string sessionUser = item["User"].value("title", "");
-                if (sessionUser != filterUsername) {
+                if (stringField(item["User"], "title") != filterUsername) {
                     continue;  // Skip sessions from other users
                 }
             }
 
             if (item.contains("Player")) {
-                std::string state = item["Player"].value("state", "");
-                if (state == "playing") {
+                if (stringField(item["Player"], "state") == "playing") {
                     bestSession = &item;
                     break;
                 }
@@ -339,45 +335,47 @@ std::optional<NowPlaying> PlexClient::getNowPlaying() {
         }
 
         if (!bestSession) {
-            return std::nullopt;
+            return nullptr;
         }
 
         auto& item = *bestSession;
-        NowPlaying np;
+        NowPlayingSnapshot::Builder media;
 
         // Title
-        np.title = item.value("title", "Unknown");
+        media.title(stringField(item, "title", "Unknown"));
 
         // Media type
-        std::string type = item.value("type", "");
-        if (type == "movie") np.mediaType = MediaType::Movie;
-        else if (type == "episode") np.mediaType = MediaType::Episode;
-        else if (type == "track") np.mediaType = MediaType::Track;
+        std::string_view type = stringField(item, "type");
+        MediaType mediaType = MediaType::Unknown;
+        if (type == "movie") mediaType = MediaType::Movie;
+        else if (type == "episode") mediaType = MediaType::Episode;
+        else if (type == "track") mediaType = MediaType::Track;
+        media.mediaType(mediaType);
 
         // Player state
         if (item.contains("Player")) {
-            std::string state = item["Player"].value("state", "");
-            if (state == "playing") np.playerState = PlayerState::Playing;
-            else if (state == "paused") np.playerState = PlayerState::Paused;
-            else if (state == "buffering") np.playerState = PlayerState::Buffering;
+            std::string_view state = stringField(item["Player"], "state");
+            if (state == "playing") media.playerState(PlayerState::Playing);
+            else if (state == "paused") media.playerState(PlayerState::Paused);
+            else if (state == "buffering") media.playerState(PlayerState::Buffering);
         }
 
         // Optional fields
-        if (item.contains("year")) np.year = item["year"].get<int>();
-        if (item.contains("grandparentTitle")) np.grandparentTitle = item["grandparentTitle"].get<std::string>();
-        if (item.contains("parentTitle")) np.parentTitle = item["parentTitle"].get<std::string>();
-        if (item.contains("parentIndex")) np.seasonNumber = item["parentIndex"].get<int>();
-        if (item.contains("index")) np.episodeNumber = item["index"].get<int>();
+        if (item.contains("year")) media.year(item["year"].get<int>());
+        if (item.contains("grandparentTitle")) media.grandparentTitle(stringValue(item["grandparentTitle"]));
+        if (item.contains("parentTitle")) media.parentTitle(stringValue(item["parentTitle"]));
+        if (item.contains("parentIndex")) media.seasonNumber(item["parentIndex"].get<int>());
+        if (item.contains("index")) media.episodeNumber(item["index"].get<int>());
 
         // Duration and progress
-        np.durationMs = item.value("duration", 0);
-        np.progressMs = item.value("viewOffset", 0);
+        media.durationMs(item.value("duration", 0));
+        media.progressMs(item.value("viewOffset", 0));
 
         // Extract genres
         if (item.contains("Genre")) {
             for (auto& genre : item["Genre"]) {
                 if (genre.contains("tag")) {
-                    np.genres.push_back(genre["tag"].get<std::string>());
+                    media.addGenre(stringValue(genre["tag"]));
                 }
             }
         }
@@ -385,66 +383,47 @@ std::optional<NowPlaying> PlexClient::getNowPlaying() {
         // Extract IMDB ID from Guid array
         if (item.contains("Guid")) {
             for (auto& guid : item["Guid"]) {
-                std::string id = guid.value("id", "");
-                if (id.find("imdb://") == 0) {
-                    np.imdbId = id.substr(7);
+                std::string_view id = stringField(guid, "id");
+                if (id.compare(0, 7, "imdb://") == 0) {
+                    media.imdbId(id.substr(7));
                     break;
                 }
             }
         }
 
-        // Query OMDB for IMDB ID and poster (for movies and shows only)
-        if (np.mediaType != MediaType::Track) {
-            std::string searchTitle = (np.mediaType == MediaType::Episode && np.grandparentTitle)
-                ? *np.grandparentTitle : np.title;
-            int searchYear = np.year.value_or(0);
-            bool isShow = (np.mediaType == MediaType::Episode);
-
-            OmdbResult omdb = queryOmdb(searchTitle, searchYear, isShow);
-            if (!omdb.imdbId.empty() && !np.imdbId) {
-                np.imdbId = omdb.imdbId;
-            }
-            if (!omdb.posterUrl.empty()) {
-                np.posterUrl = omdb.posterUrl;
-            }
-            if (!omdb.imdbRating.empty()) {
-                np.imdbRating = omdb.imdbRating;
-            }
-            if (!omdb.rottenTomatoesRating.empty()) {
-                np.rottenTomatoesRating = omdb.rottenTomatoesRating;
-            }
-        }
-
         // Extract artwork URL - use grandparentArt for shows, art/thumb for movies
-        std::string artPath;
-        if (np.mediaType == MediaType::Episode && item.contains("grandparentArt")) {
-            artPath = item["grandparentArt"].get<std::string>();
-        } else if (np.mediaType == MediaType::Track) {
+        std::string_view artPath;
+        if (mediaType == MediaType::Episode && item.contains("grandparentArt")) {
+            artPath = stringValue(item["grandparentArt"]);
+        } else if (mediaType == MediaType::Track) {
             // For music, prefer parentThumb (album art)
             if (item.contains("parentThumb")) {
-                artPath = item["parentThumb"].get<std::string>();
+                artPath = stringValue(item["parentThumb"]);
             } else if (item.contains("grandparentThumb")) {
-                artPath = item["grandparentThumb"].get<std::string>();
+                artPath = stringValue(item["grandparentThumb"]);
             }
         } else if (item.contains("art")) {
-            artPath = item["art"].get<std::string>();
+            artPath = stringValue(item["art"]);
         } else if (item.contains("thumb")) {
-            artPath = item["thumb"].get<std::string>();
+            artPath = stringValue(item["thumb"]);
         }
 
         if (!artPath.empty()) {
-            np.artPath = artPath;
+            media.artPath(artPath);
         }
 
-        std::cout << "[Plex] Now playing: " << np.displayTitle()
-                  << " (" << np.stateText() << ")"
-                  << " IMDB: " << np.imdbId.value_or("none")
-                  << " Art: " << (np.artPath ? "yes" : "no") << std::endl;
-
-        return np;
+        // Copies out of the DOM before the arena goes
+        std::shared_ptr<const NowPlayingSnapshot> snapshot = media.build();
+        if (logEnabled(LogLevel::Debug)) {
+            logDebug("Plex") << "Now playing: " << snapshot->displayTitle()
+                             << " (" << snapshot->stateText() << ")"
+                             << " IMDB: " << (snapshot->has(NowPlayingSnapshot::HAS_IMDB_ID) ? snapshot->imdbId() : "none")
+                             << " Art: " << (snapshot->has(NowPlayingSnapshot::HAS_ART_PATH) ? "yes" : "no");
+        }
+        return snapshot;
 
     } catch (const std::exception& e) {
-        std::cerr << "[Plex] JSON parse error: " << e.what() << std::endl;
-        return std::nullopt;
+        logError("Plex") << "JSON parse error: " << e.what();
+        return nullptr;
     }
 }
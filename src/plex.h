@@ -1,10 +1,17 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <vector>
 #include <cstdint>
 
+class CycleArena;
+class NowPlayingSnapshot;
+class Reactor;
+struct HttpResponse;
+
 enum class MediaType {
     Movie,
     Episode,
@@ -41,18 +48,52 @@ struct NowPlaying {
     std::string stateText() const;
 };
 
+// What OMDB knows about a title; fields it didn't return are empty
+struct OmdbResult {
+    std::string imdbId;
+    std::string posterUrl;
+    std::string imdbRating;
+    std::string rottenTomatoesRating;
+};
+
 // Set OMDB API key for IMDB lookups
 void setOmdbApiKey(const std::string& apiKey);
+// Sends OMDB lookups somewhere other than www.omdbapi.com, e.g. a local stand-in
+void setOmdbBaseUrl(const std::string& baseUrl);
+
+// Fill in IMDB ID, poster and ratings from OMDB (movies and shows only)
+void enrichWithOmdb(NowPlaying& np);
+// Non-blocking OMDB lookup for media; done runs on the reactor thread, with
+// an empty result when OMDB is not configured or has nothing
+void lookupOmdb(Reactor& reactor, const NowPlayingSnapshot& media, std::function<void(OmdbResult)> done);
 
 class PlexClient {
 public:
     PlexClient(const std::string& serverUrl, const std::string& token, const std::string& username = "");
 
+    // Points later requests at another server or account; requests already
+    // out finish with the old one. Same thread as the requests.
+    void setServer(const std::string& serverUrl, const std::string& token, const std::string& username = "");
+
+    // Fetch, parse and enrich in one blocking call
     std::optional<NowPlaying> getNowPlaying();
     bool testConnection();
 
+    // The individual steps of getNowPlaying, for callers that run them separately
+    std::string fetchSessions();
+    std::optional<NowPlaying> parseSessions(const std::string& response) const;
+    // The session parseSessions picks, as a shareable snapshot; null when
+    // nothing is playing. The response's DOM is built in arena, if given,
+    // which the caller resets afterwards; otherwise on the heap.
+    std::shared_ptr<const NowPlayingSnapshot> parseSnapshot(const std::string& response,
+                                                            CycleArena* arena = nullptr) const;
+    // Non-blocking fetchSessions; done gets the body, or "" on failure
+    void fetchSessions(Reactor& reactor, std::function<void(std::string)> done);
+
 private:
     std::string httpGet(const std::string& path);
+    std::vector<std::string> requestHeaders() const;
+    static std::string responseBody(const std::string& path, HttpResponse& response);
     std::string extractImdbId(const std::string& jsonResponse, const std::string& ratingKey);
 
     std::string serverUrl;
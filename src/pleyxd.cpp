@@ -0,0 +1,290 @@
+// pleyxd: headless Pleyx. Runs the presence pipeline without the tray, GDI+
+// or a message loop and reports its own memory and CPU use.
+
+#include "alloc_stats.h"
+#include "config.h"
+#include "config_watcher.h"
+#include "plex.h"
+#include "discord.h"
+#include "http_client.h"
+#include "image_cache.h"
+#include "log.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "process_stats.h"
+#include "reactor.h"
+#include "session_capture.h"
+#include "status_server.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <pthread.h>
+#include <ctime>
+#endif
+
+static const char* DISCORD_CLIENT_ID = "1451961488427188355";
+
+using Clock = std::chrono::steady_clock;
+
+static void usage() {
+    std::cout <<
+        "Usage: pleyxd [options]\n"
+        "  --config PATH          Config file (default: the tray build's location)\n"
+        "  --stats-interval SECS  Report memory and CPU use every SECS seconds,\n"
+        "                         0 to only report at exit (default: 300)\n"
+        "  --metrics-port PORT    Serve Prometheus metrics on 127.0.0.1:PORT/metrics\n"
+        "                         (default: metrics_port from the config, 0 = off)\n"
+        "  --trace-file PATH      Where SIGUSR2 writes the Chrome trace\n"
+        "                         (default: pleyx-trace.json in the temp directory)\n"
+        "  --log-file PATH        Also log to PATH, rotated at log_file_max_kb\n"
+        "                         (default: log_file from the config)\n"
+        "  --capture PATH         Append every /status/sessions response to PATH\n"
+        "                         for tools/replay (default: capture_file from the config)\n";
+}
+
+// Logs resident memory, CPU use and context switches; the percentage and
+// the switch count are over the time since last
+static void reportResources(ProcessStats& last, Clock::time_point& lastAt) {
+    ProcessStats now = currentProcessStats();
+    Clock::time_point nowAt = Clock::now();
+    double wall = std::chrono::duration<double>(nowAt - lastAt).count();
+    double cpuPercent = wall > 0.0 ? (now.cpuSeconds - last.cpuSeconds) / wall * 100.0 : 0.0;
+
+    char line[224];
+    snprintf(line, sizeof(line), "rss=%.1f MB peak=%.1f MB cpu=%.2fs (%.3f%% over %.0fs) threads=%u ctxsw=%llu",
+        now.residentBytes / 1048576.0, now.peakResidentBytes / 1048576.0,
+        now.cpuSeconds, cpuPercent, wall, now.threads,
+        static_cast<unsigned long long>(now.contextSwitches - last.contextSwitches));
+    logInfo("Daemon") << line;
+
+    last = now;
+    lastAt = nowAt;
+}
+
+#ifdef _WIN32
+static HANDLE g_stopEvent = nullptr;
+
+static BOOL WINAPI consoleHandler(DWORD) {
+    SetEvent(g_stopEvent);
+    return TRUE;
+}
+#endif
+
+int main(int argc, char** argv) {
+    std::string configFile;
+    int statsIntervalSecs = 300;
+    int metricsPort = -1;
+    std::string traceFile;
+    std::string logFile;
+    std::string captureFile;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            configFile = argv[++i];
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            statsIntervalSecs = atoi(argv[++i]);
+        } else if (arg == "--log-file" && i + 1 < argc) {
+            logFile = argv[++i];
+        } else if (arg == "--capture" && i + 1 < argc) {
+            captureFile = argv[++i];
+        } else if (arg == "--trace-file" && i + 1 < argc) {
+            traceFile = argv[++i];
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metricsPort = atoi(argv[++i]);
+        } else {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 2;
+        }
+    }
+
+#ifdef _WIN32
+    g_stopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    SetConsoleCtrlHandler(consoleHandler, TRUE);
+#else
+    // Block the stop signals (and SIGUSR1, refresh now, and SIGUSR2, dump
+    // the trace) before any thread starts, the log writer included, so only
+    // the main thread's sigtimedwait receives them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    Config config = configFile.empty() ? Config::load() : Config::load(configFile);
+    markStartup(StartupPhase::ConfigLoaded);
+    if (config.debug) {
+        setLogLevel(LogLevel::Debug);
+    }
+    // Files named in the config are relative to it
+    std::filesystem::path configDir = (configFile.empty() ? Config::configPath() : std::filesystem::u8path(configFile)).parent_path();
+    if (logFile.empty() && !config.logFile.empty()) {
+        logFile = (configDir / std::filesystem::u8path(config.logFile)).u8string();
+    }
+    if (captureFile.empty() && !config.captureFile.empty()) {
+        captureFile = (configDir / std::filesystem::u8path(config.captureFile)).u8string();
+    }
+    if (!logFile.empty() && !setLogFile(logFile, static_cast<uint64_t>(config.logFileMaxKb) * 1024)) {
+        logWarning("Daemon") << "Cannot open log file " << logFile;
+    }
+    if (config.plexToken.empty() || config.plexToken == "YOUR_PLEX_TOKEN_HERE") {
+        logError("Daemon") << "Set plex_token in "
+                           << (configFile.empty() ? Config::configPath().string() : configFile);
+        return 1;
+    }
+
+    // Plex is probed by the pipeline's first poll rather than a blocking
+    // request here; it retries until the server answers
+    PlexClient plex(config.plexUrl, config.plexToken, config.plexUsername);
+
+    if (!config.omdbApiKey.empty()) {
+        setOmdbApiKey(config.omdbApiKey);
+    }
+
+    // All network I/O (Plex, OMDB, catbox and Discord IPC) runs on this one
+    // reactor thread; the main thread only waits for signals
+    Reactor reactor;
+    std::thread ioThread([&reactor] { reactor.run(); });
+
+    // The Discord handshake runs on the I/O thread while the art cache is
+    // read here, and the first poll goes out right after
+    Discord discord(DISCORD_CLIENT_ID, reactor);
+    discord.connect();
+    ImageCache imageCache(config.plexUrl, config.plexToken);
+    imageCache.useCacheFile(reactor, (configDir / "art-cache.json").u8string());
+    markStartup(StartupPhase::CacheLoaded);
+
+    SessionCaptureWriter capture;
+    Pipeline pipeline(reactor, plex, discord, imageCache, config.pollingIntervalSecs, PresenceFormatter(config));
+    if (!captureFile.empty()) {
+        if (capture.open(captureFile)) {
+            logInfo("Daemon") << "Recording sessions to " << captureFile;
+            pipeline.setResponseObserver([&capture](const std::string& response) { capture.record(response); });
+        } else {
+            logWarning("Daemon") << "Cannot open capture file " << captureFile;
+        }
+    }
+    // Edits to the config file apply to the running pipeline
+    ConfigStore configStore(config);
+    pipeline.followConfig(configStore);
+    ConfigWatcher configWatcher(reactor, configStore,
+        configFile.empty() ? Config::configPath() : std::filesystem::u8path(configFile));
+    configWatcher.start([&pipeline](const Config& previous, const Config& next) {
+        if (next.debug != previous.debug) {
+            setLogLevel(next.debug ? LogLevel::Debug : LogLevel::Info);
+        }
+        pipeline.configChanged();
+    });
+    pipeline.start([](const PresenceUpdate& update) {
+        if (update.tooltip) {
+            logDebug("Daemon") << *update.tooltip;
+        }
+    });
+
+    StatusServer status(reactor, pipeline, discord);
+    status.setAllowedOrigin(config.statusAllowOrigin);
+    if (metricsPort < 0) {
+        metricsPort = config.metricsPort;
+    }
+    if (metricsPort > 0 && metricsPort <= 65535) {
+        status.start(static_cast<uint16_t>(metricsPort));
+    }
+    logInfo("Daemon") << "Running";
+
+    ProcessStats lastStats = currentProcessStats();
+    Clock::time_point lastStatsAt = Clock::now();
+
+    // The main thread only sleeps here, waking for the resource report
+    for (;;) {
+#ifdef _WIN32
+        DWORD timeout = statsIntervalSecs > 0 ? static_cast<DWORD>(statsIntervalSecs) * 1000 : INFINITE;
+        if (WaitForSingleObject(g_stopEvent, timeout) == WAIT_OBJECT_0) {
+            break;
+        }
+#else
+        int signo;
+        if (statsIntervalSecs > 0) {
+            timespec timeout = {statsIntervalSecs, 0};
+            signo = sigtimedwait(&signals, nullptr, &timeout);
+        } else {
+            signo = sigwaitinfo(&signals, nullptr);
+        }
+        if (signo == SIGUSR1) {
+            pipeline.refreshNow();
+            continue;
+        }
+        if (signo == SIGUSR2) {
+            if (traceFile.empty()) {
+                std::error_code ec;
+                traceFile = (std::filesystem::temp_directory_path(ec) / "pleyx-trace.json").string();
+            }
+            if (writeChromeTrace(traceFile)) {
+                logInfo("Daemon") << "Wrote trace to " << traceFile;
+            } else {
+                logError("Daemon") << "Failed to write trace to " << traceFile;
+            }
+            continue;
+        }
+        if (signo > 0) {
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+#endif
+        reportResources(lastStats, lastStatsAt);
+    }
+
+    logInfo("Daemon") << "Stopping";
+    configWatcher.stop();
+    pipeline.stop();
+    status.stop();
+    discord.disconnect();
+    reactor.stop();
+    ioThread.join();
+    imageCache.flush();
+
+    PipelineStats stats = pipeline.stats();
+    logInfo("Daemon") << "Cycles fetched=" << stats.fetched << " published=" << stats.published
+                      << " superseded=" << stats.superseded << " omdb_lookups=" << stats.omdbLookups
+                      << " refreshes=" << stats.refreshes;
+    TlsStats tls = tlsStats();
+    logInfo("Daemon") << "TLS handshakes full=" << tls.fullHandshakes << " resumed=" << tls.resumedHandshakes
+                      << " failed=" << tls.failedHandshakes;
+    ReactorStats loop = reactor.stats();
+    logInfo("Daemon") << "Reactor wakeups=" << loop.wakeups << " io_events=" << loop.ioEvents
+                      << " tasks=" << loop.tasks << " timers=" << loop.timersFired;
+    if (allocStatsEnabled()) {
+        LogLine line = logInfo("Daemon");
+        line << "Allocations";
+        for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); i++) {
+            AllocTag tag = static_cast<AllocTag>(i);
+            AllocTotals totals = allocTotals(tag);
+            line << " " << allocTagName(tag) << "=" << totals.count << "/" << totals.bytes << "B";
+        }
+    }
+    reportResources(lastStats, lastStatsAt);
+    shutdownLogging();
+
+#ifdef _WIN32
+    CloseHandle(g_stopEvent);
+#endif
+    return 0;
+}
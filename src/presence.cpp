@@ -0,0 +1,105 @@
+#include "presence.h"
+#include "config.h"
+#include "log.h"
+
+bool shouldShowPresence(const NowPlayingSnapshot& media) {
+    return (media.playerState() == PlayerState::Playing) ||
+        (media.playerState() == PlayerState::Paused && media.mediaType() != MediaType::Track);
+}
+
+// Built-in templates: the presence as Pleyx has always shown it
+static const PresenceTemplateConfig DEFAULT_EPISODE = {
+    "[{paused}(Paused) ]{show|TV Show}",
+    "[S{season:02}E{episode:02} \xE2\x80\xA2 ]{title}",
+    "{show|Watching TV}"
+};
+static const PresenceTemplateConfig DEFAULT_MOVIE = {
+    "[{paused}(Paused) ]{title}[ ({year})]",
+    "[{imdb_rating}][ \xE2\x80\xA2 |{rt_rating}][ \xE2\x80\xA2 |{genres}]||{player_state}",
+    "{title}"
+};
+static const PresenceTemplateConfig DEFAULT_TRACK = {
+    "{title}",
+    "{genre|Music}",
+    "{artist|Unknown Artist} - {album|Unknown Album}"
+};
+static const PresenceTemplateConfig DEFAULT_OTHER = {
+    "{title}[ ({year})]",
+    "{player_state}",
+    "Plex"
+};
+
+static PresenceTemplate compileTemplate(const std::string& configured, const std::string& fallback,
+                                        const char* name) {
+    std::string error;
+    if (!configured.empty()) {
+        if (auto compiled = PresenceTemplate::compile(configured, &error)) {
+            return std::move(*compiled);
+        }
+        logWarning("Presence") << "Invalid template " << name << " (" << error << "), using the default";
+    }
+    return PresenceTemplate::compile(fallback).value_or(PresenceTemplate());
+}
+
+PresenceFormatter::PresenceFormatter() : PresenceFormatter(Config()) {}
+
+PresenceFormatter::PresenceFormatter(const Config& config) {
+    auto compileSet = [](Templates& out, const PresenceTemplateConfig& configured,
+                         const PresenceTemplateConfig& defaults, const std::string& type) {
+        out.details = compileTemplate(configured.details, defaults.details, (type + ".details").c_str());
+        out.state = compileTemplate(configured.state, defaults.state, (type + ".state").c_str());
+        out.largeText = compileTemplate(configured.largeText, defaults.largeText, (type + ".large_text").c_str());
+    };
+    compileSet(episode, config.episodeTemplates, DEFAULT_EPISODE, "episode");
+    compileSet(movie, config.movieTemplates, DEFAULT_MOVIE, "movie");
+    compileSet(track, config.trackTemplates, DEFAULT_TRACK, "track");
+    compileSet(other, PresenceTemplateConfig(), DEFAULT_OTHER, "other");
+}
+
+void PresenceFormatter::build(const NowPlayingSnapshot& media, const std::string& artUrl, MediaInfo& info) const {
+    info.isPlaying = (media.playerState() == PlayerState::Playing);
+    info.durationMs = media.durationMs();
+    info.progressMs = media.progressMs();
+    if (media.has(NowPlayingSnapshot::HAS_IMDB_ID)) {
+        if (!info.imdbId) info.imdbId.emplace();
+        info.imdbId->assign(media.imdbId());
+    } else {
+        info.imdbId.reset();
+    }
+
+    // Set activity type and fallback artwork based on media type
+    const Templates* templates = &other;
+    const char* fallbackImage = "plex";
+    switch (media.mediaType()) {
+        case MediaType::Episode:
+            templates = &episode;
+            info.activityType = ActivityType::Watching;
+            fallbackImage = "tv";
+            break;
+        case MediaType::Movie:
+            templates = &movie;
+            info.activityType = ActivityType::Watching;
+            fallbackImage = "movie";
+            break;
+        case MediaType::Track:
+            templates = &track;
+            info.activityType = ActivityType::Listening;
+            fallbackImage = "music";
+            break;
+        default:
+            info.activityType = ActivityType::Playing;
+            break;
+    }
+    if (artUrl.empty() || media.mediaType() == MediaType::Unknown) {
+        info.largeImage = fallbackImage;
+    } else {
+        info.largeImage = artUrl;
+    }
+
+    info.details.clear();
+    templates->details.render(media, info.details);
+    info.state.clear();
+    templates->state.render(media, info.state);
+    info.largeText.clear();
+    templates->largeText.render(media, info.largeText);
+}
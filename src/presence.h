@@ -0,0 +1,37 @@
+#pragma once
+
+#include "now_playing_snapshot.h"
+#include "plex.h"
+#include "discord.h"
+#include "presence_template.h"
+#include <string>
+
+struct Config;
+
+// Show presence when playing, or when paused for movies/shows (but not music)
+bool shouldShowPresence(const NowPlayingSnapshot& media);
+
+// Builds the Discord activity from templates compiled once at load
+class PresenceFormatter {
+public:
+    // The built-in templates
+    PresenceFormatter();
+    // Templates from config; empty or invalid ones keep the built-in default
+    explicit PresenceFormatter(const Config& config);
+
+    // Fills info for media, reusing its string buffers; artUrl is empty
+    // when no artwork is available
+    void build(const NowPlayingSnapshot& media, const std::string& artUrl, MediaInfo& info) const;
+
+private:
+    struct Templates {
+        PresenceTemplate details;
+        PresenceTemplate state;
+        PresenceTemplate largeText;
+    };
+
+    Templates episode;
+    Templates movie;
+    Templates track;
+    Templates other;
+};
@@ -0,0 +1,337 @@
+#include "presence_template.h"
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+enum Field : uint8_t {
+    TITLE,
+    SHOW,
+    ARTIST,
+    ALBUM,
+    SEASON,
+    EPISODE,
+    YEAR,
+    IMDB_RATING,
+    RT_RATING,
+    GENRES,
+    GENRE,
+    PLAYER_STATE,
+    PAUSED,
+    FIELD_COUNT
+};
+
+const char* const FIELD_NAMES[FIELD_COUNT] = {
+    "title", "show", "artist", "album", "season", "episode", "year",
+    "imdb_rating", "rt_rating", "genres", "genre", "player_state", "paused"
+};
+
+const int MAX_WIDTH = 64;
+
+// Bit per field that has a value for media; sections test against it.
+// Unset texts are empty, so emptiness covers both.
+uint32_t presentFields(const NowPlayingSnapshot& media) {
+    uint32_t present = (1u << PLAYER_STATE);
+    if (!media.title().empty()) present |= 1u << TITLE;
+    if (!media.grandparentTitle().empty()) present |= (1u << SHOW) | (1u << ARTIST);
+    if (!media.parentTitle().empty()) present |= 1u << ALBUM;
+    if (media.has(NowPlayingSnapshot::HAS_SEASON)) present |= 1u << SEASON;
+    if (media.has(NowPlayingSnapshot::HAS_EPISODE)) present |= 1u << EPISODE;
+    if (media.has(NowPlayingSnapshot::HAS_YEAR)) present |= 1u << YEAR;
+    if (!media.imdbRating().empty()) present |= 1u << IMDB_RATING;
+    if (!media.rottenTomatoesRating().empty()) present |= 1u << RT_RATING;
+    if (!media.genres().empty()) present |= (1u << GENRES) | (1u << GENRE);
+    if (media.playerState() == PlayerState::Paused) present |= 1u << PAUSED;
+    return present;
+}
+
+const char* playerStateText(PlayerState state) {
+    switch (state) {
+        case PlayerState::Playing: return "Playing";
+        case PlayerState::Paused: return "Paused";
+        case PlayerState::Buffering: return "Buffering";
+        default: return "Stopped";
+    }
+}
+
+void appendNumber(std::string& out, int value) {
+    char buf[16];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+// Appends a field known to have a value
+void appendValue(std::string& out, uint8_t field, const NowPlayingSnapshot& media) {
+    switch (field) {
+        case TITLE: out += media.title(); break;
+        case SHOW:
+        case ARTIST: out += media.grandparentTitle(); break;
+        case ALBUM: out += media.parentTitle(); break;
+        case SEASON: appendNumber(out, media.seasonNumber()); break;
+        case EPISODE: appendNumber(out, media.episodeNumber()); break;
+        case YEAR: appendNumber(out, media.year()); break;
+        case IMDB_RATING: out += media.imdbRating(); break;
+        case RT_RATING: out += media.rottenTomatoesRating(); break;
+        case GENRES:
+            for (size_t i = 0; i < media.genres().size(); i++) {
+                if (i > 0) out += ", ";
+                out += media.genres()[i];
+            }
+            break;
+        case GENRE: out += media.genres().front(); break;
+        case PLAYER_STATE: out += playerStateText(media.playerState()); break;
+        default: break;  // Flags render nothing
+    }
+}
+
+}  // namespace
+
+class PresenceTemplate::Compiler {
+public:
+    Compiler(const std::string& source, PresenceTemplate& out) : source(source), out(out) {}
+
+    bool run(std::string& error) {
+        while (true) {
+            size_t alternative = out.ops.size();
+            out.ops.push_back(Op{OpKind::Alternative});
+            uint32_t required = 0;
+            if (!sequence(0, required)) {
+                error = message + " at offset " + std::to_string(pos);
+                return false;
+            }
+            out.ops[alternative].next = static_cast<uint32_t>(out.ops.size());
+            if (pos >= source.size()) {
+                return true;
+            }
+            pos += 2;  // "||"
+        }
+    }
+
+private:
+    bool fail(const std::string& text) {
+        message = text;
+        return false;
+    }
+
+    // Next character of literal text, resolving escapes; false at the end
+    bool literalChar(char& c) {
+        if (source[pos] == '\\') {
+            if (pos + 1 >= source.size()) {
+                return fail("dangling '\\'");
+            }
+            pos++;
+        }
+        c = source[pos++];
+        return true;
+    }
+
+    void flushLiteral() {
+        if (pending.empty()) {
+            return;
+        }
+        Op op{OpKind::Literal};
+        op.offset = static_cast<uint32_t>(out.literals.size());
+        op.length = static_cast<uint32_t>(pending.size());
+        out.literals += pending;
+        out.ops.push_back(op);
+        pending.clear();
+    }
+
+    // Tokens up to the end, the closing ']' of a section or a top-level "||"
+    bool sequence(int depth, uint32_t& required) {
+        while (pos < source.size()) {
+            char c = source[pos];
+            if (depth == 0 && c == '|' && pos + 1 < source.size() && source[pos + 1] == '|') {
+                break;
+            }
+            if (c == ']') {
+                if (depth == 0) {
+                    return fail("unmatched ']'");
+                }
+                flushLiteral();
+                return true;
+            }
+            if (c == '}') {
+                return fail("unmatched '}'");
+            }
+            if (c == '{') {
+                flushLiteral();
+                if (!field(required)) {
+                    return false;
+                }
+            } else if (c == '[') {
+                flushLiteral();
+                if (!section(depth)) {
+                    return false;
+                }
+            } else {
+                if (!literalChar(c)) {
+                    return false;
+                }
+                pending += c;
+            }
+        }
+        if (depth > 0) {
+            return fail("unclosed '['");
+        }
+        flushLiteral();
+        return true;
+    }
+
+    bool section(int depth) {
+        pos++;  // '['
+        size_t index = out.ops.size();
+        out.ops.push_back(Op{OpKind::Section});
+
+        // Leading text up to a '|' is the separator
+        size_t start = pos;
+        std::string separator;
+        while (pos < source.size() && !strchr("|{}[]", source[pos])) {
+            char c;
+            if (!literalChar(c)) {
+                return false;
+            }
+            separator += c;
+        }
+        if (pos < source.size() && source[pos] == '|') {
+            pos++;
+            out.ops[index].offset = static_cast<uint32_t>(out.literals.size());
+            out.ops[index].length = static_cast<uint32_t>(separator.size());
+            out.literals += separator;
+        } else {
+            pos = start;
+        }
+
+        uint32_t required = 0;
+        if (!sequence(depth + 1, required)) {
+            return false;
+        }
+        pos++;  // ']'
+        out.ops[index].required = required;
+        out.ops[index].next = static_cast<uint32_t>(out.ops.size());
+        return true;
+    }
+
+    bool field(uint32_t& required) {
+        pos++;  // '{'
+        size_t nameStart = pos;
+        while (pos < source.size() && (islower(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) {
+            pos++;
+        }
+        std::string name = source.substr(nameStart, pos - nameStart);
+        Op op{OpKind::Field};
+        op.field = FIELD_COUNT;
+        for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+            if (name == FIELD_NAMES[i]) op.field = i;
+        }
+        if (op.field == FIELD_COUNT) {
+            return fail("unknown field '" + name + "'");
+        }
+
+        if (pos < source.size() && source[pos] == ':') {
+            pos++;
+            op.zeroPad = pos < source.size() && source[pos] == '0';
+            int width = 0;
+            size_t digits = pos;
+            while (pos < source.size() && isdigit(static_cast<unsigned char>(source[pos])) && width <= MAX_WIDTH) {
+                width = width * 10 + (source[pos++] - '0');
+            }
+            if (pos == digits || width > MAX_WIDTH) {
+                return fail("bad width for '" + name + "'");
+            }
+            op.width = static_cast<uint8_t>(width);
+        }
+
+        bool hasFallback = false;
+        if (pos < source.size() && source[pos] == '|') {
+            pos++;
+            hasFallback = true;
+            std::string fallback;
+            while (pos < source.size() && source[pos] != '}') {
+                char c;
+                if (!literalChar(c)) {
+                    return false;
+                }
+                fallback += c;
+            }
+            op.offset = static_cast<uint32_t>(out.literals.size());
+            op.length = static_cast<uint32_t>(fallback.size());
+            out.literals += fallback;
+        }
+
+        if (pos >= source.size() || source[pos] != '}') {
+            return fail("expected '}' after '" + name + "'");
+        }
+        pos++;
+        // A fallback stands in for a missing value, so it never hides a section
+        if (!hasFallback) {
+            required |= 1u << op.field;
+        }
+        out.ops.push_back(op);
+        return true;
+    }
+
+    const std::string& source;
+    PresenceTemplate& out;
+    size_t pos = 0;
+    std::string pending;
+    std::string message;
+};
+
+std::optional<PresenceTemplate> PresenceTemplate::compile(const std::string& source, std::string* error) {
+    PresenceTemplate result;
+    result.text = source;
+    std::string message;
+    if (!Compiler(source, result).run(message)) {
+        if (error) *error = message;
+        return std::nullopt;
+    }
+    result.literals.shrink_to_fit();
+    result.ops.shrink_to_fit();
+    return result;
+}
+
+void PresenceTemplate::render(const NowPlayingSnapshot& media, std::string& out) const {
+    uint32_t present = presentFields(media);
+
+    for (size_t alternative = 0; alternative < ops.size(); alternative = ops[alternative].next) {
+        size_t start = out.size();
+        size_t end = ops[alternative].next;
+        for (size_t i = alternative + 1; i < end;) {
+            const Op& op = ops[i];
+            switch (op.kind) {
+                case OpKind::Section:
+                    if (op.required & ~present) {
+                        i = op.next;
+                        continue;
+                    }
+                    if (op.length && out.size() > start) {
+                        out.append(literals, op.offset, op.length);
+                    }
+                    break;
+                case OpKind::Literal:
+                    out.append(literals, op.offset, op.length);
+                    break;
+                case OpKind::Field:
+                    if (present & (1u << op.field)) {
+                        size_t mark = out.size();
+                        appendValue(out, op.field, media);
+                        size_t written = out.size() - mark;
+                        if (written < op.width) {
+                            out.insert(mark, op.width - written, op.zeroPad ? '0' : ' ');
+                        }
+                    } else {
+                        out.append(literals, op.offset, op.length);
+                    }
+                    break;
+                case OpKind::Alternative:
+                    break;
+            }
+            i++;
+        }
+        if (out.size() > start) {
+            return;
+        }
+    }
+}
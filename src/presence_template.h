@@ -0,0 +1,63 @@
+#pragma once
+
+#include "now_playing_snapshot.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A presence text template compiled once into a flat token program, so a
+// poll cycle only walks the tokens and appends to a reused buffer.
+//
+//   {field}          the field's text; {season:02} pads to a width with
+//                    zeros, {season:2} with spaces
+//   {field|text}     text when the field is empty
+//   [...]            an optional section, left out unless every field in
+//                    it (outside nested sections) has a value
+//   [sep|...]        sep goes before the section only when something
+//                    precedes it in the output
+//   a||b             the first alternative that renders non-empty
+//   \{ \} \[ \] \|   literal characters
+//
+// Fields: title, show, artist, album, season, episode, year, imdb_rating,
+// rt_rating, genres (comma separated), genre (the first one), player_state
+// and paused, which renders nothing but only has a value while paused.
+class PresenceTemplate {
+public:
+    // Renders nothing
+    PresenceTemplate() = default;
+
+    // Nullopt on a syntax error or unknown field, described in error
+    static std::optional<PresenceTemplate> compile(const std::string& source, std::string* error = nullptr);
+
+    // Appends the text for media to out
+    void render(const NowPlayingSnapshot& media, std::string& out) const;
+
+    const std::string& source() const { return text; }
+
+private:
+    enum class OpKind : uint8_t {
+        Alternative,  // next: the following alternative (or the end)
+        Section,      // next: just past the section's tokens
+        Literal,
+        Field
+    };
+
+    struct Op {
+        OpKind kind;
+        uint8_t field = 0;
+        uint8_t width = 0;
+        bool zeroPad = false;
+        uint32_t required = 0;  // Section: fields that must have a value
+        uint32_t next = 0;
+        // Slice of literals: the text, a field's fallback or a section's separator
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    class Compiler;
+
+    std::string text;
+    std::vector<Op> ops;
+    std::string literals;
+};
@@ -0,0 +1,97 @@
+#include "process_stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+static double fileTimeSeconds(const FILETIME& ft) {
+    ULARGE_INTEGER value;
+    value.LowPart = ft.dwLowDateTime;
+    value.HighPart = ft.dwHighDateTime;
+    return static_cast<double>(value.QuadPart) / 1e7;  // 100ns units
+}
+
+ProcessStats currentProcessStats() {
+    ProcessStats stats;
+    PROCESS_MEMORY_COUNTERS counters = {0};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        stats.residentBytes = counters.WorkingSetSize;
+        stats.peakResidentBytes = counters.PeakWorkingSetSize;
+    }
+
+    FILETIME created, exited, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        stats.cpuSeconds = fileTimeSeconds(kernel) + fileTimeSeconds(user);
+    }
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot != INVALID_HANDLE_VALUE) {
+        THREADENTRY32 entry = {0};
+        entry.dwSize = sizeof(entry);
+        DWORD pid = GetCurrentProcessId();
+        for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry)) {
+            if (entry.th32OwnerProcessID == pid) {
+                stats.threads++;
+            }
+        }
+        CloseHandle(snapshot);
+    }
+    return stats;
+}
+
+#else
+
+ProcessStats currentProcessStats() {
+    ProcessStats stats;
+
+    // Second field of statm is the resident set in pages
+    if (FILE* statm = fopen("/proc/self/statm", "r")) {
+        unsigned long long size = 0, resident = 0;
+        if (fscanf(statm, "%llu %llu", &size, &resident) == 2) {
+            stats.residentBytes = resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        }
+        fclose(statm);
+    }
+
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        stats.peakResidentBytes = static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        stats.peakResidentBytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+        stats.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+            usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+        // RUSAGE_SELF sums every thread of the process
+        stats.contextSwitches = static_cast<uint64_t>(usage.ru_nvcsw) + static_cast<uint64_t>(usage.ru_nivcsw);
+    }
+
+    if (FILE* status = fopen("/proc/self/status", "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), status)) {
+            if (strncmp(line, "Threads:", 8) == 0) {
+                stats.threads = static_cast<uint32_t>(strtoul(line + 8, nullptr, 10));
+                break;
+            }
+        }
+        fclose(status);
+    }
+    // ru_maxrss is only sampled by the kernel now and then
+    if (stats.peakResidentBytes < stats.residentBytes) {
+        stats.peakResidentBytes = stats.residentBytes;
+    }
+    return stats;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+struct ProcessStats {
+    uint64_t residentBytes = 0;
+    uint64_t peakResidentBytes = 0;
+    double cpuSeconds = 0.0;  // User + kernel time since start
+    uint32_t threads = 0;
+    uint64_t contextSwitches = 0;  // Voluntary + involuntary; 0 on Windows
+};
+
+// Resident memory, CPU time and threads of the current process
+ProcessStats currentProcessStats();
@@ -0,0 +1,346 @@
+#include "reactor.h"
+#include "log.h"
+#include "trace.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#endif
+
+static const int MAX_EVENTS = 64;
+
+Reactor::~Reactor() {
+    {
+        std::lock_guard<std::mutex> lock(selfHandle->mutex);
+        selfHandle->reactor = nullptr;
+    }
+
+    // Release callbacks first; their captures may still cancel or unwatch
+    timers.clear();
+#ifndef _WIN32
+    std::unordered_map<int, Watch> remaining;
+    remaining.swap(watches);
+    remaining.clear();
+#endif
+#ifdef _WIN32
+    if (port) CloseHandle(port);
+#else
+    if (pollFd >= 0) close(pollFd);
+    if (wakeFds[0] >= 0) close(wakeFds[0]);
+    if (wakeFds[1] >= 0 && wakeFds[1] != wakeFds[0]) close(wakeFds[1]);
+#endif
+}
+
+bool Reactor::inReactorThread() const {
+    return threadId.load() == std::this_thread::get_id();
+}
+
+void Reactor::stop() {
+    stopping = true;
+    wake();
+}
+
+void Reactor::post(Task task) {
+    bool needWake;
+    {
+        std::lock_guard<std::mutex> lock(postMutex);
+        posted.push_back(std::move(task));
+        needWake = !wakePending;
+        wakePending = true;
+    }
+    if (needWake) {
+        wake();
+    }
+}
+
+bool Reactor::Handle::post(Task task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!reactor) {
+        return false;
+    }
+    reactor->post(std::move(task));
+    return true;
+}
+
+void Reactor::runPosted() {
+    {
+        std::lock_guard<std::mutex> lock(postMutex);
+        running.swap(posted);
+        wakePending = false;
+    }
+    for (auto& task : running) {
+        task();
+    }
+    if (!running.empty()) {
+        ReactorStats delta;
+        delta.tasks = running.size();
+        count(delta);
+    }
+    running.clear();
+}
+
+Reactor::TimerId Reactor::runAt(Clock::time_point deadline, Task task) {
+    return timers.schedule(deadline, std::move(task));
+}
+
+void Reactor::cancelTimer(TimerId id) {
+    timers.cancel(id);
+}
+
+bool Reactor::rescheduleTimer(TimerId id, Clock::time_point deadline) {
+    return timers.reschedule(id, deadline);
+}
+
+void Reactor::runTimers() {
+    uint64_t fired = timers.advance(Clock::now());
+    if (fired) {
+        ReactorStats delta;
+        delta.timersFired = fired;
+        count(delta);
+    }
+}
+
+int Reactor::nextTimeoutMs() {
+    auto deadline = timers.nextDeadline();
+    if (!deadline) {
+        return -1;
+    }
+    auto wait = *deadline - Clock::now();
+    if (wait <= Clock::duration::zero()) {
+        return 0;
+    }
+    // Round up so the timer is due when the wait returns
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+}
+
+void Reactor::count(const ReactorStats& delta) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    statsData.wakeups += delta.wakeups;
+    statsData.ioEvents += delta.ioEvents;
+    statsData.tasks += delta.tasks;
+    statsData.timersFired += delta.timersFired;
+}
+
+ReactorStats Reactor::stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return statsData;
+}
+
+#ifdef _WIN32
+
+static const ULONG_PTR WAKE_KEY = 1;
+
+Reactor::Reactor() {
+    selfHandle->reactor = this;
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (!port) {
+        logError("Reactor") << "CreateIoCompletionPort failed: " << GetLastError();
+    }
+}
+
+void Reactor::wake() {
+    PostQueuedCompletionStatus(port, 0, WAKE_KEY, nullptr);
+}
+
+bool Reactor::associate(HANDLE handle) {
+    return CreateIoCompletionPort(handle, port, 0, 0) != nullptr;
+}
+
+void Reactor::run() {
+    threadId = std::this_thread::get_id();
+    traceThreadName("reactor");
+    while (true) {
+        runPosted();
+        runTimers();
+        if (stopping) {
+            break;
+        }
+
+        int timeoutMs = nextTimeoutMs();
+        DWORD timeout = timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs);
+        ReactorStats delta;
+        delta.wakeups = 1;
+
+        // Block for the first completion, then drain whatever else is queued
+        for (int i = 0; i < MAX_EVENTS; i++) {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            LPOVERLAPPED overlapped = nullptr;
+            BOOL ok = GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, i == 0 ? timeout : 0);
+            if (!overlapped) {
+                // Timeout, or a wake-up posted by post()/stop()
+                if (!ok || key != WAKE_KEY) break;
+                continue;
+            }
+            DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+            auto* operation = static_cast<Operation*>(overlapped);
+            auto complete = std::move(operation->complete);
+            if (complete) {
+                complete(bytes, error);
+            }
+            delta.ioEvents++;
+        }
+        count(delta);
+    }
+    threadId = std::thread::id();
+}
+
+#else
+
+Reactor::Reactor() {
+    selfHandle->reactor = this;
+#ifdef __linux__
+    pollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFds[0] = wakeFds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pollFd >= 0 && wakeFds[0] >= 0) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = static_cast<uint64_t>(wakeFds[0]);  // Generation 0
+        epoll_ctl(pollFd, EPOLL_CTL_ADD, wakeFds[0], &event);
+    } else {
+        logError("Reactor") << "Failed to create epoll instance";
+    }
+#else
+    if (pipe(wakeFds) == 0) {
+        for (int fd : wakeFds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+#endif
+}
+
+void Reactor::wake() {
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t written = write(wakeFds[1], &one, sizeof(one));
+#else
+    char one = 1;
+    ssize_t written = write(wakeFds[1], &one, 1);
+#endif
+    (void)written;  // A full pipe or counter already means a pending wake-up
+}
+
+#ifdef __linux__
+static uint32_t toEpoll(uint32_t events) {
+    return ((events & Reactor::READABLE) ? EPOLLIN : 0u) | ((events & Reactor::WRITABLE) ? EPOLLOUT : 0u);
+}
+#endif
+
+bool Reactor::watch(int fd, uint32_t events, IoHandler handler) {
+    uint32_t generation = nextGeneration++;
+    if (nextGeneration == 0) nextGeneration = 1;  // 0 marks the wake-up fd
+#ifdef __linux__
+    epoll_event event = {};
+    event.events = toEpoll(events);
+    event.data.u64 = (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    if (epoll_ctl(pollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return false;
+    }
+#endif
+    watches[fd] = Watch{events, generation, std::make_shared<IoHandler>(std::move(handler))};
+    return true;
+}
+
+void Reactor::modify(int fd, uint32_t events) {
+    auto it = watches.find(fd);
+    if (it == watches.end() || it->second.events == events) {
+        return;
+    }
+    it->second.events = events;
+#ifdef __linux__
+    epoll_event event = {};
+    event.events = toEpoll(events);
+    event.data.u64 = (static_cast<uint64_t>(it->second.generation) << 32) | static_cast<uint32_t>(fd);
+    epoll_ctl(pollFd, EPOLL_CTL_MOD, fd, &event);
+#endif
+}
+
+void Reactor::unwatch(int fd) {
+    if (watches.erase(fd)) {
+#ifdef __linux__
+        epoll_ctl(pollFd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+    }
+}
+
+void Reactor::dispatch(int fd, uint32_t generation, uint32_t events) {
+    auto it = watches.find(fd);
+    if (it == watches.end() || it->second.generation != generation) {
+        return;  // Unwatched (or the fd was reused) earlier in this batch
+    }
+    std::shared_ptr<IoHandler> handler = it->second.handler;
+    (*handler)(events);
+}
+
+void Reactor::run() {
+    threadId = std::this_thread::get_id();
+    traceThreadName("reactor");
+    while (true) {
+        runPosted();
+        runTimers();
+        if (stopping) {
+            break;
+        }
+
+        int timeoutMs = nextTimeoutMs();
+        ReactorStats delta;
+        delta.wakeups = 1;
+
+#ifdef __linux__
+        epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(pollFd, events, MAX_EVENTS, timeoutMs);
+        for (int i = 0; i < n; i++) {
+            uint64_t data = events[i].data.u64;
+            uint32_t generation = static_cast<uint32_t>(data >> 32);
+            int fd = static_cast<int>(data & 0xffffffffu);
+            if (generation == 0) {
+                uint64_t counter;
+                ssize_t drained = read(wakeFds[0], &counter, sizeof(counter));
+                (void)drained;
+                continue;
+            }
+            uint32_t ready = 0;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) ready |= READABLE;
+            if (events[i].events & EPOLLOUT) ready |= WRITABLE;
+            dispatch(fd, generation, ready);
+            delta.ioEvents++;
+        }
+#else
+        std::vector<pollfd> fds;
+        std::vector<uint32_t> generations;
+        fds.push_back(pollfd{wakeFds[0], POLLIN, 0});
+        generations.push_back(0);
+        for (auto& entry : watches) {
+            short interest = ((entry.second.events & READABLE) ? POLLIN : 0) |
+                ((entry.second.events & WRITABLE) ? POLLOUT : 0);
+            fds.push_back(pollfd{entry.first, interest, 0});
+            generations.push_back(entry.second.generation);
+        }
+        int n = poll(fds.data(), fds.size(), timeoutMs);
+        for (size_t i = 0; n > 0 && i < fds.size(); i++) {
+            if (!fds[i].revents) continue;
+            if (i == 0) {
+                char buffer[64];
+                while (read(wakeFds[0], buffer, sizeof(buffer)) > 0) {}
+                continue;
+            }
+            uint32_t ready = 0;
+            if (fds[i].revents & (POLLIN | POLLERR | POLLHUP)) ready |= READABLE;
+            if (fds[i].revents & POLLOUT) ready |= WRITABLE;
+            dispatch(fds[i].fd, generations[i], ready);
+            delta.ioEvents++;
+        }
+#endif
+        count(delta);
+    }
+    threadId = std::thread::id();
+}
+
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "timer_wheel.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+struct ReactorStats {
+    uint64_t wakeups = 0;      // Returns from the OS wait
+    uint64_t ioEvents = 0;     // Readiness events / I/O completions dispatched
+    uint64_t tasks = 0;        // Posted tasks run
+    uint64_t timersFired = 0;
+};
+
+// Single-threaded event loop for all network I/O: epoll on Linux, poll()
+// on other POSIX systems and an I/O completion port on Windows. Every
+// callback runs on the thread inside run(); post() and stop() may be
+// called from any thread, everything else only from the reactor thread.
+class Reactor {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+    using TimerId = TimerWheel::TimerId;
+
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // Dispatches events until stop()
+    void run();
+    void stop();
+    bool inReactorThread() const;
+
+    // Runs task on the reactor thread
+    void post(Task task);
+
+    // For threads that may outlive the reactor (WinHttp callbacks): posts
+    // through the handle are dropped once the reactor is destroyed
+    class Handle {
+    public:
+        bool post(Task task);
+
+    private:
+        friend class Reactor;
+        std::mutex mutex;
+        Reactor* reactor = nullptr;
+    };
+    std::shared_ptr<Handle> handle() const { return selfHandle; }
+
+    TimerId runAt(Clock::time_point deadline, Task task);
+    TimerId runAfter(Clock::duration delay, Task task) { return runAt(Clock::now() + delay, std::move(task)); }
+    void cancelTimer(TimerId id);
+    // Moves a pending timer; false if it already fired or was cancelled
+    bool rescheduleTimer(TimerId id, Clock::time_point deadline);
+
+    ReactorStats stats() const;
+
+#ifdef _WIN32
+    // An overlapped operation; complete runs on the reactor thread with the
+    // byte count and ERROR_SUCCESS or the failure code. Keep the operation
+    // alive until complete has run, including after CancelIoEx.
+    struct Operation : OVERLAPPED {
+        Operation() : OVERLAPPED() {}
+        std::function<void(DWORD bytes, DWORD error)> complete;
+    };
+
+    // Routes the completions of an overlapped handle to this reactor
+    bool associate(HANDLE handle);
+#else
+    enum : uint32_t {
+        READABLE = 1,
+        WRITABLE = 2
+    };
+    // events: the readiness that fired, plus READABLE on error or hangup
+    using IoHandler = std::function<void(uint32_t events)>;
+
+    bool watch(int fd, uint32_t events, IoHandler handler);
+    void modify(int fd, uint32_t events);
+    // Safe to call from inside the fd's own handler
+    void unwatch(int fd);
+#endif
+
+private:
+    int nextTimeoutMs();
+    void runTimers();
+    void runPosted();
+    void wake();
+    void count(const ReactorStats& delta);
+
+    std::shared_ptr<Handle> selfHandle{std::make_shared<Handle>()};
+    std::atomic<bool> stopping{false};
+    std::atomic<std::thread::id> threadId{};
+
+    std::mutex postMutex;
+    std::vector<Task> posted;
+    bool wakePending = false;  // Guarded by postMutex; coalesces wake() calls
+    std::vector<Task> running;  // Reactor thread; swapped with posted so both keep their capacity
+
+    TimerWheel timers;
+
+    mutable std::mutex statsMutex;
+    ReactorStats statsData;
+
+#ifdef _WIN32
+    HANDLE port{nullptr};
+#else
+    struct Watch {
+        uint32_t events;
+        uint32_t generation;                  // Tells a reused fd from the one an event was for
+        std::shared_ptr<IoHandler> handler;   // Shared so a handler can unwatch itself
+    };
+    void dispatch(int fd, uint32_t generation, uint32_t events);
+
+    int pollFd{-1};          // epoll instance (Linux)
+    int wakeFds[2]{-1, -1};  // eventfd on Linux (both ends equal), a pipe elsewhere
+    uint32_t nextGeneration = 1;
+    std::unordered_map<int, Watch> watches;
+#endif
+};
@@ -0,0 +1,139 @@
+#include "session_capture.h"
+#include "log.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+static const char MAGIC[] = "PLXCAP1\n";
+static const size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+static const uint8_t KIND_BODY = 0;
+static const uint8_t KIND_REPEAT = 1;
+static const uint64_t MAX_BODY = 64 * 1024 * 1024;
+
+static void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static bool readVarint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == std::char_traits<char>::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SessionCaptureWriter::open(const std::string& path) {
+    std::filesystem::path fsPath = std::filesystem::u8path(path);
+    std::error_code ec;
+    uint64_t size = std::filesystem::exists(fsPath, ec) ? std::filesystem::file_size(fsPath, ec) : 0;
+    if (size > 0) {
+        SessionCaptureReader reader;
+        if (!reader.open(path)) {
+            logError("Capture") << path << " is not a session capture";
+            return false;
+        }
+        CapturedResponse response;
+        while (reader.next(response)) {
+        }
+        if (reader.validBytes() < size) {
+            logWarning("Capture") << "Dropping " << (size - reader.validBytes())
+                                  << " damaged bytes at the end of " << path;
+            std::filesystem::resize_file(fsPath, reader.validBytes(), ec);
+            if (ec) {
+                return false;
+            }
+        }
+    }
+
+    file.open(fsPath, std::ios::binary | std::ios::app);
+    if (!file) {
+        return false;
+    }
+    if (size == 0) {
+        file.write(MAGIC, MAGIC_SIZE);
+        file.flush();
+    }
+    haveLast = false;
+    return static_cast<bool>(file);
+}
+
+void SessionCaptureWriter::record(const std::string& body) {
+    if (!file.is_open()) {
+        return;
+    }
+    int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::string head;
+    bool repeat = haveLast && body == lastBody;
+    head += static_cast<char>(repeat ? KIND_REPEAT : KIND_BODY);
+    appendVarint(head, static_cast<uint64_t>(nowUs));
+    if (!repeat) {
+        appendVarint(head, body.size());
+    }
+    file.write(head.data(), static_cast<std::streamsize>(head.size()));
+    if (!repeat) {
+        file.write(body.data(), static_cast<std::streamsize>(body.size()));
+        lastBody = body;
+        haveLast = true;
+    }
+    file.flush();
+    if (!file) {
+        logError("Capture") << "Write failed, recording stopped";
+        file.close();
+    }
+}
+
+bool SessionCaptureReader::open(const std::string& path) {
+    file.open(std::filesystem::u8path(path), std::ios::binary);
+    char magic[MAGIC_SIZE];
+    if (!file.read(magic, MAGIC_SIZE) || memcmp(magic, MAGIC, MAGIC_SIZE) != 0) {
+        file.close();
+        return false;
+    }
+    goodOffset = MAGIC_SIZE;
+    corrupt = false;
+    lastBody.clear();
+    return true;
+}
+
+bool SessionCaptureReader::next(CapturedResponse& out) {
+    if (!file.is_open() || corrupt) {
+        return false;
+    }
+    int kind = file.get();
+    if (kind == std::char_traits<char>::eof()) {
+        return false;
+    }
+
+    uint64_t arrivedUs;
+    uint64_t length = 0;
+    bool ok = (kind == KIND_BODY || kind == KIND_REPEAT) && readVarint(file, arrivedUs);
+    if (ok && kind == KIND_BODY) {
+        ok = readVarint(file, length) && length <= MAX_BODY;
+        if (ok) {
+            lastBody.resize(static_cast<size_t>(length));
+            ok = length == 0 || static_cast<bool>(file.read(&lastBody[0], static_cast<std::streamsize>(length)));
+        }
+    }
+    if (!ok) {
+        corrupt = true;
+        return false;
+    }
+
+    goodOffset = static_cast<uint64_t>(file.tellg());
+    out.arrivedUs = static_cast<int64_t>(arrivedUs);
+    out.body = lastBody;
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Capture files hold every /status/sessions response the pipeline saw, in
+// order, for replaying later (tools/replay). The layout is append-only:
+//
+//     "PLXCAP1\n"                         once, at the start
+//     u8 kind, varint arrival time        per response, in microseconds
+//     [varint length, body]               since the Unix epoch
+//
+// kind 0 carries a body; kind 1 repeats the one before it, which is most
+// polls while nothing is playing. A failed fetch is an empty body.
+struct CapturedResponse {
+    int64_t arrivedUs = 0;
+    std::string body;
+};
+
+class SessionCaptureWriter {
+public:
+    // Appends to path, creating it if needed; a record cut short by a
+    // crash is dropped first. False if the file can't be opened or isn't
+    // a capture.
+    bool open(const std::string& path);
+    bool isOpen() const { return file.is_open(); }
+    // Writes and flushes one response, stamped with the current time
+    void record(const std::string& body);
+
+private:
+    std::ofstream file;
+    std::string lastBody;
+    bool haveLast = false;
+};
+
+class SessionCaptureReader {
+public:
+    bool open(const std::string& path);
+    // The next response; false at the end or at a damaged record
+    bool next(CapturedResponse& out);
+    // Where the last good record ends, and whether anything followed it
+    uint64_t validBytes() const { return goodOffset; }
+    bool damaged() const { return corrupt; }
+
+private:
+    std::ifstream file;
+    std::string lastBody;
+    uint64_t goodOffset = 0;
+    bool corrupt = false;
+};
@@ -0,0 +1,682 @@
+#include "status_server.h"
+#include "alloc_stats.h"
+#include "discord.h"
+#include "http_client.h"
+#include "log.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "process_stats.h"
+#include "trace.h"
+#include <future>
+#include <vector>
+
+#ifdef _WIN32
+#include <mswsock.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+static const size_t MAX_REQUEST = 16 * 1024;
+static const auto REQUEST_TIMEOUT = std::chrono::seconds(5);
+// Event streams beyond this are turned away
+static const uint32_t MAX_STREAMS = 64;
+// A comment line on idle streams, so proxies keep them open and clients
+// that went away are noticed
+static const auto KEEP_ALIVE_INTERVAL = std::chrono::seconds(15);
+
+struct StatusServer::Connection {
+    uint64_t id = 0;
+    std::string in;
+    std::string out;  // The response, or an event stream's header
+    size_t sent = 0;
+    bool writing = false;  // A write is in flight or waiting for the socket
+    Reactor::TimerId timeout = 0;
+
+    // Event streams: the event being written, straight from the shared
+    // state, and the newest one behind it. A slow reader skips the states
+    // it had no time for rather than queueing them.
+    bool streaming = false;
+    uint64_t listener = 0;
+    std::shared_ptr<const NowPlayingState> sending;
+    std::shared_ptr<const NowPlayingState> pending;
+
+    // The bytes still to write: out, then each event in turn; empty once
+    // everything is written
+    std::string_view unsent() {
+        while (true) {
+            const std::string& buffer = sending ? sending->event : out;
+            if (sent < buffer.size()) {
+                return std::string_view(buffer).substr(sent);
+            }
+            sent = 0;
+            if (sending) {
+                sending.reset();
+            } else {
+                out.clear();
+            }
+            if (!pending) {
+                return {};
+            }
+            sending = std::move(pending);
+        }
+    }
+#ifdef _WIN32
+    SOCKET socket = INVALID_SOCKET;
+    bool closed = false;
+    Reactor::Operation readOp;
+    Reactor::Operation writeOp;
+    char buffer[4096];
+#else
+    int fd = -1;
+#endif
+};
+
+StatusServer::StatusServer(Reactor& reactor, Pipeline& pipeline, Discord& discord)
+    : reactor(reactor), pipeline(pipeline), discord(discord) {}
+
+StatusServer::~StatusServer() {
+    stop();
+}
+
+void StatusServer::setAllowedOrigin(std::string origin) {
+    allowedOrigin = std::move(origin);
+}
+
+void StatusServer::stop() {
+    if (!listening) {
+        return;
+    }
+    listening = false;
+    if (reactor.inReactorThread()) {
+        halt();
+    } else {
+        std::promise<void> done;
+        reactor.post([&] {
+            halt();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+// Drops every connection mid-request; clients simply see the socket close
+void StatusServer::halt() {
+    lifetime.reset();
+    streamWritesPosted = false;
+    std::vector<uint64_t> open;
+    for (auto& entry : connections) {
+        open.push_back(entry.first);
+    }
+    for (uint64_t id : open) {
+        closeConnection(id);
+    }
+#ifdef _WIN32
+    closesocket(listenSocket);  // Aborts the AcceptEx in flight
+    listenSocket = INVALID_SOCKET;
+    if (winsockStarted) {
+        WSACleanup();
+        winsockStarted = false;
+    }
+#else
+    reactor.unwatch(listenFd);
+    close(listenFd);
+    listenFd = -1;
+#endif
+}
+
+void StatusServer::received(const std::shared_ptr<Connection>& connection) {
+    if (connection->streaming) {
+        // Nothing more is expected from a stream's client; keep reading
+        // only to notice when it goes away
+        connection->in.clear();
+#ifdef _WIN32
+        startRead(connection);
+#endif
+        return;
+    }
+    if (connection->in.find("\r\n\r\n") == std::string::npos && connection->in.size() < MAX_REQUEST) {
+#ifdef _WIN32
+        startRead(connection);
+#endif
+        return;
+    }
+    bool stream = false;
+    connection->out = respond(connection->in, &stream);
+    if (stream) {
+        startStream(connection);
+    }
+    startWrite(connection);
+}
+
+// The stream starts with the current state; each change after that is
+// handed to every stream as the same shared event
+void StatusServer::startStream(const std::shared_ptr<Connection>& connection) {
+    uint64_t id = connection->id;
+    connection->streaming = true;
+    connection->in.clear();
+    openStreams++;
+    reactor.cancelTimer(connection->timeout);
+    connection->timeout = reactor.runAfter(KEEP_ALIVE_INTERVAL, [this, id] { keepAlive(id); });
+
+    NowPlayingFeed& feed = pipeline.nowPlaying();
+    connection->pending = feed.current();
+    // Runs inside the pipeline's cycle, so it only queues the state; the
+    // writes happen once the cycle is done
+    connection->listener = feed.subscribe([this, id](const std::shared_ptr<const NowPlayingState>& state) {
+        auto it = connections.find(id);
+        if (it == connections.end()) {
+            return;
+        }
+        it->second->pending = state;
+        scheduleStreamWrites();
+    });
+#ifdef _WIN32
+    startRead(connection);
+#endif
+}
+
+// One task writes to every stream with a state waiting
+void StatusServer::scheduleStreamWrites() {
+    if (streamWritesPosted) {
+        return;
+    }
+    streamWritesPosted = true;
+    std::weak_ptr<bool> alive = lifetime;
+    reactor.post([this, alive] {
+        if (alive.expired()) {
+            return;
+        }
+        streamWritesPosted = false;
+        // A failed write closes its connection and so changes the map
+        std::vector<std::shared_ptr<Connection>> ready;
+        for (auto& entry : connections) {
+            if (entry.second->streaming && entry.second->pending && !entry.second->writing) {
+                ready.push_back(entry.second);
+            }
+        }
+        for (const auto& connection : ready) {
+            startWrite(connection);
+        }
+    });
+}
+
+void StatusServer::keepAlive(uint64_t id) {
+    static const auto KEEP_ALIVE = std::make_shared<const NowPlayingState>(NowPlayingState{0, "", ": keep-alive\n\n"});
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+    std::shared_ptr<Connection> connection = it->second;
+    connection->timeout = reactor.runAfter(KEEP_ALIVE_INTERVAL, [this, id] { keepAlive(id); });
+    if (!connection->writing && !connection->pending) {
+        connection->pending = KEEP_ALIVE;
+        startWrite(connection);
+    }
+}
+
+// Sets *startStream when the connection should stay open as an event
+// stream after the returned header
+std::string StatusServer::respond(const std::string& request, bool* startStream) const {
+    size_t methodEnd = request.find(' ');
+    size_t pathEnd = methodEnd == std::string::npos ? std::string::npos : request.find(' ', methodEnd + 1);
+    std::string method = request.substr(0, methodEnd);
+    std::string path = pathEnd == std::string::npos ? "" : request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+    path = path.substr(0, path.find('?'));
+
+    int status = 200;
+    const char* reason = "OK";
+    const char* contentType = "text/plain; charset=utf-8";
+    std::string body;
+    bool nowPlaying = path == "/now-playing" || path == "/now-playing/events";
+    if (pathEnd == std::string::npos) {
+        status = 400;
+        reason = "Bad Request";
+    } else if (method != "GET" && method != "HEAD") {
+        status = 405;
+        reason = "Method Not Allowed";
+    } else if (path == "/metrics") {
+        contentType = "text/plain; version=0.0.4; charset=utf-8";
+        body = metricsText();
+    } else if (path == "/trace") {
+        contentType = "application/json";
+        body = chromeTraceJson();
+    } else if (path == "/now-playing") {
+        contentType = "application/json";
+        body = pipeline.nowPlaying().current()->json;
+    } else if (path == "/now-playing/events") {
+        if (openStreams >= MAX_STREAMS) {
+            status = 503;
+            reason = "Service Unavailable";
+            body = "Too many event streams\n";
+        } else {
+            contentType = "text/event-stream";
+            *startStream = method == "GET";
+        }
+    } else {
+        status = 404;
+        reason = "Not Found";
+        body = "Try /metrics, /trace, /now-playing or /now-playing/events\n";
+    }
+
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n"
+        "Content-Type: " + contentType + "\r\n";
+    // An event stream runs until either side closes it
+    if (!*startStream) {
+        response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    if (nowPlaying && !allowedOrigin.empty()) {
+        response += "Access-Control-Allow-Origin: " + allowedOrigin + "\r\n";
+    }
+    response += "Cache-Control: no-store\r\n"
+        "Connection: close\r\n\r\n";
+    if (method != "HEAD") {
+        response += body;
+    }
+    return response;
+}
+
+std::string StatusServer::metricsText() const {
+    std::string out;
+    out.reserve(8192);
+    appendStageMetrics(out);
+
+    PipelineStats cycles = pipeline.stats();
+    appendMetricFamily(out, "pleyx_cycles_total", "counter", "Poll cycles through each pipeline stage.");
+    appendMetricSample(out, "pleyx_cycles_total", "stage=\"fetched\"", static_cast<double>(cycles.fetched));
+    appendMetricSample(out, "pleyx_cycles_total", "stage=\"parsed\"", static_cast<double>(cycles.parsed));
+    appendMetricSample(out, "pleyx_cycles_total", "stage=\"enriched\"", static_cast<double>(cycles.enriched));
+    appendMetricSample(out, "pleyx_cycles_total", "stage=\"rendered\"", static_cast<double>(cycles.rendered));
+    appendMetricSample(out, "pleyx_cycles_total", "stage=\"published\"", static_cast<double>(cycles.published));
+    appendMetricFamily(out, "pleyx_cycles_superseded_total", "counter", "Cycles dropped for a newer one.");
+    appendMetricSample(out, "pleyx_cycles_superseded_total", "", static_cast<double>(cycles.superseded));
+    appendMetricFamily(out, "pleyx_omdb_lookups_total", "counter", "OMDB lookups, one per new title.");
+    appendMetricSample(out, "pleyx_omdb_lookups_total", "", static_cast<double>(cycles.omdbLookups));
+    appendMetricFamily(out, "pleyx_refreshes_total", "counter", "Polls brought forward on request.");
+    appendMetricSample(out, "pleyx_refreshes_total", "", static_cast<double>(cycles.refreshes));
+    appendMetricFamily(out, "pleyx_now_playing_version", "counter", "Changes to the /now-playing state.");
+    appendMetricSample(out, "pleyx_now_playing_version", "",
+        static_cast<double>(pipeline.nowPlaying().current()->version));
+    appendMetricFamily(out, "pleyx_now_playing_streams", "gauge", "Open /now-playing/events streams.");
+    appendMetricSample(out, "pleyx_now_playing_streams", "", static_cast<double>(openStreams.load()));
+
+    IpcStats ipc = discord.stats();
+    appendMetricFamily(out, "pleyx_discord_requests_total", "counter", "Discord IPC requests by outcome.");
+    appendMetricSample(out, "pleyx_discord_requests_total", "result=\"sent\"", static_cast<double>(ipc.requests));
+    appendMetricSample(out, "pleyx_discord_requests_total", "result=\"answered\"", static_cast<double>(ipc.responses));
+    appendMetricSample(out, "pleyx_discord_requests_total", "result=\"error\"", static_cast<double>(ipc.failures));
+    appendMetricSample(out, "pleyx_discord_requests_total", "result=\"timeout\"", static_cast<double>(ipc.timeouts));
+    appendMetricFamily(out, "pleyx_discord_connects_total", "counter", "Discord IPC connection attempts by outcome.");
+    appendMetricSample(out, "pleyx_discord_connects_total", "result=\"ok\"", static_cast<double>(ipc.connects));
+    appendMetricSample(out, "pleyx_discord_connects_total", "result=\"failed\"", static_cast<double>(ipc.connectFailures));
+    appendMetricSample(out, "pleyx_discord_connects_total", "result=\"dead\"", static_cast<double>(ipc.deadConnections));
+
+    TlsStats tls = tlsStats();
+    appendMetricFamily(out, "pleyx_tls_handshakes_total", "counter", "TLS handshakes by kind.");
+    appendMetricSample(out, "pleyx_tls_handshakes_total", "kind=\"full\"", static_cast<double>(tls.fullHandshakes));
+    appendMetricSample(out, "pleyx_tls_handshakes_total", "kind=\"resumed\"", static_cast<double>(tls.resumedHandshakes));
+    appendMetricSample(out, "pleyx_tls_handshakes_total", "kind=\"failed\"", static_cast<double>(tls.failedHandshakes));
+
+    ReactorStats loop = reactor.stats();
+    appendMetricFamily(out, "pleyx_reactor_wakeups_total", "counter", "Returns from the reactor's OS wait.");
+    appendMetricSample(out, "pleyx_reactor_wakeups_total", "", static_cast<double>(loop.wakeups));
+    appendMetricFamily(out, "pleyx_reactor_dispatches_total", "counter", "Callbacks run by the reactor.");
+    appendMetricSample(out, "pleyx_reactor_dispatches_total", "kind=\"io\"", static_cast<double>(loop.ioEvents));
+    appendMetricSample(out, "pleyx_reactor_dispatches_total", "kind=\"task\"", static_cast<double>(loop.tasks));
+    appendMetricSample(out, "pleyx_reactor_dispatches_total", "kind=\"timer\"", static_cast<double>(loop.timersFired));
+
+    if (allocStatsEnabled()) {
+        appendMetricFamily(out, "pleyx_allocations_total", "counter", "Heap allocations by pipeline stage.");
+        for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); i++) {
+            AllocTag tag = static_cast<AllocTag>(i);
+            appendMetricSample(out, "pleyx_allocations_total", std::string("stage=\"") + allocTagName(tag) + "\"",
+                static_cast<double>(allocTotals(tag).count));
+        }
+        appendMetricFamily(out, "pleyx_allocated_bytes_total", "counter", "Heap bytes allocated by pipeline stage.");
+        for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); i++) {
+            AllocTag tag = static_cast<AllocTag>(i);
+            appendMetricSample(out, "pleyx_allocated_bytes_total", std::string("stage=\"") + allocTagName(tag) + "\"",
+                static_cast<double>(allocTotals(tag).bytes));
+        }
+    }
+
+    ProcessStats process = currentProcessStats();
+    appendMetricFamily(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+    appendMetricSample(out, "process_resident_memory_bytes", "", static_cast<double>(process.residentBytes));
+    appendMetricFamily(out, "process_cpu_seconds_total", "counter", "User and system CPU time in seconds.");
+    appendMetricSample(out, "process_cpu_seconds_total", "", process.cpuSeconds);
+    appendMetricFamily(out, "process_threads", "gauge", "Threads in the process.");
+    appendMetricSample(out, "process_threads", "", static_cast<double>(process.threads));
+    return out;
+}
+
+#ifdef _WIN32
+
+struct StatusServer::Accept {
+    SOCKET socket = INVALID_SOCKET;
+    Reactor::Operation op;
+    char addresses[2 * (sizeof(sockaddr_in) + 16)];
+};
+
+bool StatusServer::start(uint16_t port) {
+    if (listening) {
+        return true;
+    }
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        logError("Status") << "WSAStartup failed";
+        return false;
+    }
+    winsockStarted = true;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int addrLen = sizeof(addr);
+    listenSocket = WSASocketW(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+    if (listenSocket == INVALID_SOCKET ||
+        bind(listenSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listenSocket, 16) != 0 ||
+        getsockname(listenSocket, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        logError("Status") << "Failed to listen on port " << port << ": " << WSAGetLastError();
+        if (listenSocket != INVALID_SOCKET) closesocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+        WSACleanup();
+        winsockStarted = false;
+        return false;
+    }
+    boundPort = ntohs(addr.sin_port);
+
+    lifetime = std::make_shared<bool>(true);
+    listening = true;
+    reactor.post([this] {
+        if (!reactor.associate(reinterpret_cast<HANDLE>(listenSocket)) || !startAccept()) {
+            logError("Status") << "Failed to accept connections: " << WSAGetLastError();
+        }
+    });
+    logInfo("Status") << "Serving http://127.0.0.1:" << boundPort << "/metrics";
+    return true;
+}
+
+// Keeps one AcceptEx outstanding; its completion adopts the socket and
+// issues the next
+bool StatusServer::startAccept() {
+    auto accept = std::make_shared<Accept>();
+    accept->socket = WSASocketW(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+    if (accept->socket == INVALID_SOCKET) {
+        return false;
+    }
+    std::weak_ptr<bool> alive = lifetime;
+    accept->op.complete = [this, accept, alive](DWORD, DWORD error) {
+        if (alive.expired() || error != ERROR_SUCCESS) {
+            closesocket(accept->socket);
+            if (!alive.expired() && !startAccept()) {
+                logError("Status") << "Failed to accept connections: " << WSAGetLastError();
+            }
+            return;
+        }
+        setsockopt(accept->socket, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+            reinterpret_cast<const char*>(&listenSocket), sizeof(listenSocket));
+
+        auto connection = std::make_shared<Connection>();
+        connection->id = nextConnection++;
+        connection->socket = accept->socket;
+        if (reactor.associate(reinterpret_cast<HANDLE>(connection->socket))) {
+            uint64_t id = connection->id;
+            connections[id] = connection;
+            connection->timeout = reactor.runAfter(REQUEST_TIMEOUT, [this, id] { closeConnection(id); });
+            startRead(connection);
+        } else {
+            closesocket(connection->socket);
+        }
+        if (!startAccept()) {
+            logError("Status") << "Failed to accept connections: " << WSAGetLastError();
+        }
+    };
+
+    DWORD received = 0;
+    if (!AcceptEx(listenSocket, accept->socket, accept->addresses, 0,
+                  sizeof(sockaddr_in) + 16, sizeof(sockaddr_in) + 16, &received, &accept->op) &&
+        WSAGetLastError() != ERROR_IO_PENDING) {
+        accept->op.complete = nullptr;
+        closesocket(accept->socket);
+        return false;
+    }
+    return true;
+}
+
+void StatusServer::startRead(const std::shared_ptr<Connection>& connection) {
+    std::weak_ptr<bool> alive = lifetime;
+    static_cast<OVERLAPPED&>(connection->readOp) = OVERLAPPED();
+    connection->readOp.complete = [this, connection, alive](DWORD bytes, DWORD error) {
+        if (alive.expired() || connection->closed) {
+            return;
+        }
+        if (error != ERROR_SUCCESS || bytes == 0) {
+            closeConnection(connection->id);
+            return;
+        }
+        connection->in.append(connection->buffer, bytes);
+        received(connection);
+    };
+
+    WSABUF buffer{static_cast<ULONG>(sizeof(connection->buffer)), connection->buffer};
+    DWORD flags = 0;
+    if (WSARecv(connection->socket, &buffer, 1, nullptr, &flags, &connection->readOp, nullptr) != 0 &&
+        WSAGetLastError() != WSA_IO_PENDING) {
+        connection->readOp.complete = nullptr;
+        closeConnection(connection->id);
+    }
+}
+
+void StatusServer::startWrite(const std::shared_ptr<Connection>& connection) {
+    std::weak_ptr<bool> alive = lifetime;
+    static_cast<OVERLAPPED&>(connection->writeOp) = OVERLAPPED();
+    connection->writeOp.complete = [this, connection, alive](DWORD bytes, DWORD error) {
+        if (alive.expired() || connection->closed) {
+            return;
+        }
+        if (error != ERROR_SUCCESS || bytes == 0) {
+            closeConnection(connection->id);
+            return;
+        }
+        connection->sent += bytes;
+        startWrite(connection);
+    };
+
+    std::string_view data = connection->unsent();
+    if (data.empty()) {
+        // An event stream waits for the next change
+        connection->writeOp.complete = nullptr;
+        connection->writing = false;
+        if (!connection->streaming) {
+            closeConnection(connection->id);
+        }
+        return;
+    }
+    connection->writing = true;
+    WSABUF buffer{static_cast<ULONG>(data.size()), const_cast<char*>(data.data())};
+    if (WSASend(connection->socket, &buffer, 1, nullptr, 0, &connection->writeOp, nullptr) != 0 &&
+        WSAGetLastError() != WSA_IO_PENDING) {
+        connection->writeOp.complete = nullptr;
+        closeConnection(connection->id);
+    }
+}
+
+// Operations still in flight complete aborted and find the connection closed
+void StatusServer::closeConnection(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+    std::shared_ptr<Connection> connection = it->second;
+    connections.erase(it);
+    reactor.cancelTimer(connection->timeout);
+    if (connection->streaming) {
+        pipeline.nowPlaying().unsubscribe(connection->listener);
+        openStreams--;
+    }
+    connection->closed = true;
+    closesocket(connection->socket);
+}
+
+#else
+
+bool StatusServer::start(uint16_t port) {
+    if (listening) {
+        return true;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    if (listenFd >= 0) {
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+        fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+    }
+    if (listenFd < 0 ||
+        bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listenFd, 16) != 0 ||
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        logError("Status") << "Failed to listen on port " << port << ": " << strerror(errno);
+        if (listenFd >= 0) close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    boundPort = ntohs(addr.sin_port);
+
+    lifetime = std::make_shared<bool>(true);
+    listening = true;
+    reactor.post([this] {
+        reactor.watch(listenFd, Reactor::READABLE, [this](uint32_t) { listenReady(); });
+    });
+    logInfo("Status") << "Serving http://127.0.0.1:" << boundPort << "/metrics";
+    return true;
+}
+
+void StatusServer::listenReady() {
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            return;  // EAGAIN, or an error the next readiness retries
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        auto connection = std::make_shared<Connection>();
+        uint64_t id = nextConnection++;
+        connection->id = id;
+        connection->fd = fd;
+        connections[id] = connection;
+        connection->timeout = reactor.runAfter(REQUEST_TIMEOUT, [this, id] { closeConnection(id); });
+
+        reactor.watch(fd, Reactor::READABLE, [this, id](uint32_t events) {
+            auto it = connections.find(id);
+            if (it == connections.end()) {
+                return;
+            }
+            std::shared_ptr<Connection> connection = it->second;
+            if (connection->streaming) {
+                // Reads only notice the client going away; what it sends is dropped
+                char buffer[512];
+                while (events & Reactor::READABLE) {
+                    ssize_t n = recv(connection->fd, buffer, sizeof(buffer), 0);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    }
+                    if (n <= 0) {
+                        closeConnection(id);
+                        return;
+                    }
+                }
+                if ((events & Reactor::WRITABLE) && connection->writing) {
+                    startWrite(connection);
+                }
+                return;
+            }
+            if (connection->writing) {
+                startWrite(connection);
+                return;
+            }
+            char buffer[4096];
+            while (connection->in.size() < MAX_REQUEST) {
+                ssize_t n = recv(connection->fd, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    connection->in.append(buffer, static_cast<size_t>(n));
+                } else if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                } else {
+                    closeConnection(id);
+                    return;
+                }
+            }
+            received(connection);
+        });
+    }
+}
+
+void StatusServer::startWrite(const std::shared_ptr<Connection>& connection) {
+    std::string_view data;
+    while (!(data = connection->unsent()).empty()) {
+        ssize_t n = send(connection->fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+            connection->sent += static_cast<size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Streams keep watching for the client closing meanwhile
+            if (!connection->writing) {
+                connection->writing = true;
+                reactor.modify(connection->fd, connection->streaming ? Reactor::READABLE | Reactor::WRITABLE
+                                                                     : Reactor::WRITABLE);
+            }
+            return;
+        } else {
+            closeConnection(connection->id);
+            return;
+        }
+    }
+    if (!connection->streaming) {
+        closeConnection(connection->id);
+        return;
+    }
+    // An event stream waits for the next change
+    if (connection->writing) {
+        connection->writing = false;
+        reactor.modify(connection->fd, Reactor::READABLE);
+    }
+}
+
+void StatusServer::closeConnection(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+    std::shared_ptr<Connection> connection = it->second;
+    connections.erase(it);
+    reactor.cancelTimer(connection->timeout);
+    if (connection->streaming) {
+        pipeline.nowPlaying().unsubscribe(connection->listener);
+        openStreams--;
+    }
+    reactor.unwatch(connection->fd);
+    close(connection->fd);
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "reactor.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+class Discord;
+class Pipeline;
+
+// Optional local HTTP endpoint on the reactor thread. GET /metrics serves
+// stage latencies, pipeline, Discord, TLS, reactor and process counters in
+// Prometheus text format; GET /trace the recorded spans as Chrome trace
+// JSON; GET /now-playing the pipeline's NowPlayingFeed state, and
+// GET /now-playing/events the same as a server-sent event stream, the
+// current state first and then each change. Listens on 127.0.0.1 only, one
+// request per connection.
+class StatusServer {
+public:
+    StatusServer(Reactor& reactor, Pipeline& pipeline, Discord& discord);
+    ~StatusServer();
+
+    StatusServer(const StatusServer&) = delete;
+    StatusServer& operator=(const StatusServer&) = delete;
+
+    // Binds 127.0.0.1:port (0 picks a free one); false if that fails. Both
+    // may be called from any thread; stop() needs the reactor running.
+    bool start(uint16_t port);
+    void stop();
+
+    uint16_t port() const { return boundPort; }
+
+    // Sent as Access-Control-Allow-Origin on the /now-playing endpoints so
+    // pages from that origin (e.g. a browser overlay) can read them; none
+    // when empty. Set before start().
+    void setAllowedOrigin(std::string origin);
+
+    // The /metrics page
+    std::string metricsText() const;
+
+private:
+    struct Connection;
+
+    void received(const std::shared_ptr<Connection>& connection);
+    void startWrite(const std::shared_ptr<Connection>& connection);
+    void closeConnection(uint64_t id);
+    std::string respond(const std::string& request, bool* startStream) const;
+    void startStream(const std::shared_ptr<Connection>& connection);
+    void scheduleStreamWrites();
+    void keepAlive(uint64_t id);
+    void halt();
+
+    Reactor& reactor;
+    Pipeline& pipeline;
+    Discord& discord;
+    uint16_t boundPort = 0;
+    bool listening = false;
+    std::string allowedOrigin;
+    std::atomic<uint32_t> openStreams{0};
+    // Completions and timers hold a weak reference; halt() expires it
+    std::shared_ptr<bool> lifetime;
+
+    // Reactor thread only
+    std::unordered_map<uint64_t, std::shared_ptr<Connection>> connections;
+    uint64_t nextConnection = 1;
+    bool streamWritesPosted = false;
+
+#ifdef _WIN32
+    struct Accept;
+    bool startAccept();
+    void startRead(const std::shared_ptr<Connection>& connection);
+
+    SOCKET listenSocket = INVALID_SOCKET;
+    bool winsockStarted = false;
+#else
+    void listenReady();
+
+    int listenFd = -1;
+#endif
+};
@@ -0,0 +1,273 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+TimerWheel::TimerWheel(Clock::time_point origin) : origin(origin) {
+    std::fill(heads, heads + LEVELS * SLOTS, NONE);
+}
+
+TimerWheel::~TimerWheel() {
+    clear();
+}
+
+uint64_t TimerWheel::tickOf(Clock::time_point t) const {
+    if (t <= origin) {
+        return 0;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin).count();
+    return static_cast<uint64_t>((ns + 999999) / 1000000);
+}
+
+TimerWheel::Node* TimerWheel::find(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id);
+    if (index >= nodes.size()) {
+        return nullptr;
+    }
+    Node& node = nodes[index];
+    if (!node.linked || node.serial != static_cast<uint32_t>(id >> 32)) {
+        return nullptr;
+    }
+    return &node;
+}
+
+TimerWheel::TimerId TimerWheel::schedule(Clock::time_point deadline, Task task) {
+    uint32_t index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    Node& node = nodes[index];
+    if (++node.serial == 0) node.serial = 1;
+    node.task = std::move(task);
+    node.deadline = deadline;
+    node.dueTick = std::max(tickOf(deadline), current + 1);
+    link(index);
+    live++;
+    return (static_cast<uint64_t>(node.serial) << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    Node* node = find(id);
+    if (!node) {
+        return false;
+    }
+    uint32_t index = static_cast<uint32_t>(id);
+    unlink(index);
+    // Destroyed after the wheel is consistent; its captures may cancel too
+    Task doomed = std::move(node->task);
+    release(index);
+    return true;
+}
+
+bool TimerWheel::reschedule(TimerId id, Clock::time_point deadline) {
+    Node* node = find(id);
+    if (!node) {
+        return false;
+    }
+    uint32_t index = static_cast<uint32_t>(id);
+    unlink(index);
+    node->deadline = deadline;
+    node->dueTick = std::max(tickOf(deadline), current + 1);
+    link(index);
+    return true;
+}
+
+// Level l holds timers due 64^l to 64^(l+1) ticks out, in the slot picked
+// by the due tick's digit at that level
+void TimerWheel::link(uint32_t index) {
+    Node& node = nodes[index];
+    uint64_t delta = node.dueTick > current ? node.dueTick - current : 0;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    uint64_t placed = node.dueTick;
+    const uint64_t span = uint64_t(1) << (SLOT_BITS * LEVELS);
+    if (delta >= span) {
+        placed = current + span - 1;  // Beyond the wheel: parked in the furthest top slot
+    }
+
+    int slotIndex = static_cast<int>((placed >> (SLOT_BITS * level)) & (SLOTS - 1));
+    node.slot = static_cast<uint16_t>(level * SLOTS + slotIndex);
+    node.prev = NONE;
+    node.next = heads[node.slot];
+    if (node.next != NONE) {
+        nodes[node.next].prev = index;
+    }
+    heads[node.slot] = index;
+    node.linked = true;
+    occupied[level] |= uint64_t(1) << slotIndex;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = nodes[index];
+    if (node.prev != NONE) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[node.slot] = node.next;
+    }
+    if (node.next != NONE) {
+        nodes[node.next].prev = node.prev;
+    }
+    if (heads[node.slot] == NONE) {
+        occupied[node.slot / SLOTS] &= ~(uint64_t(1) << (node.slot % SLOTS));
+    }
+    node.prev = node.next = NONE;
+    node.linked = false;
+}
+
+void TimerWheel::release(uint32_t index) {
+    nodes[index].task = nullptr;
+    nodes[index].linked = false;
+    freeNodes.push_back(index);
+    live--;
+}
+
+uint64_t TimerWheel::nextEvent(int level) const {
+    uint64_t bits = occupied[level];
+    if (!bits) {
+        return 0;
+    }
+    int shift = SLOT_BITS * level;
+    uint64_t base = current >> shift;
+    int pos = static_cast<int>(base & (SLOTS - 1));
+
+    // Slots after the current one turn this round, the rest next round
+    uint64_t later = pos == SLOTS - 1 ? 0 : bits & (~uint64_t(0) << (pos + 1));
+    uint64_t period = later
+        ? base - pos + lowestBit(later)
+        : base - pos + SLOTS + lowestBit(bits);
+    return period << shift;
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::nextDeadline() const {
+    if (live == 0) {
+        return std::nullopt;
+    }
+    // Each level's next slot to turn holds that level's earliest timers
+    std::optional<Clock::time_point> best;
+    for (int level = 0; level < LEVELS; level++) {
+        uint64_t event = nextEvent(level);
+        if (!event) continue;
+        int slot = level * SLOTS + static_cast<int>((event >> (SLOT_BITS * level)) & (SLOTS - 1));
+        for (uint32_t index = heads[slot]; index != NONE; index = nodes[index].next) {
+            if (!best || nodes[index].deadline < *best) best = nodes[index].deadline;
+        }
+    }
+    return best;
+}
+
+size_t TimerWheel::advance(Clock::time_point now) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - origin).count();
+    uint64_t target = elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+
+    // Jump from one occupied slot to the next instead of tick by tick
+    size_t ran = 0;
+    while (live > 0) {
+        uint64_t next = 0;
+        for (int level = 0; level < LEVELS; level++) {
+            uint64_t event = nextEvent(level);
+            if (event && (!next || event < next)) next = event;
+        }
+        if (!next || next > target) {
+            break;
+        }
+        current = next;
+        cascade(next);
+        ran += fire(next, now);
+    }
+    current = std::max(current, target);
+
+    // The tick in progress: timers whose exact deadline has passed run now
+    // rather than when it completes, so a zero delay means no delay. If it
+    // starts a higher level's slot, bring those timers down first; placed
+    // as seen from the next tick they sit in the same slots from this one.
+    uint64_t pending = current + 1;
+    for (int level = 1; level < LEVELS; level++) {
+        if (nextEvent(level) == pending) {
+            current = pending;
+            cascade(pending);
+            current = pending - 1;
+            break;
+        }
+    }
+    if (occupied[0] & (uint64_t(1) << (pending & (SLOTS - 1)))) {
+        ran += fire(pending, now);
+    }
+    return ran;
+}
+
+// Higher levels whose slot turns at this tick move their timers down
+void TimerWheel::cascade(uint64_t tick) {
+    for (int level = LEVELS - 1; level >= 1; level--) {
+        int shift = SLOT_BITS * level;
+        if (tick & ((uint64_t(1) << shift) - 1)) continue;
+        int slotIndex = static_cast<int>((tick >> shift) & (SLOTS - 1));
+        int slot = level * SLOTS + slotIndex;
+        uint32_t index = heads[slot];
+        heads[slot] = NONE;
+        occupied[level] &= ~(uint64_t(1) << slotIndex);
+        while (index != NONE) {
+            uint32_t next = nodes[index].next;
+            link(index);
+            index = next;
+        }
+    }
+}
+
+size_t TimerWheel::fire(uint64_t tick, Clock::time_point now) {
+    int slot = static_cast<int>(tick & (SLOTS - 1));
+    firing.clear();
+    for (uint32_t index = heads[slot]; index != NONE; index = nodes[index].next) {
+        firing.push_back(index);
+    }
+
+    // Oldest first; an earlier task may have cancelled or replaced a later one
+    size_t ran = 0;
+    for (size_t i = firing.size(); i-- > 0;) {
+        uint32_t index = firing[i];
+        Node& node = nodes[index];
+        if (!node.linked || node.slot != slot || node.dueTick > tick || node.deadline > now) {
+            continue;
+        }
+        unlink(index);
+        Task task = std::move(node.task);
+        release(index);
+        task();
+        ran++;
+    }
+    return ran;
+}
+
+void TimerWheel::clear() {
+    std::vector<Task> doomed;
+    for (uint32_t index = 0; index < nodes.size(); index++) {
+        if (nodes[index].linked) {
+            doomed.push_back(std::move(nodes[index].task));
+            nodes[index].task = nullptr;
+            nodes[index].linked = false;
+            freeNodes.push_back(index);
+        }
+    }
+    std::fill(heads, heads + LEVELS * SLOTS, NONE);
+    std::fill(occupied, occupied + LEVELS, 0);
+    live = 0;
+    // Destroyed last: captures that cancel their own timer now miss
+}
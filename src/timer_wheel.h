@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// Hierarchical timer wheel with 1ms slots: four levels of 64 slots cover
+// about 4.6 hours, later deadlines wait in the top level and are placed
+// again as it turns. Scheduling, cancelling and rescheduling are O(1);
+// advancing skips straight to the next occupied slot, so an idle wheel
+// costs nothing however long the gap. Timers still run at their exact
+// deadline, not rounded to the slot. Not thread-safe.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;  // Never 0
+    using Task = std::function<void()>;
+
+    explicit TimerWheel(Clock::time_point origin = Clock::now());
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    TimerId schedule(Clock::time_point deadline, Task task);
+    // False if the timer already fired or was cancelled
+    bool cancel(TimerId id);
+    bool reschedule(TimerId id, Clock::time_point deadline);
+
+    // Runs every timer due by now, tick by tick; tasks may schedule and
+    // cancel timers but not advance the wheel. Returns how many ran.
+    size_t advance(Clock::time_point now);
+
+    // Deadline of the earliest timer; it may already have passed
+    std::optional<Clock::time_point> nextDeadline() const;
+
+    size_t size() const { return live; }
+    // Drops every timer without running it
+    void clear();
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        uint32_t serial = 0;    // Bumped on every reuse so stale ids miss
+        uint32_t prev = NONE;
+        uint32_t next = NONE;
+        uint16_t slot = 0;      // level * SLOTS + index, valid while linked
+        bool linked = false;
+        uint64_t dueTick = 0;   // Deadline rounded up, and never before current + 1
+        Clock::time_point deadline;
+        Task task;
+    };
+
+    uint64_t tickOf(Clock::time_point t) const;  // Rounded up
+    Node* find(TimerId id);
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    // Tick at which level's first occupied slot is processed, or 0
+    uint64_t nextEvent(int level) const;
+    void cascade(uint64_t tick);
+    size_t fire(uint64_t tick, Clock::time_point now);
+
+    Clock::time_point origin;
+    uint64_t current = 0;  // Last tick processed
+    size_t live = 0;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+    uint32_t heads[LEVELS * SLOTS];
+    uint64_t occupied[LEVELS] = {};  // Bit per non-empty slot
+    std::vector<uint32_t> firing;     // Reused by fire()
+};
@@ -0,0 +1,206 @@
+#include "trace.h"
+#include "json_writer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+static const size_t MAX_THREADS = 64;
+static const int64_t INSTANT = -1;  // Duration marking a point event
+
+// Fields are relaxed atomics so a dump can read a slot while its thread
+// overwrites it; the head counter tells the dump which copies to trust
+struct TraceSlot {
+    std::atomic<const char*> category{nullptr};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<const char*> argName{nullptr};
+    std::atomic<int64_t> beginNs{0};
+    std::atomic<int64_t> durationNs{0};
+    std::atomic<int64_t> arg{0};
+};
+
+struct ThreadTrace {
+    uint32_t tid = 0;
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> head{0};  // Spans ever written; only its thread advances it
+    TraceSlot slots[TRACE_CAPACITY];
+};
+
+static_assert((TRACE_CAPACITY & (TRACE_CAPACITY - 1)) == 0, "TRACE_CAPACITY must be a power of two");
+
+static const TraceClock::time_point g_traceEpoch = TraceClock::now();
+
+// Buffers outlive their threads so a dump still shows them; registration
+// is the only locked step, once per thread
+static std::mutex g_threadsMutex;
+static std::vector<std::unique_ptr<ThreadTrace>> g_threads;
+static thread_local ThreadTrace* t_trace = nullptr;
+static thread_local bool t_traceFull = false;
+
+static ThreadTrace* threadTrace() {
+    if (t_trace || t_traceFull) {
+        return t_trace;
+    }
+    std::lock_guard<std::mutex> lock(g_threadsMutex);
+    if (g_threads.size() >= MAX_THREADS) {
+        t_traceFull = true;
+        return nullptr;
+    }
+    g_threads.push_back(std::make_unique<ThreadTrace>());
+    t_trace = g_threads.back().get();
+    t_trace->tid = static_cast<uint32_t>(g_threads.size());
+    return t_trace;
+}
+
+static int64_t sinceEpochNs(TraceClock::time_point at) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(at - g_traceEpoch).count();
+}
+
+static void record(const char* category, const char* name, int64_t beginNs, int64_t durationNs,
+                   const char* argName, int64_t arg) {
+    ThreadTrace* trace = threadTrace();
+    if (!trace) {
+        return;
+    }
+    uint64_t index = trace->head.load(std::memory_order_relaxed);
+    // Keeps the slot stores below from becoming visible ahead of the head
+    // published for the previous span; pairs with copyEvents' acquire fence
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceSlot& slot = trace->slots[index & (TRACE_CAPACITY - 1)];
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.argName.store(argName, std::memory_order_relaxed);
+    slot.beginNs.store(beginNs, std::memory_order_relaxed);
+    slot.durationNs.store(durationNs, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    trace->head.store(index + 1, std::memory_order_release);
+}
+
+void traceSpan(const char* category, const char* name, TraceClock::time_point begin,
+               TraceClock::time_point end, const char* argName, int64_t arg) {
+    int64_t beginNs = sinceEpochNs(begin);
+    int64_t durationNs = sinceEpochNs(end) - beginNs;
+    record(category, name, beginNs, durationNs > 0 ? durationNs : 0, argName, arg);
+}
+
+void traceInstant(const char* category, const char* name, const char* argName, int64_t arg) {
+    record(category, name, sinceEpochNs(TraceClock::now()), INSTANT, argName, arg);
+}
+
+void traceThreadName(const char* name) {
+    if (ThreadTrace* trace = threadTrace()) {
+        trace->name.store(name, std::memory_order_relaxed);
+    }
+}
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    const char* argName;
+    int64_t beginNs;
+    int64_t durationNs;
+    int64_t arg;
+};
+
+// Copies the slots, then keeps only those the thread cannot have started
+// overwriting while they were read
+static void copyEvents(const ThreadTrace& trace, std::vector<TraceEvent>& events) {
+    events.clear();
+    uint64_t end = trace.head.load(std::memory_order_acquire);
+    uint64_t begin = end > TRACE_CAPACITY ? end - TRACE_CAPACITY : 0;
+    events.reserve(static_cast<size_t>(end - begin));
+    for (uint64_t i = begin; i < end; i++) {
+        const TraceSlot& slot = trace.slots[i & (TRACE_CAPACITY - 1)];
+        events.push_back({slot.category.load(std::memory_order_relaxed),
+                          slot.name.load(std::memory_order_relaxed),
+                          slot.argName.load(std::memory_order_relaxed),
+                          slot.beginNs.load(std::memory_order_relaxed),
+                          slot.durationNs.load(std::memory_order_relaxed),
+                          slot.arg.load(std::memory_order_relaxed)});
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = trace.head.load(std::memory_order_relaxed);
+    // Slot of span `after` may be half written, which clobbers span after - CAPACITY
+    uint64_t firstIntact = after + 1 > TRACE_CAPACITY ? after + 1 - TRACE_CAPACITY : 0;
+    if (firstIntact > begin) {
+        size_t torn = static_cast<size_t>(std::min<uint64_t>(firstIntact - begin, events.size()));
+        events.erase(events.begin(), events.begin() + torn);
+    }
+}
+
+// Chrome wants microseconds; keep the nanoseconds as decimals
+static std::string micros(int64_t ns) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld.%03lld",
+        static_cast<long long>(ns / 1000), static_cast<long long>(ns % 1000));
+    return buf;
+}
+
+std::string chromeTraceJson() {
+#ifdef _WIN32
+    int64_t pid = _getpid();
+#else
+    int64_t pid = getpid();
+#endif
+    std::vector<ThreadTrace*> threads;
+    {
+        std::lock_guard<std::mutex> lock(g_threadsMutex);
+        for (const auto& trace : g_threads) {
+            threads.push_back(trace.get());
+        }
+    }
+
+    std::string out;
+    JsonWriter writer(out);
+    writer.beginObject().key("traceEvents").beginArray();
+    std::vector<TraceEvent> events;
+    for (ThreadTrace* trace : threads) {
+        int64_t tid = trace->tid;
+        if (const char* name = trace->name.load(std::memory_order_relaxed)) {
+            writer.beginObject()
+                .field("name", "thread_name").field("ph", "M")
+                .field("pid", pid).field("tid", tid)
+                .key("args").beginObject().field("name", name).endObject()
+                .endObject();
+        }
+
+        copyEvents(*trace, events);
+        for (const TraceEvent& event : events) {
+            writer.beginObject()
+                .field("cat", event.category).field("name", event.name)
+                .field("ph", event.durationNs == INSTANT ? "i" : "X");
+            writer.key("ts").raw(micros(event.beginNs));
+            if (event.durationNs == INSTANT) {
+                writer.field("s", "t");
+            } else {
+                writer.key("dur").raw(micros(event.durationNs));
+            }
+            writer.field("pid", pid).field("tid", tid);
+            if (event.argName) {
+                writer.key("args").beginObject().field(event.argName, event.arg).endObject();
+            }
+            writer.endObject();
+        }
+    }
+    writer.endArray().field("displayTimeUnit", "ns").endObject();
+    return out;
+}
+
+bool writeChromeTrace(const std::string& path) {
+    std::string json = chromeTraceJson();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    return static_cast<bool>(file);
+}
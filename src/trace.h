@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Always-on span recorder. Each thread writes its own ring buffer of the
+// last TRACE_CAPACITY spans without locks; a dump from any thread copies
+// whatever is consistent and renders it as Chrome trace_event JSON, for
+// chrome://tracing or ui.perfetto.dev.
+//
+// Category, name and argument name are stored by pointer, so they must be
+// string literals (or otherwise live for the whole process).
+
+using TraceClock = std::chrono::steady_clock;
+
+constexpr size_t TRACE_CAPACITY = 2048;  // Spans kept per thread
+
+// Records a finished span on the calling thread, with an optional integer
+// argument shown in the trace viewer
+void traceSpan(const char* category, const char* name, TraceClock::time_point begin,
+               TraceClock::time_point end, const char* argName = nullptr, int64_t arg = 0);
+
+// Records a point in time, e.g. a cache hit
+void traceInstant(const char* category, const char* name, const char* argName = nullptr, int64_t arg = 0);
+
+// Names the calling thread in dumps
+void traceThreadName(const char* name);
+
+// Times the enclosing scope
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name)
+        : category(category), name(name), begin(TraceClock::now()) {}
+    ~TraceScope() { traceSpan(category, name, begin, TraceClock::now(), argName, arg); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    void setArg(const char* name, int64_t value) {
+        argName = name;
+        arg = value;
+    }
+
+private:
+    const char* category;
+    const char* name;
+    TraceClock::time_point begin;
+    const char* argName = nullptr;
+    int64_t arg = 0;
+};
+
+// Every thread's recorded spans as a Chrome trace_event JSON document
+std::string chromeTraceJson();
+
+// Writes chromeTraceJson() to path; false if the file can't be written
+bool writeChromeTrace(const std::string& path);
@@ -1,14 +1,21 @@
 #include "tray_icon.h"
+#include "log.h"
+#include "pixel_kernels.h"
 
 #ifdef _WIN32
 // GDI+ requires specific include order
 #include <objidl.h>
 #include <gdiplus.h>
-#include <iostream>
-#include <vector>
+#include <algorithm>
 
 #pragma comment(lib, "gdiplus.lib")
 
+// The idle icon's brightness, in 1/256ths
+static const uint8_t GRAY_BRIGHTNESS = 154;
+// Premultiplied: Plex orange, and a translucent dark track under it
+static const uint32_t PROGRESS_COLOR = 0xFFE5A00Du;
+static const uint32_t TRACK_COLOR = 0x60000000u;
+
 static ULONG_PTR gdiplusToken = 0;
 static int gdiplusRefCount = 0;
 
@@ -33,6 +40,7 @@ TrayIcon::TrayIcon() {
 TrayIcon::~TrayIcon() {
     if (hColorIcon) DestroyIcon(hColorIcon);
     if (hGrayIcon) DestroyIcon(hGrayIcon);
+    if (hProgressIcon) DestroyIcon(hProgressIcon);
     shutdownGdiPlus();
 }
 
@@ -40,7 +48,7 @@ bool TrayIcon::load(const std::wstring& pngPath) {
     // Load PNG using GDI+
     Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile(pngPath.c_str());
     if (!bitmap || bitmap->GetLastStatus() != Gdiplus::Ok) {
-        std::cerr << "[TrayIcon] Failed to load PNG from file" << std::endl;
+        logError("TrayIcon") << "Failed to load PNG from file";
         delete bitmap;
         return false;
     }
@@ -53,13 +61,13 @@ bool TrayIcon::load(const std::wstring& pngPath) {
 bool TrayIcon::loadFromResource(HINSTANCE hInstance, int resourceId) {
     HRSRC hRes = FindResource(hInstance, MAKEINTRESOURCE(resourceId), RT_RCDATA);
     if (!hRes) {
-        std::cerr << "[TrayIcon] Resource not found: " << resourceId << std::endl;
+        logError("TrayIcon") << "Resource not found: " << resourceId;
         return false;
     }
 
     HGLOBAL hData = LoadResource(hInstance, hRes);
     if (!hData) {
-        std::cerr << "[TrayIcon] Failed to load resource" << std::endl;
+        logError("TrayIcon") << "Failed to load resource";
         return false;
     }
 
@@ -67,7 +75,7 @@ bool TrayIcon::loadFromResource(HINSTANCE hInstance, int resourceId) {
     DWORD size = SizeofResource(hInstance, hRes);
 
     if (!pData || size == 0) {
-        std::cerr << "[TrayIcon] Failed to lock resource" << std::endl;
+        logError("TrayIcon") << "Failed to lock resource";
         return false;
     }
 
@@ -87,7 +95,7 @@ bool TrayIcon::loadFromIconResource(HINSTANCE hInstance, int iconId) {
     );
 
     if (!hLoadedIcon) {
-        std::cerr << "[TrayIcon] Failed to load icon resource: " << iconId << std::endl;
+        logError("TrayIcon") << "Failed to load icon resource: " << iconId;
         return false;
     }
 
@@ -110,7 +118,7 @@ bool TrayIcon::loadFromIconResource(HINSTANCE hInstance, int iconId) {
     DeleteObject(iconInfo.hbmMask);
     DeleteObject(hGrayBitmap);
 
-    std::cout << "[TrayIcon] Loaded icons from resource (" << iconSize << "x" << iconSize << ")" << std::endl;
+    logInfo("TrayIcon") << "Loaded icons from resource (" << iconSize << "x" << iconSize << ")";
     return hColorIcon != nullptr && hGrayIcon != nullptr;
 }
 
@@ -133,7 +141,7 @@ bool TrayIcon::loadFromMemory(const void* data, size_t size) {
     pStream->Release();
 
     if (!bitmap || bitmap->GetLastStatus() != Gdiplus::Ok) {
-        std::cerr << "[TrayIcon] Failed to load PNG from memory" << std::endl;
+        logError("TrayIcon") << "Failed to load PNG from memory";
         delete bitmap;
         return false;
     }
@@ -173,7 +181,7 @@ bool TrayIcon::createIconsFromBitmap(void* bitmapPtr) {
     DeleteObject(hGrayBitmap);
     delete resized;
 
-    std::cout << "[TrayIcon] Loaded icons (" << iconSize << "x" << iconSize << ")" << std::endl;
+    logInfo("TrayIcon") << "Loaded icons (" << iconSize << "x" << iconSize << ")";
     return hColorIcon != nullptr && hGrayIcon != nullptr;
 }
 
@@ -197,11 +205,6 @@ HICON TrayIcon::createIconFromBitmap(HBITMAP hBitmap, int width, int height) {
 }
 
 HBITMAP TrayIcon::createGrayscaleBitmap(HBITMAP hSource, int width, int height) {
-    HDC hdcScreen = GetDC(nullptr);
-    HDC hdcSrc = CreateCompatibleDC(hdcScreen);
-    HDC hdcDst = CreateCompatibleDC(hdcScreen);
-
-    // Create 32-bit destination bitmap
     BITMAPINFO bmi = {0};
     bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
     bmi.bmiHeader.biWidth = width;
@@ -210,43 +213,71 @@ HBITMAP TrayIcon::createGrayscaleBitmap(HBITMAP hSource, int width, int height)
     bmi.bmiHeader.biBitCount = 32;
     bmi.bmiHeader.biCompression = BI_RGB;
 
-    void* srcBits = nullptr;
-    void* dstBits = nullptr;
-
-    HBITMAP hDstBitmap = CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &dstBits, nullptr, 0);
-
-    // Get source bits
-    SelectObject(hdcSrc, hSource);
-    SelectObject(hdcDst, hDstBitmap);
-
-    // Copy and convert to grayscale
-    BITMAPINFO srcBmi = bmi;
-    std::vector<BYTE> srcBuffer(width * height * 4);
-    GetDIBits(hdcSrc, hSource, 0, height, srcBuffer.data(), &srcBmi, DIB_RGB_COLORS);
-
-    BYTE* src = srcBuffer.data();
-    BYTE* dst = static_cast<BYTE*>(dstBits);
+    // Keep the source pixels; progress icons are drawn over them
+    HDC hdcScreen = GetDC(nullptr);
+    colorPixels.assign(static_cast<size_t>(width) * height, 0);
+    GetDIBits(hdcScreen, hSource, 0, height, colorPixels.data(), &bmi, DIB_RGB_COLORS);
+    ReleaseDC(nullptr, hdcScreen);
+    iconWidth = width;
+    iconHeight = height;
 
-    for (int i = 0; i < width * height; i++) {
-        BYTE b = src[i * 4 + 0];
-        BYTE g = src[i * 4 + 1];
-        BYTE r = src[i * 4 + 2];
-        BYTE a = src[i * 4 + 3];
+    // Luminance, then darkened
+    std::vector<uint32_t> gray(colorPixels.size());
+    grayscalePixels(colorPixels.data(), gray.data(), gray.size(), GRAY_BRIGHTNESS);
+    return createBitmap(gray.data(), width, height);
+}
 
-        // Convert to grayscale using luminance formula, then darken
-        BYTE gray = static_cast<BYTE>((r * 0.299 + g * 0.587 + b * 0.114) * 0.6);
+HBITMAP TrayIcon::createBitmap(const uint32_t* pixels, int width, int height) {
+    BITMAPINFO bmi = {0};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height;  // Top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
 
-        dst[i * 4 + 0] = gray;  // B
-        dst[i * 4 + 1] = gray;  // G
-        dst[i * 4 + 2] = gray;  // R
-        dst[i * 4 + 3] = a;     // A (preserve alpha)
+    void* bits = nullptr;
+    HBITMAP hBitmap = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (hBitmap) {
+        memcpy(bits, pixels, static_cast<size_t>(width) * height * sizeof(uint32_t));
     }
+    return hBitmap;
+}
 
-    DeleteDC(hdcSrc);
-    DeleteDC(hdcDst);
-    ReleaseDC(nullptr, hdcScreen);
+HICON TrayIcon::progressIcon(int64_t progressMs, int64_t durationMs) {
+    if (durationMs <= 0 || colorPixels.empty()) {
+        return nullptr;
+    }
+    int64_t clamped = std::clamp<int64_t>(progressMs, 0, durationMs);
+    int step = static_cast<int>(clamped * PROGRESS_STEPS / durationMs);
+    if (step == progressStep && hProgressIcon) {
+        return hProgressIcon;
+    }
 
-    return hDstBitmap;
+    // The kernels composite premultiplied pixels; icons hold straight alpha
+    std::vector<uint32_t> pixels = colorPixels;
+    premultiplyPixels(pixels.data(), pixels.size());
+    float thickness = std::max(2.0f, std::min(iconWidth, iconHeight) / 8.0f);
+    drawProgressRing(pixels.data(), iconWidth, iconHeight, 1.0, thickness, TRACK_COLOR);
+    drawProgressRing(pixels.data(), iconWidth, iconHeight, static_cast<double>(step) / PROGRESS_STEPS, thickness,
+                     PROGRESS_COLOR);
+    unpremultiplyPixels(pixels.data(), pixels.size());
+
+    HBITMAP hBitmap = createBitmap(pixels.data(), iconWidth, iconHeight);
+    HICON hIcon = hBitmap ? createIconFromBitmap(hBitmap, iconWidth, iconHeight) : nullptr;
+    if (hBitmap) {
+        DeleteObject(hBitmap);
+    }
+    if (!hIcon) {
+        return hProgressIcon;
+    }
+    // Created before the old one goes, so the handle always changes
+    if (hProgressIcon) {
+        DestroyIcon(hProgressIcon);
+    }
+    hProgressIcon = hIcon;
+    progressStep = step;
+    return hProgressIcon;
 }
 
 #endif
@@ -2,7 +2,9 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 class TrayIcon {
 public:
@@ -15,14 +17,29 @@ public:
     HICON getColorIcon() const { return hColorIcon; }
     HICON getGrayIcon() const { return hGrayIcon; }
 
+    // The colour icon with a ring around it filled to progressMs of
+    // durationMs, in PROGRESS_STEPS steps; re-rendered only when the step
+    // changes, and the previous one destroyed then. Null when the duration
+    // is unknown.
+    static constexpr int PROGRESS_STEPS = 24;
+    HICON progressIcon(int64_t progressMs, int64_t durationMs);
+
 private:
     bool loadFromMemory(const void* data, size_t size);
     bool createIconsFromBitmap(void* bitmap);  // Gdiplus::Bitmap*
     HICON createIconFromBitmap(HBITMAP hBitmap, int width, int height);
     HBITMAP createGrayscaleBitmap(HBITMAP hSource, int width, int height);
+    HBITMAP createBitmap(const uint32_t* pixels, int width, int height);
 
     HICON hColorIcon = nullptr;
     HICON hGrayIcon = nullptr;
+    HICON hProgressIcon = nullptr;
+    int progressStep = -1;
+    // The colour icon's BGRA pixels, straight alpha, that progress icons
+    // start from; iconWidth x iconHeight, the ring centred on the shorter side
+    std::vector<uint32_t> colorPixels;
+    int iconWidth = 0;
+    int iconHeight = 0;
 };
 
 #endif
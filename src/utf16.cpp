@@ -0,0 +1,159 @@
+#include "utf16.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLEYX_UTF16_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PLEYX_UTF16_NEON 1
+#include <arm_neon.h>
+#endif
+
+static const char16_t REPLACEMENT_CHAR = 0xFFFD;
+static const char16_t ELLIPSIS = 0x2026;
+
+// Widens the ASCII bytes at the start of in[0, count) into out and returns
+// how many there were. May write garbage past that point, but never past
+// out[count - 1].
+static size_t widenAscii(const unsigned char* in, char16_t* out, size_t count) {
+    size_t i = 0;
+#if defined(PLEYX_UTF16_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+        // One bit per byte with the top bit set
+        int mask = _mm_movemask_epi8(bytes);
+        if (mask != 0) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long first;
+            _BitScanForward(&first, static_cast<unsigned long>(mask));
+            return i + first;
+#else
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+#endif
+        }
+    }
+#elif defined(PLEYX_UTF16_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t bytes = vld1q_u8(in + i);
+        if (vmaxvq_u8(bytes) >= 0x80) {
+            break;
+        }
+        vst1q_u16(reinterpret_cast<uint16_t*>(out + i), vmovl_u8(vget_low_u8(bytes)));
+        vst1q_u16(reinterpret_cast<uint16_t*>(out + i + 8), vmovl_u8(vget_high_u8(bytes)));
+    }
+#else
+    for (; i + 8 <= count; i += 8) {
+        uint64_t word;
+        memcpy(&word, in + i, sizeof(word));
+        if (word & 0x8080808080808080ull) {
+            break;
+        }
+        for (size_t k = 0; k < 8; k++) {
+            out[i + k] = in[i + k];
+        }
+    }
+#endif
+    for (; i < count && in[i] < 0x80; i++) {
+        out[i] = in[i];
+    }
+    return i;
+}
+
+// Code point of the well-formed sequence at in[0, remaining), with its
+// length in length; 0 length if invalid
+static char32_t decodeSequence(const unsigned char* in, size_t remaining, size_t& length) {
+    unsigned char lead = in[0];
+    unsigned char lo = 0x80, hi = 0xBF;  // Valid range for the second byte
+    char32_t cp;
+
+    length = 0;
+    size_t len;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        len = 2;
+        cp = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        len = 3;
+        cp = lead & 0x0F;
+        if (lead == 0xE0) lo = 0xA0;       // Overlong
+        else if (lead == 0xED) hi = 0x9F;  // Surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        len = 4;
+        cp = lead & 0x07;
+        if (lead == 0xF0) lo = 0x90;       // Overlong
+        else if (lead == 0xF4) hi = 0x8F;  // Beyond U+10FFFF
+    } else {
+        return 0;
+    }
+
+    if (len > remaining || in[1] < lo || in[1] > hi) return 0;
+    for (size_t k = 1; k < len; k++) {
+        if (in[k] < 0x80 || in[k] > 0xBF) return 0;
+        cp = (cp << 6) | (in[k] & 0x3F);
+    }
+    length = len;
+    return cp;
+}
+
+// utf8ToUtf16, also reporting how many bytes of utf8 went into out
+static size_t convert(std::string_view utf8, char16_t* out, size_t capacity, size_t& consumed) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(utf8.data());
+    size_t size = utf8.size();
+    size_t i = 0, o = 0;
+
+    while (i < size && o < capacity) {
+        size_t run = widenAscii(in + i, out + o, std::min(size - i, capacity - o));
+        i += run;
+        o += run;
+        if (i >= size || o >= capacity) break;
+
+        size_t len;
+        char32_t cp = decodeSequence(in + i, size - i, len);
+        if (len == 0) {
+            out[o++] = REPLACEMENT_CHAR;
+            i++;
+        } else if (cp < 0x10000) {
+            out[o++] = static_cast<char16_t>(cp);
+            i += len;
+        } else {
+            if (capacity - o < 2) break;
+            cp -= 0x10000;
+            out[o++] = static_cast<char16_t>(0xD800 + (cp >> 10));
+            out[o++] = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+            i += len;
+        }
+    }
+    consumed = i;
+    return o;
+}
+
+size_t utf8ToUtf16(std::string_view utf8, char16_t* out, size_t capacity) {
+    size_t consumed;
+    return convert(utf8, out, capacity, consumed);
+}
+
+size_t utf8ToUtf16Elided(std::string_view utf8, char16_t* out, size_t capacity) {
+    size_t consumed;
+    size_t length = convert(utf8, out, capacity, consumed);
+    if (consumed == utf8.size() || capacity == 0) {
+        return length;
+    }
+    // Make room for the ellipsis without leaving half a surrogate pair
+    size_t cut = std::min(length, capacity - 1);
+    if (cut > 0 && out[cut - 1] >= 0xD800 && out[cut - 1] <= 0xDBFF) {
+        cut--;
+    }
+    out[cut++] = ELLIPSIS;
+    return cut;
+}
+
+std::u16string toUtf16(std::string_view utf8) {
+    // Never more code units than bytes
+    std::u16string utf16(utf8.size(), u'\0');
+    utf16.resize(utf8ToUtf16(utf8, utf16.data(), utf16.size()));
+    return utf16;
+}
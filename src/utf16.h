@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// UTF-8 to UTF-16 for strings handed to Win32 (tooltips, WinHTTP URLs and
+// headers). Runs of ASCII are widened 16 bytes at a time with SSE2 or NEON.
+// Invalid input (stray continuation bytes, overlong forms, surrogates, code
+// points past U+10FFFF, truncated sequences) becomes U+FFFD one byte at a
+// time, the same as appendJsonString.
+
+// Writes at most capacity code units of utf8 to out and returns how many.
+// Stops at the first character that doesn't fit, so a surrogate pair is
+// never split; no terminator is written.
+size_t utf8ToUtf16(std::string_view utf8, char16_t* out, size_t capacity);
+// The same, but text that doesn't fit ends in U+2026 so the cut shows
+size_t utf8ToUtf16Elided(std::string_view utf8, char16_t* out, size_t capacity);
+
+std::u16string toUtf16(std::string_view utf8);
+
+#ifdef _WIN32
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "Win32 wide strings are UTF-16");
+
+inline size_t utf8ToWide(std::string_view utf8, wchar_t* out, size_t capacity) {
+    return utf8ToUtf16(utf8, reinterpret_cast<char16_t*>(out), capacity);
+}
+
+inline size_t utf8ToWideElided(std::string_view utf8, wchar_t* out, size_t capacity) {
+    return utf8ToUtf16Elided(utf8, reinterpret_cast<char16_t*>(out), capacity);
+}
+
+inline std::wstring toWide(std::string_view utf8) {
+    // Never more code units than bytes
+    std::wstring wide(utf8.size(), L'\0');
+    wide.resize(utf8ToWide(utf8, wide.data(), wide.size()));
+    return wide;
+}
+#endif
@@ -0,0 +1,368 @@
+#include "discord_standin.h"
+#include <nlohmann/json.hpp>
+#include <deque>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+DiscordStandin::DiscordStandin(const DiscordStandinOptions& options)
+    : options(options), rng(options.seed) {
+    endpointPath = options.endpoint.empty() ? DiscordTransport::endpointName(0) : options.endpoint;
+}
+
+DiscordStandin::~DiscordStandin() {
+    stop();
+}
+
+DiscordStandinStats DiscordStandin::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statsData;
+}
+
+bool DiscordStandin::roll(double rate) {
+    if (rate <= 0.0) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+}
+
+std::chrono::milliseconds DiscordStandin::replyDelay() {
+    if (options.jitter.count() <= 0) {
+        return options.latency;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    std::uniform_int_distribution<int64_t> extra(0, options.jitter.count());
+    return options.latency + std::chrono::milliseconds(extra(rng));
+}
+
+void DiscordStandin::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+#ifdef _WIN32
+    SetEvent(stopEvent);
+#endif
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    reapClients(true);
+
+#ifdef _WIN32
+    CloseHandle(stopEvent);
+    stopEvent = nullptr;
+#else
+    close(listenFd);
+    listenFd = -1;
+    unlink(endpointPath.c_str());
+#endif
+}
+
+void DiscordStandin::dropClients() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& client : clients) {
+        client->transport.cancel();
+    }
+}
+
+void DiscordStandin::reapClients(bool all) {
+    std::list<std::unique_ptr<Client>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (all || (*it)->done) {
+                if (all) (*it)->transport.cancel();
+                finished.push_back(std::move(*it));
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& client : finished) {
+        client->thread.join();
+    }
+}
+
+#ifdef _WIN32
+
+bool DiscordStandin::start() {
+    stopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (!stopEvent) {
+        return false;
+    }
+
+    // Refuse to shadow a real Discord client listening on the same pipe
+    if (WaitNamedPipeA(endpointPath.c_str(), 1) || GetLastError() == ERROR_SEM_TIMEOUT) {
+        std::cerr << "[Standin] " << endpointPath << " is already in use" << std::endl;
+        CloseHandle(stopEvent);
+        stopEvent = nullptr;
+        return false;
+    }
+
+    running = true;
+    acceptThread = std::thread(&DiscordStandin::acceptLoop, this);
+    std::cout << "[Standin] Listening on " << endpointPath << std::endl;
+    return true;
+}
+
+void DiscordStandin::acceptLoop() {
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+    while (running) {
+        HANDLE pipe = CreateNamedPipeA(
+            endpointPath.c_str(),
+            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+            PIPE_UNLIMITED_INSTANCES,
+            64 * 1024, 64 * 1024, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            std::cerr << "[Standin] CreateNamedPipe failed: " << GetLastError() << std::endl;
+            break;
+        }
+
+        ResetEvent(overlapped.hEvent);
+        bool connected = ConnectNamedPipe(pipe, &overlapped) != FALSE;
+        if (!connected) {
+            DWORD error = GetLastError();
+            if (error == ERROR_PIPE_CONNECTED) {
+                connected = true;
+            } else if (error == ERROR_IO_PENDING) {
+                HANDLE waitHandles[2] = {overlapped.hEvent, stopEvent};
+                if (WaitForMultipleObjects(2, waitHandles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+                    DWORD unused;
+                    connected = GetOverlappedResult(pipe, &overlapped, &unused, FALSE) != FALSE;
+                } else {
+                    DWORD unused;
+                    CancelIoEx(pipe, &overlapped);
+                    GetOverlappedResult(pipe, &overlapped, &unused, TRUE);
+                }
+            }
+        }
+
+        if (!connected) {
+            CloseHandle(pipe);
+            continue;
+        }
+
+        auto client = std::make_unique<Client>();
+        client->transport.adopt(pipe);
+        Client* raw = client.get();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            statsData.connections++;
+            clients.push_back(std::move(client));
+        }
+        raw->thread = std::thread(&DiscordStandin::serve, this, std::ref(*raw));
+        reapClients(false);
+    }
+
+    CloseHandle(overlapped.hEvent);
+}
+
+#else
+
+bool DiscordStandin::start() {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (endpointPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "[Standin] Socket path too long: " << endpointPath << std::endl;
+        return false;
+    }
+    memcpy(addr.sun_path, endpointPath.c_str(), endpointPath.size() + 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        return false;
+    }
+
+    // Refuse to shadow a live server; clear a stale socket file
+    if (connect(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        std::cerr << "[Standin] " << endpointPath << " is already in use" << std::endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    close(listenFd);
+    unlink(endpointPath.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 ||
+        bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listenFd, 16) != 0) {
+        std::cerr << "[Standin] Failed to listen on " << endpointPath << ": " << strerror(errno) << std::endl;
+        if (listenFd >= 0) close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    running = true;
+    acceptThread = std::thread(&DiscordStandin::acceptLoop, this);
+    std::cout << "[Standin] Listening on " << endpointPath << std::endl;
+    return true;
+}
+
+void DiscordStandin::acceptLoop() {
+    while (running) {
+        // Poll with a short timeout so stop() never waits on a blocked accept
+        pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            reapClients(false);
+            continue;
+        }
+
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        auto client = std::make_unique<Client>();
+        client->transport.adopt(fd);
+        Client* raw = client.get();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            statsData.connections++;
+            clients.push_back(std::move(client));
+        }
+        raw->thread = std::thread(&DiscordStandin::serve, this, std::ref(*raw));
+        reapClients(false);
+    }
+}
+
+#endif
+
+static void sendJson(DiscordTransport& transport, int opcode, const json& message) {
+    transport.writeFrame(opcode, message.dump());
+}
+
+void DiscordStandin::serve(Client& client) {
+    DiscordTransport& transport = client.transport;
+    std::deque<Clock::time_point> recentCommands;  // For the rate limiter
+    bool handshakeDone = false;
+    int opcode;
+    std::string data;
+
+    while (running && transport.readFrame(opcode, data, -1)) {
+        if (opcode == OP_PING) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                statsData.pings++;
+            }
+            transport.writeFrame(OP_PONG, data);
+            continue;
+        }
+        if (opcode == OP_CLOSE) {
+            break;
+        }
+
+        json message = json::parse(data, nullptr, false);
+
+        if (!handshakeDone) {
+            if (opcode != OP_HANDSHAKE || !message.is_object() || message.value("v", 0) != 1 ||
+                !message.contains("client_id")) {
+                sendJson(transport, OP_CLOSE, {{"code", 4000}, {"message", "Invalid handshake"}});
+                break;
+            }
+            handshakeDone = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                statsData.handshakes++;
+            }
+            sendJson(transport, OP_FRAME, {
+                {"cmd", "DISPATCH"},
+                {"evt", "READY"},
+                {"data", {
+                    {"v", 1},
+                    {"config", {{"cdn_host", "cdn.discordapp.com"}, {"environment", "standin"}}},
+                    {"user", {{"id", "0"}, {"username", "standin"}}}
+                }},
+                {"nonce", nullptr}
+            });
+            continue;
+        }
+
+        if (opcode != OP_FRAME || !message.is_object()) {
+            sendJson(transport, OP_CLOSE, {{"code", 4000}, {"message", "Invalid frame"}});
+            break;
+        }
+
+        json nonce = message.value("nonce", json());
+        std::string cmd = message.value("cmd", "");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            statsData.commands++;
+        }
+        if (options.verbose) {
+            std::cout << "[Standin] " << cmd << " nonce=" << nonce.dump() << std::endl;
+        }
+
+        if (roll(options.closeRate)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                statsData.closes++;
+            }
+            sendJson(transport, OP_CLOSE, {{"code", 1000}, {"message", "Injected close"}});
+            break;
+        }
+        if (roll(options.dropRate)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            statsData.dropped++;
+            continue;
+        }
+
+        auto delay = replyDelay();
+        if (delay.count() > 0) {
+            std::this_thread::sleep_for(delay);
+        }
+
+        bool limited = false;
+        if (options.rateLimit > 0) {
+            auto now = Clock::now();
+            while (!recentCommands.empty() && now - recentCommands.front() >= options.rateLimitWindow) {
+                recentCommands.pop_front();
+            }
+            limited = static_cast<int>(recentCommands.size()) >= options.rateLimit;
+            if (!limited) {
+                recentCommands.push_back(now);
+            }
+        }
+
+        if (limited) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                statsData.rateLimited++;
+            }
+            sendJson(transport, OP_FRAME, {
+                {"cmd", cmd},
+                {"evt", "ERROR"},
+                {"data", {{"code", 4000}, {"message", "You are being rate limited."}}},
+                {"nonce", nonce}
+            });
+            continue;
+        }
+
+        json reply = {
+            {"cmd", cmd},
+            {"evt", nullptr},
+            {"data", message.contains("args") && message["args"].is_object()
+                ? message["args"].value("activity", json()) : json()},
+            {"nonce", nonce}
+        };
+        sendJson(transport, OP_FRAME, reply);
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.replies++;
+    }
+
+    // Under the lock so dropClients never cancels a handle being closed
+    std::lock_guard<std::mutex> lock(mutex);
+    transport.close();
+    client.done = true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "discord_transport.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+struct DiscordStandinOptions {
+    std::string endpoint;                  // Socket path / pipe name; empty = discord-ipc-0
+    std::chrono::milliseconds latency{0};  // Added before every reply
+    std::chrono::milliseconds jitter{0};   // Uniform extra latency in [0, jitter]
+    double dropRate = 0.0;                 // Fraction of commands that never get a reply
+    double closeRate = 0.0;                // Fraction of commands answered with CLOSE
+    int rateLimit = 0;                     // Commands allowed per window per client, 0 = off
+    std::chrono::seconds rateLimitWindow{20};
+    uint32_t seed = 1;
+    bool verbose = false;
+};
+
+struct DiscordStandinStats {
+    uint64_t connections = 0;
+    uint64_t handshakes = 0;
+    uint64_t commands = 0;
+    uint64_t replies = 0;
+    uint64_t dropped = 0;
+    uint64_t closes = 0;
+    uint64_t rateLimited = 0;
+    uint64_t pings = 0;
+};
+
+// Stand-in for the Discord client's IPC server. It speaks the handshake and
+// frame protocol on the same endpoint the real client uses and can inject
+// latency, dropped replies, CLOSE frames and rate-limit errors, so the IPC
+// layer can be exercised and measured without Discord.
+class DiscordStandin {
+public:
+    explicit DiscordStandin(const DiscordStandinOptions& options);
+    ~DiscordStandin();
+
+    bool start();
+    void stop();
+
+    // Disconnects every client, as if Discord had restarted
+    void dropClients();
+
+    const std::string& endpoint() const { return endpointPath; }
+    DiscordStandinStats stats() const;
+
+private:
+    struct Client {
+        DiscordTransport transport;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    void acceptLoop();
+    void serve(Client& client);
+    void reapClients(bool all);
+    bool roll(double rate);
+    std::chrono::milliseconds replyDelay();
+
+    DiscordStandinOptions options;
+    std::string endpointPath;
+    std::atomic<bool> running{false};
+    std::thread acceptThread;
+
+    mutable std::mutex mutex;  // Guards clients, rng and statsData
+    std::list<std::unique_ptr<Client>> clients;
+    std::mt19937 rng;
+    DiscordStandinStats statsData;
+
+#ifdef _WIN32
+    HANDLE stopEvent{nullptr};
+#else
+    int listenFd{-1};
+#endif
+};
@@ -0,0 +1,81 @@
+// discord-standin: runs the Discord IPC stand-in server until Enter is pressed.
+
+#include "discord_standin.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void usage() {
+    std::cout <<
+        "Usage: discord-standin [options]\n"
+        "  --endpoint PATH       Socket path or pipe name (default: discord-ipc-0)\n"
+        "  --latency-ms N        Delay before every reply\n"
+        "  --jitter-ms N         Extra random delay in [0, N]\n"
+        "  --drop-rate F         Fraction of commands left unanswered\n"
+        "  --close-rate F        Fraction of commands answered with CLOSE\n"
+        "  --rate-limit N[/S]    Allow N commands per S seconds (default 20) per client\n"
+        "  --seed N              Random seed for injected faults\n"
+        "  --verbose             Log every command\n";
+}
+
+int main(int argc, char** argv) {
+    DiscordStandinOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--endpoint") {
+            options.endpoint = next();
+        } else if (arg == "--latency-ms") {
+            options.latency = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--jitter-ms") {
+            options.jitter = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--drop-rate") {
+            options.dropRate = atof(next());
+        } else if (arg == "--close-rate") {
+            options.closeRate = atof(next());
+        } else if (arg == "--rate-limit") {
+            const char* value = next();
+            options.rateLimit = atoi(value);
+            if (const char* slash = strchr(value, '/')) {
+                options.rateLimitWindow = std::chrono::seconds(atoi(slash + 1));
+            }
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(strtoul(next(), nullptr, 10));
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 2;
+        }
+    }
+
+    DiscordStandin standin(options);
+    if (!standin.start()) {
+        return 1;
+    }
+
+    std::cout << "Press Enter to stop" << std::endl;
+    std::string line;
+    std::getline(std::cin, line);
+    standin.stop();
+
+    DiscordStandinStats stats = standin.stats();
+    std::cout << "connections=" << stats.connections
+              << " handshakes=" << stats.handshakes
+              << " commands=" << stats.commands
+              << " replies=" << stats.replies
+              << " dropped=" << stats.dropped
+              << " closes=" << stats.closes
+              << " rate_limited=" << stats.rateLimited
+              << " pings=" << stats.pings << std::endl;
+    return 0;
+}
@@ -0,0 +1,307 @@
+#include "http_standin.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#define closeSocket closesocket
+static const SOCKET NO_SOCKET = INVALID_SOCKET;
+static const int SEND_FLAGS = 0;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define closeSocket close
+static const int NO_SOCKET = -1;
+static const int SEND_FLAGS = MSG_NOSIGNAL;  // A client gone early is not a reason to die
+#endif
+
+static const size_t MAX_REQUEST = 64 * 1024 * 1024;
+
+static const char* reasonPhrase(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        default: return "Status";
+    }
+}
+
+static bool hasPrefixNoCase(const char* text, const char* prefix) {
+#ifdef _WIN32
+    return _strnicmp(text, prefix, strlen(prefix)) == 0;
+#else
+    return strncasecmp(text, prefix, strlen(prefix)) == 0;
+#endif
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string queryParam(const std::string& query, const std::string& name) {
+    size_t start = 0;
+    while (start <= query.size()) {
+        size_t end = query.find('&', start);
+        if (end == std::string::npos) end = query.size();
+        size_t equals = query.find('=', start);
+        if (equals < end && query.compare(start, equals - start, name) == 0 && equals - start == name.size()) {
+            std::string value;
+            for (size_t i = equals + 1; i < end; i++) {
+                int high, low;
+                if (query[i] == '+') {
+                    value += ' ';
+                } else if (query[i] == '%' && i + 2 < end &&
+                           (high = hexValue(query[i + 1])) >= 0 && (low = hexValue(query[i + 2])) >= 0) {
+                    value += static_cast<char>(high * 16 + low);
+                    i += 2;
+                } else {
+                    value += query[i];
+                }
+            }
+            return value;
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+std::string HttpStandinRequest::header(const std::string& name) const {
+    for (const auto& entry : headers) {
+        if (entry.first.size() == name.size() && hasPrefixNoCase(entry.first.c_str(), name.c_str())) {
+            return entry.second;
+        }
+    }
+    return "";
+}
+
+HttpStandin::HttpStandin(Handler handler, const std::string& host, uint16_t port)
+    : handler(std::move(handler)), host(host), requestedPort(port), listenSocket(NO_SOCKET) {}
+
+HttpStandin::~HttpStandin() {
+    stop();
+}
+
+std::string HttpStandin::url(const std::string& path) const {
+    return "http://" + host + ":" + std::to_string(boundPort) + path;
+}
+
+HttpStandinStats HttpStandin::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statsData;
+}
+
+bool HttpStandin::start() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+#endif
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(requestedPort);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "[HttpStandin] Invalid address: " << host << std::endl;
+        return false;
+    }
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    socklen_t addrLen = sizeof(addr);
+    if (listenSocket == NO_SOCKET ||
+        bind(listenSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listenSocket, 64) != 0 ||
+        getsockname(listenSocket, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        std::cerr << "[HttpStandin] Failed to listen on " << host << ":" << requestedPort << std::endl;
+        if (listenSocket != NO_SOCKET) closeSocket(listenSocket);
+        listenSocket = NO_SOCKET;
+        return false;
+    }
+    boundPort = ntohs(addr.sin_port);
+
+    running = true;
+    acceptThread = std::thread(&HttpStandin::acceptLoop, this);
+    return true;
+}
+
+void HttpStandin::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    reapConnections(true);
+    closeSocket(listenSocket);
+    listenSocket = NO_SOCKET;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void HttpStandin::reapConnections(bool all) {
+    std::list<std::unique_ptr<Connection>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (all || (*it)->done) {
+                finished.push_back(std::move(*it));
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& connection : finished) {
+        connection->thread.join();
+        closeSocket(connection->socket);
+    }
+}
+
+void HttpStandin::acceptLoop() {
+    while (running) {
+        // Poll with a short timeout so stop() never waits on a blocked accept
+#ifdef _WIN32
+        WSAPOLLFD pfd = {listenSocket, POLLRDNORM, 0};
+        int ready = WSAPoll(&pfd, 1, 100);
+#else
+        pollfd pfd = {listenSocket, POLLIN, 0};
+        int ready = poll(&pfd, 1, 100);
+#endif
+        if (ready <= 0) {
+            reapConnections(false);
+            continue;
+        }
+        Socket socket = accept(listenSocket, nullptr, nullptr);
+        if (socket == NO_SOCKET) {
+            continue;
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->socket = socket;
+        Connection* raw = connection.get();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            statsData.connections++;
+            connections.push_back(std::move(connection));
+        }
+        raw->thread = std::thread(&HttpStandin::serve, this, std::ref(*raw));
+        reapConnections(false);
+    }
+}
+
+void HttpStandin::serve(Connection& connection) {
+    Socket socket = connection.socket;
+#ifdef _WIN32
+    DWORD timeout = 5000;
+#else
+    timeval timeout = {5, 0};
+#endif
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+    // Read the request head and any Content-Length body
+    std::string request;
+    char buffer[16384];
+    size_t headerEnd = std::string::npos;
+    size_t expected = 0;
+    while (request.size() < MAX_REQUEST) {
+        int n = static_cast<int>(recv(socket, buffer, sizeof(buffer), 0));
+        if (n <= 0) {
+            break;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+        if (headerEnd == std::string::npos && (headerEnd = request.find("\r\n\r\n")) != std::string::npos) {
+            expected = headerEnd + 4;
+            for (size_t line = request.find("\r\n"); line < headerEnd; line = request.find("\r\n", line + 2)) {
+                if (hasPrefixNoCase(request.c_str() + line + 2, "Content-Length:")) {
+                    expected += strtoul(request.c_str() + line + 17, nullptr, 10);
+                }
+            }
+        }
+        if (headerEnd != std::string::npos && request.size() >= expected) {
+            break;
+        }
+    }
+
+    HttpStandinRequest parsed;
+    size_t methodEnd = request.find(' ');
+    size_t targetEnd = methodEnd == std::string::npos ? std::string::npos : request.find(' ', methodEnd + 1);
+    bool ok = headerEnd != std::string::npos && request.size() >= expected && targetEnd != std::string::npos;
+
+    HttpStandinReply reply;
+    if (ok) {
+        parsed.method = request.substr(0, methodEnd);
+        std::string target = request.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        size_t question = target.find('?');
+        parsed.path = target.substr(0, question);
+        if (question != std::string::npos) {
+            parsed.query = target.substr(question + 1);
+        }
+        for (size_t line = request.find("\r\n"); line < headerEnd; line = request.find("\r\n", line + 2)) {
+            size_t lineEnd = request.find("\r\n", line + 2);
+            size_t colon = request.find(':', line + 2);
+            if (colon < lineEnd) {
+                size_t valueStart = request.find_first_not_of(' ', colon + 1);
+                parsed.headers.emplace_back(request.substr(line + 2, colon - line - 2),
+                    valueStart < lineEnd ? request.substr(valueStart, lineEnd - valueStart) : "");
+            }
+        }
+        parsed.body = request.substr(headerEnd + 4, expected - headerEnd - 4);
+        reply = handler(parsed);
+    } else {
+        reply.status = 400;
+        reply.contentType = "text/plain";
+        reply.body = "Bad request\n";
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        (ok ? statsData.requests : statsData.malformed)++;
+    }
+
+    // Sleep in slices so stop() isn't held up by a long delay
+    auto sendAt = std::chrono::steady_clock::now() + reply.delay;
+    while (running && std::chrono::steady_clock::now() < sendAt) {
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            sendAt - std::chrono::steady_clock::now(), std::chrono::milliseconds(20)));
+    }
+
+    std::string response = "HTTP/1.1 " + std::to_string(reply.status) + " " + reasonPhrase(reply.status) + "\r\n"
+        "Content-Type: " + reply.contentType + "\r\n"
+        "Content-Length: " + std::to_string(reply.body.size()) + "\r\n"
+        "Connection: close\r\n\r\n";
+    if (parsed.method != "HEAD") {
+        response += reply.body;
+    }
+    size_t sent = 0;
+    while (sent < response.size()) {
+        int n = static_cast<int>(send(socket, response.data() + sent, static_cast<int>(response.size() - sent), SEND_FLAGS));
+        if (n <= 0) {
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+#ifdef _WIN32
+    shutdown(socket, SD_SEND);
+#else
+    shutdown(socket, SHUT_WR);
+#endif
+    connection.done = true;
+}
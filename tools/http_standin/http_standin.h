@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+struct HttpStandinRequest {
+    std::string method;
+    std::string path;   // Without the query string
+    std::string query;  // After '?', still percent-encoded
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    // The first header called name (any case), or ""
+    std::string header(const std::string& name) const;
+};
+
+struct HttpStandinReply {
+    int status = 200;
+    std::string contentType = "application/json";
+    std::string body;
+    std::chrono::milliseconds delay{0};  // Held back this long before sending
+};
+
+struct HttpStandinStats {
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+    uint64_t malformed = 0;
+};
+
+// The decoded value of name in a query string, or "" if absent
+std::string queryParam(const std::string& query, const std::string& name);
+
+// Plain HTTP/1.1 server for local stand-ins of the web services pleyx
+// talks to. pleyx sends Connection: close, so each connection carries one
+// request; it gets a thread of its own, so a delayed reply doesn't hold
+// up the others. The handler runs on those threads and must be
+// thread-safe.
+class HttpStandin {
+public:
+    using Handler = std::function<HttpStandinReply(const HttpStandinRequest&)>;
+
+    explicit HttpStandin(Handler handler, const std::string& host = "127.0.0.1", uint16_t port = 0);
+    ~HttpStandin();
+
+    bool start();
+    void stop();
+
+    uint16_t port() const { return boundPort; }
+    std::string url(const std::string& path = "/") const;
+    HttpStandinStats stats() const;
+
+private:
+#ifdef _WIN32
+    using Socket = SOCKET;
+#else
+    using Socket = int;
+#endif
+
+    struct Connection {
+        Socket socket;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    void acceptLoop();
+    void serve(Connection& connection);
+    void reapConnections(bool all);
+
+    Handler handler;
+    std::string host;
+    uint16_t requestedPort;
+    uint16_t boundPort = 0;
+    Socket listenSocket;
+    std::atomic<bool> running{false};
+    std::thread acceptThread;
+
+    mutable std::mutex mutex;  // Guards connections and statsData
+    std::list<std::unique_ptr<Connection>> connections;
+    HttpStandinStats statsData;
+};
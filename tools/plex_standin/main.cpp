@@ -0,0 +1,92 @@
+// plex-standin: runs the synthetic Plex server until Enter is pressed.
+
+#include "plex_standin.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static void usage() {
+    std::cout <<
+        "Usage: plex-standin [options]\n"
+        "  --host ADDR           Listen address (default: 127.0.0.1)\n"
+        "  --port N              Listen port (default: any free port)\n"
+        "  --token TEXT          Required X-Plex-Token, empty to accept any (default: tok)\n"
+        "  --sessions N          Concurrent streams (default: 1)\n"
+        "  --churn N             Streams ending and replaced per minute\n"
+        "  --padding N           Extra summary bytes per item, to grow payloads\n"
+        "  --art-kb N            Size of every artwork image (default: 64)\n"
+        "  --latency-ms N        Delay before every reply\n"
+        "  --jitter-ms N         Extra random delay in [0, N]\n"
+        "  --error-rate F        Fraction of requests answered with HTTP 500\n"
+        "  --malformed-rate F    Fraction of JSON replies cut off halfway\n"
+        "  --seed N              Random seed for churn, jitter and faults\n"
+        "  --verbose             Log every request\n";
+}
+
+int main(int argc, char** argv) {
+    PlexStandinOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--host") {
+            options.host = next();
+        } else if (arg == "--port") {
+            options.port = static_cast<uint16_t>(atoi(next()));
+        } else if (arg == "--token") {
+            options.token = next();
+        } else if (arg == "--sessions") {
+            options.sessions = atoi(next());
+        } else if (arg == "--churn") {
+            options.churnPerMinute = atof(next());
+        } else if (arg == "--padding") {
+            options.padding = static_cast<size_t>(strtoull(next(), nullptr, 10));
+        } else if (arg == "--art-kb") {
+            options.artBytes = static_cast<size_t>(strtoull(next(), nullptr, 10)) * 1024;
+        } else if (arg == "--latency-ms") {
+            options.latency = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--jitter-ms") {
+            options.jitter = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--error-rate") {
+            options.errorRate = atof(next());
+        } else if (arg == "--malformed-rate") {
+            options.malformedRate = atof(next());
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(strtoul(next(), nullptr, 10));
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 2;
+        }
+    }
+
+    PlexStandin standin(options);
+    if (!standin.start()) {
+        return 1;
+    }
+
+    std::cout << "Press Enter to stop" << std::endl;
+    std::string line;
+    std::getline(std::cin, line);
+    standin.stop();
+
+    PlexStandinStats stats = standin.stats();
+    std::cout << "session_requests=" << stats.sessionRequests
+              << " metadata_requests=" << stats.metadataRequests
+              << " art_requests=" << stats.artRequests
+              << " other_requests=" << stats.otherRequests
+              << " unauthorized=" << stats.unauthorized
+              << " errors=" << stats.errors
+              << " malformed=" << stats.malformed
+              << " sessions_started=" << stats.sessionsStarted
+              << " bytes_served=" << stats.bytesServed << std::endl;
+    return 0;
+}
@@ -0,0 +1,296 @@
+#include "plex_standin.h"
+#include "json_writer.h"
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+
+static const char* SHOWS[] = {"The Expanse", "Severance", "Andor", "Dark", "Sh\xC5\x8Dgun",
+                              "Frieren: Beyond Journey's End", "Slow Horses", "The Bear"};
+static const char* MOVIES[] = {"Arrival", "Dune: Part Two", "Spirited Away", "Am\xC3\xA9lie",
+                               "Parasite", "Blade Runner 2049"};
+static const char* ARTISTS[] = {"Massive Attack", "Bj\xC3\xB6rk", "Radiohead", "Boards of Canada"};
+static const char* ALBUMS[] = {"Mezzanine", "Homogenic", "In Rainbows", "Geogaddi"};
+static const char* GENRES[] = {"Drama", "Science Fiction", "Thriller", "Animation", "Comedy", "Mystery"};
+static const char* PLAYERS[] = {"Plex Web", "Plex for Android (TV)", "Plexamp", "Plex for Roku"};
+
+static const int64_t EPISODE_MS = 2700000;
+static const int64_t MOVIE_MS = 7000000;
+static const int64_t TRACK_MS = 330000;
+
+template <typename T, size_t N>
+static const T& pick(const T (&items)[N], uint64_t id) {
+    return items[id % N];
+}
+
+static int64_t durationFor(uint64_t id) {
+    switch (id % 3) {
+        case 0: return EPISODE_MS;
+        case 1: return MOVIE_MS;
+        default: return TRACK_MS;
+    }
+}
+
+PlexStandin::PlexStandin(const PlexStandinOptions& options)
+    : options(options),
+      server([this](const HttpStandinRequest& request) { return handle(request); }, options.host, options.port),
+      rng(options.seed) {
+    static const char LOREM[] = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. ";
+    while (padding.size() < options.padding) {
+        padding += LOREM;
+    }
+    padding.resize(options.padding);
+
+    // Enough of a JPEG for anything that sniffs the type
+    art.assign(options.artBytes, '\x5A');
+    const char jpegStart[] = {'\xFF', '\xD8', '\xFF', '\xE0'};
+    for (size_t i = 0; i < sizeof(jpegStart) && i < art.size(); i++) {
+        art[i] = jpegStart[i];
+    }
+    if (art.size() >= 6) {
+        art[art.size() - 2] = '\xFF';
+        art[art.size() - 1] = '\xD9';
+    }
+
+    lastChurn = Clock::now();
+    for (int i = 0; i < options.sessions; i++) {
+        sessions.push_back({nextId++, lastChurn});
+    }
+    statsData.sessionsStarted = sessions.size();
+}
+
+bool PlexStandin::start() {
+    if (!server.start()) {
+        return false;
+    }
+    std::cout << "[PlexStandin] Serving " << sessions.size() << " sessions on " << url() << std::endl;
+    return true;
+}
+
+void PlexStandin::stop() {
+    server.stop();
+}
+
+PlexStandinStats PlexStandin::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statsData;
+}
+
+bool PlexStandin::roll(double rate) {
+    if (rate <= 0.0) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+}
+
+// Ends churnPerMinute sessions a minute at random, each replaced by a new
+// stream; caller holds the mutex
+void PlexStandin::churn(Clock::time_point now) {
+    double minutes = std::chrono::duration<double, std::ratio<60>>(now - lastChurn).count();
+    lastChurn = now;
+    if (options.churnPerMinute <= 0.0 || sessions.empty()) {
+        return;
+    }
+    churnDue += minutes * options.churnPerMinute;
+    while (churnDue >= 1.0) {
+        churnDue -= 1.0;
+        size_t index = std::uniform_int_distribution<size_t>(0, sessions.size() - 1)(rng);
+        sessions[index] = {nextId++, now};
+        statsData.sessionsStarted++;
+    }
+}
+
+// One Metadata item; the session form adds the User, Player and Session
+// objects /status/sessions carries
+void PlexStandin::appendMetadata(JsonWriter& writer, uint64_t id, int64_t viewOffsetMs, bool full) {
+    uint64_t key = 10000 + id;
+    std::string prefix = "/library/metadata/" + std::to_string(key);
+    int64_t duration = durationFor(id);
+    char guid[48];
+
+    writer.beginObject()
+        .field("ratingKey", std::to_string(key))
+        .field("key", prefix)
+        .field("librarySectionID", std::to_string(1 + id % 3))
+        .field("addedAt", static_cast<int64_t>(1700000000 + id))
+        .field("duration", duration)
+        .field("thumb", prefix + "/thumb/1700000000")
+        .field("art", prefix + "/art/1700000000");
+    if (full) {
+        writer.field("viewOffset", viewOffsetMs);
+    }
+
+    switch (id % 3) {
+        case 0:
+            writer.field("type", "episode")
+                .field("title", "Episode " + std::to_string(1 + id % 10))
+                .field("grandparentTitle", pick(SHOWS, id))
+                .field("parentTitle", "Season " + std::to_string(1 + id % 4))
+                .field("parentIndex", static_cast<int64_t>(1 + id % 4))
+                .field("index", static_cast<int64_t>(1 + id % 10))
+                .field("year", static_cast<int64_t>(2015 + id % 9))
+                .field("grandparentArt", "/library/metadata/" + std::to_string(900000 + id % 8) + "/art/1700000000")
+                .field("contentRating", "TV-MA");
+            snprintf(guid, sizeof(guid), "imdb://tt%07llu", static_cast<unsigned long long>(3230000 + id));
+            break;
+        case 1:
+            writer.field("type", "movie")
+                .field("title", pick(MOVIES, id))
+                .field("year", static_cast<int64_t>(2001 + id % 23))
+                .field("studio", "Studio " + std::to_string(id % 5))
+                .field("contentRating", "PG-13");
+            snprintf(guid, sizeof(guid), "imdb://tt%07llu", static_cast<unsigned long long>(2543164 + id));
+            break;
+        default:
+            writer.field("type", "track")
+                .field("title", "Track " + std::to_string(1 + id % 12))
+                .field("grandparentTitle", pick(ARTISTS, id))
+                .field("parentTitle", pick(ALBUMS, id))
+                .field("index", static_cast<int64_t>(1 + id % 12))
+                .field("parentThumb", "/library/metadata/" + std::to_string(800000 + id % 4) + "/thumb/1700000000");
+            snprintf(guid, sizeof(guid), "mbid://%016llx", static_cast<unsigned long long>(id * 2654435761u));
+            break;
+    }
+    writer.field("summary", "A synthetic item served by plex-standin. " + padding);
+
+    writer.key("Guid").beginArray().beginObject().field("id", guid).endObject().endArray();
+    writer.key("Genre").beginArray()
+        .beginObject().field("tag", pick(GENRES, id)).endObject()
+        .beginObject().field("tag", pick(GENRES, id / 6 + 1)).endObject()
+        .endArray();
+    writer.key("Media").beginArray().beginObject()
+        .field("id", static_cast<int64_t>(key * 3))
+        .field("duration", duration)
+        .field("container", id % 3 == 2 ? "flac" : "mkv")
+        .key("Part").beginArray().beginObject()
+            .field("id", static_cast<int64_t>(key * 5))
+            .field("key", "/library/parts/" + std::to_string(key * 5) + "/1700000000/file")
+            .field("size", static_cast<int64_t>(4000000000LL + key))
+            .field("decision", "directplay")
+        .endObject().endArray()
+        .endObject().endArray();
+
+    if (full) {
+        writer.key("User").beginObject()
+            .field("id", std::to_string(1 + id % 10))
+            .field("title", "user" + std::to_string(id % 10))
+            .endObject();
+        writer.key("Player").beginObject()
+            .field("address", "192.168.1." + std::to_string(10 + id % 200))
+            .field("machineIdentifier", std::to_string(id * 7919))
+            .field("product", pick(PLAYERS, id))
+            .field("state", id % 5 == 3 ? "paused" : "playing")
+            .field("local", true)
+            .endObject();
+        writer.key("Session").beginObject()
+            .field("id", std::to_string(id * 104729))
+            .field("bandwidth", static_cast<int64_t>(9000))
+            .field("location", "lan")
+            .endObject();
+    }
+    writer.endObject();
+}
+
+std::string PlexStandin::sessionsJson() {
+    std::string out;
+    JsonWriter writer(out);
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::time_point now = Clock::now();
+    churn(now);
+
+    writer.beginObject().key("MediaContainer").beginObject()
+        .field("size", static_cast<int64_t>(sessions.size()));
+    if (!sessions.empty()) {
+        writer.key("Metadata").beginArray();
+        for (const Session& session : sessions) {
+            // Playback starts partway in and advances in real time
+            int64_t duration = durationFor(session.id);
+            int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - session.startedAt).count();
+            int64_t offset = (static_cast<int64_t>(session.id * 7919) + elapsed) % duration;
+            appendMetadata(writer, session.id, offset, true);
+        }
+        writer.endArray();
+    }
+    writer.endObject().endObject();
+    return out;
+}
+
+HttpStandinReply PlexStandin::handle(const HttpStandinRequest& request) {
+    HttpStandinReply reply;
+    reply.delay = options.latency;
+    if (options.jitter.count() > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reply.delay += std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(0, options.jitter.count())(rng));
+    }
+
+    // The client sends the token as a header; artwork URLs carry it in the query
+    std::string token = request.header("X-Plex-Token");
+    if (token.empty()) {
+        token = queryParam(request.query, "X-Plex-Token");
+    }
+    if (!options.token.empty() && token != options.token) {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.unauthorized++;
+        reply.status = 401;
+        reply.body = "{}";
+        return reply;
+    }
+
+    if (roll(options.errorRate)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.errors++;
+        reply.status = 500;
+        reply.body = "{}";
+        return reply;
+    }
+
+    const std::string& path = request.path;
+    static const std::string METADATA = "/library/metadata/";
+    uint64_t PlexStandinStats::*counter = &PlexStandinStats::otherRequests;
+    bool json = true;
+    if (path == "/status/sessions") {
+        counter = &PlexStandinStats::sessionRequests;
+        reply.body = sessionsJson();
+    } else if (path.compare(0, METADATA.size(), METADATA) == 0) {
+        size_t end = METADATA.size();
+        while (end < path.size() && isdigit(static_cast<unsigned char>(path[end]))) end++;
+        uint64_t key = strtoull(path.c_str() + METADATA.size(), nullptr, 10);
+        if (end == METADATA.size() || key < 10000) {
+            reply.status = 404;
+            reply.body = "{}";
+        } else if (end == path.size()) {
+            counter = &PlexStandinStats::metadataRequests;
+            JsonWriter writer(reply.body);
+            writer.beginObject().key("MediaContainer").beginObject()
+                .field("size", static_cast<int64_t>(1))
+                .key("Metadata").beginArray();
+            appendMetadata(writer, key - 10000, 0, false);
+            writer.endArray().endObject().endObject();
+        } else {
+            // .../art/..., .../thumb/...
+            counter = &PlexStandinStats::artRequests;
+            reply.contentType = "image/jpeg";
+            reply.body = art;
+            json = false;
+        }
+    } else if (path == "/" || path == "/identity") {
+        reply.body = "{\"MediaContainer\":{\"size\":0,\"friendlyName\":\"plex-standin\","
+            "\"machineIdentifier\":\"plex-standin\",\"version\":\"1.40.0.0000\"}}";
+    } else {
+        reply.status = 404;
+        reply.body = "{}";
+    }
+
+    if (json && reply.status == 200 && roll(options.malformedRate)) {
+        reply.body.resize(reply.body.size() / 2);
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.malformed++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    statsData.*counter += 1;
+    statsData.bytesServed += reply.body.size();
+    if (options.verbose) {
+        std::cout << "[PlexStandin] " << request.method << " " << path << " -> " << reply.status
+                  << " (" << reply.body.size() << " bytes)" << std::endl;
+    }
+    return reply;
+}
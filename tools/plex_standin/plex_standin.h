@@ -0,0 +1,87 @@
+#pragma once
+
+#include "http_standin.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+class JsonWriter;
+
+struct PlexStandinOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;                     // 0 = pick a free port
+    std::string token = "tok";             // Required X-Plex-Token; empty = accept any
+    int sessions = 1;                      // Concurrent streams
+    double churnPerMinute = 0.0;           // Streams ending, each replaced by a new one
+    size_t padding = 0;                    // Extra summary bytes per session, to grow payloads
+    size_t artBytes = 64 * 1024;           // Size of every artwork image
+    std::chrono::milliseconds latency{0};  // Added before every reply
+    std::chrono::milliseconds jitter{0};   // Uniform extra latency in [0, jitter]
+    double errorRate = 0.0;                // Fraction of requests answered with HTTP 500
+    double malformedRate = 0.0;            // Fraction answered with truncated JSON
+    uint32_t seed = 1;
+    bool verbose = false;
+};
+
+struct PlexStandinStats {
+    uint64_t sessionRequests = 0;
+    uint64_t metadataRequests = 0;
+    uint64_t artRequests = 0;
+    uint64_t otherRequests = 0;
+    uint64_t unauthorized = 0;
+    uint64_t errors = 0;        // Injected 500s
+    uint64_t malformed = 0;     // Injected truncated bodies
+    uint64_t sessionsStarted = 0;
+    uint64_t bytesServed = 0;
+};
+
+// Synthetic Plex Media Server for load and latency testing. It serves
+// /status/sessions with a configurable number of concurrent streams
+// (episodes, movies and tracks from ten users, shaped like the real
+// responses), /library/metadata/{id} for any of them and their artwork,
+// and can churn sessions, pad payloads, delay replies and inject errors.
+// Sessions are generated from their id, so a run is reproducible from
+// its seed.
+class PlexStandin {
+public:
+    explicit PlexStandin(const PlexStandinOptions& options);
+
+    bool start();
+    void stop();
+
+    uint16_t port() const { return server.port(); }
+    std::string url(const std::string& path = "") const { return server.url(path); }
+    PlexStandinStats stats() const;
+
+    // The /status/sessions body as it would be served now
+    std::string sessionsJson();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Session {
+        uint64_t id;
+        Clock::time_point startedAt;
+    };
+
+    HttpStandinReply handle(const HttpStandinRequest& request);
+    void churn(Clock::time_point now);
+    void appendMetadata(JsonWriter& writer, uint64_t id, int64_t viewOffsetMs, bool full);
+    bool roll(double rate);
+
+    PlexStandinOptions options;
+    HttpStandin server;
+    std::string padding;
+    std::string art;
+
+    mutable std::mutex mutex;  // Guards everything below
+    std::mt19937 rng;
+    std::vector<Session> sessions;
+    uint64_t nextId = 1;
+    Clock::time_point lastChurn;
+    double churnDue = 0.0;  // Fractional sessions still to replace
+    PlexStandinStats statsData;
+};
@@ -0,0 +1,319 @@
+// pleyx-replay: feeds a session capture (see session_capture.h) through the
+// full pipeline against local stand-ins for Discord, the image host and
+// OMDB, then reports per-cycle latency and the work the pipeline did.
+
+#include "alloc_stats.h"
+#include "discord.h"
+#include "discord_standin.h"
+#include "http_standin.h"
+#include "image_cache.h"
+#include "log.h"
+#include "pipeline.h"
+#include "plex.h"
+#include "reactor.h"
+#include "session_capture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static const char* DISCORD_CLIENT_ID = "1451961488427188355";
+
+struct ReplayOptions {
+    std::string capture;
+    bool fast = false;
+    double speed = 1.0;
+    size_t limit = 0;
+    bool omdb = false;
+    std::string user;
+    std::chrono::milliseconds downloadLatency{0};
+    std::chrono::milliseconds uploadLatency{0};
+    std::chrono::milliseconds omdbLatency{0};
+    bool perCycle = false;
+    bool verbose = false;
+    DiscordStandinOptions discord;
+};
+
+// What the image host and OMDB stand-in were asked to do
+struct Work {
+    std::atomic<uint64_t> downloads{0};
+    std::atomic<uint64_t> uploads{0};
+    std::atomic<uint64_t> omdbLookups{0};
+};
+
+static void usage() {
+    std::cout <<
+        "Usage: pleyx-replay CAPTURE [options]\n"
+        "  --fast                Feed each response as soon as the last cycle finished\n"
+        "                        (default: at the recorded times)\n"
+        "  --speed F             Play the recorded times F times faster\n"
+        "  --limit N             Replay only the first N responses\n"
+        "  --user NAME           Only consider sessions of this Plex user\n"
+        "  --omdb                Enrich through the OMDB stand-in (default: no OMDB key)\n"
+        "  --download-ms N       Art download latency of the image host stand-in\n"
+        "  --upload-ms N         Upload latency of the image host stand-in\n"
+        "  --omdb-ms N           OMDB stand-in latency\n"
+        "  --discord-latency-ms N  Discord stand-in reply latency\n"
+        "  --per-cycle           Print every cycle's latency\n"
+        "  --verbose             Keep pleyx's info logging\n";
+}
+
+static double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+// Art downloads, uploads speaking the catbox protocol and OMDB lookups
+static HttpStandinReply serveImageHost(const HttpStandinRequest& request, const ReplayOptions& options, Work& work) {
+    HttpStandinReply reply;
+    if (request.method == "POST" && request.path == "/user/api.php") {
+        uint64_t n = ++work.uploads;
+        reply.contentType = "text/plain";
+        reply.body = "https://files.catbox.moe/replay" + std::to_string(n) + ".jpg";
+        reply.delay = options.uploadLatency;
+    } else if (request.method == "GET" && request.path == "/omdb/") {
+        uint64_t n = ++work.omdbLookups;
+        char imdbId[16];
+        snprintf(imdbId, sizeof(imdbId), "tt%07llu", static_cast<unsigned long long>(n));
+        // No poster, so artwork still goes through the upload path
+        reply.body = std::string("{\"Response\":\"True\",\"imdbID\":\"") + imdbId + "\",\"Poster\":\"N/A\","
+            "\"Ratings\":[{\"Source\":\"Internet Movie Database\",\"Value\":\"7.9/10\"},"
+            "{\"Source\":\"Rotten Tomatoes\",\"Value\":\"91%\"}]}";
+        reply.delay = options.omdbLatency;
+    } else if (request.method == "GET" && request.path.compare(0, 9, "/library/") == 0) {
+        work.downloads++;
+        reply.contentType = "image/jpeg";
+        reply.body.assign(48 * 1024, '\xAB');
+        reply.delay = options.downloadLatency;
+    } else {
+        reply.status = 404;
+        reply.body = "{}";
+    }
+    return reply;
+}
+
+static bool parseArgs(int argc, char** argv, ReplayOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--fast") {
+            options.fast = true;
+        } else if (arg == "--speed") {
+            options.speed = atof(next());
+        } else if (arg == "--limit") {
+            options.limit = static_cast<size_t>(strtoull(next(), nullptr, 10));
+        } else if (arg == "--user") {
+            options.user = next();
+        } else if (arg == "--omdb") {
+            options.omdb = true;
+        } else if (arg == "--download-ms") {
+            options.downloadLatency = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--upload-ms") {
+            options.uploadLatency = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--omdb-ms") {
+            options.omdbLatency = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--discord-latency-ms") {
+            options.discord.latency = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--per-cycle") {
+            options.perCycle = true;
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else if (arg[0] != '-' && options.capture.empty()) {
+            options.capture = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.capture.empty() && options.speed > 0.0;
+}
+
+int main(int argc, char** argv) {
+    ReplayOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return argc > 1 && (std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h") ? 0 : 2;
+    }
+    if (!options.verbose) {
+        setLogLevel(LogLevel::Warning);
+    }
+
+    std::vector<CapturedResponse> responses;
+    SessionCaptureReader reader;
+    if (!reader.open(options.capture)) {
+        std::cerr << options.capture << " is not a session capture" << std::endl;
+        return 1;
+    }
+    CapturedResponse response;
+    while ((options.limit == 0 || responses.size() < options.limit) && reader.next(response)) {
+        responses.push_back(std::move(response));
+    }
+    if (reader.damaged()) {
+        std::cerr << "Capture is damaged after " << responses.size() << " responses; replaying those" << std::endl;
+    }
+    if (responses.empty()) {
+        std::cerr << "Nothing to replay" << std::endl;
+        return 1;
+    }
+
+#ifndef _WIN32
+    // Keep the Discord stand-in away from a real Discord client's socket
+    char dirTemplate[] = "/tmp/pleyx-replay-XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_RUNTIME_DIR", dir, 1);
+#else
+    std::cout << "Note: close Discord first, the stand-in uses its pipe name" << std::endl;
+#endif
+
+    DiscordStandin discordStandin(options.discord);
+    Work work;
+    HttpStandin imageHost([&options, &work](const HttpStandinRequest& request) {
+        return serveImageHost(request, options, work);
+    });
+    if (!discordStandin.start() || !imageHost.start()) {
+        return 1;
+    }
+    if (options.omdb) {
+        setOmdbApiKey("replay");
+        setOmdbBaseUrl(imageHost.url("/omdb/"));
+    }
+
+    Reactor reactor;
+    std::thread ioThread([&reactor] { reactor.run(); });
+    Discord discord(DISCORD_CLIENT_ID, reactor);
+    PlexClient plex(imageHost.url(""), "replay", options.user);
+    ImageCache imageCache(imageHost.url(""), "replay", imageHost.url("/user/api.php"));
+    Pipeline pipeline(reactor, plex, discord, imageCache, 1);
+
+    // Everything below runs on the reactor thread until done is set
+    std::vector<double> cycleMs;
+    cycleMs.reserve(responses.size());
+    size_t nextResponse = 0;
+    std::atomic<size_t> cyclesDone{0};
+    Clock::time_point replayStart;
+
+    std::function<void()> feedNext;
+    auto feed = [&] {
+        pipeline.inject(responses[nextResponse].body);
+        nextResponse++;
+    };
+    feedNext = [&] {
+        if (nextResponse >= responses.size()) {
+            return;
+        }
+        if (options.fast) {
+            feed();
+            return;
+        }
+        // At the recorded gap from the first response, scaled by speed
+        double offsetUs = (responses[nextResponse].arrivedUs - responses[0].arrivedUs) / options.speed;
+        reactor.runAt(replayStart + std::chrono::microseconds(static_cast<int64_t>(offsetUs)), [&] {
+            feed();
+            feedNext();
+        });
+    };
+    pipeline.setCycleObserver([&](uint64_t cycle, Clock::duration elapsed) {
+        double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+        cycleMs.push_back(ms);
+        if (options.perCycle) {
+            printf("cycle %-6llu %9.3f ms\n", static_cast<unsigned long long>(cycle), ms);
+        }
+        cyclesDone++;
+        if (options.fast) {
+            reactor.post([&] { feedNext(); });
+        }
+    });
+    pipeline.start(nullptr, false);
+
+    // Let the Discord handshake finish so the first cycle isn't charged for it
+    discord.connect().wait_for(std::chrono::seconds(5));
+
+    IpcStats ipcBefore = discord.stats();
+    DiscordStandinStats discordBefore = discordStandin.stats();
+    AllocTotals allocBefore[static_cast<size_t>(AllocTag::Count)];
+    for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); i++) {
+        allocBefore[i] = allocTotals(static_cast<AllocTag>(i));
+    }
+    reactor.post([&] {
+        replayStart = Clock::now();
+        feedNext();
+    });
+    Clock::time_point wallStart = Clock::now();
+
+    // Cycles either finish or are superseded by a newer one while enrich is busy
+    while (cyclesDone + pipeline.stats().superseded < responses.size()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    double wallSecs = std::chrono::duration<double>(Clock::now() - wallStart).count();
+
+    // Wait for Discord to answer the last updates
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    for (IpcStats ipc = discord.stats();
+         ipc.requests > ipc.responses + ipc.failures + ipc.timeouts && Clock::now() < deadline;
+         ipc = discord.stats()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    IpcStats ipc = discord.stats();
+    DiscordStandinStats discordStats = discordStandin.stats();
+    AllocTotals allocAfter[static_cast<size_t>(AllocTag::Count)];
+    for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); i++) {
+        allocAfter[i] = allocTotals(static_cast<AllocTag>(i));
+    }
+
+    pipeline.stop();
+    discord.disconnect();
+    reactor.stop();
+    ioThread.join();
+    discordStandin.stop();
+    imageHost.stop();
+
+    double spanSecs = (responses.back().arrivedUs - responses.front().arrivedUs) / 1e6;
+    PipelineStats stats = pipeline.stats();
+    printf("Replayed %zu responses recorded over %.1fs in %.3fs (%s)\n",
+        responses.size(), spanSecs, wallSecs, options.fast ? "as fast as possible" : "recorded timing");
+    printf("Cycle latency   n=%zu p50=%.3fms p90=%.3fms p99=%.3fms max=%.3fms\n",
+        cycleMs.size(), percentile(cycleMs, 50), percentile(cycleMs, 90),
+        percentile(cycleMs, 99), percentile(cycleMs, 100));
+    printf("Pipeline        parsed=%llu published=%llu superseded=%llu omdb_lookups=%llu\n",
+        static_cast<unsigned long long>(stats.parsed), static_cast<unsigned long long>(stats.published),
+        static_cast<unsigned long long>(stats.superseded), static_cast<unsigned long long>(stats.omdbLookups));
+    printf("Work            omdb_requests=%llu art_downloads=%llu uploads=%llu ipc_writes=%llu ipc_failures=%llu\n",
+        static_cast<unsigned long long>(work.omdbLookups), static_cast<unsigned long long>(work.downloads),
+        static_cast<unsigned long long>(work.uploads),
+        static_cast<unsigned long long>(discordStats.commands - discordBefore.commands),
+        static_cast<unsigned long long>(ipc.failures - ipcBefore.failures));
+    if (allocStatsEnabled()) {
+        // "other" also holds the stand-ins, which run in this process
+        printf("Allocations per response (count/bytes)\n");
+        for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); i++) {
+            double count = static_cast<double>(allocAfter[i].count - allocBefore[i].count) / responses.size();
+            double bytes = static_cast<double>(allocAfter[i].bytes - allocBefore[i].bytes) / responses.size();
+            printf("  %-8s %10.1f %12.0f\n", allocTagName(static_cast<AllocTag>(i)), count, bytes);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+// tls-standin: runs the local HTTPS stand-in server until Enter is pressed.
+
+#include "tls_standin.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static void usage() {
+    std::cout <<
+        "Usage: tls-standin [options]\n"
+        "  --host ADDR           Listen address (default: 127.0.0.1)\n"
+        "  --port N              Listen port (default: any free port)\n"
+        "  --latency-ms N        Simulated round-trip time\n"
+        "  --tls12               Cap the protocol at TLS 1.2\n"
+        "  --no-tickets          Resume from a server-side session-ID cache instead of tickets\n"
+        "  --ca-file PATH        Where to write the test CA certificate\n"
+        "  --body TEXT           Response body for every request\n"
+        "  --verbose             Log every request\n";
+}
+
+int main(int argc, char** argv) {
+    TlsStandinOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--host") {
+            options.host = next();
+        } else if (arg == "--port") {
+            options.port = static_cast<uint16_t>(atoi(next()));
+        } else if (arg == "--latency-ms") {
+            options.latency = std::chrono::milliseconds(atoi(next()));
+        } else if (arg == "--tls12") {
+            options.tls12Only = true;
+        } else if (arg == "--no-tickets") {
+            options.tickets = false;
+        } else if (arg == "--ca-file") {
+            options.caFile = next();
+        } else if (arg == "--body") {
+            options.responseBody = next();
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 2;
+        }
+    }
+
+    TlsStandin standin(options);
+    if (!standin.start()) {
+        return 1;
+    }
+
+    std::cout << "Press Enter to stop" << std::endl;
+    std::string line;
+    std::getline(std::cin, line);
+    standin.stop();
+
+    TlsStandinStats stats = standin.stats();
+    std::cout << "connections=" << stats.connections
+              << " full_handshakes=" << stats.fullHandshakes
+              << " resumed_handshakes=" << stats.resumedHandshakes
+              << " failed_handshakes=" << stats.failedHandshakes
+              << " requests=" << stats.requests << std::endl;
+    return 0;
+}
@@ -0,0 +1,300 @@
+#include "tls_standin.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+static const unsigned char SESSION_ID_CONTEXT[] = "pleyx-tls-standin";
+
+static EVP_PKEY* generateKey() {
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    if (ctx && EVP_PKEY_keygen_init(ctx) == 1 &&
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1) == 1) {
+        EVP_PKEY_keygen(ctx, &key);
+    }
+    EVP_PKEY_CTX_free(ctx);
+    return key;
+}
+
+static bool addExtension(X509* cert, X509V3_CTX* v3, int nid, const char* value) {
+    X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, v3, nid, const_cast<char*>(value));
+    if (!ext) {
+        return false;
+    }
+    bool added = X509_add_ext(cert, ext, -1) == 1;
+    X509_EXTENSION_free(ext);
+    return added;
+}
+
+// Self-signed CA when issuer is null, otherwise a localhost server
+// certificate signed by issuer
+static X509* makeCertificate(EVP_PKEY* key, const char* commonName, X509* issuer, EVP_PKEY* signingKey, long serial) {
+    X509* cert = X509_new();
+    if (!cert) {
+        return nullptr;
+    }
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 7 * 24 * 3600);
+    X509_set_pubkey(cert, key);
+
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>(commonName), -1, -1, 0);
+    X509_set_issuer_name(cert, issuer ? X509_get_subject_name(issuer) : name);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, issuer ? issuer : cert, cert, nullptr, nullptr, 0);
+    bool ok = issuer
+        ? addExtension(cert, &v3, NID_basic_constraints, "CA:FALSE") &&
+          addExtension(cert, &v3, NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1")
+        : addExtension(cert, &v3, NID_basic_constraints, "critical,CA:TRUE") &&
+          addExtension(cert, &v3, NID_key_usage, "critical,keyCertSign,cRLSign");
+
+    if (!ok || X509_sign(cert, signingKey, EVP_sha256()) == 0) {
+        X509_free(cert);
+        return nullptr;
+    }
+    return cert;
+}
+
+// Sleeps once per handshake flight the server sends, so a full handshake
+// costs the same number of round trips it would over a real link
+struct FlightDelay {
+    std::chrono::milliseconds latency;
+    bool peerSpoke = false;
+};
+
+static void onHandshakeMessage(int writeP, int, int contentType, const void* buf, size_t len, SSL*, void* arg) {
+    auto* flight = static_cast<FlightDelay*>(arg);
+    if (contentType != SSL3_RT_HANDSHAKE || len == 0) {
+        return;
+    }
+    if (!writeP) {
+        flight->peerSpoke = true;
+        return;
+    }
+    // Tickets ride along after the handshake; nobody waits on them
+    int type = static_cast<const unsigned char*>(buf)[0];
+    if (flight->peerSpoke && type != SSL3_MT_NEWSESSION_TICKET) {
+        flight->peerSpoke = false;
+        std::this_thread::sleep_for(flight->latency);
+    }
+}
+
+TlsStandin::TlsStandin(const TlsStandinOptions& options) : options(options) {}
+
+TlsStandin::~TlsStandin() {
+    stop();
+    SSL_CTX_free(context);
+}
+
+std::string TlsStandin::url(const std::string& path) const {
+    return "https://localhost:" + std::to_string(boundPort) + path;
+}
+
+TlsStandinStats TlsStandin::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statsData;
+}
+
+bool TlsStandin::createContext() {
+    EVP_PKEY* caKey = generateKey();
+    EVP_PKEY* serverKey = generateKey();
+    X509* caCert = caKey ? makeCertificate(caKey, "Pleyx Test CA", nullptr, caKey, 1) : nullptr;
+    X509* serverCert = (caCert && serverKey) ? makeCertificate(serverKey, "localhost", caCert, caKey, 2) : nullptr;
+
+    bool ok = false;
+    if (serverCert) {
+        if (options.caFile.empty()) {
+            const char* tmp = getenv("TMPDIR");
+            caPath = std::string(tmp && *tmp ? tmp : "/tmp") + "/pleyx-test-ca-" + std::to_string(getpid()) + ".pem";
+        } else {
+            caPath = options.caFile;
+        }
+        if (FILE* file = fopen(caPath.c_str(), "w")) {
+            ok = PEM_write_X509(file, caCert) == 1;
+            fclose(file);
+            ownsCaFile = options.caFile.empty();
+        }
+    }
+
+    if (ok) {
+        context = SSL_CTX_new(TLS_server_method());
+        ok = context &&
+            SSL_CTX_use_certificate(context, serverCert) == 1 &&
+            SSL_CTX_use_PrivateKey(context, serverKey) == 1 &&
+            SSL_CTX_set_session_id_context(context, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1) == 1;
+    }
+    if (ok) {
+        if (options.tls12Only) {
+            SSL_CTX_set_max_proto_version(context, TLS1_2_VERSION);
+        }
+        SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER);
+        if (!options.tickets) {
+            SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
+        }
+    }
+
+    X509_free(serverCert);
+    X509_free(caCert);
+    EVP_PKEY_free(serverKey);
+    EVP_PKEY_free(caKey);
+    return ok;
+}
+
+bool TlsStandin::start() {
+    if (!createContext()) {
+        std::cerr << "[TlsStandin] Failed to create test certificates: "
+                  << ERR_reason_error_string(ERR_get_error()) << std::endl;
+        return false;
+    }
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "[TlsStandin] Invalid address: " << options.host << std::endl;
+        return false;
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    socklen_t addrLen = sizeof(addr);
+    if (listenFd < 0 ||
+        bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listenFd, 16) != 0 ||
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        std::cerr << "[TlsStandin] Failed to listen: " << strerror(errno) << std::endl;
+        if (listenFd >= 0) close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    boundPort = ntohs(addr.sin_port);
+
+    running = true;
+    acceptThread = std::thread(&TlsStandin::acceptLoop, this);
+    std::cout << "[TlsStandin] Listening on " << url() << ", CA in " << caPath << std::endl;
+    return true;
+}
+
+void TlsStandin::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    close(listenFd);
+    listenFd = -1;
+    if (ownsCaFile) {
+        unlink(caPath.c_str());
+    }
+}
+
+void TlsStandin::acceptLoop() {
+    while (running) {
+        // Poll with a short timeout so stop() never waits on a blocked accept
+        pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            serve(fd);
+            close(fd);
+        }
+    }
+}
+
+void TlsStandin::serve(int fd) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.connections++;
+    }
+
+    timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    SSL* ssl = SSL_new(context);
+    if (!ssl) {
+        return;
+    }
+    SSL_set_fd(ssl, fd);
+    FlightDelay flight{options.latency};
+    if (options.latency.count() > 0) {
+        SSL_set_msg_callback(ssl, onHandshakeMessage);
+        SSL_set_msg_callback_arg(ssl, &flight);
+    }
+
+    if (SSL_accept(ssl) != 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.failedHandshakes++;
+        SSL_free(ssl);
+        return;
+    }
+    bool resumed = SSL_session_reused(ssl) == 1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        (resumed ? statsData.resumedHandshakes : statsData.fullHandshakes)++;
+    }
+
+    // Read the request head and any Content-Length body
+    std::string request;
+    char buffer[4096];
+    size_t headerEnd = std::string::npos;
+    size_t expected = 0;
+    while (true) {
+        int n = SSL_read(ssl, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+        if (headerEnd == std::string::npos && (headerEnd = request.find("\r\n\r\n")) != std::string::npos) {
+            const char* length = strcasestr(request.c_str(), "\r\nContent-Length:");
+            expected = headerEnd + 4 + (length && length < request.c_str() + headerEnd ? strtoul(length + 17, nullptr, 10) : 0);
+        }
+        if (headerEnd != std::string::npos && request.size() >= expected) {
+            break;
+        }
+    }
+
+    if (headerEnd != std::string::npos) {
+        if (options.verbose) {
+            std::cout << "[TlsStandin] " << request.substr(0, request.find("\r\n"))
+                      << (resumed ? " (resumed)" : " (full handshake)") << std::endl;
+        }
+        // One more round trip for the request itself
+        std::this_thread::sleep_for(options.latency);
+        std::string response = "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: " + std::to_string(options.responseBody.size()) + "\r\n"
+            "Connection: close\r\n\r\n" + options.responseBody;
+        SSL_write(ssl, response.data(), static_cast<int>(response.size()));
+        std::lock_guard<std::mutex> lock(mutex);
+        statsData.requests++;
+    }
+
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+typedef struct ssl_ctx_st SSL_CTX;
+
+struct TlsStandinOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;                     // 0 = pick a free port
+    std::chrono::milliseconds latency{0};  // Simulated round-trip time, added once per flight
+    bool tls12Only = false;                // TLS 1.2 needs an extra round trip for a full handshake
+    bool tickets = true;                   // Session tickets, otherwise a server-side session-ID cache
+    std::string caFile;                    // Where to write the test CA; empty = temp file
+    std::string responseBody = "{\"Response\":\"True\"}";
+    bool verbose = false;
+};
+
+struct TlsStandinStats {
+    uint64_t connections = 0;
+    uint64_t fullHandshakes = 0;
+    uint64_t resumedHandshakes = 0;
+    uint64_t failedHandshakes = 0;
+    uint64_t requests = 0;
+};
+
+// Local HTTPS server for exercising the TLS client. It generates a
+// throwaway CA and a localhost certificate signed by it at start(), writes
+// the CA to caFile() for the client to trust, and answers every request
+// with responseBody. Connections are served one at a time.
+class TlsStandin {
+public:
+    explicit TlsStandin(const TlsStandinOptions& options);
+    ~TlsStandin();
+
+    bool start();
+    void stop();
+
+    uint16_t port() const { return boundPort; }
+    const std::string& caFile() const { return caPath; }
+    std::string url(const std::string& path = "/") const;
+    TlsStandinStats stats() const;
+
+private:
+    bool createContext();
+    void acceptLoop();
+    void serve(int fd);
+
+    TlsStandinOptions options;
+    std::string caPath;
+    bool ownsCaFile = false;
+    uint16_t boundPort = 0;
+    SSL_CTX* context = nullptr;
+    int listenFd = -1;
+    std::atomic<bool> running{false};
+    std::thread acceptThread;
+
+    mutable std::mutex mutex;  // Guards statsData
+    TlsStandinStats statsData;
+};